@@ -7,16 +7,45 @@ layout(set = 0, binding = 0) uniform SceneUBO {
 
 layout(set = 1, binding = 0) uniform MaterialUBO {
     vec4 color;
+    vec4 specular; // unused
+    vec4 ambient; // unused
+    vec4 uvTransform; // xy = scale, zw = offset
+    vec4 atlasTransform; // xy = scale, zw = offset of the atlas region
+    vec4 textureLayer; // x = array layer, y = 1 when wrapped inside the region
 } material;
 
-layout(set = 1, binding = 1) uniform sampler2D textureSampler;
+layout(set = 1, binding = 1) uniform sampler2DArray textureSampler;
 
 layout(location = 0) in vec4 fragPos;
 layout(location = 1) in vec3 fragNormal;
 layout(location = 2) in vec2 fragUV;
+layout(location = 3) flat in float fragFade;
 
 layout(location = 0) out vec4 outColor;
 
+// LOD cross-fade dither, same as in default.frag
+layout(constant_id = 0) const bool LOD_DITHER = false;
+
+bool ditherDiscards(float fade) {
+    const float bayer[16] = float[](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    float threshold = (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+    return fade > 0.0 ? threshold >= fade : threshold < -fade;
+}
+
 void main() {
-    outColor = material.color * texture(textureSampler, fragUV);
+    // packed textures wrap inside their atlas region, gradients of the unwrapped UVs pick the mip level.
+    // Sampled before the dither discard, which leaves the derivatives of the quad undefined.
+    vec2 uv = fragUV * material.uvTransform.xy + material.uvTransform.zw;
+    vec2 uvDx = dFdx(uv) * material.atlasTransform.xy;
+    vec2 uvDy = dFdy(uv) * material.atlasTransform.xy;
+    if (material.textureLayer.y > 0.0f)
+        uv = fract(uv);
+    uv = uv * material.atlasTransform.xy + material.atlasTransform.zw;
+    vec4 texel = textureGrad(textureSampler, vec3(uv, material.textureLayer.x), uvDx, uvDy);
+
+    if (LOD_DITHER && ditherDiscards(fragFade))
+        discard;
+
+    outColor = material.color * texel;
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+#version 450
+
+// basic.vert for PackedVertex: positions arrive as unorm inside the mesh
+// bounds and the model transform includes the expansion back to model space
+
+layout(push_constant) uniform PushConstant {
+    mat4 transform;
+    mat4 normal;
+} model;
+
+layout(set = 0, binding = 0) uniform SceneUBO {
+    mat4 viewProjection;
+    vec4 cameraPos;
+} scene;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec2 inNormal;  // octahedral, unlit materials ignore it
+
+layout(location = 0) out vec4 fragPos;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragUV;
+layout(location = 3) flat out float fragFade;  // LOD cross-fade, see the fragment shader
+
+void main() {
+    fragPos = model.transform * vec4(inPosition, 1.0);
+    fragUV = inUV;
+    fragFade = model.normal[3].x;
+
+    gl_Position = scene.viewProjection * fragPos;
+}
@@ -31,16 +31,32 @@ struct Material {
 
 layout(set = 1, binding = 0) uniform MaterialUBO {
     Material material;
+    vec4 uvTransform; // xy = scale, zw = offset
+    vec4 atlasTransform; // xy = scale, zw = offset of the atlas region
+    vec4 textureLayer; // x = array layer, y = 1 when wrapped inside the region
 } u_material;
 
-layout(set = 1, binding = 1) uniform sampler2D baseTexture;
+layout(set = 1, binding = 1) uniform sampler2DArray baseTexture;
 
 layout(location = 0) in vec4 fragPos;
 layout(location = 1) in vec3 fragNormal;
 layout(location = 2) in vec2 fragUV;
+layout(location = 3) flat in float fragFade;
 
 layout(location = 0) out vec4 outColor;
 
+// Pipelines drawing a LOD cross-fade set this, the discard costs early depth
+// testing everywhere else. fragFade > 0 keeps the pixels whose threshold is
+// below it (the incoming level), fragFade < 0 the complement (the outgoing one).
+layout(constant_id = 0) const bool LOD_DITHER = false;
+
+bool ditherDiscards(float fade) {
+    const float bayer[16] = float[](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    float threshold = (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+    return fade > 0.0 ? threshold >= fade : threshold < -fade;
+}
+
 vec4 calcDirectionalLighting(vec3 normal, vec3 viewDir, DirectionalLight light, Material material) {
     // Calculate the direction to the light
     vec3 lightDir = normalize(light.direction.xyz);
@@ -83,6 +99,20 @@ vec4 calcPointLighting(vec3 normal, vec3 viewDir, PointLight light, Material mat
 }
 
 void main() {
+    // Sample the texture, packed textures repeat by wrapping inside their atlas region.
+    // Gradients of the unwrapped UVs keep the mip level from jumping at the seams. They
+    // are taken before the dither discard, which leaves the derivatives of the quad undefined.
+    vec2 uv = fragUV * u_material.uvTransform.xy + u_material.uvTransform.zw;
+    vec2 uvDx = dFdx(uv) * u_material.atlasTransform.xy;
+    vec2 uvDy = dFdy(uv) * u_material.atlasTransform.xy;
+    if (u_material.textureLayer.y > 0.0f)
+        uv = fract(uv);
+    uv = uv * u_material.atlasTransform.xy + u_material.atlasTransform.zw;
+    vec4 texel = textureGrad(baseTexture, vec3(uv, u_material.textureLayer.x), uvDx, uvDy);
+
+    if (LOD_DITHER && ditherDiscards(fragFade))
+        discard;
+
     // Normalize the surface normal
     vec3 normal = normalize(fragNormal);
     // Calculate the direction to the camera
@@ -93,8 +123,5 @@ void main() {
     color += calcDirectionalLighting(normal, viewDir, u_scene.dirLight, u_material.material);
     color += calcPointLighting(normal, viewDir, u_scene.pointLight, u_material.material);
 
-    // Sample the texture
-    vec4 texel = texture(baseTexture, fragUV);
-
     outColor = color * texel ;
 }
\ No newline at end of file
@@ -38,11 +38,13 @@ layout(location = 2) in vec3 inNormal;
 layout(location = 0) out vec4 fragPos;
 layout(location = 1) out vec3 fragNormal;
 layout(location = 2) out vec2 fragUV;
+layout(location = 3) flat out float fragFade;  // LOD cross-fade, see the fragment shader
 
 void main() {
     fragPos = u_model.transform * vec4(inPosition, 1.0);
     fragNormal = mat3(u_model.normal) * inNormal;
     fragUV = inUV;
+    fragFade = u_model.normal[3].x;
 
     gl_Position = u_scene.viewProjection * fragPos;
 }
\ No newline at end of file
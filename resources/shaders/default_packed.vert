@@ -0,0 +1,61 @@
+#version 450
+
+// default.vert for PackedVertex: positions arrive as unorm inside the mesh
+// bounds and the model transform includes the expansion back to model space
+
+layout(push_constant) uniform PushConstant {
+    mat4 transform;
+    mat4 normal;
+} u_model;
+
+struct DirectionalLight {
+    vec4 direction;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 ambient;
+};
+
+struct PointLight {
+    vec4 position;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 ambient;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding;
+};
+
+layout(set = 0, binding = 0) uniform SceneUBO {
+    mat4 viewProjection;
+    vec4 cameraPos;
+
+    DirectionalLight dirLight;
+    PointLight pointLight;
+} u_scene;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec2 inNormal;  // octahedral
+
+layout(location = 0) out vec4 fragPos;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragUV;
+layout(location = 3) flat out float fragFade;  // LOD cross-fade, see the fragment shader
+
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
+
+void main() {
+    fragPos = u_model.transform * vec4(inPosition, 1.0);
+    fragNormal = mat3(u_model.normal) * decodeOctahedral(inNormal);
+    fragUV = inUV;
+    fragFade = u_model.normal[3].x;
+
+    gl_Position = u_scene.viewProjection * fragPos;
+}
@@ -0,0 +1,341 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <stdexcept>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <glm/gtc/constants.hpp>
+#include "SceneGenerator.h"
+#include "Statistics.h"
+#include "../Core/Time.h"
+#include "../Core/Profiler.h"
+#include "../Modules/Renderer/Renderer.h"
+#include "../Modules/Scene/Gltf.h"
+
+// Headless, deterministic benchmark: builds a generated scene, renders a fixed
+// number of frames along a fixed camera path and reports frame statistics as JSON.
+//
+//   VulkanSandboxBench --nodes 5000 --depth 3 --frames 600 --out result.json
+//   VulkanSandboxBench --gltf models/sponza/Sponza.gltf --frames 600
+
+namespace
+{
+	struct BenchConfig
+	{
+		SceneGeneratorConfig Scene;
+		std::string GltfPath;		// replaces the generated scene when set
+		LodSettings Lod;
+		MeshletSettings Meshlets;
+		uint32_t WarmupFrames = 60;
+		uint32_t Frames = 600;
+		uint32_t Width = 1280;
+		uint32_t Height = 720;
+		std::string OutputPath = "bench.json";	// "-" writes to stdout
+		std::string ScreenshotPath;
+		std::string TracePath;
+	};
+
+	// JSON string contents, quotes, backslashes and control characters escaped
+	void WriteEscaped(std::ostream& out, const std::string& text)
+	{
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				out << '\\' << c;
+			else if (static_cast<unsigned char>(c) < 0x20)
+			{
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+				out << escaped;
+			}
+			else
+				out << c;
+		}
+	}
+
+	void PrintUsage()
+	{
+		std::cout <<
+			"usage: VulkanSandboxBench [options]\n"
+			"  --nodes <n>          number of scene nodes (1000)\n"
+			"  --depth <n>          hierarchy depth (3)\n"
+			"  --fanout <n>         children per node (8)\n"
+			"  --reuse <0..1>       chance to reuse an existing mesh (0.9)\n"
+			"  --default <w>        weight of Default materials (0.6)\n"
+			"  --basic <w>          weight of Basic materials (0.3)\n"
+			"  --wireframe <w>      weight of Wireframe materials (0.1)\n"
+			"  --textured           use image textures\n"
+			"  --packed             use the 16 byte packed vertex layout\n"
+			"  --seed <n>           random seed (1337)\n"
+			"  --gltf <file>        render a glTF scene under resources/assets/ instead\n"
+			"  --no-lod             always draw the full level of detail\n"
+			"  --lod-error <px>     screen space error allowed for coarser levels (1)\n"
+			"  --lod-fade           dither between levels when they switch\n"
+			"  --no-meshlets        cull whole objects only\n"
+			"  --no-mesh-shaders    cull meshlets in compute even where mesh shaders are supported\n"
+			"  --warmup <n>         frames rendered before measuring (60)\n"
+			"  --frames <n>         measured frames (600)\n"
+			"  --width <n>          render width (1280)\n"
+			"  --height <n>         render height (720)\n"
+			"  --out <file>         JSON report path, - for stdout (bench.json)\n"
+			"  --screenshot <file>  save the last frame as PNG\n"
+			"  --trace <file>       write the measured frames as a Chrome trace (needs VS_ENABLE_PROFILER)\n";
+	}
+
+	bool ParseArguments(int argc, char** argv, BenchConfig& config)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			auto next = [&]() -> const char*
+			{
+				if (i + 1 >= argc)
+					throw std::runtime_error("missing value for " + arg);
+				return argv[++i];
+			};
+
+			if (arg == "--nodes") config.Scene.NodeCount = std::stoul(next());
+			else if (arg == "--depth") config.Scene.Depth = std::stoul(next());
+			else if (arg == "--fanout") config.Scene.FanOut = std::stoul(next());
+			else if (arg == "--reuse") config.Scene.MeshReuse = std::stof(next());
+			else if (arg == "--default") config.Scene.DefaultWeight = std::stof(next());
+			else if (arg == "--basic") config.Scene.BasicWeight = std::stof(next());
+			else if (arg == "--wireframe") config.Scene.WireframeWeight = std::stof(next());
+			else if (arg == "--textured") config.Scene.Textured = true;
+			else if (arg == "--packed") config.Scene.PackedVertices = true;
+			else if (arg == "--seed") config.Scene.Seed = std::stoul(next());
+			else if (arg == "--gltf") config.GltfPath = next();
+			else if (arg == "--no-lod") config.Lod.Enabled = false;
+			else if (arg == "--lod-error") config.Lod.PixelError = std::stof(next());
+			else if (arg == "--lod-fade") config.Lod.CrossFade = true;
+			else if (arg == "--no-meshlets") config.Meshlets.Enabled = false;
+			else if (arg == "--no-mesh-shaders") config.Meshlets.MeshShaders = false;
+			else if (arg == "--warmup") config.WarmupFrames = std::stoul(next());
+			else if (arg == "--frames") config.Frames = std::stoul(next());
+			else if (arg == "--width") config.Width = std::stoul(next());
+			else if (arg == "--height") config.Height = std::stoul(next());
+			else if (arg == "--out") config.OutputPath = next();
+			else if (arg == "--screenshot") config.ScreenshotPath = next();
+			else if (arg == "--trace") config.TracePath = next();
+			else if (arg == "--help" || arg == "-h")
+			{
+				PrintUsage();
+				return false;
+			}
+			else
+				throw std::runtime_error("unknown argument " + arg);
+		}
+
+		config.Frames = std::max(config.Frames, 1u);
+		return true;
+	}
+
+	// Orbits the scene once over the measured frames, looking at the origin
+	void PlaceCamera(Camera& camera, float radius, uint32_t frame, uint32_t frameCount)
+	{
+		float angle = glm::two_pi<float>() * static_cast<float>(frame) / static_cast<float>(frameCount);
+		float distance = std::max(radius, 2.0f) * 1.25f;
+		camera.Position = glm::vec3(std::cos(angle) * distance, distance * 0.5f, std::sin(angle) * distance);
+
+		glm::vec3 direction = glm::normalize(-camera.Position);
+		camera.Rotation.x = glm::degrees(std::asin(direction.y));
+		camera.Rotation.y = glm::degrees(std::atan2(direction.z, direction.x));
+		camera.UpdateRotation();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchConfig config;
+	try
+	{
+		if (!ParseArguments(argc, argv, config))
+			return EXIT_SUCCESS;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		Timer setupTimer;
+
+		Camera camera;
+		SceneGraph scene;
+		scene.Initialize();
+
+		GeneratedSceneInfo info{};
+		uint64_t importedTriangles = 0;
+		if (config.GltfPath.empty())
+		{
+			SceneGenerator generator(config.Scene);
+			info = generator.Generate(scene);
+		}
+		else
+		{
+			GltfImportResult imported = Gltf::Import(config.GltfPath, scene);
+			SceneGenerator::AddLights(scene);
+			info.NodeCount = imported.NodeCount;
+			info.MeshVariants = imported.ModelCount;
+			info.Radius = imported.Radius;
+			importedTriangles = imported.TriangleCount;
+		}
+
+		Renderer renderer(camera, scene, config.Width, config.Height);
+		renderer.Initialize();
+		renderer.SetLodSettings(config.Lod);
+		renderer.SetMeshletSettings(config.Meshlets);
+		// measure with every texture resident, not the placeholders
+		renderer.FinishTextureLoads();
+
+		double setupMs = setupTimer.GetElapsed() * 1000.0;
+
+		uint32_t totalFrames = config.WarmupFrames + config.Frames;
+		std::vector<double> cpuFrameMs, renderCpuMs, fenceWaitMs, gpuFrameMs, gpuSceneMs, drawCalls, pipelineBinds, descriptorSetBinds, meshBinds, triangles, culledObjects, meshlets;
+		cpuFrameMs.reserve(config.Frames);
+		renderCpuMs.reserve(config.Frames);
+		fenceWaitMs.reserve(config.Frames);
+		gpuFrameMs.reserve(config.Frames);
+		gpuSceneMs.reserve(config.Frames);
+		drawCalls.reserve(config.Frames);
+		pipelineBinds.reserve(config.Frames);
+		descriptorSetBinds.reserve(config.Frames);
+		meshBinds.reserve(config.Frames);
+		triangles.reserve(config.Frames);
+		culledObjects.reserve(config.Frames);
+		meshlets.reserve(config.Frames);
+
+		PROFILE_THREAD("Main");
+		uint64_t firstTraceFrame = Profiler::GetFrame() + config.WarmupFrames + 1;
+
+		Timer frameTimer;
+		for (uint32_t frame = 0; frame < totalFrames; frame++)
+		{
+			PROFILE_FRAME();
+			{
+				std::lock_guard<std::mutex> lock(scene.GetMutex());
+				PlaceCamera(camera, info.Radius, frame, totalFrames);
+				scene.PublishSnapshot(camera);
+			}
+
+			frameTimer.Reset();
+			renderer.Update(1.0f / 60.0f);
+			double frameMs = frameTimer.GetElapsed() * 1000.0;
+
+			if (frame < config.WarmupFrames)
+				continue;
+
+			const RenderStats& stats = renderer.GetStats();
+			cpuFrameMs.push_back(frameMs);
+			renderCpuMs.push_back(stats.CpuFrameMs);
+			fenceWaitMs.push_back(stats.FenceWaitMs);
+			if (renderer.GetGpuProfiler().IsSupported())
+			{
+				gpuFrameMs.push_back(stats.GpuFrameMs);
+				gpuSceneMs.push_back(renderer.GetGpuProfiler().GetTiming("Scene"));
+			}
+			drawCalls.push_back(stats.DrawCalls);
+			pipelineBinds.push_back(stats.PipelineBinds);
+			descriptorSetBinds.push_back(stats.DescriptorSetBinds);
+			meshBinds.push_back(stats.MeshBinds);
+			triangles.push_back(static_cast<double>(stats.Triangles));
+			culledObjects.push_back(stats.CulledObjects);
+			meshlets.push_back(stats.Meshlets);
+		}
+
+		renderer.WaitIdle();
+		if (!config.ScreenshotPath.empty())
+			renderer.SaveFrame(config.ScreenshotPath);
+		if (!config.TracePath.empty() && !Profiler::ExportChromeTrace(config.TracePath, firstTraceFrame, Profiler::GetFrame()))
+			throw std::runtime_error("failed to write " + config.TracePath);
+
+		MemoryStats memory = renderer.GetMemoryStats();
+		std::vector<MemoryHeapBudget> budgets = renderer.GetMemoryBudget();
+
+		std::ostringstream out;
+		out << "{\n";
+		out << "  \"config\": { "
+			<< "\"nodes\": " << config.Scene.NodeCount << ", "
+			<< "\"depth\": " << config.Scene.Depth << ", "
+			<< "\"fanout\": " << config.Scene.FanOut << ", "
+			<< "\"reuse\": " << config.Scene.MeshReuse << ", "
+			<< "\"default\": " << config.Scene.DefaultWeight << ", "
+			<< "\"basic\": " << config.Scene.BasicWeight << ", "
+			<< "\"wireframe\": " << config.Scene.WireframeWeight << ", "
+			<< "\"textured\": " << (config.Scene.Textured ? "true" : "false") << ", "
+			<< "\"packed\": " << (config.Scene.PackedVertices ? "true" : "false") << ", "
+			<< "\"seed\": " << config.Scene.Seed << ", "
+			<< "\"gltf\": \"";
+		WriteEscaped(out, config.GltfPath);
+		out << "\", "
+			<< "\"lod\": " << (config.Lod.Enabled ? "true" : "false") << ", "
+			<< "\"lod_error\": " << config.Lod.PixelError << ", "
+			<< "\"lod_fade\": " << (config.Lod.CrossFade ? "true" : "false") << ", "
+			<< "\"meshlets\": " << (config.Meshlets.Enabled ? "true" : "false") << ", "
+			<< "\"mesh_shaders\": " << (config.Meshlets.MeshShaders && renderer.IsMeshShaderSupported() ? "true" : "false") << ", "
+			<< "\"warmup\": " << config.WarmupFrames << ", "
+			<< "\"frames\": " << config.Frames << ", "
+			<< "\"width\": " << config.Width << ", "
+			<< "\"height\": " << config.Height << " },\n";
+		out << "  \"scene\": { "
+			<< "\"nodes\": " << info.NodeCount << ", "
+			<< "\"mesh_variants\": " << info.MeshVariants << ", "
+			<< "\"imported_triangles\": " << importedTriangles << " },\n";
+		out << "  \"setup_ms\": " << setupMs << ",\n";
+		WriteSeries(out, "cpu_frame_ms", Summarize(cpuFrameMs)); out << ",\n";
+		WriteSeries(out, "render_cpu_ms", Summarize(renderCpuMs)); out << ",\n";
+		WriteSeries(out, "fence_wait_ms", Summarize(fenceWaitMs)); out << ",\n";
+		WriteSeries(out, "gpu_frame_ms", Summarize(gpuFrameMs)); out << ",\n";
+		WriteSeries(out, "gpu_scene_ms", Summarize(gpuSceneMs)); out << ",\n";
+		WriteSeries(out, "draw_calls", Summarize(drawCalls)); out << ",\n";
+		WriteSeries(out, "pipeline_binds", Summarize(pipelineBinds)); out << ",\n";
+		WriteSeries(out, "descriptor_set_binds", Summarize(descriptorSetBinds)); out << ",\n";
+		WriteSeries(out, "mesh_binds", Summarize(meshBinds)); out << ",\n";
+		WriteSeries(out, "triangles", Summarize(triangles)); out << ",\n";
+		WriteSeries(out, "culled_objects", Summarize(culledObjects)); out << ",\n";
+		WriteSeries(out, "meshlets", Summarize(meshlets)); out << ",\n";
+		out << "  \"memory\": { "
+			<< "\"total_bytes\": " << memory.TotalBytes << ", "
+			<< "\"allocations\": " << memory.AllocationCount << ", "
+			<< "\"heaps\": [";
+		for (size_t i = 0; i < memory.HeapBytes.size(); i++)
+		{
+			out << (i ? ", " : "") << "{ "
+				<< "\"bytes\": " << memory.HeapBytes[i] << ", "
+				<< "\"usage\": " << budgets[i].Usage << ", "
+				<< "\"budget\": " << budgets[i].Budget << ", "
+				<< "\"size\": " << budgets[i].Size << " }";
+		}
+		out << "], \"categories\": { ";
+		for (size_t i = 0; i < memory.CategoryBytes.size(); i++)
+			out << (i ? ", " : "") << "\"" << GetMemoryCategoryName(static_cast<MemoryCategory>(i)) << "\": " << memory.CategoryBytes[i];
+		out << " } }\n";
+		out << "}\n";
+
+		if (config.OutputPath == "-")
+			std::cout << out.str();
+		else
+		{
+			std::ofstream file(config.OutputPath);
+			if (!file)
+				throw std::runtime_error("failed to open " + config.OutputPath);
+			file << out.str();
+		}
+
+		renderer.Terminate();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,153 @@
+#include <cmath>
+#include <queue>
+#include <algorithm>
+#include "SceneGenerator.h"
+#include "../Modules/Renderer/Vulkan/MeshSimplifier.h"
+#include "../Modules/Renderer/Vulkan/ProceduralMesh.h"
+
+namespace
+{
+	const char* const TEXTURES[] = {
+		"images/bricks.jpg",
+		"images/grass.jpg",
+		"images/plant.jpg",
+		"images/world.png"
+	};
+
+	const float TOP_LEVEL_SPACING = 4.0f;
+	const float CHILD_RING_RADIUS = 1.5f;
+	const float CHILD_SCALE = 0.5f;
+}
+
+SceneGenerator::SceneGenerator(const SceneGeneratorConfig& config)
+	: m_Config(config), m_Random(config.Seed)
+{
+}
+
+GeneratedSceneInfo SceneGenerator::Generate(SceneGraph& scene)
+{
+	GeneratedSceneInfo info{};
+	uint32_t depth = std::max(m_Config.Depth, 1u);
+	uint32_t fanOut = std::max(m_Config.FanOut, 1u);
+
+	// nodes in one full top level subtree, used to decide how many top level nodes we need
+	uint64_t subtreeSize = 0;
+	uint64_t levelSize = 1;
+	for (uint32_t level = 0; level < depth && subtreeSize < m_Config.NodeCount; level++)
+	{
+		subtreeSize += levelSize;
+		levelSize *= fanOut;
+	}
+	uint32_t topLevelCount = static_cast<uint32_t>(std::max<uint64_t>(1, (m_Config.NodeCount + subtreeSize - 1) / subtreeSize));
+	topLevelCount = std::min(topLevelCount, m_Config.NodeCount);
+	uint32_t gridSide = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(topLevelCount))));
+
+	struct Pending
+	{
+		NodeHandle Parent;
+		uint32_t Level;
+	};
+	std::queue<Pending> pending;
+
+	for (uint32_t i = 0; i < topLevelCount; i++)
+	{
+		NodeHandle node = scene.AddNode("n" + std::to_string(info.NodeCount++), Model(PickMesh(), PickMaterial()));
+		float x = (static_cast<float>(i % gridSide) - gridSide * 0.5f) * TOP_LEVEL_SPACING;
+		float z = (static_cast<float>(i / gridSide) - gridSide * 0.5f) * TOP_LEVEL_SPACING;
+		scene[node].GetTransform().Position = glm::vec3(x, 0.0f, z);
+		scene[node].GetTransform().Rotation.y = Random() * 360.0f - 180.0f;
+		pending.push({ node, 1 });
+
+		info.Radius = std::max(info.Radius, std::sqrt(x * x + z * z) + CHILD_RING_RADIUS * 2.0f);
+	}
+
+	// breadth first so every top level subtree gets the same shape
+	while (!pending.empty() && info.NodeCount < m_Config.NodeCount)
+	{
+		Pending current = pending.front();
+		pending.pop();
+		if (current.Level >= depth)
+			continue;
+
+		for (uint32_t i = 0; i < fanOut && info.NodeCount < m_Config.NodeCount; i++)
+		{
+			NodeHandle node = scene.AddNode("n" + std::to_string(info.NodeCount++), Model(PickMesh(), PickMaterial()), current.Parent);
+			float angle = glm::radians(360.0f * i / fanOut);
+			scene[node].GetTransform().Position = glm::vec3(std::cos(angle) * CHILD_RING_RADIUS, 0.5f, std::sin(angle) * CHILD_RING_RADIUS);
+			scene[node].GetTransform().Scale = glm::vec3(CHILD_SCALE);
+			pending.push({ node, current.Level + 1 });
+		}
+	}
+
+	AddLights(scene);
+
+	info.MeshVariants = static_cast<uint32_t>(m_Meshes.size());
+	return info;
+}
+
+void SceneGenerator::AddLights(SceneGraph& scene)
+{
+	NodeHandle sun = scene.AddNode("sun", DirectionalLight());
+	scene[sun].GetTransform().Rotation = glm::vec3(45.0f, 45.0f, 0.0f);
+
+	NodeHandle pointLight = scene.AddNode("pointLight", PointLight());
+	scene[pointLight].GetTransform().Position = glm::vec3(0.0f, 2.0f, 0.0f);
+}
+
+float SceneGenerator::Random()
+{
+	// built from the raw mt19937 output, std distributions differ between standard libraries
+	return static_cast<float>(m_Random() >> 8) * (1.0f / 16777216.0f);
+}
+
+uint32_t SceneGenerator::RandomIndex(uint32_t count)
+{
+	return std::min(static_cast<uint32_t>(Random() * count), count - 1);
+}
+
+std::shared_ptr<const MeshData> SceneGenerator::PickMesh()
+{
+	if (!m_Meshes.empty() && Random() < m_Config.MeshReuse)
+		return m_Meshes[RandomIndex(static_cast<uint32_t>(m_Meshes.size()))];
+
+	// new variant: spheres get a fresh tessellation so every variant is distinct
+	// geometry, the tessellations cycle so repeats come from the mesh cache
+	MeshData mesh;
+	switch (RandomIndex(4))
+	{
+	case 0: mesh = MeshData::Cube(); break;
+	case 1: mesh = MeshData::Pyramid(); break;
+	case 2: mesh = MeshData::Quad(); break;
+	default:
+		mesh = *ProceduralMeshCache::Get().GetMesh(ProceduralMeshDesc::Sphere(m_NextSphereDefinition, m_NextSphereDefinition));
+		m_NextSphereDefinition = m_NextSphereDefinition >= 96 ? 8 : m_NextSphereDefinition + 4;
+		break;
+	}
+	if (m_Config.PackedVertices)
+		mesh.Format = VertexFormat::Packed;
+	// once per variant here instead of once per node when the renderer sets up,
+	// every node picking the variant shares it
+	MeshSimplifier::GenerateLods(mesh);
+	m_Meshes.push_back(std::make_shared<const MeshData>(std::move(mesh)));
+	return m_Meshes.back();
+}
+
+MaterialData SceneGenerator::PickMaterial()
+{
+	MaterialData material{};
+	material.Parameters.DiffuseColor = glm::vec4(Random(), Random(), Random(), 1.0f);
+
+	float total = m_Config.DefaultWeight + m_Config.BasicWeight + m_Config.WireframeWeight;
+	float pick = Random() * (total > 0.0f ? total : 1.0f);
+	if (pick < m_Config.DefaultWeight || total <= 0.0f)
+		material.Type = MaterialType::Default;
+	else if (pick < m_Config.DefaultWeight + m_Config.BasicWeight)
+		material.Type = MaterialType::Basic;
+	else
+		material.Type = MaterialType::Wireframe;
+
+	if (m_Config.Textured)
+		material.TexturePath = TEXTURES[RandomIndex(static_cast<uint32_t>(std::size(TEXTURES)))];
+
+	return material;
+}
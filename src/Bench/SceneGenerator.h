@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <random>
+#include "../Modules/Scene/Graph.h"
+
+struct SceneGeneratorConfig
+{
+	uint32_t NodeCount = 1000;
+	uint32_t Depth = 3;				// levels of nodes below the scene root
+	uint32_t FanOut = 8;			// children per inner node
+	float MeshReuse = 0.9f;			// chance a node reuses an existing mesh variant instead of generating a new one
+	float DefaultWeight = 0.6f;		// relative share of each material type
+	float BasicWeight = 0.3f;
+	float WireframeWeight = 0.1f;
+	bool Textured = false;			// sample the asset images instead of the 1x1 white fallback
+	bool PackedVertices = false;	// upload meshes as PackedVertex instead of Vertex
+	uint32_t Seed = 1337;
+};
+
+struct GeneratedSceneInfo
+{
+	uint32_t NodeCount = 0;
+	uint32_t MeshVariants = 0;
+	float Radius = 0.0f;			// radius of a circle on the XZ plane containing every node
+};
+
+// Procedurally fills a scene graph from the MeshData generators. The same
+// config always produces the same scene on every platform.
+class SceneGenerator
+{
+public:
+	SceneGenerator(const SceneGeneratorConfig& config);
+
+	GeneratedSceneInfo Generate(SceneGraph& scene);
+	// The "sun" and "pointLight" nodes the renderer lights every scene with
+	static void AddLights(SceneGraph& scene);
+
+private:
+	float Random();
+	uint32_t RandomIndex(uint32_t count);
+	std::shared_ptr<const MeshData> PickMesh();
+	MaterialData PickMaterial();
+
+	SceneGeneratorConfig m_Config;
+	std::mt19937 m_Random;
+	std::vector<std::shared_ptr<const MeshData>> m_Meshes;
+	uint32_t m_NextSphereDefinition = 8;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <vector>
+
+// Summary statistics shared by the benchmark executables
+
+struct Series
+{
+	double Mean = 0.0, Min = 0.0, P50 = 0.0, P90 = 0.0, P95 = 0.0, P99 = 0.0, Max = 0.0;
+};
+
+// Nearest rank percentiles, so every reported value is an actual sample
+inline Series Summarize(std::vector<double> samples)
+{
+	Series series{};
+	if (samples.empty())
+		return series;
+
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&](double p)
+	{
+		size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+		return samples[std::min(std::max<size_t>(rank, 1), samples.size()) - 1];
+	};
+
+	double sum = 0.0;
+	for (double sample : samples)
+		sum += sample;
+
+	series.Mean = sum / samples.size();
+	series.Min = samples.front();
+	series.P50 = percentile(50.0);
+	series.P90 = percentile(90.0);
+	series.P95 = percentile(95.0);
+	series.P99 = percentile(99.0);
+	series.Max = samples.back();
+	return series;
+}
+
+inline void WriteSeries(std::ostream& out, const char* name, const Series& series)
+{
+	out << "  \"" << name << "\": { "
+		<< "\"mean\": " << series.Mean << ", "
+		<< "\"min\": " << series.Min << ", "
+		<< "\"p50\": " << series.P50 << ", "
+		<< "\"p90\": " << series.P90 << ", "
+		<< "\"p95\": " << series.P95 << ", "
+		<< "\"p99\": " << series.P99 << ", "
+		<< "\"max\": " << series.Max << " }";
+}
@@ -0,0 +1,363 @@
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stack>
+#include <queue>
+#include <atomic>
+#include <new>
+#include "Statistics.h"
+#include "../Core/Time.h"
+#include "../Core/ThreadPool.h"
+#include "../Modules/Scene/Graph.h"
+
+// CPU only microbenchmark of scene traversal. Builds a tree breadth first and
+// times each way of visiting it, along with the heap allocations of a pass,
+// as JSON. stack_dfs is the iterator the scene graph used to have, a
+// std::stack of pending children.
+//
+//   VulkanSandboxTraversalBench --nodes 100000 --fanout 8 --passes 200
+//
+// A fanout as large as the node count builds one wide flat level, where
+// adding a node used to scan all of its siblings for duplicate names.
+
+namespace
+{
+	std::atomic<uint64_t> s_Allocations{ 0 };
+
+	struct TraversalConfig
+	{
+		uint32_t NodeCount = 100000;
+		uint32_t FanOut = 8;
+		uint32_t Passes = 200;
+		std::string OutputPath = "-";	// "-" writes to stdout
+	};
+
+	struct Result
+	{
+		const char* Name;
+		std::vector<double> Milliseconds;
+		uint64_t Allocations = 0;		// most in a single pass
+		uint64_t Visited = 0;
+	};
+
+	void PrintUsage()
+	{
+		std::cout <<
+			"usage: VulkanSandboxTraversalBench [options]\n"
+			"  --nodes <n>     number of scene nodes (100000)\n"
+			"  --fanout <n>    children per inner node (8)\n"
+			"  --passes <n>    measured passes per traversal (200)\n"
+			"  --out <file>    JSON report path, - for stdout (-)\n";
+	}
+
+	bool ParseArguments(int argc, char** argv, TraversalConfig& config)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			auto next = [&]() -> const char*
+			{
+				if (i + 1 >= argc)
+					throw std::runtime_error("missing value for " + arg);
+				return argv[++i];
+			};
+
+			if (arg == "--nodes") config.NodeCount = std::stoul(next());
+			else if (arg == "--fanout") config.FanOut = std::stoul(next());
+			else if (arg == "--passes") config.Passes = std::stoul(next());
+			else if (arg == "--out") config.OutputPath = next();
+			else if (arg == "--help" || arg == "-h")
+			{
+				PrintUsage();
+				return false;
+			}
+			else
+				throw std::runtime_error("unknown argument " + arg);
+		}
+
+		config.NodeCount = std::max(config.NodeCount, 1u);
+		config.FanOut = std::max(config.FanOut, 1u);
+		config.Passes = std::max(config.Passes, 1u);
+		return true;
+	}
+
+	// Breadth first like the bench scenes, so the pool starts out of order.
+	// Three in four nodes are models sharing one mesh, a few are lights.
+	void BuildScene(SceneGraph& scene, const TraversalConfig& config)
+	{
+		Model model(std::make_shared<const MeshData>(MeshData::Cube()), MaterialData{});
+		std::queue<NodeHandle> pending;
+		pending.push(scene.GetRoot());
+		uint32_t count = 0;
+		while (count < config.NodeCount)
+		{
+			NodeHandle parent = pending.front();
+			pending.pop();
+			for (uint32_t i = 0; i < config.FanOut && count < config.NodeCount; i++, count++)
+			{
+				std::string name = "n" + std::to_string(count);
+				NodeHandle node;
+				if (count % 1000 == 0)
+					node = scene.AddNode(name, PointLight(), parent);
+				else if (count % 4 == 0)
+					node = scene.AddNode(name, parent);
+				else
+					node = scene.AddNode(name, model, parent);
+				scene[node].GetTransform().Position.x = static_cast<float>(count % 7);
+				pending.push(node);
+			}
+		}
+	}
+
+	template <typename Pass>
+	Result Measure(const char* name, uint32_t passes, Pass pass)
+	{
+		Result result{ name };
+		result.Visited = pass();	// warm up, sizes any scratch storage
+		result.Milliseconds.reserve(passes);
+		for (uint32_t i = 0; i < passes; i++)
+		{
+			uint64_t allocations = s_Allocations.load(std::memory_order_relaxed);
+			Timer timer;
+			pass();
+			result.Milliseconds.push_back(timer.GetElapsed() * 1000.0);
+			result.Allocations = std::max(result.Allocations, s_Allocations.load(std::memory_order_relaxed) - allocations);
+		}
+		return result;
+	}
+
+	// Keeps the compiler from dropping the visits
+	volatile float s_Sink = 0.0f;
+}
+
+// Counts every heap allocation in the process so each pass can report its own
+void* operator new(size_t size)
+{
+	s_Allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size > 0 ? size : 1))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
+
+int main(int argc, char** argv)
+{
+	TraversalConfig config;
+	try
+	{
+		if (!ParseArguments(argc, argv, config))
+			return EXIT_SUCCESS;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		SceneGraph scene;
+		Timer buildTimer;
+		BuildScene(scene, config);
+		double buildMs = buildTimer.GetElapsed() * 1000.0;
+		NodePool& pool = scene.GetNodes();
+		NodeHandle root = scene.GetRoot();
+
+		std::vector<Result> results;
+		results.push_back(Measure("stack_dfs", config.Passes, [&]()
+		{
+			uint64_t visited = 0;
+			float sum = 0.0f;
+			std::stack<NodeHandle> pending;
+			pending.push(root);
+			while (!pending.empty())
+			{
+				NodeHandle handle = pending.top();
+				pending.pop();
+				sum += scene[handle].GetTransform().Position.x;
+				visited++;
+				for (NodeHandle child : scene.Children(handle))
+					pending.push(child);
+			}
+			s_Sink = sum;
+			return visited;
+		}));
+
+		// the warm up pass sorts the breadth first build
+		results.push_back(Measure("linear", config.Passes, [&]()
+		{
+			uint64_t visited = 0;
+			float sum = 0.0f;
+			for (Node& node : scene)
+			{
+				sum += node.GetTransform().Position.x;
+				visited++;
+			}
+			s_Sink = sum;
+			return visited;
+		}));
+
+		results.push_back(Measure("sibling_links", config.Passes, [&]()
+		{
+			uint64_t visited = 0;
+			float sum = 0.0f;
+			NodeHandle handle = root;
+			while (!handle.IsNull())
+			{
+				sum += scene[handle].GetTransform().Position.x;
+				visited++;
+				NodeHandle child = pool.GetFirstChild(handle);
+				if (!child.IsNull())
+				{
+					handle = child;
+					continue;
+				}
+				while (!handle.IsNull() && handle != root)
+				{
+					NodeHandle sibling = pool.GetNextSibling(handle);
+					if (!sibling.IsNull())
+					{
+						handle = sibling;
+						break;
+					}
+					handle = pool.GetParent(handle);
+				}
+				if (handle == root)
+					break;
+			}
+			s_Sink = sum;
+			return visited;
+		}));
+
+		NodeHandle firstChild = pool.GetFirstChild(root);
+		results.push_back(Measure("subtree", config.Passes, [&]()
+		{
+			uint64_t visited = 0;
+			float sum = 0.0f;
+			for (Node& node : scene.Subtree(firstChild))
+			{
+				sum += node.GetTransform().Position.x;
+				visited++;
+			}
+			s_Sink = sum;
+			return visited;
+		}));
+
+		// queries walk the packed components, which Reorder keeps in node order
+		results.push_back(Measure("query_models", config.Passes, [&]()
+		{
+			uint64_t visited = 0;
+			float sum = 0.0f;
+			scene.Query<MaterialComponent, MeshComponent>().Each([&](NodeHandle handle, MaterialComponent&, MeshComponent&)
+			{
+				sum += pool.GetNodes()[pool.GetPosition(handle)].GetTransform().Position.x;
+				visited++;
+			});
+			s_Sink = sum;
+			return visited;
+		}));
+
+		results.push_back(Measure("query_point_lights", config.Passes, [&]()
+		{
+			uint64_t visited = 0;
+			float sum = 0.0f;
+			scene.Query<PointLight>().Each([&](NodeHandle handle, PointLight&)
+			{
+				sum += pool.GetNodes()[pool.GetPosition(handle)].GetTransform().Position.x;
+				visited++;
+			});
+			s_Sink = sum;
+			return visited;
+		}));
+
+		// every job writes only the transforms of its own nodes
+		ThreadPool threads;
+		results.push_back(Measure("parallel_query_models", config.Passes, [&]()
+		{
+			scene.Query<MeshComponent>().ParallelEach(threads, [&](NodeHandle handle, MeshComponent&)
+			{
+				Transform& transform = pool.GetNodes()[pool.GetPosition(handle)].GetTransform();
+				transform.Position.y = transform.Position.x * 0.5f;
+			});
+			return static_cast<uint64_t>(pool.GetStorage<MeshComponent>().GetSize());
+		}));
+
+		// a topology change followed by a traversal: one re-sort of the whole pool
+		results.push_back(Measure("edit_and_reorder", config.Passes, [&]()
+		{
+			NodeHandle leaf = scene.AddNode("edit", root);
+			scene.RemoveNode(leaf);
+			return static_cast<uint64_t>(scene.Subtree(root).size());
+		}));
+
+		// slash separated paths of every 100th node, resolved through the name index
+		std::vector<std::string> paths;
+		for (uint32_t i = 1; i < pool.GetSize(); i += 100)
+		{
+			std::string path;
+			for (NodeHandle handle = pool.GetNodes()[i].GetHandle(); handle != root; handle = pool.GetParent(handle))
+				path = "/" + scene.GetName(handle) + path;
+			paths.push_back(path);
+		}
+		results.push_back(Measure("find_path", config.Passes, [&]()
+		{
+			uint64_t found = 0;
+			for (const std::string& path : paths)
+				found += !scene.Find(path).IsNull();
+			return found;
+		}));
+
+		Camera camera;
+		results.push_back(Measure("publish_snapshot", config.Passes, [&]()
+		{
+			scene.PublishSnapshot(camera);
+			return static_cast<uint64_t>(pool.GetSize());
+		}));
+
+		std::ofstream file;
+		if (config.OutputPath != "-")
+		{
+			file.open(config.OutputPath);
+			if (!file)
+				throw std::runtime_error("Failed to open " + config.OutputPath);
+		}
+		std::ostream& out = config.OutputPath == "-" ? std::cout : file;
+
+		out << "{\n";
+		out << "  \"config\": { "
+			<< "\"nodes\": " << config.NodeCount << ", "
+			<< "\"fanout\": " << config.FanOut << ", "
+			<< "\"passes\": " << config.Passes << " },\n";
+		out << "  \"build_ms\": " << buildMs << ",\n";
+		for (const Result& result : results)
+		{
+			out << "  \"" << result.Name << "_visited\": " << result.Visited << ",\n";
+			out << "  \"" << result.Name << "_allocations\": " << result.Allocations << ",\n";
+			WriteSeries(out, (std::string(result.Name) + "_ms").c_str(), Summarize(result.Milliseconds));
+			out << (&result == &results.back() ? "\n" : ",\n");
+		}
+		out << "}\n";
+
+		scene.Terminate();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <chrono>
 #include "App.h"
+#include "Profiler.h"
+#include "../Modules/Renderer/Vulkan/ProceduralMesh.h"
 
 #define BIND_CALLBACK(func) std::bind(&App::func, this)
 #define BIND_CALLBACK_1(func) std::bind(&App::func, this, std::placeholders::_1)
@@ -14,10 +16,14 @@ App::App()
 
 App::~App()
 {
+	m_Running = false;
+	if (m_SimulationThread.joinable())
+		m_SimulationThread.join();
 }
 
 void App::Init()
 {
+	PROFILE_SCOPE("App::Init");
 	m_Window.Initialize();
 	m_Window.SetFPSCounterEnabled(true);
 	m_Window.SetOnResizeCallback(BIND_CALLBACK_2(OnResize));
@@ -27,69 +33,114 @@ void App::Init()
 	m_Camera.Position.z = 3.0f;
 	m_Camera.Rotation.x = -45.0f;
 
-	m_Scene = SceneGraph();
 	m_Scene.Initialize();
 
+	// the two sphere nodes share one mesh
 	Model cube = Model(MeshData::Cube(), {{{0.0f, 0.0f, 1.0f, 1.0f}}, "images/bricks.jpg"});
-	Model sphere = Model(MeshData::Sphere(96), {{{1.0f, 1.0f, 1.0f, 1.0f}}, "images/world.png"});
+	Model sphere = Model(ProceduralMeshCache::Get().GetMesh(ProceduralMeshDesc::Sphere(96, 96)), {{{1.0f, 1.0f, 1.0f, 1.0f}}, "images/world.png"});
 	Model pyramid = Model(MeshData::Pyramid(), {{{0.0f, 1.0f, 0.0f, 1.0f}}, "images/bricks.jpg"});
 	Model floor = Model(MeshData::Quad(), {{{1.0f, 1.0f, 1.0f, 1.0f}}, "images/bricks.jpg"});
 
-	Node* inner = new Node("Inner", sphere);
-	Node* cubeNode = new Node("cube", cube);
-	inner->AddNode(cubeNode);
-	inner->GetTransform().Rotation.y = 45.0f;
-	(*inner)["cube"]->GetTransform().Position.x = 2.0f;
-	(*inner)["cube"]->GetTransform().Position.y = 2.0f;
-	m_Scene.AddNode(inner);
+	NodeHandle inner = m_Scene.AddNode("Inner", sphere);
+	NodeHandle cubeNode = m_Scene.AddNode("cube", cube, inner);
+	m_Scene[inner].GetTransform().Rotation.y = 45.0f;
+	m_Scene[cubeNode].GetTransform().Position.x = 2.0f;
+	m_Scene[cubeNode].GetTransform().Position.y = 2.0f;
 
-	Node* a = new Node("a");
-	Node* b = new Node("b");
-	Node* c = new Node("c");
+	NodeHandle a = m_Scene.AddNode("a");
+	NodeHandle b = m_Scene.AddNode("b", a);
+	m_Scene.AddNode("c", b);
 
-	b->AddNode(c);
-	a->AddNode(b);
-	m_Scene.AddNode(a);
+	NodeHandle sphereNode = m_Scene.AddNode("sphere", sphere);
+	m_Scene[sphereNode].GetTransform().Position.x = -2.0f;
 
-	Node* sphereNode = new Node("sphere", sphere);
-	m_Scene.AddNode(sphereNode);
-	m_Scene["sphere"].GetTransform().Position.x = -2.0f;
+	NodeHandle pyramidNode = m_Scene.AddNode("pyramid", pyramid);
+	m_Scene[pyramidNode].GetTransform().Position.z = -2.0f;
 
-	Node* pyramidNode = new Node("pyramid", pyramid);
-	m_Scene.AddNode(pyramidNode);
-	m_Scene["pyramid"].GetTransform().Position.z = -2.0f;
+	NodeHandle floorNode = m_Scene.AddNode("floor", floor);
+	m_Scene[floorNode].GetTransform().Position.y = -1.0f;
+	m_Scene[floorNode].GetTransform().Scale = glm::vec3(10.0f);
+	m_Scene[floorNode].GetTransform().Rotation.x = -90.0f;
 
-	Node* floorNode = new Node("floor", floor);
-	m_Scene.AddNode(floorNode);
-	m_Scene["floor"].GetTransform().Position.y = -1.0f;
-	m_Scene["floor"].GetTransform().Scale = glm::vec3(10.0f);
-	m_Scene["floor"].GetTransform().Rotation.x = -90.0f;
+	NodeHandle sun = m_Scene.AddNode("sun", DirectionalLight());
+	m_Scene[sun].GetTransform().Rotation.x = 45.0f;
+	m_Scene[sun].GetTransform().Rotation.y = 45.0f;
 
-	Node* sun = new Node("sun", DirectionalLight());
-	m_Scene.AddNode(sun);
-	m_Scene["sun"].GetTransform().Rotation.x = 45.0f;
-	m_Scene["sun"].GetTransform().Rotation.y = 45.0f;
-
-	Node* pointLight = new Node("pointLight", PointLight());
-	m_Scene.AddNode(pointLight);
+	m_Scene.AddNode("pointLight", PointLight());
 
 	m_Renderer = std::make_unique<Renderer>(m_Window, m_Camera, m_Scene);
 	m_Renderer->Initialize();
+
+	// make sure the renderer has something to draw before the first tick
+	std::lock_guard<std::mutex> lock(m_Scene.GetMutex());
+	m_Scene.PublishSnapshot(m_Camera, Time::Now());
 }
 
 void App::Run()
 {
+	m_Running = true;
+	m_SimulationThread = std::thread(&App::SimulationLoop, this);
+
+	// The main thread owns the window: it pumps events, samples input for the
+	// simulation thread and renders the latest published scene snapshot
+	PROFILE_THREAD("Main");
+	m_FrameTimer.Reset();
 	while (!m_Window.ShouldClose())
 	{
+		PROFILE_FRAME();
+		PROFILE_SCOPE("App::Frame");
+
+		float deltaTime = m_FrameTimer.Tick();
 		m_Window.UpdateFPSCounter();
 		m_Window.PollEvents();
-		HandleInput();
-		m_Renderer->Update();
+		m_Window.CaptureInput(m_Input.GetWriteBuffer());
+		ExportTraceOnRequest(m_Input.GetWriteBuffer());
+		m_Input.Publish();
+		m_Renderer->Update(deltaTime);
 	}
 
+	m_Running = false;
+	m_SimulationThread.join();
 	m_Renderer->WaitIdle();
 }
 
+void App::SimulationLoop()
+{
+	PROFILE_THREAD("Simulation");
+	Timer timer;
+	FixedTimestep timestep(1.0 / SIMULATION_TICK_RATE);
+
+	try
+	{
+		while (m_Running)
+		{
+			timestep.Accumulate(timer.Tick());
+			m_Input.Acquire();
+
+			{
+				PROFILE_SCOPE("App::SimulationStep");
+				std::lock_guard<std::mutex> lock(m_Scene.GetMutex());
+				bool stepped = false;
+				while (timestep.Step())
+				{
+					HandleInput(m_Input.GetReadBuffer(), static_cast<float>(timestep.GetStep()));
+					stepped = true;
+				}
+
+				if (stepped)
+					m_Scene.PublishSnapshot(m_Camera, Time::Now(), timestep.GetStep());
+			}
+
+			std::this_thread::sleep_for(std::chrono::duration<double>(timestep.GetTimeToNextStep()));
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Simulation error: " << e.what() << std::endl;
+		m_Window.Close();
+	}
+}
+
 void App::Exit()
 {
 	m_Renderer->Terminate();
@@ -101,46 +152,62 @@ void App::OnResize(int width, int height)
 	m_Renderer->Resize( static_cast<uint32_t>(width), static_cast<uint32_t>(height) );
 }
 
-void App::HandleInput()
+void App::ExportTraceOnRequest(const InputState& input)
 {
-	m_Window.OnMouseMove(BIND_CALLBACK_4(OnMouseMoveCallback));
+	bool pressed = input.IsKeyPressed(Keyboard::Key::F9);
+	if (pressed && !m_TraceKeyHeld)
+	{
+		uint64_t lastFrame = Profiler::GetFrame();
+		uint64_t firstFrame = lastFrame > TRACE_FRAME_COUNT ? lastFrame - TRACE_FRAME_COUNT : 0;
+		if (Profiler::ExportChromeTrace(TRACE_FILENAME, firstFrame, lastFrame))
+			std::cout << "Wrote frames " << firstFrame << "-" << lastFrame << " to " << TRACE_FILENAME << std::endl;
+		else
+			std::cerr << "Failed to write " << TRACE_FILENAME << std::endl;
+	}
+	m_TraceKeyHeld = pressed;
+}
 
-	if (m_Window.IsMouseButtonReleased(Mouse::Button::Right) && m_Window.IsMouseButtonReleased(Mouse::Button::Left))
-		m_Window.ResetOffset();
+void App::HandleInput(const InputState& input, float deltaTime)
+{
+	PROFILE_SCOPE("App::HandleInput");
+	// offsets are only meaningful while a button stays held, same as Window::ResetOffset
+	bool wasHeld = m_LastInput.IsMouseButtonPressed(Mouse::Button::Right) || m_LastInput.IsMouseButtonPressed(Mouse::Button::Left);
+	float xOffset = wasHeld ? input.MouseX - m_LastInput.MouseX : 0.0f;
+	float yOffset = wasHeld ? m_LastInput.MouseY - input.MouseY : 0.0f;
+	OnMouseMoveCallback(input.MouseX, input.MouseY, xOffset, yOffset);
+	m_LastInput = input;
 
-	float delta = 0.001f;
+	float delta = CAMERA_SPEED * deltaTime;
 
-	if (m_Window.IsKeyPressed(Keyboard::Key::LeftShift))
-		delta = 0.005f;
-	else
-		delta = 0.001f;
+	if (input.IsKeyPressed(Keyboard::Key::LeftShift))
+		delta = CAMERA_FAST_SPEED * deltaTime;
 
 
-	if (m_Window.IsKeyPressed(Keyboard::Key::W))
+	if (input.IsKeyPressed(Keyboard::Key::W))
 		m_Camera.MoveForward(delta);
 
-	if (m_Window.IsKeyPressed(Keyboard::Key::S))
+	if (input.IsKeyPressed(Keyboard::Key::S))
 		m_Camera.MoveForward(-delta);
 
-	if (m_Window.IsKeyPressed(Keyboard::Key::A))
+	if (input.IsKeyPressed(Keyboard::Key::A))
 		m_Camera.MoveRight(-delta);
 
-	if (m_Window.IsKeyPressed(Keyboard::Key::D))
+	if (input.IsKeyPressed(Keyboard::Key::D))
 		m_Camera.MoveRight(delta);
 
-	if (m_Window.IsKeyPressed(Keyboard::Key::E))
+	if (input.IsKeyPressed(Keyboard::Key::E))
 		m_Camera.Position.y += delta;
 
-	if (m_Window.IsKeyPressed(Keyboard::Key::Q))
+	if (input.IsKeyPressed(Keyboard::Key::Q))
 		m_Camera.Position.y -= delta;
 
-	if (m_Window.IsKeyPressed(Keyboard::Key::Escape))
+	if (input.IsKeyPressed(Keyboard::Key::Escape))
 		m_Window.Close();
 }
 
 void App::OnMouseMoveCallback(float xPos, float yPos, float xOffset, float yOffset)
 {
-	if (m_Window.IsMouseButtonPressed(Mouse::Button::Right))
+	if (m_LastInput.IsMouseButtonPressed(Mouse::Button::Right))
 	{
 		m_Camera.Rotation.y += xOffset * 0.25f;
 		m_Camera.Rotation.x += yOffset * 0.25f;
@@ -2,7 +2,11 @@
 #include <GLFW/glfw3.h>
 #include <memory>
 #include <vector>
+#include <thread>
+#include <atomic>
 #include "../Core/Window.h"
+#include "../Core/TripleBuffer.h"
+#include "../Core/Time.h"
 #include "../Modules/Scene/Camera.h"
 #include "../Modules/Scene/Graph.h"
 #include "../Modules/Scene/Model.h"
@@ -10,6 +14,17 @@
 #include "../Modules/Scene/Lighting/DirectionalLight.h"
 #include "../Modules/Scene/Lighting/PointLight.h"
 
+// Rate at which the simulation thread updates the scene and publishes snapshots
+const double SIMULATION_TICK_RATE = 120.0;
+
+// Camera movement speed in units per second
+const float CAMERA_SPEED = 2.0f;
+const float CAMERA_FAST_SPEED = 8.0f;
+
+// F9 writes the last TRACE_FRAME_COUNT frames of CPU profiler zones to TRACE_FILENAME
+const uint64_t TRACE_FRAME_COUNT = 300;
+const char* const TRACE_FILENAME = "trace.json";
+
 class App
 {
 public:
@@ -21,10 +36,18 @@ public:
 	void OnResize(int width, int height);
 
 private:
-	void HandleInput();
+	void SimulationLoop();
+	void HandleInput(const InputState& input, float deltaTime);
+	void ExportTraceOnRequest(const InputState& input);
 	void OnMouseMoveCallback(float xPos, float yPos, float xOffset, float yOffset);
 
 	std::unique_ptr<Renderer> m_Renderer;
+	std::thread m_SimulationThread;
+	std::atomic<bool> m_Running{ false };
+	TripleBuffer<InputState> m_Input;
+	InputState m_LastInput;
+	bool m_TraceKeyHeld = false;
+	Timer m_FrameTimer;
 	Camera m_Camera;
 	SceneGraph m_Scene;
 	DirectionalLight m_DirLight;
@@ -0,0 +1,324 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include "Json.h"
+#include "Profiler.h"
+
+namespace
+{
+	// Deeper documents are rejected instead of overflowing the stack
+	const int MAX_DEPTH = 256;
+
+	const JsonValue& NullValue()
+	{
+		static const JsonValue value;
+		return value;
+	}
+
+	bool IsNumberCharacter(char c)
+	{
+		return isdigit(static_cast<unsigned char>(c)) || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-';
+	}
+
+	void AppendUtf8(std::string& out, uint32_t codepoint)
+	{
+		if (codepoint < 0x80)
+			out += static_cast<char>(codepoint);
+		else if (codepoint < 0x800)
+		{
+			out += static_cast<char>(0xC0 | (codepoint >> 6));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+		else if (codepoint < 0x10000)
+		{
+			out += static_cast<char>(0xE0 | (codepoint >> 12));
+			out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+		else
+		{
+			out += static_cast<char>(0xF0 | (codepoint >> 18));
+			out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+	}
+}
+
+// Recursive descent over the text, which does not need to be null terminated
+class JsonParser
+{
+public:
+	JsonParser(const char* text, size_t size) : m_Text(text), m_Size(size) {}
+
+	JsonValue ParseDocument()
+	{
+		JsonValue value;
+		SkipWhitespace();
+		ParseValue(value, 0);
+		SkipWhitespace();
+		if (m_Position != m_Size)
+			Fail("unexpected data after the document");
+		return value;
+	}
+
+private:
+	[[noreturn]] void Fail(const std::string& message) const
+	{
+		throw std::runtime_error("JSON error at offset " + std::to_string(m_Position) + ": " + message);
+	}
+
+	bool AtEnd() const { return m_Position >= m_Size; }
+	char Peek() const { return AtEnd() ? '\0' : m_Text[m_Position]; }
+
+	void SkipWhitespace()
+	{
+		while (!AtEnd() && (m_Text[m_Position] == ' ' || m_Text[m_Position] == '\t' || m_Text[m_Position] == '\n' || m_Text[m_Position] == '\r'))
+			m_Position++;
+	}
+
+	void Expect(char c)
+	{
+		if (Peek() != c)
+			Fail(std::string("expected '") + c + "'");
+		m_Position++;
+	}
+
+	void ExpectLiteral(const char* literal)
+	{
+		size_t length = strlen(literal);
+		if (m_Size - m_Position < length || memcmp(m_Text + m_Position, literal, length) != 0)
+			Fail(std::string("expected ") + literal);
+		m_Position += length;
+	}
+
+	void ParseValue(JsonValue& value, int depth)
+	{
+		if (depth > MAX_DEPTH)
+			Fail("nesting too deep");
+
+		switch (Peek())
+		{
+		case '{':
+			ParseObject(value, depth);
+			break;
+		case '[':
+			ParseArray(value, depth);
+			break;
+		case '"':
+			value.m_Type = JsonValue::Type::String;
+			ParseString(value.m_String);
+			break;
+		case 't':
+			ExpectLiteral("true");
+			value.m_Type = JsonValue::Type::Bool;
+			value.m_Bool = true;
+			break;
+		case 'f':
+			ExpectLiteral("false");
+			value.m_Type = JsonValue::Type::Bool;
+			value.m_Bool = false;
+			break;
+		case 'n':
+			ExpectLiteral("null");
+			break;
+		default:
+			ParseNumber(value);
+			break;
+		}
+	}
+
+	void ParseObject(JsonValue& value, int depth)
+	{
+		value.m_Type = JsonValue::Type::Object;
+		Expect('{');
+		SkipWhitespace();
+		if (Peek() == '}')
+		{
+			m_Position++;
+			return;
+		}
+
+		while (true)
+		{
+			SkipWhitespace();
+			value.m_Members.emplace_back();
+			ParseString(value.m_Members.back().first);
+			SkipWhitespace();
+			Expect(':');
+			SkipWhitespace();
+			ParseValue(value.m_Members.back().second, depth + 1);
+			SkipWhitespace();
+			if (Peek() == '}')
+			{
+				m_Position++;
+				return;
+			}
+			Expect(',');
+		}
+	}
+
+	void ParseArray(JsonValue& value, int depth)
+	{
+		value.m_Type = JsonValue::Type::Array;
+		Expect('[');
+		SkipWhitespace();
+		if (Peek() == ']')
+		{
+			m_Position++;
+			return;
+		}
+
+		while (true)
+		{
+			SkipWhitespace();
+			value.m_Elements.emplace_back();
+			ParseValue(value.m_Elements.back(), depth + 1);
+			SkipWhitespace();
+			if (Peek() == ']')
+			{
+				m_Position++;
+				return;
+			}
+			Expect(',');
+		}
+	}
+
+	uint32_t ParseHex4()
+	{
+		if (m_Size - m_Position < 4)
+			Fail("truncated \\u escape");
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			char c = m_Text[m_Position++];
+			value <<= 4;
+			if (c >= '0' && c <= '9') value |= c - '0';
+			else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+			else Fail("invalid \\u escape");
+		}
+		return value;
+	}
+
+	void ParseString(std::string& out)
+	{
+		Expect('"');
+		while (true)
+		{
+			if (AtEnd())
+				Fail("unterminated string");
+
+			// copy runs without escapes in one go
+			size_t start = m_Position;
+			while (!AtEnd() && m_Text[m_Position] != '"' && m_Text[m_Position] != '\\' && static_cast<unsigned char>(m_Text[m_Position]) >= 0x20)
+				m_Position++;
+			out.append(m_Text + start, m_Position - start);
+
+			char c = Peek();
+			if (c == '"')
+			{
+				m_Position++;
+				return;
+			}
+			if (c != '\\')
+				Fail(AtEnd() ? "unterminated string" : "control character in string");
+
+			m_Position++;
+			char escape = Peek();
+			m_Position++;
+			switch (escape)
+			{
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				uint32_t codepoint = ParseHex4();
+				// surrogate pairs encode code points past the basic plane
+				if (codepoint >= 0xD800 && codepoint < 0xDC00 && m_Size - m_Position >= 6 && m_Text[m_Position] == '\\' && m_Text[m_Position + 1] == 'u')
+				{
+					m_Position += 2;
+					uint32_t low = ParseHex4();
+					if (low >= 0xDC00 && low < 0xE000)
+						codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+					else
+						Fail("invalid surrogate pair");
+				}
+				AppendUtf8(out, codepoint);
+				break;
+			}
+			default:
+				m_Position--;
+				Fail("invalid escape");
+			}
+		}
+	}
+
+	void ParseNumber(JsonValue& value)
+	{
+		size_t start = m_Position;
+		if (Peek() == '-')
+			m_Position++;
+		if (!isdigit(static_cast<unsigned char>(Peek())))
+			Fail("unexpected character");
+		while (!AtEnd() && IsNumberCharacter(m_Text[m_Position]))
+			m_Position++;
+
+		// strtod needs a terminated string, numbers are short enough for the stack
+		char buffer[64];
+		size_t length = m_Position - start;
+		if (length >= sizeof(buffer))
+			Fail("number too long");
+		memcpy(buffer, m_Text + start, length);
+		buffer[length] = '\0';
+
+		char* end = nullptr;
+		value.m_Type = JsonValue::Type::Number;
+		value.m_Number = strtod(buffer, &end);
+		if (end != buffer + length)
+		{
+			m_Position = start;
+			Fail("invalid number");
+		}
+	}
+
+	const char* m_Text;
+	size_t m_Size;
+	size_t m_Position = 0;
+};
+
+JsonValue JsonValue::Parse(const char* text, size_t size)
+{
+	PROFILE_SCOPE("JsonValue::Parse");
+	JsonParser parser(text, size);
+	return parser.ParseDocument();
+}
+
+const std::string& JsonValue::AsString() const
+{
+	static const std::string empty;
+	return IsString() ? m_String : empty;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	if (!IsArray() || index >= m_Elements.size())
+		return NullValue();
+	return m_Elements[index];
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const
+{
+	// objects in asset files are small, a linear scan beats building a map
+	for (const auto& member : m_Members)
+		if (member.first == key)
+			return member.second;
+	return NullValue();
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Parsed JSON document, enough for asset formats like glTF. Lookups of
+// missing keys or indices return a null value, so chains like
+// json["asset"]["version"].AsString() need no checks in between.
+class JsonValue
+{
+public:
+	enum class Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	// Throws std::runtime_error with the byte offset of the first error
+	static JsonValue Parse(const char* text, size_t size);
+
+	Type GetType() const { return m_Type; }
+	bool IsNull() const { return m_Type == Type::Null; }
+	bool IsBool() const { return m_Type == Type::Bool; }
+	bool IsNumber() const { return m_Type == Type::Number; }
+	bool IsString() const { return m_Type == Type::String; }
+	bool IsArray() const { return m_Type == Type::Array; }
+	bool IsObject() const { return m_Type == Type::Object; }
+
+	// Values of another type return the fallback, or an empty string
+	bool AsBool(bool fallback = false) const { return IsBool() ? m_Bool : fallback; }
+	double AsNumber(double fallback = 0.0) const { return IsNumber() ? m_Number : fallback; }
+	float AsFloat(float fallback = 0.0f) const { return IsNumber() ? static_cast<float>(m_Number) : fallback; }
+	int64_t AsInt(int64_t fallback = 0) const { return IsNumber() ? static_cast<int64_t>(m_Number) : fallback; }
+	const std::string& AsString() const;
+
+	// Elements of an array or members of an object
+	size_t Size() const { return IsArray() ? m_Elements.size() : m_Members.size(); }
+	bool Has(const std::string& key) const { return !(*this)[key].IsNull(); }
+	const JsonValue& operator[](size_t index) const;
+	const JsonValue& operator[](const std::string& key) const;
+	const std::vector<JsonValue>& GetElements() const { return m_Elements; }
+	const std::vector<std::pair<std::string, JsonValue>>& GetMembers() const { return m_Members; }
+
+private:
+	friend class JsonParser;
+
+	Type m_Type = Type::Null;
+	bool m_Bool = false;
+	double m_Number = 0.0;
+	std::string m_String;
+	std::vector<JsonValue> m_Elements;
+	std::vector<std::pair<std::string, JsonValue>> m_Members;	// in document order
+};
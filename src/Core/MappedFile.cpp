@@ -0,0 +1,115 @@
+#include <stdexcept>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "MappedFile.h"
+#include "Profiler.h"
+
+MappedFile::MappedFile(const std::string& filename)
+{
+	PROFILE_SCOPE("MappedFile::MappedFile");
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open " + filename);
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		throw std::runtime_error("Failed to read the size of " + filename);
+	}
+
+	m_File = file;
+	m_Size = static_cast<size_t>(size.QuadPart);
+	// empty files cannot be mapped, they stay open with no data
+	if (m_Size == 0)
+		return;
+
+	m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_Mapping)
+		m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_Data)
+	{
+		Close();
+		throw std::runtime_error("Failed to map " + filename);
+	}
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+		throw std::runtime_error("Failed to open " + filename);
+
+	struct stat status;
+	if (fstat(file, &status) != 0)
+	{
+		close(file);
+		throw std::runtime_error("Failed to read the size of " + filename);
+	}
+
+	m_Size = static_cast<size_t>(status.st_size);
+	if (m_Size > 0)
+	{
+		void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data == MAP_FAILED)
+		{
+			close(file);
+			throw std::runtime_error("Failed to map " + filename);
+		}
+		m_Data = static_cast<const uint8_t*>(data);
+	}
+	// the mapping keeps the file alive on its own
+	close(file);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(m_Data, other.m_Data);
+		std::swap(m_Size, other.m_Size);
+#ifdef _WIN32
+		std::swap(m_File, other.m_File);
+		std::swap(m_Mapping, other.m_Mapping);
+#endif
+	}
+	return *this;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_Data)
+		UnmapViewOfFile(m_Data);
+	if (m_Mapping)
+		CloseHandle(m_Mapping);
+	if (m_File)
+		CloseHandle(m_File);
+	m_File = nullptr;
+	m_Mapping = nullptr;
+#else
+	if (m_Data)
+		munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+	m_Data = nullptr;
+	m_Size = 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first
+// access, so parsing a header does not read the rest of the file.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	// Throws std::runtime_error if the file cannot be opened or mapped
+	explicit MappedFile(const std::string& filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	void Close();
+
+	bool IsOpen() const { return m_Data != nullptr; }
+	const uint8_t* GetData() const { return m_Data; }
+	size_t GetSize() const { return m_Size; }
+
+private:
+	const uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+#ifdef _WIN32
+	void* m_File = nullptr;
+	void* m_Mapping = nullptr;
+#endif
+};
@@ -0,0 +1,154 @@
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include "Profiler.h"
+#include "Time.h"
+
+namespace
+{
+	struct Event
+	{
+		const char* Name;
+		uint64_t Start;
+		uint64_t End;
+		uint64_t Frame;
+	};
+
+	// Written only by its owning thread. Head is published with release
+	// ordering so the exporter sees complete events up to it.
+	struct ThreadBuffer
+	{
+		std::unique_ptr<Event[]> Events{ new Event[Profiler::EVENTS_PER_THREAD] };
+		std::atomic<uint64_t> Head{ 0 };
+		std::atomic<const char*> Name{ nullptr };
+		uint32_t ThreadId = 0;
+	};
+
+	static_assert((Profiler::EVENTS_PER_THREAD & (Profiler::EVENTS_PER_THREAD - 1)) == 0, "EVENTS_PER_THREAD must be a power of two");
+
+	const Time::Clock::time_point s_Epoch = Time::Clock::now();
+	std::atomic<uint64_t> s_Frame{ 0 };
+
+	// buffers live until exit so traces can still include threads that have finished
+	std::mutex s_RegistryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> s_Buffers;
+
+	thread_local ThreadBuffer* t_Buffer = nullptr;
+
+	ThreadBuffer& GetThreadBuffer()
+	{
+		if (t_Buffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(s_RegistryMutex);
+			s_Buffers.push_back(std::make_unique<ThreadBuffer>());
+			t_Buffer = s_Buffers.back().get();
+			t_Buffer->ThreadId = static_cast<uint32_t>(s_Buffers.size());
+		}
+		return *t_Buffer;
+	}
+
+	// trace timestamps are microseconds, keep the nanoseconds as three decimals
+	std::string ToMicroseconds(uint64_t nanoseconds)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "%llu.%03llu",
+			static_cast<unsigned long long>(nanoseconds / 1000),
+			static_cast<unsigned long long>(nanoseconds % 1000));
+		return text;
+	}
+
+	void WriteEscaped(std::ostream& out, const char* text)
+	{
+		for (; *text; text++)
+		{
+			if (*text == '"' || *text == '\\')
+				out << '\\';
+			out << *text;
+		}
+	}
+}
+
+uint64_t Profiler::Now()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Time::Clock::now() - s_Epoch).count());
+}
+
+void Profiler::NextFrame()
+{
+	s_Frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t Profiler::GetFrame()
+{
+	return s_Frame.load(std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	GetThreadBuffer().Name.store(name, std::memory_order_release);
+}
+
+void Profiler::Record(const char* name, uint64_t start, uint64_t end)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+	uint64_t head = buffer.Head.load(std::memory_order_relaxed);
+	buffer.Events[head & (EVENTS_PER_THREAD - 1)] = { name, start, end, s_Frame.load(std::memory_order_relaxed) };
+	buffer.Head.store(head + 1, std::memory_order_release);
+}
+
+bool Profiler::ExportChromeTrace(const std::string& filename, uint64_t firstFrame, uint64_t lastFrame)
+{
+	std::ofstream file(filename);
+	if (!file)
+		return false;
+
+	std::vector<Event> events;
+	file << "{\"traceEvents\":[\n";
+	bool first = true;
+
+	std::lock_guard<std::mutex> lock(s_RegistryMutex);
+	for (const auto& buffer : s_Buffers)
+	{
+		// copy the ring, then drop whatever the owning thread may have overwritten meanwhile
+		uint64_t head = buffer->Head.load(std::memory_order_acquire);
+		uint64_t tail = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+		events.clear();
+		for (uint64_t i = tail; i < head; i++)
+			events.push_back(buffer->Events[i & (EVENTS_PER_THREAD - 1)]);
+
+		uint64_t newHead = buffer->Head.load(std::memory_order_acquire);
+		uint64_t validFrom = newHead > EVENTS_PER_THREAD ? newHead - EVENTS_PER_THREAD : 0;
+		uint64_t overwritten = validFrom > tail ? std::min(validFrom - tail, head - tail) : 0;
+		events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(overwritten));
+
+		const char* name = buffer->Name.load(std::memory_order_acquire);
+		if (name != nullptr)
+		{
+			file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->ThreadId << ",\"args\":{\"name\":\"";
+			WriteEscaped(file, name);
+			file << "\"}}";
+			first = false;
+		}
+
+		for (const Event& event : events)
+		{
+			if (event.Frame < firstFrame || event.Frame > lastFrame)
+				continue;
+
+			file << (first ? "" : ",\n") << "{\"name\":\"";
+			WriteEscaped(file, event.Name);
+			file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->ThreadId
+				<< ",\"ts\":" << ToMicroseconds(event.Start)
+				<< ",\"dur\":" << ToMicroseconds(event.End - event.Start)
+				<< ",\"args\":{\"frame\":" << event.Frame << "}}";
+			first = false;
+		}
+	}
+
+	file << "\n]}\n";
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Scoped CPU zone profiler.
+//
+//   PROFILE_SCOPE("Renderer::DrawFrame");
+//
+// records the time between the macro and the end of the enclosing scope into
+// a buffer owned by the calling thread, tagged with the current frame index.
+// Recording takes no locks; PROFILE_FRAME() advances the frame index and
+// Profiler::ExportChromeTrace writes a frame range in the Chrome trace event
+// format (chrome://tracing, ui.perfetto.dev).
+//
+// Zones are only recorded when VS_ENABLE_PROFILER is defined, otherwise the
+// macros expand to nothing.
+namespace Profiler
+{
+	// Zones kept per thread, older ones are overwritten
+	const uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+	// Nanoseconds on a monotonic clock
+	uint64_t Now();
+
+	void NextFrame();
+	uint64_t GetFrame();
+
+	// Names the calling thread in exported traces, the name must be a string literal
+	void SetThreadName(const char* name);
+	void Record(const char* name, uint64_t start, uint64_t end);
+
+	// Writes every zone that started in [firstFrame, lastFrame], returns false if the file could not be written
+	bool ExportChromeTrace(const std::string& filename, uint64_t firstFrame, uint64_t lastFrame);
+
+	class Zone
+	{
+	public:
+		explicit Zone(const char* name) : m_Name(name), m_Start(Now()) {}
+		~Zone() { Record(m_Name, m_Start, Now()); }
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* m_Name;
+		uint64_t m_Start;
+	};
+}
+
+#ifdef VS_ENABLE_PROFILER
+	#define PROFILE_CONCAT_IMPL(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+	// "" name only compiles for string literals, which are safe to keep by pointer
+	#define PROFILE_SCOPE(name) ::Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)("" name)
+	#define PROFILE_FRAME() ::Profiler::NextFrame()
+	#define PROFILE_THREAD(name) ::Profiler::SetThreadName("" name)
+#else
+	#define PROFILE_SCOPE(name)
+	#define PROFILE_FRAME()
+	#define PROFILE_THREAD(name)
+#endif
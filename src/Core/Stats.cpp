@@ -0,0 +1,74 @@
+#include <algorithm>
+#include "Stats.h"
+
+void StatSeries::Push(float value)
+{
+	uint32_t next = m_Next.load(std::memory_order_relaxed);
+	m_Values[next % SIZE].store(value, std::memory_order_relaxed);
+	m_Next.store(next + 1, std::memory_order_release);
+}
+
+uint32_t StatSeries::GetCount() const
+{
+	return std::min(m_Next.load(std::memory_order_acquire), SIZE);
+}
+
+uint32_t StatSeries::GetOffset() const
+{
+	uint32_t next = m_Next.load(std::memory_order_acquire);
+	return next < SIZE ? 0 : next % SIZE;
+}
+
+float StatSeries::GetLatest() const
+{
+	uint32_t next = m_Next.load(std::memory_order_acquire);
+	return next == 0 ? 0.0f : GetValue(next - 1);
+}
+
+float StatSeries::GetAverage() const
+{
+	uint32_t count = GetCount();
+	if (count == 0)
+		return 0.0f;
+
+	float sum = 0.0f;
+	for (uint32_t i = 0; i < count; i++)
+		sum += GetValue(i);
+	return sum / count;
+}
+
+float StatSeries::GetMax() const
+{
+	float max = 0.0f;
+	for (uint32_t i = 0; i < GetCount(); i++)
+		max = std::max(max, GetValue(i));
+	return max;
+}
+
+StatsRegistry& StatsRegistry::Get()
+{
+	static StatsRegistry registry;
+	return registry;
+}
+
+StatCounter& StatsRegistry::GetCounter(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (const auto& counter : m_Counters)
+		if (counter->GetName() == name)
+			return *counter;
+
+	m_Counters.push_back(std::make_unique<StatCounter>(name));
+	return *m_Counters.back();
+}
+
+StatSeries& StatsRegistry::GetSeries(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (const auto& series : m_Series)
+		if (series->GetName() == name)
+			return *series;
+
+	m_Series.push_back(std::make_unique<StatSeries>(name));
+	return *m_Series.back();
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Named value any subsystem can publish to. Updates are relaxed atomics, so
+// they cost about as much as a plain store and are safe from any thread.
+class StatCounter
+{
+public:
+	StatCounter(const std::string& name) : m_Name(name) {}
+
+	void Set(int64_t value) { m_Value.store(value, std::memory_order_relaxed); }
+	void Add(int64_t value = 1) { m_Value.fetch_add(value, std::memory_order_relaxed); }
+	int64_t Get() const { return m_Value.load(std::memory_order_relaxed); }
+	const std::string& GetName() const { return m_Name; }
+
+private:
+	std::string m_Name;
+	std::atomic<int64_t> m_Value{ 0 };
+};
+
+// Rolling window of the last SIZE samples, usually one per frame.
+// Meant for a single writer, readers may run on any thread.
+class StatSeries
+{
+public:
+	static const uint32_t SIZE = 240;
+
+	StatSeries(const std::string& name) : m_Name(name) {}
+
+	void Push(float value);
+
+	const std::string& GetName() const { return m_Name; }
+	uint32_t GetCount() const;
+	// Index of the oldest sample, for ImGui's values_offset
+	uint32_t GetOffset() const;
+	float GetValue(uint32_t index) const { return m_Values[index % SIZE].load(std::memory_order_relaxed); }
+	float GetLatest() const;
+	float GetAverage() const;
+	float GetMax() const;
+
+private:
+	std::string m_Name;
+	std::array<std::atomic<float>, SIZE> m_Values{};
+	std::atomic<uint32_t> m_Next{ 0 };
+};
+
+// Process wide directory of counters and series. Lookups take a lock, so
+// fetch a counter once and keep the reference; it stays valid until exit.
+class StatsRegistry
+{
+public:
+	static StatsRegistry& Get();
+
+	StatCounter& GetCounter(const std::string& name);
+	StatSeries& GetSeries(const std::string& name);
+
+	// Calls function for every counter in registration order
+	template <typename Function>
+	void ForEachCounter(Function function)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (const auto& counter : m_Counters)
+			function(static_cast<const StatCounter&>(*counter));
+	}
+
+private:
+	StatsRegistry() = default;
+
+	std::mutex m_Mutex;
+	std::vector<std::unique_ptr<StatCounter>> m_Counters;
+	std::vector<std::unique_ptr<StatSeries>> m_Series;
+};
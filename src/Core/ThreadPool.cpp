@@ -0,0 +1,53 @@
+#include <algorithm>
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+	for (uint32_t i = 0; i < threadCount; i++)
+		m_Threads.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+		m_Jobs.clear();
+	}
+	m_Condition.notify_all();
+
+	for (std::thread& thread : m_Threads)
+		thread.join();
+}
+
+void ThreadPool::Enqueue(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Jobs.push_back(std::move(job));
+	}
+	m_Condition.notify_one();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	PROFILE_THREAD("Worker");
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+			if (m_Stopping)
+				return;
+
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop_front();
+		}
+		job();
+	}
+}
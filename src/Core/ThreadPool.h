@@ -0,0 +1,46 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running submitted jobs in FIFO order.
+// Exceptions thrown by a job are stored in its future.
+class ThreadPool
+{
+public:
+	// threadCount 0 uses every hardware thread but one, which is left for the caller
+	explicit ThreadPool(uint32_t threadCount = 0);
+	// Jobs that have not started yet are dropped, their futures report a broken promise
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template <typename Function>
+	auto Submit(Function function) -> std::future<decltype(function())>
+	{
+		using Result = decltype(function());
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::move(function));
+		std::future<Result> future = task->get_future();
+		Enqueue([task]() { (*task)(); });
+		return future;
+	}
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+private:
+	void Enqueue(std::function<void()> job);
+	void WorkerLoop();
+
+	std::vector<std::thread> m_Threads;
+	std::deque<std::function<void()>> m_Jobs;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_Stopping = false;
+};
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include "Time.h"
+
+namespace
+{
+	const Time::Clock::time_point s_StartTime = Time::Clock::now();
+}
+
+double Time::Now()
+{
+	return std::chrono::duration<double>(Clock::now() - s_StartTime).count();
+}
+
+Timer::Timer()
+{
+	Reset();
+}
+
+void Timer::Reset()
+{
+	m_Start = Time::Clock::now();
+	m_Last = m_Start;
+	m_Delta = 0.0f;
+}
+
+float Timer::Tick()
+{
+	Time::Clock::time_point now = Time::Clock::now();
+	m_Delta = std::chrono::duration<float>(now - m_Last).count();
+	m_Last = now;
+	return m_Delta;
+}
+
+double Timer::GetElapsed() const
+{
+	return std::chrono::duration<double>(Time::Clock::now() - m_Start).count();
+}
+
+FixedTimestep::FixedTimestep(double step, uint32_t maxStepsPerUpdate)
+	: m_Step(step), m_MaxSteps(maxStepsPerUpdate)
+{
+}
+
+void FixedTimestep::Accumulate(double frameDelta)
+{
+	m_Accumulator += frameDelta;
+
+	// drop time we can't catch up on instead of spiralling after a long stall
+	double maxAccumulated = m_Step * m_MaxSteps;
+	if (m_Accumulator > maxAccumulated)
+		m_Accumulator = maxAccumulated;
+
+	m_PendingSteps = std::min(static_cast<uint32_t>(m_Accumulator / m_Step), m_MaxSteps);
+}
+
+bool FixedTimestep::Step()
+{
+	if (m_PendingSteps == 0)
+		return false;
+
+	m_PendingSteps--;
+	m_Accumulator -= m_Step;
+	m_StepCount++;
+	return true;
+}
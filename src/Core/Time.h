@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+namespace Time
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Seconds elapsed since the application started, on a monotonic high resolution clock
+	double Now();
+}
+
+// Measures the time between consecutive ticks, typically one per frame
+class Timer
+{
+public:
+	Timer();
+
+	void Reset();
+	// Returns the seconds elapsed since the previous tick
+	float Tick();
+
+	float GetDelta() const { return m_Delta; }
+	double GetElapsed() const;
+
+private:
+	Time::Clock::time_point m_Start;
+	Time::Clock::time_point m_Last;
+	float m_Delta = 0.0f;
+};
+
+// Fixed step accumulator: variable frame times go in, a whole number of
+// constant simulation steps come out, and the remainder is exposed as an
+// interpolation factor for rendering
+class FixedTimestep
+{
+public:
+	FixedTimestep(double step, uint32_t maxStepsPerUpdate = 8);
+
+	void Accumulate(double frameDelta);
+	// Consumes one step from the accumulator, use as while (timestep.Step()) { ... }
+	bool Step();
+
+	double GetStep() const { return m_Step; }
+	double GetTimeToNextStep() const { return m_Step - m_Accumulator; }
+	float GetAlpha() const { return static_cast<float>(m_Accumulator / m_Step); }
+	uint64_t GetStepCount() const { return m_StepCount; }
+
+private:
+	double m_Step;
+	double m_Accumulator = 0.0;
+	uint32_t m_MaxSteps;
+	uint32_t m_PendingSteps = 0;
+	uint64_t m_StepCount = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Single producer / single consumer hand-over of the latest value.
+// The producer fills GetWriteBuffer() and calls Publish(), the consumer calls
+// Acquire() and reads GetReadBuffer(). Neither side ever blocks or locks, and
+// buffers are reused so their contents (and capacity) survive between swaps.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	T& GetWriteBuffer() { return m_Buffers[m_WriteIndex]; }
+	const T& GetReadBuffer() const { return m_Buffers[m_ReadIndex]; }
+
+	void Publish()
+	{
+		uint8_t previous = m_Shared.exchange(m_WriteIndex | DIRTY_BIT, std::memory_order_acq_rel);
+		m_WriteIndex = previous & INDEX_MASK;
+	}
+
+	// Returns true if a newer value was published since the last call
+	bool Acquire()
+	{
+		if ((m_Shared.load(std::memory_order_relaxed) & DIRTY_BIT) == 0)
+			return false;
+
+		uint8_t previous = m_Shared.exchange(m_ReadIndex, std::memory_order_acq_rel);
+		m_ReadIndex = previous & INDEX_MASK;
+		return true;
+	}
+
+private:
+	static constexpr uint8_t DIRTY_BIT = 0x4;
+	static constexpr uint8_t INDEX_MASK = 0x3;
+
+	std::array<T, 3> m_Buffers{};
+	std::atomic<uint8_t> m_Shared{ 1 };
+	uint8_t m_WriteIndex = 0;
+	uint8_t m_ReadIndex = 2;
+};
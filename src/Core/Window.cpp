@@ -47,22 +47,22 @@ void Window::UpdateFPSCounter(float updateFrequency)
 	if (!m_FPSCounterEnabled)
         return;
 
-	static double lastTime = glfwGetTime();
-	static int frameCount = 0;
-
 	double currentTime = glfwGetTime();
-	float delta = static_cast<float>(currentTime - lastTime);
-	frameCount++;
+	if (m_FPSLastTime == 0.0)
+		m_FPSLastTime = currentTime;
+
+	float delta = static_cast<float>(currentTime - m_FPSLastTime);
+	m_FPSFrameCount++;
 
 	if (delta < updateFrequency)
 		return;
 
-	float fps = frameCount / delta;
+	float fps = m_FPSFrameCount / delta;
 
 	std::string title = Name + " - FPS: " + std::to_string(fps);
 	glfwSetWindowTitle(m_GLFWwindow, title.c_str());
-	frameCount = 0;
-	lastTime = currentTime;
+	m_FPSFrameCount = 0;
+	m_FPSLastTime = currentTime;
 }
 
 void Window::OnMouseMove(std::function<void(float xPos, float yPos, float xOffset, float yOffset)> callback)
@@ -108,6 +108,20 @@ bool Window::IsKeyPressed(Keyboard::Key key)
 	return glfwGetKey(m_GLFWwindow, key) == GLFW_PRESS;
 }
 
+void Window::CaptureInput(InputState& state)
+{
+	for (int key = GLFW_KEY_SPACE; key <= GLFW_KEY_LAST; key++)
+		state.Keys.set(key, glfwGetKey(m_GLFWwindow, key) == GLFW_PRESS);
+
+	for (int button = 0; button <= GLFW_MOUSE_BUTTON_LAST; button++)
+		state.MouseButtons.set(button, glfwGetMouseButton(m_GLFWwindow, button) == GLFW_PRESS);
+
+	double mouseX, mouseY;
+	glfwGetCursorPos(m_GLFWwindow, &mouseX, &mouseY);
+	state.MouseX = static_cast<float>(mouseX);
+	state.MouseY = static_cast<float>(mouseY);
+}
+
 bool Window::IsMouseButtonReleased(Mouse::Button button)
 {
 	return glfwGetMouseButton(m_GLFWwindow, button) == GLFW_RELEASE;
@@ -3,8 +3,23 @@
 #include <GLFW/glfw3.h>
 #include <string>
 #include <functional>
+#include <bitset>
 #include "InputKeys.h"
 
+// Copy of the keyboard and mouse state taken on the main thread, so input can
+// be consumed from other threads without calling into GLFW
+struct InputState
+{
+	std::bitset<GLFW_KEY_LAST + 1> Keys;
+	std::bitset<GLFW_MOUSE_BUTTON_LAST + 1> MouseButtons;
+	float MouseX = 0.0f;
+	float MouseY = 0.0f;
+
+	bool IsKeyPressed(Keyboard::Key key) const { return Keys.test(key); }
+	bool IsMouseButtonPressed(Mouse::Button button) const { return MouseButtons.test(button); }
+	bool IsMouseButtonReleased(Mouse::Button button) const { return !MouseButtons.test(button); }
+};
+
 class Window
 {
 public:
@@ -25,6 +40,7 @@ public:
 	bool IsMouseButtonPressed(Mouse::Button button);
 	bool IsMouseButtonReleased(Mouse::Button button);
 	bool IsKeyPressed(Keyboard::Key key);
+	void CaptureInput(InputState& state);
 
 	VkSurfaceKHR CreateSurface(VkInstance instance);
 
@@ -44,6 +60,8 @@ private:
 	GLFWwindow* m_GLFWwindow;
 	std::function<void(int width, int height)> m_OnResizeCallback;
 	bool m_FPSCounterEnabled = false;
+	double m_FPSLastTime = 0.0;
+	int m_FPSFrameCount = 0;
 	float m_LastXPos = 0.0f;
 	float m_LastYPos = 0.0f;
 	bool m_FirstMouse = true;
@@ -3,6 +3,6 @@ class IModule
 public:
 	virtual ~IModule() {};
 	virtual void Initialize() = 0;
-	virtual void Update() = 0;
+	virtual void Update(float deltaTime) = 0;
 	virtual void Terminate() = 0;
 };
\ No newline at end of file
@@ -1,17 +1,29 @@
 #include <iostream>
 #include <array>
+#include <algorithm>
+#include <cstdio>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
 #include "Renderer.h"
+#include "../../Core/Profiler.h"
 
 
 Renderer::Renderer(Window& window, Camera& camera, SceneGraph& sceneGraph)
-	: m_Window{ window },
+	: m_Window{ &window },
 	  m_Camera{ camera },
 	  m_SceneGraph{ sceneGraph }
 {
 	std::cout << "Renderer Constructor" << std::endl;
-	Resize(m_Window.Width, m_Window.Height);
+	Resize(m_Window->Width, m_Window->Height);
+	m_Camera.UpdateRotation();
+}
+
+Renderer::Renderer(Camera& camera, SceneGraph& sceneGraph, uint32_t width, uint32_t height)
+	: m_Camera{ camera },
+	  m_SceneGraph{ sceneGraph }
+{
+	std::cout << "Renderer Constructor (headless)" << std::endl;
+	Resize(width, height);
 	m_Camera.UpdateRotation();
 }
 
@@ -22,19 +34,40 @@ Renderer::~Renderer()
 
 void Renderer::Initialize()
 {
+	PROFILE_SCOPE("Renderer::Initialize");
 	try
 	{
 		m_Device = std::make_unique<Device>(m_Window);
 		m_Device->Initialize();
-		m_SwapChain = std::make_unique<SwapChain>(*m_Device, m_Window);
-		m_SwapChain->Initialize();
+		if (IsHeadless())
+		{
+			m_Offscreen = std::make_unique<Offscreen>(*m_Device, m_Width, m_Height);
+			m_Offscreen->Initialize();
+			m_FramebufferResized = false;
+		}
+		else
+		{
+			m_SwapChain = std::make_unique<SwapChain>(*m_Device, *m_Window);
+			m_SwapChain->Initialize();
+		}
 		SetupDescriptors();
 		SetupPipelines();
+		m_ThreadPool = std::make_unique<ThreadPool>();
+		m_TextureLoader = std::make_unique<TextureLoader>(*m_Device);
+		m_TextureLoader->Initialize();
+		m_TextureAtlas = std::make_unique<TextureAtlas>(*m_Device);
+		m_TextureAtlas->Initialize();
+		m_TextureStreamer = std::make_unique<TextureStreamer>(*m_Device, *m_ThreadPool, *m_TextureLoader, *m_TextureAtlas);
+		m_TextureStreamer->Initialize();
 		SetupMaterials();
 		SetupMeshes();
 		CreateCommandBuffers();
 		CreateSyncObjects();
-		InitImGui();
+		m_GpuProfiler = std::make_unique<GpuProfiler>(*m_Device, MAX_FRAMES_IN_FLIGHT);
+		m_GpuProfiler->Initialize();
+		RegisterStats();
+		if (!IsHeadless())
+			InitImGui();
 	}
 	catch (vk::SystemError& err)
     {
@@ -43,8 +76,10 @@ void Renderer::Initialize()
     }
 }
 
-void Renderer::Update()
+void Renderer::Update(float deltaTime)
 {
+	m_DeltaTime = deltaTime;
+
 	try
 	{
 		DrawFrame();
@@ -65,12 +100,23 @@ void Renderer::Terminate()
 {
 	try
 	{
-		DestroyImGui();
+		if (!IsHeadless())
+			DestroyImGui();
+		// stop decoding before the loader and the materials waiting for it go away
+		m_ThreadPool.reset();
+		m_TextureLoader->Terminate();
+		m_TextureStreamer->Terminate();
+		FreeRetiredMaterialBindings(true);
+		m_TextureAtlas->Terminate();
 		m_SceneGraph.Terminate();
 		DestroyPipelines();
 		DestroyDescriptors();
 		DestroySyncObjects();
-		m_SwapChain->Terminate();
+		m_GpuProfiler->Terminate();
+		if (IsHeadless())
+			m_Offscreen->Terminate();
+		else
+			m_SwapChain->Terminate();
 		m_Device->Terminate();
 	}
 	catch (vk::SystemError& err)
@@ -86,80 +132,258 @@ void Renderer::Resize(uint32_t width, uint32_t height)
 	m_Width = width;
 	m_Height = height;
 	m_FramebufferResized = true;
+
+	// the camera is owned by the simulation thread
+	std::lock_guard<std::mutex> lock(m_SceneGraph.GetMutex());
 	m_Camera.Resize(m_Width, m_Height);
 }
 
+void Renderer::ReadbackFrame(std::vector<uint8_t>& pixels)
+{
+	if (!IsHeadless())
+		throw std::runtime_error("Frame readback requires a headless renderer");
+
+	m_Device->WaitIdle();
+	m_Offscreen->ReadPixels(pixels);
+}
+
+void Renderer::SaveFrame(const std::string& filename)
+{
+	if (!IsHeadless())
+		throw std::runtime_error("Frame readback requires a headless renderer");
+
+	m_Device->WaitIdle();
+	m_Offscreen->SavePNG(filename);
+}
+
+vk::RenderPass Renderer::GetRenderPass() const
+{
+	return IsHeadless() ? m_Offscreen->GetRenderPass() : m_SwapChain->GetRenderPass();
+}
+
+vk::Extent2D Renderer::GetExtent() const
+{
+	return IsHeadless() ? m_Offscreen->GetExtent() : m_SwapChain->GetExtent();
+}
+
 void Renderer::SetupMeshes()
 {
-	for (auto it = m_SceneGraph.begin(); it != m_SceneGraph.end(); ++it)
+	PROFILE_SCOPE("Renderer::SetupMeshes");
+	// mesh files go from their mapping into the ring, which submits once it is full
+	StagingRing staging(*m_Device);
+	// nodes instancing one mesh share its data or file, and so one GPU mesh
+	std::unordered_map<const MeshData*, std::shared_ptr<Mesh>> byData;
+	std::unordered_map<std::string, std::shared_ptr<Mesh>> byPath;
+	for (MeshComponent& mesh : m_SceneGraph.GetNodes().GetStorage<MeshComponent>())
 	{
-		Node& node = *it;
-		if (node.GetType() == NodeType::Model)
+		if (mesh.GPUMesh != nullptr)
+			continue;
+
+		std::shared_ptr<Mesh>& shared = mesh.Path.empty() ? byData[mesh.Data.get()] : byPath[mesh.Path];
+		if (shared == nullptr)
 		{
-			MeshData meshData = node.GetModel().GetMeshData();
-			node.m_Mesh = new Mesh(*m_Device);
-			node.m_Mesh->Create(meshData.Vertices, meshData.Indices);
+			// the last node dropping its reference destroys the mesh
+			shared = std::shared_ptr<Mesh>(new Mesh(*m_Device), [](Mesh* gpuMesh)
+			{
+				gpuMesh->Destroy();
+				delete gpuMesh;
+			});
+			CreateMesh(*shared, mesh, staging);
 		}
+		mesh.GPUMesh = shared;
+	}
+	staging.Flush();
+}
+
+void Renderer::CreateMesh(Mesh& gpuMesh, const MeshComponent& mesh, StagingRing& staging)
+{
+	if (!mesh.Path.empty())
+	{
+		MappedFile file(ASSETS_PATH + mesh.Path);
+		gpuMesh.Create(MeshFile::Parse(file.GetData(), file.GetSize()), staging);
+		WriteMeshletDescriptorSet(&gpuMesh);
+		return;
 	}
+
+	// mesh files are simplified, optimized and split offline by the mesh tool, everything else here
+	MeshData meshData = *mesh.Data;
+	if (meshData.Lods.empty())
+		MeshSimplifier::GenerateLods(meshData);
+	MeshOptimizer::Optimize(meshData);
+	if (MeshletBuilder::IsWorthBuilding(meshData))
+		MeshletBuilder::Build(meshData);
+	gpuMesh.Create(meshData.Vertices, meshData.Indices, meshData.Format, meshData.Lods, meshData.Meshlets);
+	WriteMeshletDescriptorSet(&gpuMesh);
+}
+
+void Renderer::WriteMeshletDescriptorSet(Mesh* mesh)
+{
+	if (!mesh->HasMeshlets())
+		return;
+
+	vk::DescriptorBufferInfo meshletInfo(mesh->GetMeshletBuffer(), 0, VK_WHOLE_SIZE);
+	vk::DescriptorBufferInfo vertexInfo(mesh->GetMeshletVertexBuffer(), 0, VK_WHOLE_SIZE);
+	vk::DescriptorBufferInfo triangleInfo(mesh->GetMeshletTriangleBuffer(), 0, VK_WHOLE_SIZE);
+	vk::DescriptorBufferInfo meshVertexInfo(mesh->GetVertexBuffer(), 0, VK_WHOLE_SIZE);
+
+	vk::DescriptorSet set;
+	DescriptorWriter writer(*m_MeshletDescriptorSetLayout, *m_MeshletDescriptorPool);
+	writer.WriteBuffer(0, &meshletInfo)
+		.WriteBuffer(1, &vertexInfo)
+		.WriteBuffer(2, &triangleInfo)
+		.WriteBuffer(3, &meshVertexInfo);
+	if (!writer.Build(set))
+		throw std::runtime_error("Failed to allocate meshlet descriptor set");
+	mesh->SetMeshletDescriptorSet(set);
 }
 
 void Renderer::SetupMaterials()
 {
-	for (auto it = m_SceneGraph.begin(); it != m_SceneGraph.end(); ++it)
+	PROFILE_SCOPE("Renderer::SetupMaterials");
+	for (MaterialComponent& component : m_SceneGraph.GetNodes().GetStorage<MaterialComponent>())
 	{
-		Node& node = *it;
-		if (node.GetType() == NodeType::Model)
+		Material* material = new Material(*m_Device);
+		component.GPUMaterial = material;
+
+		auto parameters = component.Data;
+		material->Create(parameters);
+		material->TextureRegion = m_TextureAtlas->GetWhiteRegion();
+		WriteMaterialDescriptorSet(material);
+
+		// drawn white until the decode and first upload finish. A texture
+		// packed into the atlas only moves the region, the set stays valid.
+		if (parameters.TexturePath != "")
 		{
-			node.m_Material = new Material(*m_Device);
-			
-			auto parameters = node.GetModel().GetMaterialParameters();
-			node.m_Material->Create(parameters);
-			
-			DescriptorWriter(
-				*m_Pipelines[parameters.Type].MaterialDescriptorSetLayout,
-				*m_MaterialDescriptorPool)
-					.WriteBuffer(0, &node.m_Material->MaterialUniformBuffer->DescriptorInfo())
-					.WriteImage(1, &node.m_Material->BaseTexture->DescriptorInfo())
-					.Build(node.m_Material->DescriptorSet);
+			auto onResident = [this, material](std::shared_ptr<Texture> texture)
+			{
+				OnTextureLoaded(material, std::move(texture));
+			};
+			auto onPacked = [material](const AtlasRegion& region)
+			{
+				material->TextureRegion = region;
+			};
+			material->TextureStreamId = parameters.EmbeddedTexture
+				? m_TextureStreamer->Add(parameters.TexturePath, parameters.EmbeddedTexture, onResident, onPacked)
+				: m_TextureStreamer->Add(ASSETS_PATH + parameters.TexturePath, onResident, onPacked);
 		}
 	}
 }
 
+void Renderer::WriteMaterialDescriptorSet(Material* material)
+{
+	vk::DescriptorBufferInfo bufferInfo = material->MaterialUniformBuffer->DescriptorInfo();
+	vk::DescriptorImageInfo imageInfo = material->BaseTexture ? material->BaseTexture->DescriptorInfo() : m_TextureAtlas->DescriptorInfo();
+
+	bool built = DescriptorWriter(
+		*m_Pipelines[material->GetType()].MaterialDescriptorSetLayout,
+		*m_MaterialDescriptorPool)
+			.WriteBuffer(0, &bufferInfo)
+			.WriteImage(1, &imageInfo)
+			.Build(material->DescriptorSet);
+	if (!built)
+		throw std::runtime_error("Failed to allocate material descriptor set");
+}
+
+void Renderer::OnTextureLoaded(Material* material, std::shared_ptr<Texture> texture)
+{
+	// the frame in flight may still read the old set and texture, so the
+	// material gets a new set rather than an update in place
+	m_RetiredBindings.push_back({ material->DescriptorSet, std::move(material->BaseTexture), m_FrameNumber + MAX_FRAMES_IN_FLIGHT });
+	material->BaseTexture = std::move(texture);
+	WriteMaterialDescriptorSet(material);
+}
+
+void Renderer::FreeRetiredMaterialBindings(bool all)
+{
+	std::vector<vk::DescriptorSet> sets;
+	auto it = m_RetiredBindings.begin();
+	while (it != m_RetiredBindings.end())
+	{
+		if (all || it->FreeAtFrame <= m_FrameNumber)
+		{
+			// dropping the last reference to the texture destroys it
+			sets.push_back(it->Set);
+			it = m_RetiredBindings.erase(it);
+		}
+		else
+			++it;
+	}
+
+	if (!sets.empty())
+		m_MaterialDescriptorPool->FreeDescriptors(sets);
+}
+
+void Renderer::FinishTextureLoads()
+{
+	m_TextureStreamer->Flush();
+	m_TextureLoader->Flush();
+}
+
 void Renderer::SetupDescriptors()
 {
+	PROFILE_SCOPE("Renderer::SetupDescriptors");
 	vk::DeviceSize bufferSize = sizeof(SceneUBO);
 
+	// meshlets are culled by compute or task shaders and expanded by mesh shaders
+	vk::ShaderStageFlags meshletStages = vk::ShaderStageFlagBits::eCompute;
+	if (m_Device->IsMeshShaderSupported())
+		meshletStages |= vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+
 	m_SceneDescriptorSetLayout = DescriptorSetLayout::Builder(*m_Device)
-		.AddBinding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
+		.AddBinding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | meshletStages)
 		.Build();
 
 	m_SceneDescriptorPool = DescriptorPool::Builder(*m_Device)
 		.SetMaxSets(MAX_FRAMES_IN_FLIGHT)
-		.AddPoolSize(vk::DescriptorType::eUniformBuffer, 1)
+		.AddPoolSize(vk::DescriptorType::eUniformBuffer, MAX_FRAMES_IN_FLIGHT)
 		.Build();
 
+	// one uniform buffer and one sampler per material set
 	m_MaterialDescriptorPool = DescriptorPool::Builder(*m_Device)
-		.SetMaxSets(1000)
-		.AddPoolSize(vk::DescriptorType::eUniformBuffer, 1)
-		.AddPoolSize(vk::DescriptorType::eCombinedImageSampler, 1)
+		.SetMaxSets(MATERIAL_SETS_PER_POOL)
+		.AddPoolSize(vk::DescriptorType::eUniformBuffer, MATERIAL_SETS_PER_POOL)
+		.AddPoolSize(vk::DescriptorType::eCombinedImageSampler, MATERIAL_SETS_PER_POOL)
+		.Build();
+
+	// meshlets, meshlet vertices, meshlet triangles and the mesh vertices as storage buffers
+	m_MeshletDescriptorSetLayout = DescriptorSetLayout::Builder(*m_Device)
+		.AddBinding(0, vk::DescriptorType::eStorageBuffer, meshletStages)
+		.AddBinding(1, vk::DescriptorType::eStorageBuffer, meshletStages)
+		.AddBinding(2, vk::DescriptorType::eStorageBuffer, meshletStages)
+		.AddBinding(3, vk::DescriptorType::eStorageBuffer, meshletStages)
+		.Build();
+
+	m_MeshletCommandSetLayout = DescriptorSetLayout::Builder(*m_Device)
+		.AddBinding(0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute)
+		.Build();
+
+	// four storage buffers per mesh set, one per command set
+	m_MeshletDescriptorPool = DescriptorPool::Builder(*m_Device)
+		.SetMaxSets(MESHLET_SETS_PER_POOL)
+		.AddPoolSize(vk::DescriptorType::eStorageBuffer, 4 * MESHLET_SETS_PER_POOL)
 		.Build();
 
 	for (uint32_t i = 0; i < m_Frames.size(); i++)
 	{
+		ReserveMeshletCommands(m_Frames[i], INITIAL_MESHLET_COMMANDS);
+
 		m_Frames[i].SceneUniformBuffer = std::make_unique<Buffer>(
 			*m_Device,
 			bufferSize,
 			1,
 			vk::BufferUsageFlagBits::eUniformBuffer,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::Uniform
 		);
 		m_Frames[i].SceneUniformBuffer->Map();
 
 		vk::DescriptorBufferInfo bufferInfo = m_Frames[i].SceneUniformBuffer->DescriptorInfo();
 
-		DescriptorWriter (*m_SceneDescriptorSetLayout, *m_SceneDescriptorPool)
+		bool built = DescriptorWriter(*m_SceneDescriptorSetLayout, *m_SceneDescriptorPool)
 			.WriteBuffer(0, &bufferInfo)
 			.Build(m_Frames[i].SceneDescriptorSet);
+		if (!built)
+			throw std::runtime_error("Failed to allocate scene descriptor set");
 	}
 }
 
@@ -168,102 +392,125 @@ void Renderer::DestroyDescriptors()
 	m_SceneDescriptorPool.reset();
 	m_SceneDescriptorSetLayout.reset();
 	m_MaterialDescriptorPool.reset();
+	m_MeshletDescriptorPool.reset();
+	m_MeshletDescriptorSetLayout.reset();
+	m_MeshletCommandSetLayout.reset();
 
 	for (size_t i = 0; i < m_Frames.size(); i++)
+	{
 		m_Frames[i].SceneUniformBuffer.reset();
+		m_Frames[i].MeshletCommandBuffer.reset();
+	}
+}
+
+void Renderer::ReserveMeshletCommands(FrameData& frame, uint32_t commandCount)
+{
+	if (frame.MeshletCommandBuffer && frame.MeshletCommandBuffer->GetInstanceCount() >= commandCount)
+		return;
+
+	// only called after the frame's fence wait, nothing reads the old buffer anymore
+	uint32_t capacity = frame.MeshletCommandBuffer ? frame.MeshletCommandBuffer->GetInstanceCount() * 2 : INITIAL_MESHLET_COMMANDS;
+	frame.MeshletCommandBuffer = std::make_unique<Buffer>(
+		*m_Device,
+		sizeof(vk::DrawIndexedIndirectCommand),
+		std::max(capacity, commandCount),
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Geometry
+	);
+
+	vk::DescriptorBufferInfo bufferInfo = frame.MeshletCommandBuffer->DescriptorInfo();
+	DescriptorWriter writer(*m_MeshletCommandSetLayout, *m_MeshletDescriptorPool);
+	writer.WriteBuffer(0, &bufferInfo);
+	if (frame.MeshletCommandDescriptorSet)
+		writer.Overwrite(frame.MeshletCommandDescriptorSet);
+	else if (!writer.Build(frame.MeshletCommandDescriptorSet))
+		throw std::runtime_error("Failed to allocate meshlet command descriptor set");
 }
 
 void Renderer::SetupPipelines()
 {
-	// default pipeline
-	{
-		auto pipeline = Pipeline(m_Device->GetDevice(), m_SwapChain->GetRenderPass());
-		auto sceneLayout = m_SceneDescriptorSetLayout->GetDescriptorSetLayout();
-		auto materialLayout = DescriptorSetLayout::Builder(*m_Device)
-			.AddBinding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eFragment)
-			.AddBinding(1, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment)
-			.Build();
-			
-		std::array<vk::DescriptorSetLayout, 2> setLayouts = { sceneLayout, materialLayout->GetDescriptorSetLayout() };
-		pipeline.Create(
-			"resources/shaders/default.vert.spv",
-			"resources/shaders/default.frag.spv",
-			{
-				Vertex::GetBindingDescription(),
-				Vertex::GetAttributeDescriptions(),
-				static_cast<uint32_t>(setLayouts.size()),
-				setLayouts.data(),
-				sizeof(PushConstantData)
-			}
-		);
+	PROFILE_SCOPE("Renderer::SetupPipelines");
+	CreateMaterialPipeline(MaterialType::Default, "default", "default");
+	CreateMaterialPipeline(MaterialType::Basic, "basic", "basic");
+	CreateMaterialPipeline(MaterialType::Wireframe, "basic", "basic", vk::PolygonMode::eLine, vk::CullModeFlagBits::eNone);
+
+	std::array<vk::DescriptorSetLayout, 3> cullLayouts = {
+		m_SceneDescriptorSetLayout->GetDescriptorSetLayout(),
+		m_MeshletDescriptorSetLayout->GetDescriptorSetLayout(),
+		m_MeshletCommandSetLayout->GetDescriptorSetLayout()
+	};
+	m_MeshletCullPipeline = std::make_unique<ComputePipeline>(m_Device->GetDevice());
+	m_MeshletCullPipeline->Create("resources/shaders/meshlet_cull.comp.spv", static_cast<uint32_t>(cullLayouts.size()), cullLayouts.data(), sizeof(MeshletCullConstants));
+}
 
-		MaterialPipeline materialPipelineData{};
-		materialPipelineData.Pipeline = std::make_unique<Pipeline>(pipeline);
-		materialPipelineData.MaterialDescriptorSetLayout = std::move(materialLayout);
+void Renderer::CreateMaterialPipeline(MaterialType type, const std::string& vertexShader, const std::string& fragmentShader, vk::PolygonMode polygonMode, vk::CullModeFlagBits cullMode)
+{
+	auto sceneLayout = m_SceneDescriptorSetLayout->GetDescriptorSetLayout();
+	auto materialLayout = DescriptorSetLayout::Builder(*m_Device)
+		.AddBinding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eFragment)
+		.AddBinding(1, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment)
+		.Build();
 
-		m_Pipelines.insert({ MaterialType::Default, std::move(materialPipelineData) });
-	}
+	std::array<vk::DescriptorSetLayout, 2> setLayouts = { sceneLayout, materialLayout->GetDescriptorSetLayout() };
+	std::string fragmentPath = "resources/shaders/" + fragmentShader + ".frag.spv";
 
-	// basic pipeline
-	{
-		auto pipeline = Pipeline(m_Device->GetDevice(), m_SwapChain->GetRenderPass());
-		auto sceneLayout = m_SceneDescriptorSetLayout->GetDescriptorSetLayout();
-		auto materialLayout = DescriptorSetLayout::Builder(*m_Device)
-			.AddBinding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eFragment)
-			.AddBinding(1, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment)
-			.Build();
-			
-		std::array<vk::DescriptorSetLayout, 2> setLayouts = { sceneLayout, materialLayout->GetDescriptorSetLayout() };
-		pipeline.Create(
-			"resources/shaders/basic.vert.spv",
-			"resources/shaders/basic.frag.spv",
+	// every variant has the same layouts, so descriptor sets stay bound when switching between them
+	auto createVariant = [&](const std::string& vertexPath, const vk::VertexInputBindingDescription& binding,
+		const std::vector<vk::VertexInputAttributeDescription>& attributes, bool dither)
+	{
+		auto pipeline = std::make_unique<Pipeline>(m_Device->GetDevice(), GetRenderPass());
+		pipeline->Create(
+			vertexPath,
+			fragmentPath,
 			{
-				Vertex::GetBindingDescription(),
-				Vertex::GetAttributeDescriptions(),
+				binding,
+				attributes,
 				static_cast<uint32_t>(setLayouts.size()),
 				setLayouts.data(),
-				sizeof(PushConstantData)
+				sizeof(PushConstantData),
+				polygonMode,
+				vk::PrimitiveTopology::eTriangleList,
+				cullMode,
+				{ dither ? VK_TRUE : VK_FALSE }
 			}
 		);
+		return pipeline;
+	};
 
-		MaterialPipeline materialPipelineData{};
-		materialPipelineData.Pipeline = std::make_unique<Pipeline>(pipeline);
-		materialPipelineData.MaterialDescriptorSetLayout = std::move(materialLayout);
-
-		m_Pipelines.insert({ MaterialType::Basic, std::move(materialPipelineData) });
-	}
+	std::string vertexPath = "resources/shaders/" + vertexShader + ".vert.spv";
+	std::string packedVertexPath = "resources/shaders/" + vertexShader + "_packed.vert.spv";
+	MaterialPipeline materialPipelineData{};
+	materialPipelineData.Pipeline = createVariant(vertexPath, Vertex::GetBindingDescription(), Vertex::GetAttributeDescriptions(), false);
+	materialPipelineData.PackedPipeline = createVariant(packedVertexPath, PackedVertex::GetBindingDescription(), PackedVertex::GetAttributeDescriptions(), false);
+	materialPipelineData.DitherPipeline = createVariant(vertexPath, Vertex::GetBindingDescription(), Vertex::GetAttributeDescriptions(), true);
+	materialPipelineData.PackedDitherPipeline = createVariant(packedVertexPath, PackedVertex::GetBindingDescription(), PackedVertex::GetAttributeDescriptions(), true);
 
-	// wireframe pipeline
-	{
-		auto pipeline = Pipeline(m_Device->GetDevice(), m_SwapChain->GetRenderPass());
-		auto sceneLayout = m_SceneDescriptorSetLayout->GetDescriptorSetLayout();
-		auto materialLayout = DescriptorSetLayout::Builder(*m_Device)
-			.AddBinding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eFragment)
-			.AddBinding(1, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment)
-			.Build();
-			
-		std::array<vk::DescriptorSetLayout, 2> setLayouts = { sceneLayout, materialLayout->GetDescriptorSetLayout() };
-		pipeline.Create(
-			"resources/shaders/basic.vert.spv",
-			"resources/shaders/basic.frag.spv",
+	// the mesh shader reads the full vertex layout itself, packed meshes take the compute path
+	if (m_Device->IsMeshShaderSupported())
+	{
+		std::array<vk::DescriptorSetLayout, 3> meshletSetLayouts = { sceneLayout, materialLayout->GetDescriptorSetLayout(), m_MeshletDescriptorSetLayout->GetDescriptorSetLayout() };
+		materialPipelineData.MeshletPipeline = std::make_unique<Pipeline>(m_Device->GetDevice(), GetRenderPass());
+		materialPipelineData.MeshletPipeline->CreateMeshShading(
+			"resources/shaders/meshlet.task.spv",
+			"resources/shaders/meshlet.mesh.spv",
+			fragmentPath,
 			{
-				Vertex::GetBindingDescription(),
-				Vertex::GetAttributeDescriptions(),
-				static_cast<uint32_t>(setLayouts.size()),
-				setLayouts.data(),
+				vk::VertexInputBindingDescription(),
+				{},
+				static_cast<uint32_t>(meshletSetLayouts.size()),
+				meshletSetLayouts.data(),
 				sizeof(PushConstantData),
-				vk::PolygonMode::eLine,
+				polygonMode,
 				vk::PrimitiveTopology::eTriangleList,
-				vk::CullModeFlagBits::eNone
+				cullMode,
+				{ VK_FALSE }
 			}
 		);
-
-		MaterialPipeline materialPipelineData{};
-		materialPipelineData.Pipeline = std::make_unique<Pipeline>(pipeline);
-		materialPipelineData.MaterialDescriptorSetLayout = std::move(materialLayout);
-
-		m_Pipelines.insert({ MaterialType::Wireframe, std::move(materialPipelineData) });
 	}
+
+	materialPipelineData.MaterialDescriptorSetLayout = std::move(materialLayout);
+	m_Pipelines.insert({ type, std::move(materialPipelineData) });
 }
 
 void Renderer::DestroyPipelines()
@@ -271,35 +518,60 @@ void Renderer::DestroyPipelines()
 	for (auto& pipeline : m_Pipelines)
 	{
 		pipeline.second.Pipeline->Terminate();
+		pipeline.second.PackedPipeline->Terminate();
+		pipeline.second.DitherPipeline->Terminate();
+		pipeline.second.PackedDitherPipeline->Terminate();
+		if (pipeline.second.MeshletPipeline)
+			pipeline.second.MeshletPipeline->Terminate();
 		pipeline.second.MaterialDescriptorSetLayout.reset();
 	}
+	m_MeshletCullPipeline->Terminate();
 }
 
-void Renderer::UpdateSceneUBO(uint32_t currentImage)
+Pipeline* Renderer::GetMaterialPipeline(MaterialType type, VertexFormat format, bool dither, bool meshShading)
 {
+	MaterialPipeline& materialPipeline = m_Pipelines[type];
+	if (meshShading)
+		return materialPipeline.MeshletPipeline.get();
+	if (format == VertexFormat::Packed)
+		return dither ? materialPipeline.PackedDitherPipeline.get() : materialPipeline.PackedPipeline.get();
+	return dither ? materialPipeline.DitherPipeline.get() : materialPipeline.Pipeline.get();
+}
+
+SceneUBO Renderer::UpdateSceneUBO(const SceneSnapshot& snapshot, float alpha, uint32_t currentImage)
+{
+	PROFILE_SCOPE("Renderer::UpdateSceneUBO");
+	// render between the last two simulation steps so motion stays smooth at any frame rate
+	Camera camera = snapshot.CurrentCamera;
+	camera.Position = glm::mix(snapshot.PreviousCamera.Position, snapshot.CurrentCamera.Position, alpha);
+	camera.Rotation = glm::mix(snapshot.PreviousCamera.Rotation, snapshot.CurrentCamera.Rotation, alpha);
+	camera.UpdateRotation();
+
 	SceneUBO ubo{};
-	ubo.ViewProjection = m_Camera.GetProjectionMatrix() * m_Camera.GetViewMatrix();
-	ubo.CameraPosition = glm::vec4(m_Camera.Position, 1.0f);
-	Node dirLight = m_SceneGraph["sun"];
+	ubo.ViewProjection = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+	ubo.CameraPosition = glm::vec4(camera.Position, 1.0f);
+
+	const DirectionalLight& dirLight = snapshot.DirLight.Light;
 	ubo.DirLight = {
-		glm::vec4(dirLight.GetTransform().GetForward(), 0.0f),
-		glm::vec4(dirLight.GetDirLight().Diffuse, 0.0f),
-		glm::vec4(dirLight.GetDirLight().Specular, 0.0f),
-		glm::vec4(dirLight.GetDirLight().Ambient, 0.0f)
+		glm::vec4(snapshot.DirLight.Direction, 0.0f),
+		glm::vec4(dirLight.Diffuse, 0.0f),
+		glm::vec4(dirLight.Specular, 0.0f),
+		glm::vec4(dirLight.Ambient, 0.0f)
 	};
-	Node pointLight = m_SceneGraph["pointLight"];
 
+	const PointLight& pointLight = snapshot.PointLight.Light;
 	ubo.PointLight = {
-		glm::vec4(pointLight.GetTransform().Position, 1.0f),
-		glm::vec4(pointLight.GetPointLight().Diffuse, 0.0f),
-		glm::vec4(pointLight.GetPointLight().Specular, 0.0f),
-		glm::vec4(pointLight.GetPointLight().Ambient, 0.0f),
-		{pointLight.GetPointLight().Constant,
-		pointLight.GetPointLight().Linear,
-		pointLight.GetPointLight().Quadratic, 0.0f}
+		glm::vec4(snapshot.PointLight.Position, 1.0f),
+		glm::vec4(pointLight.Diffuse, 0.0f),
+		glm::vec4(pointLight.Specular, 0.0f),
+		glm::vec4(pointLight.Ambient, 0.0f),
+		{pointLight.Constant,
+		pointLight.Linear,
+		pointLight.Quadratic, 0.0f}
 	};
 
 	m_Frames[currentImage].SceneUniformBuffer->WriteToBuffer(&ubo);
+	return ubo;
 }
 
 void Renderer::CreateCommandBuffers()
@@ -341,87 +613,340 @@ void Renderer::DestroySyncObjects()
 
 void Renderer::DrawFrame()
 {
+	PROFILE_SCOPE("Renderer::DrawFrame");
 	vk::CommandBuffer& commandBuffer = m_Frames[m_CurrentFrame].CommandBuffer;
 	uint32_t currentBuffer{};
 
+	// latest state published by the simulation thread, never the live scene graph
+	const SceneSnapshot& snapshot = m_SceneGraph.AcquireSnapshot();
+	float alpha = GetInterpolationAlpha(snapshot, Time::Now());
+
+	double frameStart = Time::Now();
+	m_Stats = RenderStats();
 	BeginFrame(currentBuffer);	
-	UpdateSceneUBO(m_CurrentFrame);
+	SceneUBO ubo = UpdateSceneUBO(snapshot, alpha, m_CurrentFrame);
+	const glm::mat4& viewProjection = ubo.ViewProjection;
+	Frustum frustum = Frustum::FromMatrix(viewProjection);
+	// pixels per world unit at distance 1, for screen size estimates
+	float projectionScale = std::abs(snapshot.CurrentCamera.GetProjectionMatrix()[1][1]) * GetExtent().height * 0.5f;
+	bool meshShading = m_MeshletSettings.MeshShaders && m_Device->IsMeshShaderSupported();
+
+	if (m_LodStates.size() != snapshot.Items.size())
+		m_LodStates.assign(snapshot.Items.size(), LodState());
+
+	// visibility and levels first, the meshlet culling pass has to be recorded before the render pass
+	uint32_t meshletCommandCount = 0;
+	m_VisibleItems.clear();
+	{
+		PROFILE_SCOPE("Renderer::CullScene");
+		for (size_t i = 0; i < snapshot.Items.size(); i++)
+		{
+			const RenderItem& item = snapshot.Items[i];
+			// translation and scale are lerped and rotation slerped, a lerped matrix would shear and shrink
+			bool interpolated = item.Moved && alpha < 1.0f;
+			glm::mat4 model = interpolated ? WorldTransform::Interpolate(item.Previous, item.Current, alpha).GetMatrix() : item.Model;
+			glm::vec3 center = glm::vec3(model * glm::vec4(item.GPUMesh->GetBoundsCenter(), 1.0f));
+			float radius = GetWorldRadius(model, item.GPUMesh->GetBoundsRadius());
+			if (!frustum.IntersectsSphere(center, radius))
+			{
+				m_Stats.CulledObjects++;
+				continue;
+			}
+
+			float distance = std::max((viewProjection * glm::vec4(center, 1.0f)).w, radius);
+			if (item.GPUMaterial->TextureStreamId != TextureStreamer::INVALID_ID)
+				m_TextureStreamer->RequestScreenSize(item.GPUMaterial->TextureStreamId, 2.0f * radius * projectionScale / distance);
+
+			LodState& lod = m_LodStates[i];
+			UpdateLod(lod, *item.GPUMesh, GetWorldRadius(model, 1.0f) * projectionScale / distance);
+
+			VisibleItem visible;
+			visible.Index = static_cast<uint32_t>(i);
+			visible.Model = model;
+			visible.Normal = interpolated ? glm::transpose(glm::inverse(model)) : item.Normal;
+			// meshlets only cover the full level, cross-fades draw whole levels dithered
+			visible.Meshlets = m_MeshletSettings.Enabled && item.GPUMesh->HasMeshlets() && lod.Level == 0 && lod.Fade >= 1.0f;
+			visible.MeshShading = visible.Meshlets && meshShading && item.GPUMesh->GetVertexFormat() == VertexFormat::Full;
+			if (visible.Meshlets && !visible.MeshShading)
+			{
+				visible.FirstCommand = meshletCommandCount;
+				meshletCommandCount += item.GPUMesh->GetMeshletCount();
+			}
+			if (visible.Meshlets)
+			{
+				m_Stats.MeshletObjects++;
+				m_Stats.Meshlets += item.GPUMesh->GetMeshletCount();
+			}
+			m_VisibleItems.push_back(visible);
+		}
+	}
+
+	if (meshletCommandCount > 0)
+		RecordMeshletCulling(commandBuffer, snapshot, glm::vec3(ubo.CameraPosition), meshletCommandCount);
+
+	BeginRenderPass(currentBuffer);
 
 	MaterialType currentPipeline = MaterialType::None;
+	VertexFormat currentFormat = VertexFormat::Full;
+	bool currentDither = false;
+	bool currentMeshShading = false;
+	Pipeline* pipeline = nullptr;
+	uint32_t maxDrawsPerCommand = m_Device->IsMultiDrawIndirectSupported() ? MAX_MULTI_DRAW_COUNT : 1;
 
-	for (auto it = m_SceneGraph.begin(); it != m_SceneGraph.end(); ++it)
 	{
-		Node& node = *it;
-		// only draw model type nodes
-		//if (node.GetType() != NodeType::Model)
-		if (node.GetType() != NodeType::Model)
-			continue;
-
-		// only bind pipeline if it's different from the last one
-		if (currentPipeline != node.m_Material->GetType())
+		PROFILE_SCOPE("Renderer::RecordScene");
+		GpuProfiler::Scope sceneScope(*m_GpuProfiler, commandBuffer, "Scene");
+		for (const VisibleItem& visible : m_VisibleItems)
 		{
-			currentPipeline = node.m_Material->GetType();
-			m_Pipelines[currentPipeline].Pipeline->Bind(commandBuffer);
-			
-			// bind scene descriptor set
-			commandBuffer.bindDescriptorSets(
-			vk::PipelineBindPoint::eGraphics,
-			m_Pipelines[node.m_Material->GetType()].Pipeline->GetLayout(),
-			0,
-			1, &m_Frames[m_CurrentFrame].SceneDescriptorSet,
-			0, nullptr);
+			const RenderItem& item = snapshot.Items[visible.Index];
+			const glm::mat4& model = visible.Model;
+			const LodState& lod = m_LodStates[visible.Index];
+
+			// during a cross-fade both levels are drawn dithered, the incoming one
+			// keeps exactly the pixels the outgoing one discards
+			uint32_t levels[2] = { lod.Level, lod.PreviousLevel };
+			float fades[2] = { lod.Fade, -lod.Fade };
+			uint32_t levelCount = lod.Fade < 1.0f ? 2 : 1;
+			if (levelCount == 1)
+				fades[0] = 0.0f;
+			else
+				m_Stats.FadingObjects++;
+
+			VertexFormat format = item.GPUMesh->GetVertexFormat();
+			for (uint32_t l = 0; l < levelCount; l++)
+			{
+				// only bind pipeline if it's different from the last one
+				bool dither = levelCount == 2;
+				if (currentPipeline != item.Type || currentFormat != format || currentDither != dither || currentMeshShading != visible.MeshShading)
+				{
+					currentPipeline = item.Type;
+					currentFormat = format;
+					currentDither = dither;
+					currentMeshShading = visible.MeshShading;
+					pipeline = GetMaterialPipeline(currentPipeline, format, dither, visible.MeshShading);
+					pipeline->Bind(commandBuffer);
+
+					// bind scene descriptor set
+					commandBuffer.bindDescriptorSets(
+					vk::PipelineBindPoint::eGraphics,
+					pipeline->GetLayout(),
+					0,
+					1, &m_Frames[m_CurrentFrame].SceneDescriptorSet,
+					0, nullptr);
+
+					m_Stats.PipelineBinds++;
+					m_Stats.DescriptorSetBinds++;
+				}
+
+				PushConstantData pushConstantData{};
+				// packed positions are expanded from the mesh bounds, normals decode on their own
+				pushConstantData.Model = format == VertexFormat::Packed ? model * item.GPUMesh->GetDequantizeMatrix() : model;
+				pushConstantData.Normal = visible.Normal;
+				pushConstantData.Normal[3].x = fades[l];
+
+				commandBuffer.pushConstants(pipeline->GetLayout(), pipeline->GetPushConstantStages(), 0, sizeof(PushConstantData), &pushConstantData);
+
+				if (l == 0)
+				{
+					item.GPUMaterial->UpdateMaterial(item.Parameters, item.Type);
+
+					// bind material descriptor set
+					commandBuffer.bindDescriptorSets(
+						vk::PipelineBindPoint::eGraphics,
+						pipeline->GetLayout(),
+						1,
+						1, &item.GPUMaterial->DescriptorSet,
+						0, nullptr);
+					m_Stats.DescriptorSetBinds++;
+
+					if (!visible.MeshShading)
+					{
+						item.GPUMesh->Bind(commandBuffer);
+						m_Stats.MeshBinds++;
+					}
+				}
+
+				if (visible.MeshShading)
+				{
+					// the task shader culls, one workgroup per 32 meshlets
+					vk::DescriptorSet meshletSet = item.GPUMesh->GetMeshletDescriptorSet();
+					commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->GetLayout(), 2, 1, &meshletSet, 0, nullptr);
+					m_Stats.DescriptorSetBinds++;
+					m_Device->DrawMeshTasks(commandBuffer, (item.GPUMesh->GetMeshletCount() + MESHLET_TASK_GROUP_SIZE - 1) / MESHLET_TASK_GROUP_SIZE);
+					m_Stats.Triangles += item.GPUMesh->GetLod(0).IndexCount / 3;
+					m_Stats.DrawCalls++;
+				}
+				else if (visible.Meshlets)
+				{
+					// culled meshlets are commands with no instances, the triangle count is before culling
+					vk::Buffer commands = m_Frames[m_CurrentFrame].MeshletCommandBuffer->GetBuffer();
+					uint32_t meshletCount = item.GPUMesh->GetMeshletCount();
+					for (uint32_t first = 0; first < meshletCount; first += maxDrawsPerCommand)
+					{
+						commandBuffer.drawIndexedIndirect(
+							commands,
+							static_cast<vk::DeviceSize>(visible.FirstCommand + first) * sizeof(vk::DrawIndexedIndirectCommand),
+							std::min(maxDrawsPerCommand, meshletCount - first),
+							sizeof(vk::DrawIndexedIndirectCommand));
+						m_Stats.DrawCalls++;
+					}
+					m_Stats.Triangles += item.GPUMesh->GetLod(0).IndexCount / 3;
+				}
+				else if(item.GPUMesh->IsIndexed())
+				{
+					const MeshLod& level = item.GPUMesh->GetLod(levels[l]);
+					commandBuffer.drawIndexed(level.IndexCount, 1, level.FirstIndex, 0, 0);
+					m_Stats.Triangles += level.IndexCount / 3;
+					m_Stats.DrawCalls++;
+				}
+
+				else
+				{
+					commandBuffer.draw(item.GPUMesh->GetVertexSize(), 1, 0, 0);
+					m_Stats.Triangles += item.GPUMesh->GetVertexSize() / 3;
+					m_Stats.DrawCalls++;
+				}
+			}
 		}
-		
-		PushConstantData pushConstantData{};
+	}
 
-		// TODO: Implement world and local transforms and update them outside of the draw loop
-		// This implementation only updates 1 layer above the current node
-		if (node.m_Parent != nullptr)
-		{
-			glm::mat4 parent = node.m_Parent->GetTransform().GetCompositeMatrix();
-			glm::mat4 model = node.GetTransform().GetCompositeMatrix();
-			pushConstantData.Model = parent * model;
-			pushConstantData.Normal = glm::transpose(glm::inverse(parent * model));
-		}
-		else
-		{
-			pushConstantData.Model = node.GetTransform().GetCompositeMatrix();
-			pushConstantData.Normal = node.GetTransform().GetNormalMatrix();
-		}
-		
-		commandBuffer.pushConstants(m_Pipelines[node.m_Material->GetType()].Pipeline->GetLayout(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstantData), &pushConstantData);
+	if (!IsHeadless())
+	{
+		PROFILE_SCOPE("Renderer::ImGui");
+		// TODO: move to begin frame function
+		ImGui_ImplVulkan_NewFrame();
+		ImGui_ImplGlfw_NewFrame();
+		ImGui::NewFrame();
+		DrawImGui();
+		// TODO: move to end frame function
+		ImGui::Render();
+
+		GpuProfiler::Scope imguiScope(*m_GpuProfiler, commandBuffer, "ImGui");
+		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), m_Frames[m_CurrentFrame].CommandBuffer);
+	}
+	EndFrame(currentBuffer);
 
-		node.m_Material->UpdateMaterial(node.GetModel().GetMaterialParameters());
+	m_Stats.CpuFrameMs = static_cast<float>((Time::Now() - frameStart) * 1000.0) - m_Stats.FenceWaitMs;
+	PublishStats();
+	m_FrameNumber++;
+}
 
-		// bind material descriptor set
-		commandBuffer.bindDescriptorSets(
-			vk::PipelineBindPoint::eGraphics,
-			m_Pipelines[node.m_Material->GetType()].Pipeline->GetLayout(),
-			1,
-			1, &node.m_Material->DescriptorSet,
-			0, nullptr);
+void Renderer::RecordMeshletCulling(vk::CommandBuffer commandBuffer, const SceneSnapshot& snapshot, const glm::vec3& cameraPosition, uint32_t commandCount)
+{
+	PROFILE_SCOPE("Renderer::RecordMeshletCulling");
+	FrameData& frame = m_Frames[m_CurrentFrame];
+	ReserveMeshletCommands(frame, commandCount);
 
-		node.m_Mesh->Bind(commandBuffer);
-		if(node.m_Mesh->IsIndexed())
-			commandBuffer.drawIndexed(node.m_Mesh->GetIndexCount(), 1, 0, 0, 0);
+	GpuProfiler::Scope cullScope(*m_GpuProfiler, commandBuffer, "Meshlet culling");
+	m_MeshletCullPipeline->Bind(commandBuffer);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_MeshletCullPipeline->GetLayout(), 0, 1, &frame.SceneDescriptorSet, 0, nullptr);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_MeshletCullPipeline->GetLayout(), 2, 1, &frame.MeshletCommandDescriptorSet, 0, nullptr);
 
-		else
-			commandBuffer.draw(node.m_Mesh->GetVertexSize(), 1, 0, 0);
+	for (const VisibleItem& visible : m_VisibleItems)
+	{
+		if (!visible.Meshlets || visible.MeshShading)
+			continue;
+
+		// meshlet bounds are in model space even for packed vertices, so no dequantize matrix here
+		const Mesh& mesh = *snapshot.Items[visible.Index].GPUMesh;
+		MeshletCullConstants constants{};
+		constants.Model = visible.Model;
+		constants.CameraPosition = glm::vec4(glm::vec3(glm::inverse(visible.Model) * glm::vec4(cameraPosition, 1.0f)), GetWorldRadius(visible.Model, 1.0f));
+		constants.Ranges = glm::uvec4(mesh.GetMeshletCount(), visible.FirstCommand, mesh.GetLod(0).FirstIndex, 0);
+
+		vk::DescriptorSet meshletSet = mesh.GetMeshletDescriptorSet();
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_MeshletCullPipeline->GetLayout(), 1, 1, &meshletSet, 0, nullptr);
+		commandBuffer.pushConstants(m_MeshletCullPipeline->GetLayout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(MeshletCullConstants), &constants);
+		commandBuffer.dispatch((mesh.GetMeshletCount() + MESHLET_CULL_GROUP_SIZE - 1) / MESHLET_CULL_GROUP_SIZE, 1, 1);
 	}
 
-	// TODO: move to begin frame function
-	ImGui_ImplVulkan_NewFrame();
-	ImGui_ImplGlfw_NewFrame();
-	ImGui::NewFrame();
-	DrawImGui();
-	// TODO: move to end frame function
-	ImGui::Render();
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), m_Frames[m_CurrentFrame].CommandBuffer);
-	EndFrame(currentBuffer);
+	vk::MemoryBarrier barrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead);
+	commandBuffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eComputeShader,
+		vk::PipelineStageFlagBits::eDrawIndirect,
+		vk::DependencyFlags(),
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+}
+
+void Renderer::UpdateLod(LodState& state, const Mesh& mesh, float pixelsPerUnit)
+{
+	// items keep their index while the scene is unchanged, a stale state only needs clamping
+	if (state.Level >= mesh.GetLodCount() || state.PreviousLevel >= mesh.GetLodCount())
+		state = LodState();
+
+	uint32_t level = m_LodSettings.Enabled ? SelectLod(mesh, pixelsPerUnit, state.Level) : 0;
+	if (level != state.Level)
+	{
+		state.PreviousLevel = state.Level;
+		state.Level = level;
+		state.Fade = 0.0f;
+	}
+	state.Fade = m_LodSettings.CrossFade && m_LodSettings.FadeTime > 0.0f ? std::clamp(state.Fade + m_DeltaTime / m_LodSettings.FadeTime, LOD_MIN_FADE, 1.0f) : 1.0f;
+}
+
+uint32_t Renderer::SelectLod(const Mesh& mesh, float pixelsPerUnit, uint32_t current) const
+{
+	// coarser levels than the current one have to beat the threshold by the
+	// hysteresis margin, so items near a boundary do not switch every frame
+	uint32_t level = 0;
+	for (uint32_t i = 1; i < mesh.GetLodCount(); i++)
+	{
+		float threshold = m_LodSettings.PixelError * (i > current ? 1.0f - m_LodSettings.Hysteresis : 1.0f);
+		if (mesh.GetLod(i).Error * pixelsPerUnit > threshold)
+			break;
+		level = i;
+	}
+	return level;
+}
+
+void Renderer::RegisterStats()
+{
+	StatsRegistry& registry = StatsRegistry::Get();
+	m_DrawCallsCounter = &registry.GetCounter("Draw calls");
+	m_PipelineBindsCounter = &registry.GetCounter("Pipeline binds");
+	m_DescriptorSetBindsCounter = &registry.GetCounter("Descriptor set binds");
+	m_MeshBindsCounter = &registry.GetCounter("Mesh binds");
+	m_TrianglesCounter = &registry.GetCounter("Triangles");
+	m_CulledObjectsCounter = &registry.GetCounter("Culled objects");
+	m_FadingObjectsCounter = &registry.GetCounter("LOD cross-fades");
+	m_MeshletObjectsCounter = &registry.GetCounter("Meshlet objects");
+	m_MeshletsCounter = &registry.GetCounter("Meshlets");
+	m_PendingTexturesCounter = &registry.GetCounter("Textures loading");
+	m_StreamedTextureKiBCounter = &registry.GetCounter("Streamed textures (KiB)");
+	m_StreamingBudgetKiBCounter = &registry.GetCounter("Streaming budget (KiB)");
+	m_AtlasTexturesCounter = &registry.GetCounter("Atlas textures");
+	m_FrameTimeSeries = &registry.GetSeries("Frame time");
+	m_CpuTimeSeries = &registry.GetSeries("CPU time");
+	m_GpuTimeSeries = &registry.GetSeries("GPU time");
+	m_FenceWaitSeries = &registry.GetSeries("Fence wait");
+}
+
+void Renderer::PublishStats()
+{
+	m_DrawCallsCounter->Set(m_Stats.DrawCalls);
+	m_PipelineBindsCounter->Set(m_Stats.PipelineBinds);
+	m_DescriptorSetBindsCounter->Set(m_Stats.DescriptorSetBinds);
+	m_MeshBindsCounter->Set(m_Stats.MeshBinds);
+	m_TrianglesCounter->Set(static_cast<int64_t>(m_Stats.Triangles));
+	m_CulledObjectsCounter->Set(m_Stats.CulledObjects);
+	m_FadingObjectsCounter->Set(m_Stats.FadingObjects);
+	m_MeshletObjectsCounter->Set(m_Stats.MeshletObjects);
+	m_MeshletsCounter->Set(m_Stats.Meshlets);
+	m_PendingTexturesCounter->Set(m_TextureLoader->GetPendingCount());
+	m_StreamedTextureKiBCounter->Set(static_cast<int64_t>(m_TextureStreamer->GetResidentBytes() / 1024));
+	m_StreamingBudgetKiBCounter->Set(static_cast<int64_t>(m_TextureStreamer->GetBudget() / 1024));
+	m_AtlasTexturesCounter->Set(m_TextureAtlas->GetTextureCount());
+	m_FrameTimeSeries->Push(m_DeltaTime * 1000.0f);
+	m_CpuTimeSeries->Push(m_Stats.CpuFrameMs);
+	m_GpuTimeSeries->Push(m_Stats.GpuFrameMs);
+	m_FenceWaitSeries->Push(m_Stats.FenceWaitMs);
 }
 
 void Renderer::InitImGui()
 {
+	PROFILE_SCOPE("Renderer::InitImGui");
 	vk::DescriptorPoolSize pool_sizes[] =
 	{
 		{ vk::DescriptorType::eSampler, 1000 },
@@ -460,7 +985,7 @@ void Renderer::InitImGui()
 		requestSurfaceColorSpace
 	);
 
-	ImGui_ImplGlfw_InitForVulkan(m_Window.GetWindow(), true);
+	ImGui_ImplGlfw_InitForVulkan(m_Window->GetWindow(), true);
 
 	ImGui_ImplVulkan_InitInfo init_info = {};
 		init_info.Instance = m_Device->GetInstance();
@@ -486,24 +1011,158 @@ void Renderer::InitImGui()
 
 void Renderer::DrawImGui()
 {
+	PROFILE_SCOPE("Renderer::DrawImGui");
+	// the editor windows read and write live nodes, so they share the simulation lock
+	std::lock_guard<std::mutex> lock(m_SceneGraph.GetMutex());
+
     ImGui::Begin("Scene Hierarchy");
-    for (auto it = m_SceneGraph.begin(); it != m_SceneGraph.end(); ++it)
-	{
-		Node& node = *it;
-        if (ImGui::Selectable(node.GetName().c_str(), m_SelectedNode == &node))
-			m_SelectedNode = &node;
-	}
+	DrawHierarchyNode(m_SceneGraph.GetRoot());
     ImGui::End();
 
     ImGui::Begin("Node Properties");
-    if (m_SelectedNode != nullptr)
-		m_SelectedNode->OnPropertiesGUI();
+    if (m_SceneGraph.IsValid(m_SelectedNode))
+		m_SceneGraph.OnPropertiesGUI(m_SelectedNode);
     ImGui::End();
 
+	DrawGpuProfilerGUI();
+	DrawPerformanceGUI();
+
 	//ImGui::ShowDemoWindow();
 	//ImGui::ShowMetricsWindow();
 }
 
+void Renderer::DrawHierarchyNode(NodeHandle handle)
+{
+	// collapsed subtrees are never walked, which keeps large scenes cheap
+	NodeChildView children = m_SceneGraph.Children(handle);
+	ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth;
+	if (children.empty())
+		flags |= ImGuiTreeNodeFlags_Leaf;
+	if (handle == m_SceneGraph.GetRoot())
+		flags |= ImGuiTreeNodeFlags_DefaultOpen;
+	if (handle == m_SelectedNode)
+		flags |= ImGuiTreeNodeFlags_Selected;
+
+	// names are only unique among siblings, slots are unique in the scene
+	bool open = ImGui::TreeNodeEx(reinterpret_cast<void*>(static_cast<uintptr_t>(handle.Index)), flags, "%s", m_SceneGraph.GetName(handle).c_str());
+	if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen())
+		m_SelectedNode = handle;
+	if (!open)
+		return;
+
+	for (NodeHandle child : children)
+		DrawHierarchyNode(child);
+	ImGui::TreePop();
+}
+
+void Renderer::DrawGpuProfilerGUI()
+{
+	ImGui::Begin("GPU Profiler");
+	if (!m_GpuProfiler->IsSupported())
+		ImGui::TextUnformatted("Timestamp queries are not supported on this device");
+	else if (ImGui::BeginTable("GpuTimings", 2, ImGuiTableFlags_RowBg))
+	{
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("ms", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableHeadersRow();
+		for (const GpuTiming& timing : m_GpuProfiler->GetResults())
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%*s%s", static_cast<int>(timing.Depth * 2), "", timing.Name);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", timing.Milliseconds);
+		}
+		ImGui::EndTable();
+	}
+	ImGui::End();
+}
+
+void Renderer::DrawPerformanceGUI()
+{
+	StatsRegistry& registry = StatsRegistry::Get();
+
+	ImGui::Begin("Performance");
+
+	// frame times, oldest sample on the left
+	auto plotSeries = [](const char* label, const StatSeries& series, float height)
+	{
+		char overlay[64];
+		snprintf(overlay, sizeof(overlay), "%.2f ms (avg %.2f, max %.2f)", series.GetLatest(), series.GetAverage(), series.GetMax());
+		ImGui::PlotHistogram(
+			label,
+			[](void* data, int index) { return static_cast<const StatSeries*>(data)->GetValue(index); },
+			const_cast<StatSeries*>(&series),
+			static_cast<int>(series.GetCount()),
+			static_cast<int>(series.GetOffset()),
+			overlay,
+			0.0f, std::max(series.GetMax(), 1.0f),
+			ImVec2(0.0f, height));
+	};
+
+	plotSeries("Frame", *m_FrameTimeSeries, 80.0f);
+	plotSeries("CPU", *m_CpuTimeSeries, 40.0f);
+	plotSeries("GPU", *m_GpuTimeSeries, 40.0f);
+	plotSeries("Fence wait", *m_FenceWaitSeries, 40.0f);
+
+	if (ImGui::CollapsingHeader("Counters", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		registry.ForEachCounter([](const StatCounter& counter)
+		{
+			ImGui::Text("%-22s %lld", counter.GetName().c_str(), static_cast<long long>(counter.Get()));
+		});
+	}
+
+	if (ImGui::CollapsingHeader("Level of detail"))
+	{
+		ImGui::Checkbox("Enabled", &m_LodSettings.Enabled);
+		ImGui::SliderFloat("Pixel error", &m_LodSettings.PixelError, 0.1f, 16.0f, "%.1f px");
+		ImGui::SliderFloat("Hysteresis", &m_LodSettings.Hysteresis, 0.0f, 0.9f);
+		ImGui::Checkbox("Cross-fade", &m_LodSettings.CrossFade);
+		ImGui::SliderFloat("Fade time", &m_LodSettings.FadeTime, 0.05f, 1.0f, "%.2f s");
+	}
+
+	if (ImGui::CollapsingHeader("Meshlets"))
+	{
+		ImGui::Checkbox("Meshlet culling", &m_MeshletSettings.Enabled);
+		if (m_Device->IsMeshShaderSupported())
+			ImGui::Checkbox("Mesh shaders", &m_MeshletSettings.MeshShaders);
+		else
+			ImGui::TextUnformatted("Mesh shaders are not supported, culling in compute");
+		if (!m_Device->IsMultiDrawIndirectSupported())
+			ImGui::TextUnformatted("Multi draw indirect is not supported, one draw per meshlet");
+	}
+
+	if (ImGui::CollapsingHeader("GPU memory", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		MemoryStats memory = m_Device->GetMemoryStats();
+		std::vector<MemoryHeapBudget> budgets = m_Device->GetMemoryBudget();
+		ImGui::Text("%u allocations, %.1f MiB%s", memory.AllocationCount, memory.TotalBytes / (1024.0 * 1024.0),
+			m_Device->IsMemoryBudgetSupported() ? "" : " (estimated budget)");
+
+		for (uint32_t heap = 0; heap < budgets.size(); heap++)
+		{
+			const MemoryHeapBudget& budget = budgets[heap];
+			char label[96];
+			snprintf(label, sizeof(label), "%.1f / %.1f MiB", budget.Usage / (1024.0 * 1024.0), budget.Budget / (1024.0 * 1024.0));
+			ImGui::Text("Heap %u%s, ours %.1f MiB", heap, budget.DeviceLocal ? " (device local)" : "", memory.HeapBytes[heap] / (1024.0 * 1024.0));
+
+			float fraction = budget.Budget > 0 ? static_cast<float>(static_cast<double>(budget.Usage) / budget.Budget) : 0.0f;
+			bool warning = fraction > MEMORY_BUDGET_WARNING;
+			if (warning)
+				ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.9f, 0.2f, 0.2f, 1.0f));
+			ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), label);
+			if (warning)
+				ImGui::PopStyleColor();
+		}
+
+		for (size_t category = 0; category < memory.CategoryBytes.size(); category++)
+			ImGui::Text("%-12s %8.2f MiB", GetMemoryCategoryName(static_cast<MemoryCategory>(category)), memory.CategoryBytes[category] / (1024.0 * 1024.0));
+	}
+
+	ImGui::End();
+}
+
 void Renderer::DestroyImGui()
 {
 	ImGui_ImplVulkan_Shutdown();
@@ -514,27 +1173,50 @@ void Renderer::DestroyImGui()
 
 void Renderer::BeginFrame(uint32_t &imageIndex)
 {
+	PROFILE_SCOPE("Renderer::BeginFrame");
 	if (m_FramebufferResized)
 	{
-		while (m_Width == 0 || m_Height == 0)
-			glfwWaitEvents();
+		if (IsHeadless())
+		{
+			m_Device->WaitIdle();
+			m_Offscreen->Resize(m_Width, m_Height);
+		}
+		else
+		{
+			while (m_Width == 0 || m_Height == 0)
+				glfwWaitEvents();
 
-		m_Device->WaitIdle();
-		m_SwapChain->Recreate();
+			m_Device->WaitIdle();
+			m_SwapChain->Recreate();
+		}
 		m_FramebufferResized = false;
 	}
 
-	while(vk::Result::eTimeout == m_Device->GetDevice().waitForFences(1, &m_Frames[m_CurrentFrame].RenderFence, VK_TRUE, UINT64_MAX));
-
-	vk::ResultValue<uint32_t> currentBuffer = m_Device->GetDevice().acquireNextImageKHR(m_SwapChain->GetSwapChain(),
-																						UINT64_MAX,
-																						m_Frames[m_CurrentFrame].PresentSemaphore,
-																						nullptr);
+	{
+		PROFILE_SCOPE("Renderer::WaitForFence");
+		double fenceWaitStart = Time::Now();
+		while(vk::Result::eTimeout == m_Device->GetDevice().waitForFences(1, &m_Frames[m_CurrentFrame].RenderFence, VK_TRUE, UINT64_MAX));
+		m_Stats.FenceWaitMs = static_cast<float>((Time::Now() - fenceWaitStart) * 1000.0);
+	}
+	m_Device->UpdateMemoryBudget();
+	m_TextureStreamer->Update(m_FrameNumber);
+	m_TextureLoader->Update();
+	FreeRetiredMaterialBindings(false);
+
+	if (IsHeadless())
+		imageIndex = 0;
+	else
+	{
+		vk::ResultValue<uint32_t> currentBuffer = m_Device->GetDevice().acquireNextImageKHR(m_SwapChain->GetSwapChain(),
+																							UINT64_MAX,
+																							m_Frames[m_CurrentFrame].PresentSemaphore,
+																							nullptr);
 
-	if (currentBuffer.result != vk::Result::eSuccess)
-		throw std::runtime_error("Failed to acquire swap chain image");
+		if (currentBuffer.result != vk::Result::eSuccess)
+			throw std::runtime_error("Failed to acquire swap chain image");
 
-	imageIndex = currentBuffer.value;
+		imageIndex = currentBuffer.value;
+	}
 
 	while (vk::Result::eTimeout == m_Device->GetDevice().resetFences(1, &m_Frames[m_CurrentFrame].RenderFence));
 	m_Frames[m_CurrentFrame].CommandBuffer.reset(vk::CommandBufferResetFlagBits::eReleaseResources);
@@ -545,16 +1227,25 @@ void Renderer::BeginFrame(uint32_t &imageIndex)
 	);
 
 	m_Frames[m_CurrentFrame].CommandBuffer.begin(beginInfo);
-	
+
+	// the fence wait above guarantees this frame's previous queries are available
+	m_GpuProfiler->BeginFrame(m_Frames[m_CurrentFrame].CommandBuffer, m_CurrentFrame);
+	m_Stats.GpuFrameMs = static_cast<float>(m_GpuProfiler->GetTiming("Frame"));
+	// textures packed during the streamer update, before the render pass starts
+	m_TextureAtlas->RecordUploads(m_Frames[m_CurrentFrame].CommandBuffer, m_FrameNumber, MAX_FRAMES_IN_FLIGHT);
+}
+
+void Renderer::BeginRenderPass(uint32_t imageIndex)
+{
 	const vk::ClearValue clearValues[2]{
 		{vk::ClearColorValue(std::array<float, 4>{.05f, 0.f, .05f, 1.f})},
 		{vk::ClearDepthStencilValue(1.f, 0)}
 	};
 
 	vk::RenderPassBeginInfo renderPassInfo(
-		m_SwapChain->GetRenderPass(),
-		m_SwapChain->GetFramebuffer(imageIndex),
-		vk::Rect2D( vk::Offset2D( 0, 0 ), m_SwapChain->GetExtent() ),
+		GetRenderPass(),
+		IsHeadless() ? m_Offscreen->GetFramebuffer() : m_SwapChain->GetFramebuffer(imageIndex),
+		vk::Rect2D( vk::Offset2D( 0, 0 ), GetExtent() ),
 		2, clearValues
 	);
 
@@ -563,35 +1254,45 @@ void Renderer::BeginFrame(uint32_t &imageIndex)
 	vk::Viewport viewport(
 		0.0f,
 		0.0f,
-		static_cast<float>(m_SwapChain->GetExtent().width),
-		static_cast<float>(m_SwapChain->GetExtent().height),
+		static_cast<float>(GetExtent().width),
+		static_cast<float>(GetExtent().height),
 		0.0f,
 		1.0f
 	);
 	m_Frames[m_CurrentFrame].CommandBuffer.setViewport(0, 1, &viewport);
 
-	vk::Rect2D scissor(vk::Offset2D(0, 0), m_SwapChain->GetExtent());
+	vk::Rect2D scissor(vk::Offset2D(0, 0), GetExtent());
 	m_Frames[m_CurrentFrame].CommandBuffer.setScissor(0, 1, &scissor);
 }
 
 void Renderer::EndFrame(uint32_t &imageIndex)
 {
+	PROFILE_SCOPE("Renderer::EndFrame");
 	m_Frames[m_CurrentFrame].CommandBuffer.endRenderPass();
+	m_GpuProfiler->EndFrame(m_Frames[m_CurrentFrame].CommandBuffer);
 	m_Frames[m_CurrentFrame].CommandBuffer.end();
 
 	vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
 
+	// offscreen frames have no image to acquire or present, so no semaphores either
+	uint32_t semaphoreCount = IsHeadless() ? 0 : 1;
 	vk::SubmitInfo submitInfo(
-		1, &m_Frames[m_CurrentFrame].PresentSemaphore,
+		semaphoreCount, &m_Frames[m_CurrentFrame].PresentSemaphore,
 		waitStages,
 		1, &m_Frames[m_CurrentFrame].CommandBuffer,
-		1, &m_Frames[m_CurrentFrame].RenderSemaphore
+		semaphoreCount, &m_Frames[m_CurrentFrame].RenderSemaphore
 	);
 
 	vk::Result queueSubmitResult = m_Device->GetGraphicsQueue().submit(1, &submitInfo, m_Frames[m_CurrentFrame].RenderFence);
 	if(queueSubmitResult != vk::Result::eSuccess)
 		throw std::runtime_error("Failed to submit draw command buffer");
 
+	if (IsHeadless())
+	{
+		m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		return;
+	}
+
 	vk::Result queuePresentResult = m_Device->GetPresentQueue().presentKHR(
 		vk::PresentInfoKHR(1, &m_Frames[m_CurrentFrame].RenderSemaphore,
 						   1, &m_SwapChain->GetSwapChain(),
@@ -8,22 +8,36 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#define IMGUI_ENABLE_PROFILER
 #include <imgui.h>
 #include "Vulkan/Buffer.h"
 #include "Vulkan/Descriptor.h"
 #include "Vulkan/Device.h"
+#include "Vulkan/GpuProfiler.h"
 #include "Vulkan/Mesh.h"
+#include "Vulkan/MeshFile.h"
+#include "Vulkan/MeshOptimizer.h"
+#include "Vulkan/MeshSimplifier.h"
+#include "Vulkan/MeshletBuilder.h"
+#include "Vulkan/Offscreen.h"
 #include "Vulkan/Pipeline.h"
+#include "Vulkan/StagingRing.h"
 #include "Vulkan/SwapChain.h"
 #include "Vulkan/Texture.h"
+#include "Vulkan/TextureAtlas.h"
+#include "Vulkan/TextureLoader.h"
+#include "Vulkan/TextureStreamer.h"
 #include "Vulkan/ValidationLayer.h"
 #include "../Scene/Camera.h"
+#include "../Scene/Frustum.h"
 #include "../Scene/Graph.h"
 #include "../Scene/Model.h"
 #include "../Scene/Lighting/DirectionalLight.h"
 #include "../Scene/Lighting/PointLight.h"
 #include "../ModuleInterface.h"
+#include "../../Core/MappedFile.h"
+#include "../../Core/Stats.h"
+#include "../../Core/ThreadPool.h"
+#include "../../Core/Time.h"
 #include "../../Core/Window.h"
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
@@ -55,9 +69,28 @@ struct SceneUBO
 
 struct PushConstantData {
 	glm::mat4 Model;
-	glm::mat4 Normal;
+	glm::mat4 Normal;	// shaders use the upper 3x3, Normal[3].x carries the LOD fade
 };
 
+// Culling of one item's meshlets, see meshlet_cull.comp
+struct MeshletCullConstants {
+	glm::mat4 Model;
+	glm::vec4 CameraPosition;	// model space, w = largest scale of Model
+	glm::uvec4 Ranges;			// x = meshlet count, y = first command, z = first index of level 0
+};
+
+// Commands the meshlet command buffers start with, they double when a frame needs more
+const uint32_t INITIAL_MESHLET_COMMANDS = 4096;
+// Sets per block of the meshlet descriptor pool, one per meshlet mesh and frame in flight
+const uint32_t MESHLET_SETS_PER_POOL = 256;
+// Sets per block of the material descriptor pool, a material holds a second set while its texture swap retires
+const uint32_t MATERIAL_SETS_PER_POOL = 256;
+// Workgroup sizes of meshlet_cull.comp and meshlet.task
+const uint32_t MESHLET_CULL_GROUP_SIZE = 64;
+const uint32_t MESHLET_TASK_GROUP_SIZE = 32;
+// maxDrawIndirectCount every device with multiDrawIndirect reaches
+const uint32_t MAX_MULTI_DRAW_COUNT = 65535;
+
 struct FrameData {
 	vk::Semaphore PresentSemaphore; 
 	vk::Semaphore RenderSemaphore;
@@ -67,11 +100,85 @@ struct FrameData {
 
 	std::unique_ptr<Buffer> SceneUniformBuffer;
 	vk::DescriptorSet SceneDescriptorSet;
+
+	// indexed indirect draws written by the meshlet culling pass, grown on demand
+	std::unique_ptr<Buffer> MeshletCommandBuffer;
+	vk::DescriptorSet MeshletCommandDescriptorSet;
+};
+
+// Per frame counters, reset at the start of every DrawFrame
+struct RenderStats
+{
+	uint32_t DrawCalls = 0;
+	uint32_t PipelineBinds = 0;
+	uint32_t DescriptorSetBinds = 0;
+	uint32_t MeshBinds = 0;
+	uint64_t Triangles = 0;
+	uint32_t CulledObjects = 0;		// items outside the view frustum, not drawn
+	uint32_t FadingObjects = 0;		// items drawn at two levels of detail during a cross-fade
+	uint32_t MeshletObjects = 0;	// items culled and drawn meshlet by meshlet
+	uint32_t Meshlets = 0;			// meshlets of those items, culled on the GPU
+	float CpuFrameMs = 0.0f;		// DrawFrame without the fence wait
+	float FenceWaitMs = 0.0f;	// time the CPU spent blocked on the frame fence
+	float GpuFrameMs = 0.0f;	// GPU time of the frame MAX_FRAMES_IN_FLIGHT frames ago
+};
+
+// Descriptor set and texture replaced while frames in flight may still use them
+struct RetiredMaterialBinding
+{
+	vk::DescriptorSet Set;
+	std::shared_ptr<Texture> Texture;
+	uint64_t FreeAtFrame;
+};
+
+// Level of detail selection by the projected size of each level's error
+struct LodSettings
+{
+	bool Enabled = true;
+	float PixelError = 1.0f;		// coarsest level whose error covers at most this many pixels
+	float Hysteresis = 0.25f;		// switching to a coarser level needs this much margin below PixelError
+	bool CrossFade = false;			// dither between the old and new level after a switch
+	float FadeTime = 0.25f;			// seconds
+};
+
+// Fade a cross-fade starts at. Above 0, so the two levels split the pixels even
+// on frames where no time passes, and below the smallest dither threshold.
+const float LOD_MIN_FADE = 1.0f / 64.0f;
+
+// Level an item is drawn at, kept across frames
+struct LodState
+{
+	uint32_t Level = 0;
+	uint32_t PreviousLevel = 0;		// fading out while Fade < 1
+	float Fade = 1.0f;
+};
+
+// Culling below the object level for meshes with meshlets, at level 0 outside of cross-fades
+struct MeshletSettings
+{
+	bool Enabled = true;
+	bool MeshShaders = true;		// task and mesh shaders when supported, compute and indirect draws otherwise
+};
+
+// Item that passed frustum culling, recorded once the meshlet culling pass is done
+struct VisibleItem
+{
+	uint32_t Index;					// into the snapshot items
+	glm::mat4 Model;				// interpolated
+	glm::mat4 Normal;				// of the interpolated Model
+	bool Meshlets = false;			// drawn from meshlet commands or by mesh shaders
+	bool MeshShading = false;
+	uint32_t FirstCommand = 0;		// into the frame's meshlet command buffer
 };
 
 struct MaterialPipeline
 {
 	std::unique_ptr<Pipeline> Pipeline;
+	std::unique_ptr<::Pipeline> PackedPipeline;		// for meshes with PackedVertex layout
+	// both of the above with the LOD cross-fade dither specialized in
+	std::unique_ptr<::Pipeline> DitherPipeline;
+	std::unique_ptr<::Pipeline> PackedDitherPipeline;
+	std::unique_ptr<::Pipeline> MeshletPipeline;		// task and mesh shaders, only when supported
 	std::unique_ptr<DescriptorSetLayout> MaterialDescriptorSetLayout;
 };
 
@@ -79,57 +186,140 @@ class Renderer: public IModule
 {
 public:
 	Renderer(Window& window, Camera& camera, SceneGraph& sceneGraph);
+	// Headless renderer drawing into offscreen images of the given size
+	Renderer(Camera& camera, SceneGraph& sceneGraph, uint32_t width, uint32_t height);
 	~Renderer();
 
 	void Initialize();
-	void Update();
+	void Update(float deltaTime);
 	void WaitIdle();
 	void Terminate();
 	void Resize(uint32_t width, uint32_t height);
 
+	bool IsHeadless() const { return m_Window == nullptr; }
+	const RenderStats& GetStats() const { return m_Stats; }
+	MemoryStats GetMemoryStats() const { return m_Device->GetMemoryStats(); }
+	std::vector<MemoryHeapBudget> GetMemoryBudget() const { return m_Device->GetMemoryBudget(); }
+	const GpuProfiler& GetGpuProfiler() const { return *m_GpuProfiler; }
+	const LodSettings& GetLodSettings() const { return m_LodSettings; }
+	void SetLodSettings(const LodSettings& settings) { m_LodSettings = settings; }
+	const MeshletSettings& GetMeshletSettings() const { return m_MeshletSettings; }
+	void SetMeshletSettings(const MeshletSettings& settings) { m_MeshletSettings = settings; }
+	bool IsMeshShaderSupported() const { return m_Device->IsMeshShaderSupported(); }
+	// Textures load in the background after Initialize, this blocks until all are bound
+	void FinishTextureLoads();
+	uint32_t GetPendingTextureCount() const { return m_TextureLoader->GetPendingCount(); }
+	// Headless only: copies the last rendered frame back to memory (RGBA8) or a PNG file
+	void ReadbackFrame(std::vector<uint8_t>& pixels);
+	void SaveFrame(const std::string& filename);
+
 private:
+	vk::RenderPass GetRenderPass() const;
+	vk::Extent2D GetExtent() const;
+
 	void SetupMeshes();
+	// Uploads the mesh file or processes the mesh data of one component
+	void CreateMesh(Mesh& gpuMesh, const MeshComponent& mesh, StagingRing& staging);
+	void WriteMeshletDescriptorSet(Mesh* mesh);
 	void SetupMaterials();
+	void WriteMaterialDescriptorSet(Material* material);
+	void OnTextureLoaded(Material* material, std::shared_ptr<Texture> texture);
+	// Frees bindings retired at least MAX_FRAMES_IN_FLIGHT frames ago, or all of them
+	void FreeRetiredMaterialBindings(bool all);
 
 	void SetupDescriptors();
 	void DestroyDescriptors();
 
 	void SetupPipelines();
+	void CreateMaterialPipeline(MaterialType type, const std::string& vertexShader, const std::string& fragmentShader,
+		vk::PolygonMode polygonMode = vk::PolygonMode::eFill, vk::CullModeFlagBits cullMode = vk::CullModeFlagBits::eBack);
 	void DestroyPipelines();
-	void UpdateSceneUBO(uint32_t currentImage);
+	Pipeline* GetMaterialPipeline(MaterialType type, VertexFormat format, bool dither, bool meshShading = false);
+	// Returns the values written to the UBO
+	SceneUBO UpdateSceneUBO(const SceneSnapshot& snapshot, float alpha, uint32_t currentImage);
 
 	void CreateCommandBuffers();
 	void CreateSyncObjects();
 	void DestroySyncObjects();
 
 	void BeginFrame(uint32_t& imageIndex);
+	// Separate from BeginFrame so compute work can be recorded in between
+	void BeginRenderPass(uint32_t imageIndex);
 	void EndFrame(uint32_t& imageIndex);
 	void DrawFrame();
+	// Culls the meshlets of the visible items on the GPU into indirect draws
+	void RecordMeshletCulling(vk::CommandBuffer commandBuffer, const SceneSnapshot& snapshot, const glm::vec3& cameraPosition, uint32_t commandCount);
+	void ReserveMeshletCommands(FrameData& frame, uint32_t commandCount);
+	// pixelsPerUnit is the size in pixels of one model space unit at the item's distance
+	void UpdateLod(LodState& state, const Mesh& mesh, float pixelsPerUnit);
+	uint32_t SelectLod(const Mesh& mesh, float pixelsPerUnit, uint32_t current) const;
 
 	void InitImGui();
 	void DrawImGui();
+	void DrawHierarchyNode(NodeHandle handle);
+	void DrawGpuProfilerGUI();
+	void DrawPerformanceGUI();
+	void RegisterStats();
+	void PublishStats();
 	void DestroyImGui();
 
 private:
-	uint32_t m_Width, m_Height;
+	uint32_t m_Width = 0, m_Height = 0;
 	bool m_FramebufferResized = false;
+	float m_DeltaTime = 0.0f;
+	RenderStats m_Stats;
+	LodSettings m_LodSettings;
+	std::vector<LodState> m_LodStates;	// by snapshot item, the order only changes with the scene
+	MeshletSettings m_MeshletSettings;
+	std::vector<VisibleItem> m_VisibleItems;	// reused every frame
+
+	// registry entries published every frame, see RegisterStats
+	StatCounter* m_DrawCallsCounter = nullptr;
+	StatCounter* m_PipelineBindsCounter = nullptr;
+	StatCounter* m_DescriptorSetBindsCounter = nullptr;
+	StatCounter* m_MeshBindsCounter = nullptr;
+	StatCounter* m_TrianglesCounter = nullptr;
+	StatCounter* m_CulledObjectsCounter = nullptr;
+	StatCounter* m_FadingObjectsCounter = nullptr;
+	StatCounter* m_MeshletObjectsCounter = nullptr;
+	StatCounter* m_MeshletsCounter = nullptr;
+	StatCounter* m_PendingTexturesCounter = nullptr;
+	StatCounter* m_StreamedTextureKiBCounter = nullptr;
+	StatCounter* m_StreamingBudgetKiBCounter = nullptr;
+	StatCounter* m_AtlasTexturesCounter = nullptr;
+	StatSeries* m_FrameTimeSeries = nullptr;
+	StatSeries* m_CpuTimeSeries = nullptr;
+	StatSeries* m_GpuTimeSeries = nullptr;
+	StatSeries* m_FenceWaitSeries = nullptr;
 
-	Window& m_Window;
+	Window* m_Window = nullptr;
 	Camera& m_Camera;
 	SceneGraph& m_SceneGraph;
-	Node* m_SelectedNode = nullptr;
+	NodeHandle m_SelectedNode;
 
 	std::unique_ptr<Device> m_Device;
 	std::unique_ptr<SwapChain> m_SwapChain;
+	std::unique_ptr<Offscreen> m_Offscreen;
+	std::unique_ptr<GpuProfiler> m_GpuProfiler;
+	std::unique_ptr<ThreadPool> m_ThreadPool;
+	std::unique_ptr<TextureLoader> m_TextureLoader;
+	std::unique_ptr<TextureAtlas> m_TextureAtlas;
+	std::unique_ptr<TextureStreamer> m_TextureStreamer;
 
 	std::unordered_map<MaterialType, MaterialPipeline, EnumClassHash> m_Pipelines;
 
 	std::vector<FrameData> m_Frames = std::vector<FrameData>(MAX_FRAMES_IN_FLIGHT);
 	uint32_t m_CurrentFrame = 0;
+	uint64_t m_FrameNumber = 0;
 
 	std::unique_ptr<DescriptorPool> m_SceneDescriptorPool{};
 	std::unique_ptr<DescriptorSetLayout> m_SceneDescriptorSetLayout{};
 	std::unique_ptr<DescriptorPool> m_MaterialDescriptorPool{};
+	std::vector<RetiredMaterialBinding> m_RetiredBindings;
+	std::unique_ptr<DescriptorSetLayout> m_MeshletDescriptorSetLayout{};		// per mesh, see Mesh::GetMeshletDescriptorSet
+	std::unique_ptr<DescriptorSetLayout> m_MeshletCommandSetLayout{};
+	std::unique_ptr<DescriptorPool> m_MeshletDescriptorPool{};
+	std::unique_ptr<ComputePipeline> m_MeshletCullPipeline;
 
 	vk::DescriptorPool m_ImguiPool;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Buffer.h"
+#include "../../../Core/Profiler.h"
 
 Buffer::Buffer(
     Device& device,
@@ -6,19 +7,21 @@ Buffer::Buffer(
     uint32_t instanceCount,
     vk::BufferUsageFlags usage,
     vk::MemoryPropertyFlags properties,
+    MemoryCategory category,
     vk::DeviceSize minOffsetAlignment)
     : m_Device(device), m_InstanceCount(instanceCount), m_InstanceSize(instanceSize), m_Usage(usage), m_MemoryProperties(properties)
 {
+    PROFILE_SCOPE("Buffer::Buffer");
     m_AlignmentSize = GetAlignment(m_InstanceSize, minOffsetAlignment);
     m_BufferSize = m_AlignmentSize * m_InstanceCount;
-    m_Buffer = m_Device.CreateBuffer(m_BufferSize, m_Usage, m_MemoryProperties, m_Memory);
+    m_Buffer = m_Device.CreateBuffer(m_BufferSize, m_Usage, m_MemoryProperties, category, m_Memory);
 }
 
 Buffer::~Buffer()
 {
     Unmap();
     m_Device.GetDevice().destroyBuffer(m_Buffer);
-    m_Device.GetDevice().freeMemory(m_Memory);
+    m_Device.FreeMemory(m_Memory);
 }
 
 vk::Result Buffer::Map(vk::DeviceSize size, vk::DeviceSize offset)
@@ -12,6 +12,7 @@ public:
 		uint32_t instanceCount,
 		vk::BufferUsageFlags usage,
 		vk::MemoryPropertyFlags properties,
+		MemoryCategory category,
 		vk::DeviceSize minOffsetAlignment = 1);
 	~Buffer();
 
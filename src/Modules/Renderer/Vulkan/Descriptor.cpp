@@ -78,47 +78,77 @@ std::unique_ptr<DescriptorPool> DescriptorPool::Builder::Build() const
 }
 
 DescriptorPool::DescriptorPool(Device &device, uint32_t maxSets, vk::DescriptorPoolCreateFlags poolFlags, const std::vector<vk::DescriptorPoolSize> &poolSizes)
-	: m_Device{device}
+	: m_Device{device}, m_MaxSets{maxSets}, m_PoolFlags{poolFlags}, m_PoolSizes{poolSizes}
 {
-	vk::DescriptorPoolCreateInfo poolInfo(
-		poolFlags,
-		maxSets,
-		static_cast<uint32_t>(poolSizes.size()),
-		poolSizes.data()
-	);
-	vk::Result createPoolResult = device.GetDevice().createDescriptorPool(&poolInfo, nullptr, &m_DescriptorPool);
-	if (createPoolResult != vk::Result::eSuccess)
-		throw std::runtime_error("Failed to create descriptor pool");
+	m_DescriptorPools.push_back(CreateBlock());
 }
 
 DescriptorPool::~DescriptorPool()
 {
-	m_Device.GetDevice().destroyDescriptorPool(m_DescriptorPool);
+	for (vk::DescriptorPool pool : m_DescriptorPools)
+		m_Device.GetDevice().destroyDescriptorPool(pool);
 }
 
-bool DescriptorPool::AllocateDescriptor(const vk::DescriptorSetLayout descriptorSetLayout, vk::DescriptorSet &descriptor) const
+bool DescriptorPool::AllocateDescriptor(const vk::DescriptorSetLayout descriptorSetLayout, vk::DescriptorSet &descriptor)
 {
-	vk::DescriptorSetAllocateInfo allocInfo(
-		m_DescriptorPool,
-		1,
-		&descriptorSetLayout
-	);
-	vk::Result allocateResult = m_Device.GetDevice().allocateDescriptorSets(&allocInfo, &descriptor);
-	if (allocateResult != vk::Result::eSuccess)
-		return false;
-	return true;
+	auto allocate = [&](vk::DescriptorPool pool)
+	{
+		vk::DescriptorSetAllocateInfo allocInfo(
+			pool,
+			1,
+			&descriptorSetLayout
+		);
+		if (m_Device.GetDevice().allocateDescriptorSets(&allocInfo, &descriptor) != vk::Result::eSuccess)
+			return false;
+		if (m_PoolFlags & vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+			m_Owners[static_cast<VkDescriptorSet>(descriptor)] = pool;
+		return true;
+	};
+
+	// freed sets leave room in older blocks, a new block only once all are full
+	for (auto pool = m_DescriptorPools.rbegin(); pool != m_DescriptorPools.rend(); ++pool)
+		if (allocate(*pool))
+			return true;
+
+	m_DescriptorPools.push_back(CreateBlock());
+	return allocate(m_DescriptorPools.back());
+}
+
+void DescriptorPool::FreeDescriptors(std::vector<vk::DescriptorSet> &descriptors)
+{
+	for (vk::DescriptorSet descriptor : descriptors)
+	{
+		auto owner = m_Owners.find(static_cast<VkDescriptorSet>(descriptor));
+		if (owner == m_Owners.end())
+			throw std::runtime_error("Descriptor set was not allocated from this pool");
+
+		vk::Result freeResult = m_Device.GetDevice().freeDescriptorSets(owner->second, 1, &descriptor);
+		if (freeResult != vk::Result::eSuccess)
+			throw std::runtime_error("Failed to free descriptor sets");
+		m_Owners.erase(owner);
+	}
 }
 
-void DescriptorPool::FreeDescriptors(std::vector<vk::DescriptorSet> &descriptors) const
+void DescriptorPool::ResetPool()
 {
-	vk::Result freeResult = m_Device.GetDevice().freeDescriptorSets(m_DescriptorPool, static_cast<uint32_t>(descriptors.size()), descriptors.data());
-	if (freeResult != vk::Result::eSuccess)
-		throw std::runtime_error("Failed to free descriptor sets");
+	for (vk::DescriptorPool pool : m_DescriptorPools)
+		m_Device.GetDevice().resetDescriptorPool(pool);
+	m_Owners.clear();
 }
 
-void DescriptorPool::ResetPool()
+vk::DescriptorPool DescriptorPool::CreateBlock()
 {
-	m_Device.GetDevice().resetDescriptorPool(m_DescriptorPool);
+	vk::DescriptorPoolCreateInfo poolInfo(
+		m_PoolFlags,
+		m_MaxSets,
+		static_cast<uint32_t>(m_PoolSizes.size()),
+		m_PoolSizes.data()
+	);
+	vk::DescriptorPool pool;
+	vk::Result createPoolResult = m_Device.GetDevice().createDescriptorPool(&poolInfo, nullptr, &pool);
+	if (createPoolResult != vk::Result::eSuccess)
+		throw std::runtime_error("Failed to create descriptor pool");
+	return pool;
 }
 
 DescriptorWriter::DescriptorWriter(DescriptorSetLayout &setLayout, DescriptorPool &pool)
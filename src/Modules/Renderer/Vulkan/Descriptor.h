@@ -1,6 +1,8 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
 #include <memory.h>
+#include <unordered_map>
+#include <vector>
 #include "Device.h"
 
 class DescriptorSetLayout
@@ -42,6 +44,9 @@ private:
 friend class DescriptorWriter;
 };
 
+// Pool sizes and max sets describe one block. Once a block runs out another
+// one of the same size is created, so allocations only fail when the device
+// itself is out of memory.
 class DescriptorPool
 {
 public:
@@ -72,13 +77,20 @@ public:
 	DescriptorPool(const DescriptorPool &) = delete;
 	DescriptorPool &operator=(const DescriptorPool &) = delete;
 
-	bool AllocateDescriptor(const vk::DescriptorSetLayout descriptorSetLayout, vk::DescriptorSet &descriptor) const;
-	void FreeDescriptors(std::vector<vk::DescriptorSet> &descriptors) const;
+	bool AllocateDescriptor(const vk::DescriptorSetLayout descriptorSetLayout, vk::DescriptorSet &descriptor);
+	void FreeDescriptors(std::vector<vk::DescriptorSet> &descriptors);
 	void ResetPool();
 
 private:
+	vk::DescriptorPool CreateBlock();
+
 	Device& m_Device;
-	vk::DescriptorPool m_DescriptorPool;
+	uint32_t m_MaxSets;
+	vk::DescriptorPoolCreateFlags m_PoolFlags;
+	std::vector<vk::DescriptorPoolSize> m_PoolSizes;
+	std::vector<vk::DescriptorPool> m_DescriptorPools;	// the last one is tried first
+	// block of every set, only kept when sets can be freed individually
+	std::unordered_map<VkDescriptorSet, vk::DescriptorPool> m_Owners;
 
 friend class DescriptorWriter;
 };
@@ -1,14 +1,63 @@
+#include <cassert>
 #include <iostream>
 #include <set>
+#include <string>
+#include <algorithm>
 #include "Device.h"
+#include "../../../Core/Profiler.h"
 
-Device::Device(Window& window): m_Window(window) {}
+const char* GetMemoryCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Geometry: return "Geometry";
+	case MemoryCategory::Texture: return "Texture";
+	case MemoryCategory::Uniform: return "Uniform";
+	case MemoryCategory::Staging: return "Staging";
+	case MemoryCategory::Attachment: return "Attachment";
+	default: return "Unknown";
+	}
+}
+
+Device::Device(Window* window): m_Window(window)
+{
+	if (!IsHeadless())
+		m_DeviceExtensions = deviceExtensions;
+}
 
 Device::~Device() {}
 
 void Device::CreateDevice()
 {
     m_QueueFamilies = FindQueueFamilies(m_PhysicalDevice);
+
+	uint32_t deviceApiVersion = std::min(m_ApiVersion, m_PhysicalDevice.getProperties().apiVersion);
+	std::set<std::string> availableExtensions;
+	for (const auto& extension : m_PhysicalDevice.enumerateDeviceExtensionProperties())
+		availableExtensions.insert(extension.extensionName.data());
+
+	// optional, without it budgets are estimated from the heap sizes
+	if (deviceApiVersion >= VK_API_VERSION_1_1 && availableExtensions.count(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+	{
+		m_DeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		m_MemoryBudgetSupported = true;
+	}
+
+	// optional as well, meshlets are culled in a compute pass and drawn indirectly
+	// without it. 1.2 has the SPIR-V 1.4 the mesh and task shaders are built for.
+	vk::PhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures;
+	if (deviceApiVersion >= VK_API_VERSION_1_2 && availableExtensions.count(VK_EXT_MESH_SHADER_EXTENSION_NAME))
+	{
+		auto features = m_PhysicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+		const auto& supported = features.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+		if (supported.taskShader && supported.meshShader)
+		{
+			m_DeviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+			meshShaderFeatures.taskShader = VK_TRUE;
+			meshShaderFeatures.meshShader = VK_TRUE;
+			m_MeshShaderSupported = true;
+		}
+	}
 	
 	float queuePriority = 1.0f;
 
@@ -25,6 +74,7 @@ void Device::CreateDevice()
 	}
 
 	vk::PhysicalDeviceFeatures deviceFeatures = m_PhysicalDevice.getFeatures();
+	m_MultiDrawIndirectSupported = deviceFeatures.multiDrawIndirect;
 
 	vk::DeviceCreateInfo createInfo(
 		vk::DeviceCreateFlags(),
@@ -32,12 +82,22 @@ void Device::CreateDevice()
 		queueCreateInfos.data(),
 		0,
 		nullptr,
-		static_cast<uint32_t>( deviceExtensions.size() ),
-		deviceExtensions.data(),
+		static_cast<uint32_t>( m_DeviceExtensions.size() ),
+		m_DeviceExtensions.data(),
 		&deviceFeatures
 	);
 
+	// extension features only go through the pNext chain, the core ones with them
+	vk::PhysicalDeviceFeatures2 deviceFeatures2(deviceFeatures, &meshShaderFeatures);
+	if (m_MeshShaderSupported)
+	{
+		createInfo.pEnabledFeatures = nullptr;
+		createInfo.pNext = &deviceFeatures2;
+	}
+
 	m_Device = m_PhysicalDevice.createDevice( createInfo );
+	if (m_MeshShaderSupported)
+		m_DrawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(m_Device.getProcAddr("vkCmdDrawMeshTasksEXT"));
 
 	m_GraphicsQueue = m_Device.getQueue(m_QueueFamilies.GraphicsFamily.value(), 0);
 	m_PresentQueue = m_Device.getQueue(m_QueueFamilies.PresentFamily.value(), 0);
@@ -54,8 +114,11 @@ void Device::CreateInstance()
 	vkEnumerateInstanceVersion(&version);
 	std::cout << "Vulkan Version: " << VK_API_VERSION_MAJOR(version) << '.' << VK_API_VERSION_MINOR(version) << '.' << VK_API_VERSION_PATCH(version) << std::endl;
 
-	vk::ApplicationInfo appInfo("Vulkan Sandbox", 1, "No Engine", 1, VK_API_VERSION_1_0);
-	auto extensions = m_ValidationLayer->GetRequiredExtensions();
+	// 1.1 gives us vkGetPhysicalDeviceMemoryProperties2 for the memory budget
+	// query, 1.2 the SPIR-V version mesh shaders need
+	m_ApiVersion = version >= VK_API_VERSION_1_2 ? VK_API_VERSION_1_2 : version >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_1 : VK_API_VERSION_1_0;
+	vk::ApplicationInfo appInfo("Vulkan Sandbox", 1, "No Engine", 1, m_ApiVersion);
+	auto extensions = m_ValidationLayer->GetRequiredExtensions(!IsHeadless());
 	vk::InstanceCreateInfo createInfo( {}, &appInfo, 0, nullptr, static_cast<uint32_t>(extensions.size()), extensions.data() );
 
 	VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo;
@@ -97,6 +160,9 @@ void Device::SelectPhysicalDevice()
 			break;
 		}
 	}
+
+	if (!m_PhysicalDevice)
+		throw std::runtime_error("Failed to find a suitable GPU");
 }
 
 bool Device::IsDeviceSuitable(vk::PhysicalDevice device)
@@ -105,8 +171,9 @@ bool Device::IsDeviceSuitable(vk::PhysicalDevice device)
 
 	bool extensionsSupported = CheckDeviceExtensionSupport(device);
 
-	bool swapChainAdequate = false;
-	if (extensionsSupported)
+	// offscreen rendering has no swap chain to validate
+	bool swapChainAdequate = IsHeadless();
+	if (extensionsSupported && !IsHeadless())
 	{
 		SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.Formats.empty() && !swapChainSupport.PresentModes.empty();
@@ -127,13 +194,21 @@ QueueFamilyIndices Device::FindQueueFamilies(vk::PhysicalDevice device)
 	for (const auto& queueFamily : queueFamilies)
 	{
 		VkBool32 presentSupport = false;
-		vk::Result result = device.getSurfaceSupportKHR(i, m_Surface, &presentSupport);
+		if (!IsHeadless())
+		{
+			vk::Result result = device.getSurfaceSupportKHR(i, m_Surface, &presentSupport);
 
-		if (result != vk::Result::eSuccess)
-			throw std::runtime_error("Failed to get surface support");
+			if (result != vk::Result::eSuccess)
+				throw std::runtime_error("Failed to get surface support");
+		}
 
 		if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+		{
 			indices.GraphicsFamily = i;
+			// without a surface the graphics queue doubles as the "present" queue
+			if (IsHeadless())
+				presentSupport = true;
+		}
 		
 		if (presentSupport)
 			indices.PresentFamily = i;
@@ -149,12 +224,18 @@ QueueFamilyIndices Device::FindQueueFamilies(vk::PhysicalDevice device)
 
 void Device::Initialize()
 {
+	PROFILE_SCOPE("Device::Initialize");
 	CreateInstance();
     CreateValidationLayer();
     CreateSurface();
     SelectPhysicalDevice();
     CreateDevice();
 	CreateCommandPool();
+
+	m_MemoryProperties = m_PhysicalDevice.getMemoryProperties();
+	m_MemoryStats.HeapBytes.resize(m_MemoryProperties.memoryHeapCount, 0);
+	m_HeapOverWarning.resize(m_MemoryProperties.memoryHeapCount, false);
+	UpdateMemoryBudget();
 }
 
 void Device::Terminate()
@@ -185,10 +266,8 @@ SwapChainSupportDetails Device::QuerySwapChainSupport(vk::PhysicalDevice device)
 
 uint32_t Device::FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties)
 {
-    vk::PhysicalDeviceMemoryProperties memProperties = m_PhysicalDevice.getMemoryProperties();
-
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+		if ((typeFilter & (1 << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
 			return i;
 
 	throw std::runtime_error("Failed to find suitable memory type");
@@ -198,8 +277,10 @@ vk::Buffer Device::CreateBuffer(
 	vk::DeviceSize size,
 	vk::BufferUsageFlags usage,
 	vk::MemoryPropertyFlags properties,
+	MemoryCategory category,
 	vk::DeviceMemory& bufferMemory)
 {
+	PROFILE_SCOPE("Device::CreateBuffer");
 	vk::BufferCreateInfo bufferInfo(
 		vk::BufferCreateFlags(),
 		size,
@@ -210,14 +291,7 @@ vk::Buffer Device::CreateBuffer(
 	vk::Buffer buffer = m_Device.createBuffer(bufferInfo);
 
 	vk::MemoryRequirements memRequirements = m_Device.getBufferMemoryRequirements(buffer);
-	vk::MemoryAllocateInfo allocInfo(
-		memRequirements.size,
-		FindMemoryType(memRequirements.memoryTypeBits, properties)
-	);
-
-	vk::Result allocateResult = m_Device.allocateMemory(&allocInfo, nullptr, &bufferMemory);
-	if (allocateResult != vk::Result::eSuccess)
-		throw std::runtime_error("Failed to allocate buffer memory");
+	bufferMemory = AllocateMemory(memRequirements, properties, category);
 
 	m_Device.bindBufferMemory(buffer, bufferMemory, 0);
 
@@ -226,6 +300,7 @@ vk::Buffer Device::CreateBuffer(
 
 void Device::CopyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size)
 {
+	PROFILE_SCOPE("Device::CopyBuffer");
 	vk::CommandBuffer commandBuffer = BeginSingleTimeCommands();
 
 	vk::BufferCopy copyRegion(0, 0, size);
@@ -235,15 +310,16 @@ void Device::CopyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSi
 	EndSingleTimeCommands(commandBuffer);
 }
 
-vk::Image Device::CreateImage(uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::DeviceMemory &imageMemory)
+vk::Image Device::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category, vk::DeviceMemory &imageMemory, uint32_t arrayLayers)
 {
+	PROFILE_SCOPE("Device::CreateImage");
     vk::ImageCreateInfo imageInfo(
 		vk::ImageCreateFlags(),
 		vk::ImageType::e2D,
 		format,
 		vk::Extent3D(width, height, 1),
-		1,
-		1,
+		mipLevels,
+		arrayLayers,
 		vk::SampleCountFlagBits::e1,
 		tiling,
 		usage,
@@ -256,26 +332,166 @@ vk::Image Device::CreateImage(uint32_t width, uint32_t height, vk::Format format
 	vk::Image image = m_Device.createImage(imageInfo);
 
 	vk::MemoryRequirements memRequirements = m_Device.getImageMemoryRequirements(image);
+	imageMemory = AllocateMemory(memRequirements, properties, category);
+
+	m_Device.bindImageMemory(image, imageMemory, 0);
+
+	return image;
+}
+
+vk::DeviceMemory Device::AllocateMemory(vk::MemoryRequirements requirements, vk::MemoryPropertyFlags properties, MemoryCategory category)
+{
+	uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, properties);
+	uint32_t heapIndex = m_MemoryProperties.memoryTypes[memoryType].heapIndex;
 	vk::MemoryAllocateInfo allocInfo(
-		memRequirements.size,
-		FindMemoryType(memRequirements.memoryTypeBits, properties)
+		requirements.size,
+		memoryType
 	);
 
-	vk::Result allocateResult = m_Device.allocateMemory(&allocInfo, nullptr, &imageMemory);
+	vk::DeviceMemory memory;
+	vk::Result allocateResult = m_Device.allocateMemory(&allocInfo, nullptr, &memory);
+	if (allocateResult == vk::Result::eErrorOutOfDeviceMemory && m_MemoryPressureCallback)
+	{
+		// give the owner of the callback a chance to release memory, then retry once
+		std::cerr << "Out of device memory allocating " << requirements.size << " bytes of " << GetMemoryCategoryName(category) << std::endl;
+		m_MemoryPressureCallback(heapIndex, GetMemoryBudget()[heapIndex]);
+		allocateResult = m_Device.allocateMemory(&allocInfo, nullptr, &memory);
+	}
 	if (allocateResult != vk::Result::eSuccess)
-		throw std::runtime_error("Failed to allocate image memory");
+		throw std::runtime_error("Failed to allocate device memory");
 
-	m_Device.bindImageMemory(image, imageMemory, 0);
+	{
+		std::lock_guard<std::mutex> lock(m_MemoryMutex);
+		m_Allocations[static_cast<VkDeviceMemory>(memory)] = { requirements.size, heapIndex, category };
+		m_MemoryStats.HeapBytes[heapIndex] += requirements.size;
+		m_MemoryStats.CategoryBytes[static_cast<size_t>(category)] += requirements.size;
+		m_MemoryStats.TotalBytes += requirements.size;
+		m_MemoryStats.AllocationCount++;
+	}
 
-	return image;
+	CheckMemoryBudget(heapIndex);
+	return memory;
 }
 
-vk::ImageView Device::CreateImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags)
+void Device::FreeMemory(vk::DeviceMemory memory)
 {
+	if (!memory)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_MemoryMutex);
+		auto it = m_Allocations.find(static_cast<VkDeviceMemory>(memory));
+		if (it != m_Allocations.end())
+		{
+			m_MemoryStats.HeapBytes[it->second.HeapIndex] -= it->second.Size;
+			m_MemoryStats.CategoryBytes[static_cast<size_t>(it->second.Category)] -= it->second.Size;
+			m_MemoryStats.TotalBytes -= it->second.Size;
+			m_MemoryStats.AllocationCount--;
+			m_Allocations.erase(it);
+		}
+	}
+
+	m_Device.freeMemory(memory);
+}
+
+MemoryStats Device::GetMemoryStats()
+{
+	std::lock_guard<std::mutex> lock(m_MemoryMutex);
+	return m_MemoryStats;
+}
+
+void Device::UpdateMemoryBudget()
+{
+	std::vector<MemoryHeapBudget> budgets(m_MemoryProperties.memoryHeapCount);
+	vk::PhysicalDeviceMemoryBudgetPropertiesEXT driverBudget;
+	if (m_MemoryBudgetSupported)
+	{
+		auto properties = m_PhysicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+		driverBudget = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+	}
+
+	std::lock_guard<std::mutex> lock(m_MemoryMutex);
+	for (uint32_t heap = 0; heap < m_MemoryProperties.memoryHeapCount; heap++)
+	{
+		const vk::MemoryHeap& memoryHeap = m_MemoryProperties.memoryHeaps[heap];
+		budgets[heap].Size = memoryHeap.size;
+		budgets[heap].DeviceLocal = static_cast<bool>(memoryHeap.flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+		if (m_MemoryBudgetSupported)
+		{
+			budgets[heap].Budget = driverBudget.heapBudget[heap];
+			budgets[heap].Usage = driverBudget.heapUsage[heap];
+		}
+		else
+		{
+			budgets[heap].Budget = static_cast<vk::DeviceSize>(memoryHeap.size * MEMORY_BUDGET_FALLBACK);
+			budgets[heap].Usage = m_MemoryStats.HeapBytes[heap];
+		}
+	}
+
+	m_HeapBudgets = std::move(budgets);
+	m_HeapBytesAtBudgetUpdate = m_MemoryStats.HeapBytes;
+}
+
+std::vector<MemoryHeapBudget> Device::GetMemoryBudget()
+{
+	std::lock_guard<std::mutex> lock(m_MemoryMutex);
+
+	// the driver numbers are only refreshed once per frame, add what we allocated or freed since
+	std::vector<MemoryHeapBudget> budgets = m_HeapBudgets;
+	for (size_t heap = 0; heap < budgets.size(); heap++)
+	{
+		int64_t delta = static_cast<int64_t>(m_MemoryStats.HeapBytes[heap]) - static_cast<int64_t>(m_HeapBytesAtBudgetUpdate[heap]);
+		budgets[heap].Usage = static_cast<vk::DeviceSize>(std::max<int64_t>(0, static_cast<int64_t>(budgets[heap].Usage) + delta));
+	}
+	return budgets;
+}
+
+void Device::CheckMemoryBudget(uint32_t heapIndex)
+{
+	MemoryHeapBudget budget = GetMemoryBudget()[heapIndex];
+	bool overWarning = budget.Usage > budget.Budget * MEMORY_BUDGET_WARNING;
+
+	{
+		// warn once per crossing instead of on every allocation past the threshold
+		std::lock_guard<std::mutex> lock(m_MemoryMutex);
+		if (overWarning == m_HeapOverWarning[heapIndex])
+			return;
+		m_HeapOverWarning[heapIndex] = overWarning;
+	}
+
+	if (!overWarning)
+		return;
+
+	std::cerr << "Warning: memory heap " << heapIndex << " at "
+		<< budget.Usage / (1024 * 1024) << " of " << budget.Budget / (1024 * 1024) << " MiB budget" << std::endl;
+	if (m_MemoryPressureCallback)
+		m_MemoryPressureCallback(heapIndex, budget);
+}
+
+void Device::PrintMemoryReport(std::ostream& out)
+{
+	MemoryStats stats = GetMemoryStats();
+	std::vector<MemoryHeapBudget> budgets = GetMemoryBudget();
+
+	out << "Device memory: " << stats.AllocationCount << " allocations, " << stats.TotalBytes / 1024 << " KiB"
+		<< (m_MemoryBudgetSupported ? "" : " (budget estimated, VK_EXT_memory_budget unavailable)") << std::endl;
+	for (size_t heap = 0; heap < budgets.size(); heap++)
+	{
+		out << "  heap " << heap << (budgets[heap].DeviceLocal ? " (device local)" : "")
+			<< ": ours " << stats.HeapBytes[heap] / 1024 << " KiB, usage " << budgets[heap].Usage / 1024
+			<< " KiB, budget " << budgets[heap].Budget / 1024 << " KiB, size " << budgets[heap].Size / 1024 << " KiB" << std::endl;
+	}
+	for (size_t category = 0; category < stats.CategoryBytes.size(); category++)
+		out << "  " << GetMemoryCategoryName(static_cast<MemoryCategory>(category)) << ": " << stats.CategoryBytes[category] / 1024 << " KiB" << std::endl;
+}
+
+vk::ImageView Device::CreateImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels, vk::ImageViewType viewType, uint32_t arrayLayers)
+{
+	PROFILE_SCOPE("Device::CreateImageView");
     vk::ImageViewCreateInfo viewInfo(
 		vk::ImageViewCreateFlags(),
 		image,
-		vk::ImageViewType::e2D,
+		viewType,
 		format,
 		vk::ComponentMapping(
 			vk::ComponentSwizzle::eIdentity,
@@ -285,8 +501,8 @@ vk::ImageView Device::CreateImageView(vk::Image image, vk::Format format, vk::Im
 		),
 		vk::ImageSubresourceRange(
 			aspectFlags,
-			0, 1,
-			0, 1
+			0, mipLevels,
+			0, arrayLayers
 		)
 	);
 
@@ -295,6 +511,7 @@ vk::ImageView Device::CreateImageView(vk::Image image, vk::Format format, vk::Im
 
 void Device::CopyBufferToImage(vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height)
 {
+	PROFILE_SCOPE("Device::CopyBufferToImage");
 	vk::CommandBuffer commandBuffer = BeginSingleTimeCommands();
 
 	vk::BufferImageCopy region(
@@ -322,7 +539,7 @@ bool Device::CheckDeviceExtensionSupport(vk::PhysicalDevice device)
 {
     std::vector<vk::ExtensionProperties> availableExtensions = device.enumerateDeviceExtensionProperties();
 
-	std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	std::set<std::string> requiredExtensions(m_DeviceExtensions.begin(), m_DeviceExtensions.end());
 
 	for (const auto& extension : availableExtensions)
 		requiredExtensions.erase(extension.extensionName);
@@ -332,11 +549,17 @@ bool Device::CheckDeviceExtensionSupport(vk::PhysicalDevice device)
 
 void Device::CreateSurface()
 {
-    m_Surface = m_Window.CreateSurface(m_Instance);
+	if (IsHeadless())
+		return;
+
+    m_Surface = m_Window->CreateSurface(m_Instance);
 }
 
 void Device::DestroySurface()
 {
+	if (IsHeadless())
+		return;
+
 	m_Instance.destroySurfaceKHR(m_Surface);
 }
 
@@ -357,6 +580,12 @@ void Device::DestroyCommandPool()
 	m_Device.destroyCommandPool(m_CommandPool);
 }
 
+void Device::DrawMeshTasks(vk::CommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+	assert(m_DrawMeshTasks && "Mesh shaders are not supported");
+	m_DrawMeshTasks(static_cast<VkCommandBuffer>(commandBuffer), groupCountX, groupCountY, groupCountZ);
+}
+
 vk::CommandBuffer Device::BeginSingleTimeCommands()
 {
     vk::CommandBufferAllocateInfo allocInfo(
@@ -376,6 +605,7 @@ vk::CommandBuffer Device::BeginSingleTimeCommands()
 
 void Device::EndSingleTimeCommands(vk::CommandBuffer commandBuffer)
 {
+	PROFILE_SCOPE("Device::EndSingleTimeCommands");
 	commandBuffer.end();
 
 	vk::SubmitInfo submitInfo(
@@ -1,6 +1,11 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
 #include <optional>
+#include <array>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <unordered_map>
 #include "./ValidationLayer.h"
 #include "../../../Core/Window.h"
 
@@ -22,6 +27,46 @@ struct SwapChainSupportDetails
 	std::vector<vk::PresentModeKHR> PresentModes;
 };
 
+// What an allocation is used for, reported separately in MemoryStats
+enum class MemoryCategory
+{
+	Geometry,
+	Texture,
+	Uniform,
+	Staging,
+	Attachment,
+	Count
+};
+
+const char* GetMemoryCategoryName(MemoryCategory category);
+
+// Device memory currently allocated through CreateBuffer / CreateImage
+struct MemoryStats
+{
+	vk::DeviceSize TotalBytes = 0;
+	uint32_t AllocationCount = 0;
+	std::vector<vk::DeviceSize> HeapBytes;	// indexed by memory heap
+	std::array<vk::DeviceSize, static_cast<size_t>(MemoryCategory::Count)> CategoryBytes{};
+};
+
+// Usage of one memory heap against what the driver lets this process use.
+// Without VK_EXT_memory_budget the budget is a fixed share of the heap size
+// and usage only counts our own allocations.
+struct MemoryHeapBudget
+{
+	vk::DeviceSize Size = 0;
+	vk::DeviceSize Budget = 0;
+	vk::DeviceSize Usage = 0;
+	bool DeviceLocal = false;
+};
+
+// Allocations pushing a heap past this share of its budget trigger a warning and the pressure callback
+const float MEMORY_BUDGET_WARNING = 0.9f;
+// Share of the heap size assumed available when the driver cannot report a budget
+const float MEMORY_BUDGET_FALLBACK = 0.8f;
+
+using MemoryPressureCallback = std::function<void(uint32_t heapIndex, const MemoryHeapBudget& budget)>;
+
 const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
@@ -29,7 +74,8 @@ const std::vector<const char*> deviceExtensions = {
 class Device
 {
 public:
-    Device(Window& window);
+    // Passing no window creates a headless device without surface or presentation support
+    Device(Window* window);
     ~Device();
 
     Device(const Device &) = delete;
@@ -45,6 +91,7 @@ public:
     vk::SurfaceKHR GetSurface() const { return m_Surface; }
     QueueFamilyIndices GetQueueFamilies() const { return m_QueueFamilies; }
     vk::CommandPool GetCommandPool() const { return m_CommandPool; }
+    bool IsHeadless() const { return m_Window == nullptr; }
 
     void Initialize();
     void Terminate();
@@ -55,10 +102,27 @@ public:
 	void EndSingleTimeCommands(vk::CommandBuffer commandBuffer);
 
     uint32_t FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
-    vk::Buffer CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::DeviceMemory& bufferMemory);
+    vk::Buffer CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category, vk::DeviceMemory& bufferMemory);
     void CopyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size);
-    vk::Image CreateImage(uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::DeviceMemory& imageMemory);
-    vk::ImageView CreateImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags);
+    vk::Image CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category, vk::DeviceMemory& imageMemory, uint32_t arrayLayers = 1);
+    // Releases memory obtained from CreateBuffer / CreateImage and updates the statistics
+    void FreeMemory(vk::DeviceMemory memory);
+    MemoryStats GetMemoryStats();
+    // Refreshes the driver reported budgets, call about once per frame
+    void UpdateMemoryBudget();
+    std::vector<MemoryHeapBudget> GetMemoryBudget();
+    bool IsMemoryBudgetSupported() const { return m_MemoryBudgetSupported; }
+    // VK_EXT_mesh_shader with task shaders, enabled when the device has it
+    bool IsMeshShaderSupported() const { return m_MeshShaderSupported; }
+    // Several indirect draws per call, otherwise each needs its own
+    bool IsMultiDrawIndirectSupported() const { return m_MultiDrawIndirectSupported; }
+    // vkCmdDrawMeshTasksEXT, loaded from the device since the loader does not export it
+    void DrawMeshTasks(vk::CommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+    // Called when an allocation brings a heap close to its budget, or fails because it is exhausted.
+    // Runs on the allocating thread; a typical response is evicting texture mips.
+    void SetMemoryPressureCallback(MemoryPressureCallback callback) { m_MemoryPressureCallback = std::move(callback); }
+    void PrintMemoryReport(std::ostream& out);
+    vk::ImageView CreateImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels = 1, vk::ImageViewType viewType = vk::ImageViewType::e2D, uint32_t arrayLayers = 1);
     void CopyBufferToImage(vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height);
 
 private:
@@ -78,7 +142,11 @@ private:
     void CreateValidationLayer();
     void DestroyValidationLayer();
 
-    Window& m_Window;
+    vk::DeviceMemory AllocateMemory(vk::MemoryRequirements requirements, vk::MemoryPropertyFlags properties, MemoryCategory category);
+    void CheckMemoryBudget(uint32_t heapIndex);
+
+    Window* m_Window;
+    std::vector<const char*> m_DeviceExtensions;
     vk::Instance m_Instance;
     vk::PhysicalDevice m_PhysicalDevice;
     vk::Device m_Device;
@@ -90,4 +158,25 @@ private:
     vk::CommandPool m_CommandPool;
 
     ValidationLayer* m_ValidationLayer;
+
+    struct Allocation
+    {
+        vk::DeviceSize Size;
+        uint32_t HeapIndex;
+        MemoryCategory Category;
+    };
+    std::mutex m_MemoryMutex;
+    std::unordered_map<VkDeviceMemory, Allocation> m_Allocations;
+    MemoryStats m_MemoryStats;
+
+    bool m_MemoryBudgetSupported = false;
+    bool m_MeshShaderSupported = false;
+    bool m_MultiDrawIndirectSupported = false;
+    PFN_vkCmdDrawMeshTasksEXT m_DrawMeshTasks = nullptr;
+    uint32_t m_ApiVersion = VK_API_VERSION_1_0;
+    vk::PhysicalDeviceMemoryProperties m_MemoryProperties;
+    std::vector<MemoryHeapBudget> m_HeapBudgets;
+    std::vector<vk::DeviceSize> m_HeapBytesAtBudgetUpdate;	// our usage when m_HeapBudgets was refreshed
+    std::vector<bool> m_HeapOverWarning;
+    MemoryPressureCallback m_MemoryPressureCallback;
 };
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include <cstring>
+#include <stdexcept>
+#include "GpuProfiler.h"
+
+GpuProfiler::Scope::Scope(GpuProfiler& profiler, vk::CommandBuffer commandBuffer, const char* name)
+	: m_Profiler(profiler), m_CommandBuffer(commandBuffer)
+{
+	m_Index = m_Profiler.BeginScope(m_CommandBuffer, name);
+}
+
+GpuProfiler::Scope::~Scope()
+{
+	m_Profiler.EndScope(m_CommandBuffer, m_Index);
+}
+
+GpuProfiler::GpuProfiler(Device& device, uint32_t framesInFlight)
+	: m_Device(device), m_Frames(framesInFlight)
+{
+}
+
+GpuProfiler::~GpuProfiler()
+{
+}
+
+void GpuProfiler::Initialize()
+{
+	vk::PhysicalDeviceProperties properties = m_Device.GetPhysicalDevice().getProperties();
+	std::vector<vk::QueueFamilyProperties> queueFamilies = m_Device.GetPhysicalDevice().getQueueFamilyProperties();
+	uint32_t validBits = queueFamilies[m_Device.GetQueueFamilies().GraphicsFamily.value()].timestampValidBits;
+
+	m_Supported = validBits != 0 && properties.limits.timestampPeriod > 0.0f;
+	if (!m_Supported)
+		return;
+
+	m_TimestampPeriod = properties.limits.timestampPeriod;
+	m_TimestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+	vk::QueryPoolCreateInfo poolInfo({}, vk::QueryType::eTimestamp, MAX_SCOPES * 2);
+	for (FrameQueries& frame : m_Frames)
+	{
+		frame.Pool = m_Device.GetDevice().createQueryPool(poolInfo);
+		if (!frame.Pool)
+			throw std::runtime_error("Failed to create timestamp query pool");
+		frame.Scopes.reserve(MAX_SCOPES);
+	}
+
+	m_Timestamps.resize(MAX_SCOPES * 2);
+	m_Results.reserve(MAX_SCOPES);
+}
+
+void GpuProfiler::Terminate()
+{
+	for (FrameQueries& frame : m_Frames)
+	{
+		if (frame.Pool)
+			m_Device.GetDevice().destroyQueryPool(frame.Pool);
+		frame.Pool = nullptr;
+	}
+	m_Current = nullptr;
+}
+
+void GpuProfiler::BeginFrame(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if (!m_Supported)
+		return;
+
+	FrameQueries& frame = m_Frames[frameIndex];
+	CollectResults(frame);
+
+	commandBuffer.resetQueryPool(frame.Pool, 0, MAX_SCOPES * 2);
+	frame.Scopes.clear();
+	frame.QueryCount = 0;
+	m_Current = &frame;
+	m_Depth = 0;
+	m_FrameScope = BeginScope(commandBuffer, "Frame");
+}
+
+void GpuProfiler::EndFrame(vk::CommandBuffer commandBuffer)
+{
+	if (!m_Supported)
+		return;
+
+	EndScope(commandBuffer, m_FrameScope);
+	m_FrameScope = UINT32_MAX;
+	m_Current = nullptr;
+}
+
+double GpuProfiler::GetTiming(const char* name) const
+{
+	for (const GpuTiming& timing : m_Results)
+		if (std::strcmp(timing.Name, name) == 0)
+			return timing.Milliseconds;
+	return 0.0;
+}
+
+uint32_t GpuProfiler::BeginScope(vk::CommandBuffer commandBuffer, const char* name)
+{
+	if (m_Current == nullptr || m_Current->QueryCount + 2 > MAX_SCOPES * 2)
+		return UINT32_MAX;
+
+	ScopeRecord record{ name, m_Depth++, m_Current->QueryCount, m_Current->QueryCount + 1 };
+	m_Current->QueryCount += 2;
+	commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_Current->Pool, record.BeginQuery);
+
+	m_Current->Scopes.push_back(record);
+	return static_cast<uint32_t>(m_Current->Scopes.size() - 1);
+}
+
+void GpuProfiler::EndScope(vk::CommandBuffer commandBuffer, uint32_t index)
+{
+	if (m_Current == nullptr || index == UINT32_MAX)
+		return;
+
+	m_Depth--;
+	commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_Current->Pool, m_Current->Scopes[index].EndQuery);
+}
+
+void GpuProfiler::CollectResults(FrameQueries& frame)
+{
+	if (frame.QueryCount == 0)
+		return;
+
+	// the frame's fence has signaled, so this only fails if a scope was left open
+	vk::Result result = m_Device.GetDevice().getQueryPoolResults(
+		frame.Pool,
+		0, frame.QueryCount,
+		frame.QueryCount * sizeof(uint64_t), m_Timestamps.data(),
+		sizeof(uint64_t),
+		vk::QueryResultFlagBits::e64
+	);
+	if (result != vk::Result::eSuccess)
+		return;
+
+	m_Results.clear();
+	for (const ScopeRecord& scope : frame.Scopes)
+	{
+		uint64_t ticks = (m_Timestamps[scope.EndQuery] - m_Timestamps[scope.BeginQuery]) & m_TimestampMask;
+		m_Results.push_back({ scope.Name, scope.Depth, ticks * m_TimestampPeriod / 1000000.0 });
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <string>
+#include "Device.h"
+
+struct GpuTiming
+{
+	const char* Name;
+	uint32_t Depth;			// nesting level, 0 for outermost scopes
+	double Milliseconds;
+};
+
+// Measures command buffer regions with timestamp queries. Every frame in
+// flight owns a query pool; its results are read back once the frame's fence
+// has been waited on, so reading never stalls the GPU and the reported
+// timings lag the recorded frame by MAX_FRAMES_IN_FLIGHT frames.
+class GpuProfiler
+{
+public:
+	static const uint32_t MAX_SCOPES = 32;
+
+	// Writes a timestamp pair around everything recorded during its lifetime.
+	// The name is stored as is, so it must be a string literal.
+	class Scope
+	{
+	public:
+		Scope(GpuProfiler& profiler, vk::CommandBuffer commandBuffer, const char* name);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		GpuProfiler& m_Profiler;
+		vk::CommandBuffer m_CommandBuffer;
+		uint32_t m_Index;
+	};
+
+	GpuProfiler(Device& device, uint32_t framesInFlight);
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler &) = delete;
+	void operator=(const GpuProfiler &) = delete;
+
+	void Initialize();
+	void Terminate();
+
+	// Call once the fence of frameIndex has signaled and its command buffer has begun,
+	// outside of any render pass. Collects that frame's previous results, resets its
+	// queries and opens the "Frame" scope closed by EndFrame.
+	void BeginFrame(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+	// Call outside of any render pass, right before the command buffer ends
+	void EndFrame(vk::CommandBuffer commandBuffer);
+
+	bool IsSupported() const { return m_Supported; }
+	// Timings of the most recently completed frame, in recording order
+	const std::vector<GpuTiming>& GetResults() const { return m_Results; }
+	// Milliseconds of the first scope with the given name, or 0 if it was not recorded
+	double GetTiming(const char* name) const;
+
+private:
+	struct ScopeRecord
+	{
+		const char* Name;
+		uint32_t Depth;
+		uint32_t BeginQuery;
+		uint32_t EndQuery;
+	};
+
+	struct FrameQueries
+	{
+		vk::QueryPool Pool;
+		std::vector<ScopeRecord> Scopes;
+		uint32_t QueryCount = 0;
+	};
+
+	uint32_t BeginScope(vk::CommandBuffer commandBuffer, const char* name);
+	void EndScope(vk::CommandBuffer commandBuffer, uint32_t index);
+	void CollectResults(FrameQueries& frame);
+
+	Device& m_Device;
+	bool m_Supported = false;
+	double m_TimestampPeriod = 1.0;		// nanoseconds per tick
+	uint64_t m_TimestampMask = ~0ull;
+
+	std::vector<FrameQueries> m_Frames;
+	FrameQueries* m_Current = nullptr;
+	uint32_t m_FrameScope = UINT32_MAX;
+	uint32_t m_Depth = 0;
+
+	std::vector<uint64_t> m_Timestamps;
+	std::vector<GpuTiming> m_Results;
+};
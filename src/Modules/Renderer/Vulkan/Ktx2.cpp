@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include "Ktx2.h"
+#include "../../../Core/Profiler.h"
+
+namespace
+{
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	struct Ktx2Header
+	{
+		uint8_t Identifier[12];
+		uint32_t VkFormat;
+		uint32_t TypeSize;
+		uint32_t PixelWidth;
+		uint32_t PixelHeight;
+		uint32_t PixelDepth;
+		uint32_t LayerCount;
+		uint32_t FaceCount;
+		uint32_t LevelCount;
+		uint32_t SupercompressionScheme;
+		uint32_t DfdByteOffset;
+		uint32_t DfdByteLength;
+		uint32_t KvdByteOffset;
+		uint32_t KvdByteLength;
+		uint64_t SgdByteOffset;
+		uint64_t SgdByteLength;
+	};
+	static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must match the file layout");
+
+	struct Ktx2LevelIndex
+	{
+		uint64_t ByteOffset;
+		uint64_t ByteLength;
+		uint64_t UncompressedByteLength;
+	};
+
+	// Khronos data format descriptor values used by the formats we write
+	const uint32_t KHR_DF_MODEL_RGBSDA = 1;
+	const uint32_t KHR_DF_MODEL_BC1A = 128;
+	const uint32_t KHR_DF_MODEL_BC3 = 130;
+	const uint32_t KHR_DF_MODEL_BC4 = 131;
+	const uint32_t KHR_DF_MODEL_BC5 = 132;
+	const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+	const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+	const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+	const uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+	const uint32_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+
+	struct DfdSample
+	{
+		uint32_t BitOffset;
+		uint32_t BitLength;
+		uint32_t Channel;
+		uint32_t Upper;
+	};
+
+	bool IsSrgb(vk::Format format)
+	{
+		return format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eBc1RgbSrgbBlock || format == vk::Format::eBc3SrgbBlock;
+	}
+
+	// Basic descriptor block, see the Khronos Data Format Specification
+	std::vector<uint32_t> BuildDataFormatDescriptor(vk::Format format)
+	{
+		uint32_t model;
+		std::vector<DfdSample> samples;
+		switch (format)
+		{
+		case vk::Format::eR8G8B8A8Unorm:
+		case vk::Format::eR8G8B8A8Srgb:
+			model = KHR_DF_MODEL_RGBSDA;
+			samples = { { 0, 8, 0, 255 }, { 8, 8, 1, 255 }, { 16, 8, 2, 255 }, { 24, 8, KHR_DF_CHANNEL_ALPHA, 255 } };
+			break;
+		case vk::Format::eBc1RgbUnormBlock:
+		case vk::Format::eBc1RgbSrgbBlock:
+			model = KHR_DF_MODEL_BC1A;
+			samples = { { 0, 64, 0, UINT32_MAX } };
+			break;
+		case vk::Format::eBc3UnormBlock:
+		case vk::Format::eBc3SrgbBlock:
+			model = KHR_DF_MODEL_BC3;
+			samples = { { 0, 64, KHR_DF_CHANNEL_ALPHA, UINT32_MAX }, { 64, 64, 0, UINT32_MAX } };
+			break;
+		case vk::Format::eBc4UnormBlock:
+			model = KHR_DF_MODEL_BC4;
+			samples = { { 0, 64, 0, UINT32_MAX } };
+			break;
+		case vk::Format::eBc5UnormBlock:
+			model = KHR_DF_MODEL_BC5;
+			samples = { { 0, 64, 0, UINT32_MAX }, { 64, 64, 1, UINT32_MAX } };
+			break;
+		default:
+			throw std::runtime_error("KTX2 writing is not supported for " + vk::to_string(format));
+		}
+
+		bool srgb = IsSrgb(format);
+		uint32_t blockDimension = Ktx2::IsBlockCompressed(format) ? 3 : 0;	// stored as size - 1
+		uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+		std::vector<uint32_t> words;
+		words.push_back(4 + blockSize);	// dfdTotalSize
+		words.push_back(0);	// vendor Khronos, basic descriptor type
+		words.push_back(2 | (blockSize << 16));	// version 1.3
+		words.push_back(model | (KHR_DF_PRIMARIES_BT709 << 8) | ((srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+		words.push_back(blockDimension | (blockDimension << 8));
+		words.push_back(Ktx2::GetBlockBytes(format));	// bytesPlane0
+		words.push_back(0);
+		for (const DfdSample& sample : samples)
+		{
+			uint32_t channelType = sample.Channel;
+			if (srgb && sample.Channel == KHR_DF_CHANNEL_ALPHA)
+				channelType |= KHR_DF_SAMPLE_DATATYPE_LINEAR;
+			words.push_back(sample.BitOffset | ((sample.BitLength - 1) << 16) | (channelType << 24));
+			words.push_back(0);	// sample position
+			words.push_back(0);	// lower
+			words.push_back(sample.Upper);
+		}
+		return words;
+	}
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+uint32_t Ktx2::GetBlockBytes(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eR8G8B8A8Unorm:
+	case vk::Format::eR8G8B8A8Srgb:
+		return 4;
+	case vk::Format::eBc1RgbUnormBlock:
+	case vk::Format::eBc1RgbSrgbBlock:
+	case vk::Format::eBc4UnormBlock:
+		return 8;
+	case vk::Format::eBc3UnormBlock:
+	case vk::Format::eBc3SrgbBlock:
+	case vk::Format::eBc5UnormBlock:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+bool Ktx2::IsBlockCompressed(vk::Format format)
+{
+	return format != vk::Format::eR8G8B8A8Unorm && format != vk::Format::eR8G8B8A8Srgb;
+}
+
+Ktx2Image Ktx2::Read(const std::string& filename)
+{
+	PROFILE_SCOPE("Ktx2::Read");
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("Failed to open " + filename);
+
+	std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+	return Read(std::move(data), filename);
+}
+
+bool Ktx2::IsKtx2(const uint8_t* data, size_t size)
+{
+	return size >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+Ktx2Image Ktx2::Read(std::vector<uint8_t> data, const std::string& filename)
+{
+	Ktx2Image image;
+	image.Data = std::move(data);
+
+	Ktx2Header header;
+	if (image.Data.size() < sizeof(header) || !IsKtx2(image.Data.data(), image.Data.size()))
+		throw std::runtime_error(filename + " is not a KTX2 file");
+	memcpy(&header, image.Data.data(), sizeof(header));
+
+	if (header.SupercompressionScheme != 0)
+		throw std::runtime_error(filename + " uses supercompression, which is not supported");
+	if (header.VkFormat == VK_FORMAT_UNDEFINED)
+		throw std::runtime_error(filename + " has no Vulkan format (Basis Universal is not supported)");
+	if (header.PixelHeight == 0 || header.PixelDepth > 1 || header.LayerCount > 1 || header.FaceCount != 1)
+		throw std::runtime_error(filename + " is not a single 2D image");
+
+	image.Format = static_cast<vk::Format>(header.VkFormat);
+	image.Width = header.PixelWidth;
+	image.Height = header.PixelHeight;
+
+	// a level count of 0 asks the loader to generate mips, we just use the base level
+	uint32_t levelCount = std::max(header.LevelCount, 1u);
+	size_t indexEnd = sizeof(header) + levelCount * sizeof(Ktx2LevelIndex);
+	if (image.Data.size() < indexEnd)
+		throw std::runtime_error(filename + " is truncated");
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		Ktx2LevelIndex index;
+		memcpy(&index, image.Data.data() + sizeof(header) + level * sizeof(Ktx2LevelIndex), sizeof(index));
+		if (index.ByteLength == 0 || index.ByteOffset + index.ByteLength > image.Data.size())
+			throw std::runtime_error(filename + " has an invalid level index");
+		image.Levels.push_back({ index.ByteOffset, index.ByteLength });
+	}
+
+	return image;
+}
+
+void Ktx2::Write(const std::string& filename, vk::Format format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels)
+{
+	std::vector<uint32_t> dfd = BuildDataFormatDescriptor(format);
+	uint32_t levelCount = static_cast<uint32_t>(levels.size());
+
+	Ktx2Header header{};
+	memcpy(header.Identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.VkFormat = static_cast<uint32_t>(format);
+	header.TypeSize = 1;
+	header.PixelWidth = width;
+	header.PixelHeight = height;
+	header.FaceCount = 1;
+	header.LevelCount = levelCount;
+	header.DfdByteOffset = static_cast<uint32_t>(sizeof(header) + levelCount * sizeof(Ktx2LevelIndex));
+	header.DfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+	// level data is stored smallest first, each level aligned to lcm(block size, 4)
+	uint64_t alignment = std::max<uint64_t>(GetBlockBytes(format), 4);
+	std::vector<Ktx2LevelIndex> index(levelCount);
+	uint64_t offset = header.DfdByteOffset + header.DfdByteLength;
+	for (uint32_t level = levelCount; level-- > 0;)
+	{
+		offset = AlignUp(offset, alignment);
+		index[level] = { offset, levels[level].size(), levels[level].size() };
+		offset += levels[level].size();
+	}
+
+	std::vector<uint8_t> data(static_cast<size_t>(offset), 0);
+	memcpy(data.data(), &header, sizeof(header));
+	memcpy(data.data() + sizeof(header), index.data(), index.size() * sizeof(Ktx2LevelIndex));
+	memcpy(data.data() + header.DfdByteOffset, dfd.data(), header.DfdByteLength);
+	for (uint32_t level = 0; level < levelCount; level++)
+		memcpy(data.data() + index[level].ByteOffset, levels[level].data(), levels[level].size());
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("Failed to create " + filename);
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One mip level inside Ktx2Image::Data
+struct Ktx2Level
+{
+	uint64_t Offset;
+	uint64_t Size;
+};
+
+// GPU ready texture payload from a KTX 2.0 container. Only 2D images without
+// supercompression are handled, Basis Universal and Zstd files are rejected.
+struct Ktx2Image
+{
+	vk::Format Format = vk::Format::eUndefined;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	std::vector<Ktx2Level> Levels;	// largest first
+	std::vector<uint8_t> Data;
+};
+
+namespace Ktx2
+{
+	// Throws std::runtime_error for malformed or unsupported files
+	Ktx2Image Read(const std::string& filename);
+	// Same for a file already in memory, filename only appears in errors
+	Ktx2Image Read(std::vector<uint8_t> data, const std::string& filename);
+	// Whether data starts with the KTX 2.0 identifier
+	bool IsKtx2(const uint8_t* data, size_t size);
+
+	// Writes levels (largest first) of one of the formats GetBlockBytes knows
+	void Write(const std::string& filename, vk::Format format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels);
+
+	// Bytes per 4x4 block, or per texel for uncompressed formats; 0 if the format cannot be written
+	uint32_t GetBlockBytes(vk::Format format);
+	bool IsBlockCompressed(vk::Format format);
+}
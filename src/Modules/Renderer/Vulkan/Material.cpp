@@ -1,5 +1,6 @@
 #include <imgui.h>
 #include "Material.h"
+#include "../../../Core/Profiler.h"
 
 Material::Material(Device &device)
     : m_Device(device)
@@ -8,44 +9,48 @@ Material::Material(Device &device)
 
 void Material::Destroy()
 {
-    BaseTexture->Destroy();
+    // the TextureStreamer destroys the image with its last user
     BaseTexture.reset();
 }
 
 void Material::Create(MaterialData& parameters)
 {
-    BaseTexture = std::make_unique<Texture>(m_Device);
-    if (parameters.TexturePath != "")
-        BaseTexture->LoadFromFile(ASSETS_PATH + parameters.TexturePath);
-    else
-    {
-        const unsigned char pixels[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFD, 0xFD, 0xFD, 0xFD, 'V', '3', 0x12, 0x0F };
-        BaseTexture->LoadFromBuffer({ (void*)pixels }, 1, 1);
-    }
+	PROFILE_SCOPE("Material::Create");
+    // BaseTexture stays empty until the renderer's TextureStreamer delivers it,
+    // meanwhile and for untextured or atlas packed textures TextureRegion is sampled
 
-    vk::DeviceSize bufferSize = sizeof(MaterialParameters);
+    vk::DeviceSize bufferSize = sizeof(GPUMaterial);
     MaterialUniformBuffer = std::make_unique<Buffer>(
 			m_Device,
 			bufferSize,
 			1,
 			vk::BufferUsageFlagBits::eUniformBuffer,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::Uniform
 		);
 	MaterialUniformBuffer->Map();
     m_Type = parameters.Type;
 }
 
-void Material::UpdateMaterial(MaterialData& parameters)
+void Material::UpdateMaterial(const MaterialParameters& parameters, MaterialType type)
 {
     // update type
-    if (m_Type != parameters.Type)
-        m_Type = parameters.Type;
+    if (m_Type != type)
+        m_Type = type;
 
     // update ubo
-    MaterialParameters ubo{};
-    ubo.DiffuseColor = parameters.Parameters.DiffuseColor;
-    ubo.SpecularColor = parameters.Parameters.SpecularColor;
-    ubo.AmbientColor = parameters.Parameters.AmbientColor;
+    GPUMaterial ubo{};
+    ubo.Parameters = parameters;
+    if (BaseTexture)
+    {
+        ubo.AtlasTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+        ubo.TextureLayer = glm::vec4(0.0f);
+    }
+    else
+    {
+        ubo.AtlasTransform = TextureRegion.Transform;
+        ubo.TextureLayer = glm::vec4(static_cast<float>(TextureRegion.Layer), 1.0f, 0.0f, 0.0f);
+    }
 	MaterialUniformBuffer->WriteToBuffer(&ubo);
 }
 
@@ -67,6 +72,7 @@ void MaterialData::OnGUI()
         case MaterialType::Basic:
             ImGui::Text("Type: Basic");
             ImGui::ColorEdit3("Color", &Parameters.DiffuseColor.x);
+            ImGui::DragFloat4("UV Transform", &Parameters.UVTransform.x, 0.01f);
             ImGui::Text(TexturePath.c_str());
             break;
         case MaterialType::Wireframe:
@@ -79,6 +85,7 @@ void MaterialData::OnGUI()
             ImGui::ColorEdit3("Specular Color", &Parameters.SpecularColor.x);
             ImGui::ColorEdit3("Ambient Color", &Parameters.AmbientColor.x);
             ImGui::DragFloat("Shininess", &Parameters.SpecularColor.w, 0.1f, 0.0f, 512.0f);
+            ImGui::DragFloat4("UV Transform", &Parameters.UVTransform.x, 0.01f);
             break;
     }
 
@@ -8,6 +8,7 @@
 #include "Descriptor.h"
 #include "Device.h"
 #include "Texture.h"
+#include "TextureAtlas.h"
 
 const char* const ASSETS_PATH = "resources/assets/";
 
@@ -15,6 +16,14 @@ struct MaterialParameters {
 	glm::vec4 DiffuseColor = glm::vec4(1.0f);
 	glm::vec4 SpecularColor = glm::vec4(1.0f, 1.0f, 1.0f, 32.0f); // w = shininess
 	glm::vec4 AmbientColor = glm::vec4(1.0f);
+	glm::vec4 UVTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f); // xy = scale, zw = offset, before any atlas remap
+};
+
+// Material uniform buffer, the parameters followed by where the texture sits in its image
+struct GPUMaterial {
+	MaterialParameters Parameters;
+	glm::vec4 AtlasTransform;	// xy = scale, zw = offset of the atlas region
+	glm::vec4 TextureLayer;		// x = array layer, y = 1 when UVs wrap inside the region
 };
 
 enum MaterialType {
@@ -37,6 +46,8 @@ struct EnumClassHash
 struct MaterialData {
 	MaterialParameters Parameters;
 	std::string TexturePath = "";
+	// Encoded image embedded in the scene file, TexturePath then only names it
+	std::shared_ptr<const std::vector<uint8_t>> EmbeddedTexture;
 	MaterialType Type = MaterialType::Default;
 
 	void OnGUI();
@@ -52,11 +63,13 @@ public:
 
 private:
     void Create(MaterialData& parameters);
-	void UpdateMaterial(MaterialData& parameters);
+	void UpdateMaterial(const MaterialParameters& parameters, MaterialType type);
 
     Device& m_Device;
 	std::unique_ptr<Buffer> MaterialUniformBuffer;
-	std::unique_ptr<Texture> BaseTexture;
+	std::shared_ptr<Texture> BaseTexture;	// null while loading or without TexturePath, shared by materials of one file
+	uint32_t TextureStreamId = UINT32_MAX;	// TextureStreamer id of BaseTexture
+	AtlasRegion TextureRegion;	// used while BaseTexture is null, the white region or a packed texture
 	vk::DescriptorSet DescriptorSet;
 	MaterialType m_Type;
 
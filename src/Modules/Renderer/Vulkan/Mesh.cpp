@@ -1,4 +1,13 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include "Mesh.h"
+#include "MeshFile.h"
+#include "MeshletBuilder.h"
+#include "ProceduralMesh.h"
+#include "../../../Core/Profiler.h"
 
 vk::VertexInputBindingDescription Vertex::GetBindingDescription()
 {
@@ -33,6 +42,115 @@ std::vector<vk::VertexInputAttributeDescription> Vertex::GetAttributeDescription
 	return attributeDescriptions;
 }
 
+namespace
+{
+	// Flat axes still need a scale to divide by, their positions all quantize to 0
+	glm::vec3 GetQuantizeExtent(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 extent = boundsMax - boundsMin;
+		for (int axis = 0; axis < 3; axis++)
+			if (extent[axis] <= 0.0f)
+				extent[axis] = 1.0f;
+		return extent;
+	}
+
+	glm::vec2 EncodeOctahedral(glm::vec3 normal)
+	{
+		float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+		if (sum == 0.0f)
+			return glm::vec2(0.0f);
+		normal /= sum;
+		glm::vec2 encoded(normal.x, normal.y);
+		if (normal.z < 0.0f)
+		{
+			// fold the lower hemisphere over the diagonals
+			encoded.x = (1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+			encoded.y = (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		return encoded;
+	}
+
+	// Storage buffers hold whole 32-bit words, meshlet triangles are bytes
+	vk::DeviceSize AlignToWord(vk::DeviceSize size)
+	{
+		return (size + 3) / 4 * 4;
+	}
+
+	// Same decode as the packed vertex shaders
+	glm::vec3 DecodeOctahedral(const glm::vec2& encoded)
+	{
+		glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+		float fold = std::max(-normal.z, 0.0f);
+		normal.x += normal.x >= 0.0f ? -fold : fold;
+		normal.y += normal.y >= 0.0f ? -fold : fold;
+		return glm::normalize(normal);
+	}
+}
+
+vk::VertexInputBindingDescription PackedVertex::GetBindingDescription()
+{
+	return vk::VertexInputBindingDescription(
+		0,								// binding
+		sizeof(PackedVertex),			// stride
+		vk::VertexInputRate::eVertex	// inputRate
+	);
+}
+
+std::vector<vk::VertexInputAttributeDescription> PackedVertex::GetAttributeDescriptions()
+{
+	std::vector<vk::VertexInputAttributeDescription> attributeDescriptions{};
+	attributeDescriptions.push_back(vk::VertexInputAttributeDescription(
+		0,									// location
+		0,									// binding
+		vk::Format::eR16G16B16A16Unorm,		// format
+		offsetof(PackedVertex, Position)	// offset
+	));
+	attributeDescriptions.push_back(vk::VertexInputAttributeDescription(
+		1,									// location
+		0,									// binding
+		vk::Format::eR16G16Sfloat,			// format
+		offsetof(PackedVertex, TexCoord)	// offset
+	));
+	attributeDescriptions.push_back(vk::VertexInputAttributeDescription(
+		2,									// location
+		0,									// binding
+		vk::Format::eR16G16Snorm,			// format
+		offsetof(PackedVertex, Normal)		// offset
+	));
+	return attributeDescriptions;
+}
+
+PackedVertex PackedVertex::Pack(const Vertex& vertex, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	PackedVertex packed{};
+	glm::vec3 position = glm::clamp((vertex.Position - boundsMin) / GetQuantizeExtent(boundsMin, boundsMax), 0.0f, 1.0f);
+	for (int axis = 0; axis < 3; axis++)
+		packed.Position[axis] = static_cast<uint16_t>(std::lround(position[axis] * 65535.0f));
+
+	glm::vec2 normal = glm::clamp(EncodeOctahedral(vertex.Normal), -1.0f, 1.0f);
+	packed.Normal[0] = static_cast<int16_t>(std::lround(normal.x * 32767.0f));
+	packed.Normal[1] = static_cast<int16_t>(std::lround(normal.y * 32767.0f));
+
+	packed.TexCoord[0] = glm::packHalf1x16(vertex.TexCoord.x);
+	packed.TexCoord[1] = glm::packHalf1x16(vertex.TexCoord.y);
+	return packed;
+}
+
+Vertex PackedVertex::Unpack(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	Vertex vertex{};
+	glm::vec3 position(Position[0], Position[1], Position[2]);
+	vertex.Position = boundsMin + position / 65535.0f * GetQuantizeExtent(boundsMin, boundsMax);
+	vertex.Normal = DecodeOctahedral(glm::max(glm::vec2(Normal[0], Normal[1]) / 32767.0f, -1.0f));
+	vertex.TexCoord = glm::vec2(glm::unpackHalf1x16(TexCoord[0]), glm::unpackHalf1x16(TexCoord[1]));
+	return vertex;
+}
+
+glm::mat4 PackedVertex::GetDequantizeMatrix(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	return glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), GetQuantizeExtent(boundsMin, boundsMax));
+}
+
 MeshData MeshData::Triangle()
 {
 	MeshData triangle = {};
@@ -142,64 +260,118 @@ MeshData MeshData::Pyramid()
 
 MeshData MeshData::Sphere(uint32_t definition)
 {
-    MeshData sphere = {};
-
-    // Generate vertices
-    for (uint32_t i = 0; i <= definition; ++i)
-    {
-        float v = static_cast<float>(i) / definition;
-        float phi = v * 3.141592f;
-
-        for (uint32_t j = 0; j <= definition; ++j)
-        {
-            float u = static_cast<float>(j) / definition;
-            float theta = u * 2 * 3.141592f;
-
-            float x = std::cos(theta) * std::sin(phi);
-            float y = std::cos(phi);
-            float z = std::sin(theta) * std::sin(phi);
-
-			glm::vec3 position = {x, y, z};
-			glm::vec3 normal =  glm::normalize(position);
-
-
-            sphere.Vertices.push_back({position, {static_cast<float>(definition - j) / definition, v}, normal});
-        }
-    }
-
-    // Generate indices
-	for (uint32_t i = 0; i < definition; ++i)
-		for (uint32_t j = 0; j < definition; ++j)
-		{
-			uint32_t k1 = i * (definition + 1) + j;
-			uint32_t k2 = k1 + definition + 1;
-
-			sphere.Indices.push_back(k1);
-			sphere.Indices.push_back(k1 + 1);
-			sphere.Indices.push_back(k2);
+	return ProceduralMesh::Generate(ProceduralMeshDesc::Sphere(definition, definition));
+}
 
-			sphere.Indices.push_back(k2);
-			sphere.Indices.push_back(k1 + 1);
-			sphere.Indices.push_back(k2 + 1);
-		}
+void MeshData::ComputeMissingNormals()
+{
+	std::vector<glm::vec3> accumulated(Vertices.size(), glm::vec3(0.0f));
+	for (size_t i = 0; i + 2 < Indices.size(); i += 3)
+	{
+		const glm::vec3& a = Vertices[Indices[i]].Position;
+		glm::vec3 normal = glm::cross(Vertices[Indices[i + 1]].Position - a, Vertices[Indices[i + 2]].Position - a);
+		for (size_t corner = 0; corner < 3; corner++)
+			accumulated[Indices[i + corner]] += normal;
+	}
+	for (size_t i = 0; i < Vertices.size(); i++)
+		if (Vertices[i].Normal == glm::vec3(0.0f) && glm::length(accumulated[i]) > 0.0f)
+			Vertices[i].Normal = glm::normalize(accumulated[i]);
+}
 
-    return sphere;
+uint32_t MeshData::GetIndexSize() const
+{
+	for (uint32_t index : Indices)
+		if (index > UINT16_MAX)
+			return 4;
+	return 2;
 }
 
 Mesh::Mesh(Device &device): m_Device(device)
 {
 }
 
-void Mesh::Create(std::vector<Vertex> vertices, std::vector<uint16_t> indices)
+void Mesh::Create(std::vector<Vertex> vertices, std::vector<uint32_t> indices, VertexFormat format, std::vector<MeshLod> lods, const MeshletData& meshlets)
 {
-	CreateVertexBuffer(vertices);
+	PROFILE_SCOPE("Mesh::Create");
+	ComputeBounds(vertices);
+	m_VertexFormat = format;
+	if (format == VertexFormat::Packed)
+	{
+		std::vector<PackedVertex> packed(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+			packed[i] = PackedVertex::Pack(vertices[i], m_BoundsMin, m_BoundsMax);
+		m_DequantizeMatrix = PackedVertex::GetDequantizeMatrix(m_BoundsMin, m_BoundsMax);
+		CreateVertexBuffer(packed.data(), sizeof(PackedVertex) * packed.size(), static_cast<uint32_t>(packed.size()));
+	}
+	else
+		CreateVertexBuffer(vertices.data(), sizeof(Vertex) * vertices.size(), static_cast<uint32_t>(vertices.size()));
 	CreateIndexBuffer(indices);
+	m_Lods = lods.empty() ? std::vector<MeshLod>{ MeshLod{ 0, m_IndexCount, 0.0f } } : std::move(lods);
+	if (!meshlets.IsEmpty())
+		CreateMeshletBuffers(meshlets);
+}
+
+void Mesh::Create(const MeshFileView& file, StagingRing& staging)
+{
+	PROFILE_SCOPE("Mesh::CreateFromFile");
+	const MeshFileHeader& header = *file.Header;
+	m_BoundsCenter = glm::vec3(header.BoundsCenter[0], header.BoundsCenter[1], header.BoundsCenter[2]);
+	m_BoundsRadius = header.BoundsRadius;
+	m_BoundsMin = glm::vec3(header.BoundsMin[0], header.BoundsMin[1], header.BoundsMin[2]);
+	m_BoundsMax = glm::vec3(header.BoundsMax[0], header.BoundsMax[1], header.BoundsMax[2]);
+
+	if (file.HasPackedVertexLayout())
+	{
+		// packed against the bounds stored in the header
+		m_VertexFormat = VertexFormat::Packed;
+		m_DequantizeMatrix = PackedVertex::GetDequantizeMatrix(m_BoundsMin, m_BoundsMax);
+	}
+	else if (!file.HasVertexLayout())
+		throw std::runtime_error("Mesh file vertex layout matches neither Vertex nor PackedVertex");
+
+	m_VertexCount = header.VertexCount;
+	m_VertexBuffer = new Buffer(
+		m_Device,
+		file.GetVertexBytes(),
+		1,
+		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Geometry
+	);
+	staging.Upload(file.Vertices, file.GetVertexBytes(), m_VertexBuffer->GetBuffer());
+
+	m_Lods.resize(header.LodCount);
+	for (uint32_t i = 0; i < header.LodCount; i++)
+	{
+		const MeshFileLod& lod = file.Lods[i];
+		if (static_cast<uint64_t>(lod.FirstIndex) + lod.IndexCount > header.IndexCount)
+			throw std::runtime_error("Mesh file LOD " + std::to_string(i) + " reaches past the index buffer");
+		m_Lods[i] = { lod.FirstIndex, lod.IndexCount, lod.Error };
+	}
+
+	if (header.IndexCount == 0)
+		return;
+
+	m_IndexCount = header.IndexCount;
+	m_IndexType = header.IndexSize == 4 ? vk::IndexType::eUint32 : vk::IndexType::eUint16;
+	m_IndexBuffer = new Buffer(
+		m_Device,
+		file.GetIndexBytes(),
+		1,
+		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Geometry
+	);
+	staging.Upload(file.Indices, file.GetIndexBytes(), m_IndexBuffer->GetBuffer());
+	if (file.HasMeshlets())
+		CreateMeshletBuffers(file, staging);
 }
 
 void Mesh::Destroy()
 {
 	DestroyVertexBuffer();
 	DestroyIndexBuffer();
+	DestroyMeshletBuffers();
 }
 
 void Mesh::Bind(vk::CommandBuffer commandBuffer)
@@ -209,30 +381,52 @@ void Mesh::Bind(vk::CommandBuffer commandBuffer)
 	commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
 
 	if (m_IndexCount > 0)
-		commandBuffer.bindIndexBuffer(m_IndexBuffer->GetBuffer(), 0, vk::IndexType::eUint16);
+		commandBuffer.bindIndexBuffer(m_IndexBuffer->GetBuffer(), 0, m_IndexType);
+}
+
+void Mesh::ComputeBounds(const std::vector<Vertex>& vertices)
+{
+	if (vertices.empty())
+		return;
+
+	// sphere around the bounding box center, not minimal but cheap and stable
+	m_BoundsMin = vertices[0].Position;
+	m_BoundsMax = vertices[0].Position;
+	for (const Vertex& vertex : vertices)
+	{
+		m_BoundsMin = glm::min(m_BoundsMin, vertex.Position);
+		m_BoundsMax = glm::max(m_BoundsMax, vertex.Position);
+	}
+
+	m_BoundsCenter = (m_BoundsMin + m_BoundsMax) * 0.5f;
+	m_BoundsRadius = 0.0f;
+	for (const Vertex& vertex : vertices)
+		m_BoundsRadius = std::max(m_BoundsRadius, glm::length(vertex.Position - m_BoundsCenter));
 }
 
-void Mesh::CreateVertexBuffer(const std::vector<Vertex> &vertices)
+void Mesh::CreateVertexBuffer(const void* vertices, vk::DeviceSize bufferSize, uint32_t count)
 {
-	vk::DeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-	m_Vertices = vertices;
+	m_VertexCount = count;
 	
 	Buffer stagingBuffer = Buffer(
 		m_Device,
 		bufferSize,
 		1,
 		vk::BufferUsageFlagBits::eTransferSrc,
-		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		MemoryCategory::Staging
 	);
 	stagingBuffer.Map();
-	stagingBuffer.WriteToBuffer((void *)vertices.data());
+	stagingBuffer.WriteToBuffer(const_cast<void*>(vertices));
 
+	// mesh shaders fetch vertices themselves from the same buffer
 	m_VertexBuffer = new Buffer(
 		m_Device,
 		bufferSize,
 		1,
-		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
-		vk::MemoryPropertyFlagBits::eDeviceLocal
+		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Geometry
 	);
 
 	m_Device.CopyBuffer(stagingBuffer.GetBuffer(), m_VertexBuffer->GetBuffer(), bufferSize);
@@ -241,34 +435,48 @@ void Mesh::CreateVertexBuffer(const std::vector<Vertex> &vertices)
 void Mesh::DestroyVertexBuffer()
 {
 	delete m_VertexBuffer;
+	m_VertexBuffer = nullptr;
 }
 
-void Mesh::CreateIndexBuffer(const std::vector<uint16_t> &indices)
+void Mesh::CreateIndexBuffer(const std::vector<uint32_t> &indices)
 {
 	if (indices.size() <= 0)
 		return;
 
 	m_IndexCount = indices.size();
-	vk::DeviceSize bufferSize = sizeof(indices[0]) * m_IndexCount;
-	m_Indices = indices;
+
+	// 16-bit whenever every index fits, half the bandwidth of 32-bit ones
+	std::vector<uint16_t> narrow;
+	const void* data = indices.data();
+	vk::DeviceSize bufferSize = sizeof(uint32_t) * m_IndexCount;
+	m_IndexType = vk::IndexType::eUint32;
+	if (*std::max_element(indices.begin(), indices.end()) <= UINT16_MAX)
+	{
+		narrow.assign(indices.begin(), indices.end());
+		data = narrow.data();
+		bufferSize = sizeof(uint16_t) * m_IndexCount;
+		m_IndexType = vk::IndexType::eUint16;
+	}
 
 	Buffer stagingBuffer = Buffer(
 		m_Device,
 		bufferSize,
 		1,
 		vk::BufferUsageFlagBits::eTransferSrc,
-		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		MemoryCategory::Staging
 	);
 
 	stagingBuffer.Map();
-	stagingBuffer.WriteToBuffer((void *)indices.data());
+	stagingBuffer.WriteToBuffer(const_cast<void*>(data));
 
 	m_IndexBuffer = new Buffer(
 		m_Device,
 		bufferSize,
 		1,
 		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
-		vk::MemoryPropertyFlagBits::eDeviceLocal
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Geometry
 	);
 
 	m_Device.CopyBuffer(stagingBuffer.GetBuffer(), m_IndexBuffer->GetBuffer(), bufferSize);
@@ -277,4 +485,101 @@ void Mesh::CreateIndexBuffer(const std::vector<uint16_t> &indices)
 void Mesh::DestroyIndexBuffer()
 {
 	delete m_IndexBuffer;
+	m_IndexBuffer = nullptr;
+}
+
+void Mesh::CreateMeshletBuffers(const MeshletData& meshlets)
+{
+	m_MeshletCount = static_cast<uint32_t>(meshlets.Meshlets.size());
+	std::vector<uint8_t> triangles = meshlets.Triangles;
+	triangles.resize(AlignToWord(triangles.size()), 0);
+
+	auto createBuffer = [this](const void* data, vk::DeviceSize bufferSize)
+	{
+		Buffer stagingBuffer = Buffer(
+			m_Device,
+			bufferSize,
+			1,
+			vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::Staging
+		);
+		stagingBuffer.Map();
+		stagingBuffer.WriteToBuffer(const_cast<void*>(data));
+
+		Buffer* buffer = new Buffer(
+			m_Device,
+			bufferSize,
+			1,
+			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			MemoryCategory::Geometry
+		);
+		m_Device.CopyBuffer(stagingBuffer.GetBuffer(), buffer->GetBuffer(), bufferSize);
+		return buffer;
+	};
+
+	m_MeshletBuffer = createBuffer(meshlets.Meshlets.data(), sizeof(Meshlet) * meshlets.Meshlets.size());
+	m_MeshletVertexBuffer = createBuffer(meshlets.Vertices.data(), sizeof(uint32_t) * meshlets.Vertices.size());
+	m_MeshletTriangleBuffer = createBuffer(triangles.data(), triangles.size());
+}
+
+void Mesh::CreateMeshletBuffers(const MeshFileView& file, StagingRing& staging)
+{
+	const MeshFileHeader& header = *file.Header;
+
+	// the task and mesh shaders index these buffers unchecked, so every range
+	// has to stay inside the meshlet data and level 0 before it is uploaded
+	const MeshLod& fullLevel = m_Lods[0];
+	if (header.MeshletVertexCount == 0 || header.MeshletTriangleCount == 0)
+		throw std::runtime_error("Mesh file meshlets have no vertices or triangles");
+	for (uint32_t i = 0; i < header.MeshletCount; i++)
+	{
+		const Meshlet& meshlet = file.Meshlets[i];
+		if (meshlet.VertexCount > MAX_MESHLET_VERTICES || meshlet.TriangleCount > MAX_MESHLET_TRIANGLES ||
+			static_cast<uint64_t>(meshlet.VertexOffset) + meshlet.VertexCount > header.MeshletVertexCount ||
+			static_cast<uint64_t>(meshlet.TriangleOffset) + meshlet.TriangleCount > header.MeshletTriangleCount ||
+			(static_cast<uint64_t>(meshlet.TriangleOffset) + meshlet.TriangleCount) * 3 > fullLevel.IndexCount)
+			throw std::runtime_error("Mesh file meshlet " + std::to_string(i) + " exceeds the meshlet limits or reaches past the meshlet data");
+		for (uint32_t t = 0; t < meshlet.TriangleCount * 3; t++)
+		{
+			if (file.MeshletTriangles[meshlet.TriangleOffset * 3 + t] >= meshlet.VertexCount)
+				throw std::runtime_error("Mesh file meshlet " + std::to_string(i) + " references a vertex it does not have");
+		}
+	}
+	for (uint32_t i = 0; i < header.MeshletVertexCount; i++)
+	{
+		if (file.MeshletVertices[i] >= header.VertexCount)
+			throw std::runtime_error("Mesh file meshlet vertex " + std::to_string(i) + " references a vertex past the vertex buffer");
+	}
+
+	m_MeshletCount = header.MeshletCount;
+	auto createBuffer = [this, &staging](const void* data, vk::DeviceSize size)
+	{
+		Buffer* buffer = new Buffer(
+			m_Device,
+			AlignToWord(size),
+			1,
+			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			MemoryCategory::Geometry
+		);
+		staging.Upload(data, size, buffer->GetBuffer());
+		return buffer;
+	};
+
+	m_MeshletBuffer = createBuffer(file.Meshlets, sizeof(Meshlet) * header.MeshletCount);
+	m_MeshletVertexBuffer = createBuffer(file.MeshletVertices, sizeof(uint32_t) * header.MeshletVertexCount);
+	m_MeshletTriangleBuffer = createBuffer(file.MeshletTriangles, static_cast<vk::DeviceSize>(header.MeshletTriangleCount) * 3);
+}
+
+void Mesh::DestroyMeshletBuffers()
+{
+	delete m_MeshletBuffer;
+	delete m_MeshletVertexBuffer;
+	delete m_MeshletTriangleBuffer;
+	m_MeshletBuffer = nullptr;
+	m_MeshletVertexBuffer = nullptr;
+	m_MeshletTriangleBuffer = nullptr;
+	m_MeshletCount = 0;
 }
@@ -4,6 +4,9 @@
 #include <vector>
 #include "Buffer.h"
 #include "Device.h"
+#include "StagingRing.h"
+
+struct MeshFileView;
 
 struct Vertex
 {
@@ -15,16 +18,86 @@ struct Vertex
 	static std::vector<vk::VertexInputAttributeDescription> GetAttributeDescriptions();
 };
 
+// 16 byte vertex with the same shader locations as Vertex. Positions are
+// 16-bit unorm inside the mesh bounding box and expanded by the model matrix,
+// normals are octahedral 2x16-bit snorm, UVs are half floats.
+struct PackedVertex
+{
+	uint16_t Position[4];		// w unused
+	int16_t Normal[2];
+	uint16_t TexCoord[2];
+
+	static vk::VertexInputBindingDescription GetBindingDescription();
+	static std::vector<vk::VertexInputAttributeDescription> GetAttributeDescriptions();
+
+	// boundsMin and boundsMax must contain the position
+	static PackedVertex Pack(const Vertex& vertex, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	Vertex Unpack(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+	// Maps packed positions back into model space
+	static glm::mat4 GetDequantizeMatrix(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+};
+static_assert(sizeof(PackedVertex) == 16, "Packed vertices must stay 16 bytes");
+
+enum class VertexFormat
+{
+	Full,		// Vertex
+	Packed		// PackedVertex
+};
+
+// Index range drawn for one level of detail, level 0 is the full mesh
+struct MeshLod
+{
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	float Error = 0.0f;			// simplification error in model space units
+};
+
+// Cluster of at most MAX_MESHLET_VERTICES vertices and MAX_MESHLET_TRIANGLES
+// triangles of the full level of detail, laid out for std430 storage buffers.
+// Its triangles are also a contiguous range of the index buffer.
+struct Meshlet
+{
+	glm::vec3 Center;			// bounding sphere in model space
+	float Radius;
+	glm::vec3 ConeApex;			// backfacing when dot(normalize(ConeApex - camera), ConeAxis) >= ConeCutoff
+	float ConeCutoff;			// above 1 when the normals spread too far to cull this way
+	glm::vec3 ConeAxis;
+	uint32_t VertexOffset;		// into MeshletData::Vertices
+	uint32_t TriangleOffset;	// into MeshletData::Triangles and, as triangles, the index buffer
+	uint32_t VertexCount;
+	uint32_t TriangleCount;
+	uint32_t Reserved;
+};
+static_assert(sizeof(Meshlet) == 64, "Meshlets must match the std430 layout of the shaders");
+
+struct MeshletData
+{
+	std::vector<Meshlet> Meshlets;
+	std::vector<uint32_t> Vertices;		// mesh vertex of each meshlet vertex
+	std::vector<uint8_t> Triangles;		// three meshlet vertices per triangle
+
+	bool IsEmpty() const { return Meshlets.empty(); }
+};
+
 struct MeshData
 {
 	std::vector<Vertex> Vertices;
-	std::vector<uint16_t> Indices;
+	std::vector<uint32_t> Indices;
+	VertexFormat Format = VertexFormat::Full;	// layout of the GPU vertex buffer
+	std::vector<MeshLod> Lods;	// empty until generated, the whole index buffer is one level then
+	MeshletData Meshlets;		// empty until built, level 0 is in meshlet order then
 
 	static MeshData Triangle();
 	static MeshData Quad();
 	static MeshData Cube();
 	static MeshData Pyramid();
+	// UV sphere, ProceduralMesh has more shapes and a cache for shared meshes
 	static MeshData Sphere(uint32_t definition = 36);
+
+	// Vertices without a normal get the area weighted average of their faces
+	void ComputeMissingNormals();
+	// Narrowest index width in bytes that holds every index, 2 or 4
+	uint32_t GetIndexSize() const;
 };
 
 class Mesh
@@ -32,7 +105,11 @@ class Mesh
 public:
     Mesh(Device& device);
 
-    void Create(std::vector<Vertex> vertices, std::vector<uint16_t> indices);
+    void Create(std::vector<Vertex> vertices, std::vector<uint32_t> indices, VertexFormat format = VertexFormat::Full, std::vector<MeshLod> lods = {},
+        const MeshletData& meshlets = {});
+    // Copies the blobs of a mapped mesh file straight into staging, nothing is
+    // converted or kept on the CPU. The buffers are ready after staging.Flush().
+    void Create(const MeshFileView& file, StagingRing& staging);
     void Destroy();
     void Bind(vk::CommandBuffer commandBuffer);
 	
@@ -40,19 +117,54 @@ public:
 	vk::Buffer GetIndexBuffer() const { return m_IndexBuffer->GetBuffer(); }
 	bool IsIndexed() const { return m_IndexCount > 0; }
 	uint32_t GetIndexCount() const { return m_IndexCount; }
-	uint32_t GetVertexSize() const { return static_cast<uint32_t>(m_Vertices.size()); }
+	vk::IndexType GetIndexType() const { return m_IndexType; }
+	// At least one level, the last one is the coarsest
+	uint32_t GetLodCount() const { return static_cast<uint32_t>(m_Lods.size()); }
+	const MeshLod& GetLod(uint32_t level) const { return m_Lods[level]; }
+	// Meshlets of level 0 in storage buffers, the vertex buffer doubles as one
+	bool HasMeshlets() const { return m_MeshletCount > 0; }
+	uint32_t GetMeshletCount() const { return m_MeshletCount; }
+	vk::Buffer GetMeshletBuffer() const { return m_MeshletBuffer->GetBuffer(); }
+	vk::Buffer GetMeshletVertexBuffer() const { return m_MeshletVertexBuffer->GetBuffer(); }
+	vk::Buffer GetMeshletTriangleBuffer() const { return m_MeshletTriangleBuffer->GetBuffer(); }
+	// Written by the renderer once the buffers exist
+	vk::DescriptorSet GetMeshletDescriptorSet() const { return m_MeshletDescriptorSet; }
+	void SetMeshletDescriptorSet(vk::DescriptorSet set) { m_MeshletDescriptorSet = set; }
+	uint32_t GetVertexSize() const { return m_VertexCount; }
+	// Bounding sphere in model space
+	glm::vec3 GetBoundsCenter() const { return m_BoundsCenter; }
+	float GetBoundsRadius() const { return m_BoundsRadius; }
+	VertexFormat GetVertexFormat() const { return m_VertexFormat; }
+	// Applied before the model matrix, identity unless the vertices are packed
+	const glm::mat4& GetDequantizeMatrix() const { return m_DequantizeMatrix; }
 
 
 private:
-    void CreateVertexBuffer(const std::vector<Vertex>& vertices);
+    void ComputeBounds(const std::vector<Vertex>& vertices);
+    void CreateVertexBuffer(const void* vertices, vk::DeviceSize bufferSize, uint32_t count);
     void DestroyVertexBuffer();
-    void CreateIndexBuffer(const std::vector<uint16_t>& indices);
+    void CreateIndexBuffer(const std::vector<uint32_t>& indices);
     void DestroyIndexBuffer();
+    void CreateMeshletBuffers(const MeshletData& meshlets);
+    void CreateMeshletBuffers(const MeshFileView& file, StagingRing& staging);
+    void DestroyMeshletBuffers();
 
     Device& m_Device;
-    Buffer* m_VertexBuffer;
-	std::vector<Vertex> m_Vertices;
-    Buffer* m_IndexBuffer;
-	std::vector<uint16_t> m_Indices;
+    Buffer* m_VertexBuffer = nullptr;
+    Buffer* m_IndexBuffer = nullptr;
+    uint32_t m_VertexCount = 0;
     uint32_t m_IndexCount = 0;
+	vk::IndexType m_IndexType = vk::IndexType::eUint16;
+	glm::vec3 m_BoundsCenter = glm::vec3(0.0f);
+	float m_BoundsRadius = 0.0f;
+	glm::vec3 m_BoundsMin = glm::vec3(0.0f);
+	glm::vec3 m_BoundsMax = glm::vec3(0.0f);
+	VertexFormat m_VertexFormat = VertexFormat::Full;
+	glm::mat4 m_DequantizeMatrix = glm::mat4(1.0f);
+	std::vector<MeshLod> m_Lods;
+	Buffer* m_MeshletBuffer = nullptr;
+	Buffer* m_MeshletVertexBuffer = nullptr;
+	Buffer* m_MeshletTriangleBuffer = nullptr;
+	uint32_t m_MeshletCount = 0;
+	vk::DescriptorSet m_MeshletDescriptorSet;
 };
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "MeshFile.h"
+#include "MeshletBuilder.h"
+#include "../../../Core/Profiler.h"
+
+namespace
+{
+	const char MESH_FILE_MAGIC[4] = { 'V', 'S', 'M', 'S' };
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// A table or blob of count elements of elementSize bytes at offset, inside size
+	bool IsRangeValid(uint64_t offset, uint64_t count, uint64_t elementSize, size_t size)
+	{
+		if (offset % MESH_FILE_ALIGNMENT != 0 || offset > size)
+			return false;
+		return elementSize == 0 || count <= (size - offset) / elementSize;
+	}
+
+	bool MatchesLayout(const MeshFileView& view, uint32_t stride, const std::vector<vk::VertexInputAttributeDescription>& expected)
+	{
+		if (view.Header->VertexStride != stride || view.Header->AttributeCount != expected.size())
+			return false;
+
+		for (uint32_t i = 0; i < view.Header->AttributeCount; i++)
+			if (view.Attributes[i].Location != expected[i].location || view.Attributes[i].Format != static_cast<uint32_t>(expected[i].format) || view.Attributes[i].Offset != expected[i].offset)
+				return false;
+		return true;
+	}
+
+	uint32_t ReadIndex(const MeshFileView& view, uint32_t i)
+	{
+		if (view.Header->IndexSize == 2)
+		{
+			uint16_t index;
+			memcpy(&index, view.Indices + static_cast<size_t>(i) * 2, 2);
+			return index;
+		}
+		uint32_t index;
+		memcpy(&index, view.Indices + static_cast<size_t>(i) * 4, 4);
+		return index;
+	}
+}
+
+bool MeshFileView::HasVertexLayout() const
+{
+	return MatchesLayout(*this, sizeof(Vertex), Vertex::GetAttributeDescriptions());
+}
+
+bool MeshFileView::HasPackedVertexLayout() const
+{
+	return MatchesLayout(*this, sizeof(PackedVertex), PackedVertex::GetAttributeDescriptions());
+}
+
+MeshFileView MeshFile::Parse(const uint8_t* data, size_t size)
+{
+	if (size < sizeof(MeshFileHeader))
+		throw std::runtime_error("Mesh file is smaller than its header");
+
+	MeshFileView view;
+	view.Header = reinterpret_cast<const MeshFileHeader*>(data);
+	const MeshFileHeader& header = *view.Header;
+	if (memcmp(header.Magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC)) != 0)
+		throw std::runtime_error("Not a mesh file");
+	if (header.Version != MESH_FILE_VERSION)
+		throw std::runtime_error("Unsupported mesh file version " + std::to_string(header.Version));
+	if (header.IndexSize != 2 && header.IndexSize != 4)
+		throw std::runtime_error("Unsupported mesh index size " + std::to_string(header.IndexSize));
+	if (header.VertexStride == 0 || header.AttributeCount == 0 || header.LodCount == 0)
+		throw std::runtime_error("Mesh file without vertex layout or LODs");
+	if (header.VertexCount == 0)
+		throw std::runtime_error("Mesh file without vertices");
+
+	if (!IsRangeValid(header.AttributesOffset, header.AttributeCount, sizeof(MeshFileAttribute), size) ||
+		!IsRangeValid(header.LodsOffset, header.LodCount, sizeof(MeshFileLod), size) ||
+		!IsRangeValid(header.VerticesOffset, header.VertexCount, header.VertexStride, size) ||
+		!IsRangeValid(header.IndicesOffset, header.IndexCount, header.IndexSize, size))
+		throw std::runtime_error("Mesh file is truncated or has misaligned sections");
+	if (header.MeshletCount > 0 && (
+		!IsRangeValid(header.MeshletsOffset, header.MeshletCount, sizeof(Meshlet), size) ||
+		!IsRangeValid(header.MeshletVerticesOffset, header.MeshletVertexCount, sizeof(uint32_t), size) ||
+		!IsRangeValid(header.MeshletTrianglesOffset, header.MeshletTriangleCount, 3, size)))
+		throw std::runtime_error("Mesh file meshlets are truncated or misaligned");
+
+	view.Attributes = reinterpret_cast<const MeshFileAttribute*>(data + header.AttributesOffset);
+	view.Lods = reinterpret_cast<const MeshFileLod*>(data + header.LodsOffset);
+	view.Vertices = data + header.VerticesOffset;
+	view.Indices = data + header.IndicesOffset;
+	if (header.MeshletCount > 0)
+	{
+		view.Meshlets = reinterpret_cast<const Meshlet*>(data + header.MeshletsOffset);
+		view.MeshletVertices = reinterpret_cast<const uint32_t*>(data + header.MeshletVerticesOffset);
+		view.MeshletTriangles = data + header.MeshletTrianglesOffset;
+	}
+	return view;
+}
+
+std::vector<std::string> MeshFile::Validate(const uint8_t* data, size_t size)
+{
+	PROFILE_SCOPE("MeshFile::Validate");
+	std::vector<std::string> errors;
+	MeshFileView view;
+	try
+	{
+		view = Parse(data, size);
+	}
+	catch (const std::exception& e)
+	{
+		errors.push_back(e.what());
+		return errors;
+	}
+
+	const MeshFileHeader& header = *view.Header;
+	for (uint32_t i = 0; i < header.AttributeCount; i++)
+	{
+		const MeshFileAttribute& attribute = view.Attributes[i];
+		if (attribute.Offset >= header.VertexStride)
+			errors.push_back("Attribute " + std::to_string(i) + " starts past the vertex stride");
+	}
+
+	if (header.IndexCount % 3 != 0)
+		errors.push_back("Index count " + std::to_string(header.IndexCount) + " is not a multiple of 3");
+
+	for (uint32_t i = 0; i < header.IndexCount; i++)
+	{
+		uint32_t index = ReadIndex(view, i);
+		if (index >= header.VertexCount)
+		{
+			errors.push_back("Index " + std::to_string(i) + " references vertex " + std::to_string(index) + " of " + std::to_string(header.VertexCount));
+			break;
+		}
+	}
+
+	for (uint32_t i = 0; i < header.LodCount; i++)
+	{
+		const MeshFileLod& lod = view.Lods[i];
+		if (static_cast<uint64_t>(lod.FirstIndex) + lod.IndexCount > header.IndexCount)
+			errors.push_back("LOD " + std::to_string(i) + " reaches past the index buffer");
+		if (lod.FirstIndex % 3 != 0 || lod.IndexCount % 3 != 0)
+			errors.push_back("LOD " + std::to_string(i) + " does not cover whole triangles");
+		if (i > 0 && lod.Error < view.Lods[i - 1].Error)
+			errors.push_back("LOD " + std::to_string(i) + " has a smaller error than the level before it");
+		if (i > 0 && lod.IndexCount > view.Lods[i - 1].IndexCount)
+			errors.push_back("LOD " + std::to_string(i) + " has more indices than the level before it");
+	}
+
+	// meshlets partition level 0 in order, each within the limits the shaders assume
+	const MeshFileLod& fullLevel = view.Lods[0];
+	bool fullLevelValid = static_cast<uint64_t>(fullLevel.FirstIndex) + fullLevel.IndexCount <= header.IndexCount;
+	uint32_t meshletTriangles = 0;
+	for (uint32_t i = 0; i < header.MeshletCount && fullLevelValid; i++)
+	{
+		const Meshlet& meshlet = view.Meshlets[i];
+		std::string name = "Meshlet " + std::to_string(i);
+		if (meshlet.VertexCount > MAX_MESHLET_VERTICES || meshlet.TriangleCount > MAX_MESHLET_TRIANGLES)
+			errors.push_back(name + " exceeds the meshlet limits");
+		if (meshlet.TriangleOffset != meshletTriangles ||
+			static_cast<uint64_t>(meshlet.VertexOffset) + meshlet.VertexCount > header.MeshletVertexCount ||
+			static_cast<uint64_t>(meshlet.TriangleOffset) + meshlet.TriangleCount > header.MeshletTriangleCount ||
+			(static_cast<uint64_t>(meshlet.TriangleOffset) + meshlet.TriangleCount) * 3 > fullLevel.IndexCount)
+		{
+			errors.push_back(name + " is out of order or reaches past the meshlet data");
+			break;
+		}
+		meshletTriangles += meshlet.TriangleCount;
+
+		for (uint32_t t = 0; t < meshlet.TriangleCount * 3; t++)
+		{
+			uint8_t local = view.MeshletTriangles[meshlet.TriangleOffset * 3 + t];
+			uint32_t vertex = local < meshlet.VertexCount ? view.MeshletVertices[meshlet.VertexOffset + local] : UINT32_MAX;
+			if (vertex != ReadIndex(view, fullLevel.FirstIndex + meshlet.TriangleOffset * 3 + t))
+			{
+				errors.push_back(name + " does not match the index buffer");
+				break;
+			}
+		}
+	}
+	if (header.MeshletCount > 0 && meshletTriangles * 3 != fullLevel.IndexCount)
+		errors.push_back("Meshlets cover " + std::to_string(meshletTriangles) + " triangles, level 0 has " + std::to_string(fullLevel.IndexCount / 3));
+
+	// packed positions are inside the bounds by construction, only full ones need checking
+	if (view.HasVertexLayout())
+	{
+		const float tolerance = 1e-4f * std::max(1.0f, header.BoundsRadius);
+		for (uint32_t i = 0; i < header.VertexCount; i++)
+		{
+			Vertex vertex;
+			memcpy(&vertex, view.Vertices + static_cast<size_t>(i) * sizeof(Vertex), sizeof(Vertex));
+			bool inside = true;
+			for (int axis = 0; axis < 3; axis++)
+				inside = inside && vertex.Position[axis] >= header.BoundsMin[axis] - tolerance && vertex.Position[axis] <= header.BoundsMax[axis] + tolerance;
+			glm::vec3 center(header.BoundsCenter[0], header.BoundsCenter[1], header.BoundsCenter[2]);
+			if (!inside || glm::length(vertex.Position - center) > header.BoundsRadius + tolerance)
+			{
+				errors.push_back("Vertex " + std::to_string(i) + " lies outside the bounds");
+				break;
+			}
+		}
+	}
+	return errors;
+}
+
+void MeshFile::Write(const std::string& filename, const MeshData& data)
+{
+	PROFILE_SCOPE("MeshFile::Write");
+	bool packed = data.Format == VertexFormat::Packed;
+	std::vector<vk::VertexInputAttributeDescription> attributes = packed ? PackedVertex::GetAttributeDescriptions() : Vertex::GetAttributeDescriptions();
+
+	MeshFileHeader header{};
+	memcpy(header.Magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC));
+	header.Version = MESH_FILE_VERSION;
+	header.VertexCount = static_cast<uint32_t>(data.Vertices.size());
+	header.VertexStride = packed ? sizeof(PackedVertex) : sizeof(Vertex);
+	header.IndexCount = static_cast<uint32_t>(data.Indices.size());
+	header.IndexSize = data.GetIndexSize();
+	header.AttributeCount = static_cast<uint32_t>(attributes.size());
+	header.LodCount = data.Lods.empty() ? 1 : static_cast<uint32_t>(data.Lods.size());
+	header.MeshletCount = static_cast<uint32_t>(data.Meshlets.Meshlets.size());
+	header.MeshletVertexCount = static_cast<uint32_t>(data.Meshlets.Vertices.size());
+	header.MeshletTriangleCount = static_cast<uint32_t>(data.Meshlets.Triangles.size() / 3);
+
+	// same sphere around the box center as Mesh computes at runtime
+	glm::vec3 min(0.0f), max(0.0f), center(0.0f);
+	float radius = 0.0f;
+	if (!data.Vertices.empty())
+	{
+		min = max = data.Vertices[0].Position;
+		for (const Vertex& vertex : data.Vertices)
+		{
+			min = glm::min(min, vertex.Position);
+			max = glm::max(max, vertex.Position);
+		}
+		center = (min + max) * 0.5f;
+		for (const Vertex& vertex : data.Vertices)
+			radius = std::max(radius, glm::length(vertex.Position - center));
+	}
+	for (int axis = 0; axis < 3; axis++)
+	{
+		header.BoundsCenter[axis] = center[axis];
+		header.BoundsMin[axis] = min[axis];
+		header.BoundsMax[axis] = max[axis];
+	}
+	header.BoundsRadius = radius;
+
+	header.AttributesOffset = AlignUp(sizeof(MeshFileHeader), MESH_FILE_ALIGNMENT);
+	header.LodsOffset = AlignUp(header.AttributesOffset + sizeof(MeshFileAttribute) * header.AttributeCount, MESH_FILE_ALIGNMENT);
+	header.VerticesOffset = AlignUp(header.LodsOffset + sizeof(MeshFileLod) * header.LodCount, MESH_FILE_ALIGNMENT);
+	header.IndicesOffset = AlignUp(header.VerticesOffset + static_cast<uint64_t>(header.VertexCount) * header.VertexStride, MESH_FILE_ALIGNMENT);
+	uint64_t fileSize = header.IndicesOffset + static_cast<uint64_t>(header.IndexCount) * header.IndexSize;
+	if (header.MeshletCount > 0)
+	{
+		header.MeshletsOffset = AlignUp(fileSize, MESH_FILE_ALIGNMENT);
+		header.MeshletVerticesOffset = AlignUp(header.MeshletsOffset + sizeof(Meshlet) * header.MeshletCount, MESH_FILE_ALIGNMENT);
+		header.MeshletTrianglesOffset = AlignUp(header.MeshletVerticesOffset + sizeof(uint32_t) * header.MeshletVertexCount, MESH_FILE_ALIGNMENT);
+		fileSize = header.MeshletTrianglesOffset + static_cast<uint64_t>(header.MeshletTriangleCount) * 3;
+	}
+
+	std::vector<uint8_t> file(static_cast<size_t>(fileSize), 0);
+	memcpy(file.data(), &header, sizeof(header));
+	for (uint32_t i = 0; i < header.AttributeCount; i++)
+	{
+		MeshFileAttribute attribute{ attributes[i].location, static_cast<uint32_t>(attributes[i].format), attributes[i].offset, 0 };
+		memcpy(file.data() + header.AttributesOffset + i * sizeof(MeshFileAttribute), &attribute, sizeof(attribute));
+	}
+	std::vector<MeshLod> lods = data.Lods.empty() ? std::vector<MeshLod>{ MeshLod{ 0, header.IndexCount, 0.0f } } : data.Lods;
+	for (uint32_t i = 0; i < header.LodCount; i++)
+	{
+		MeshFileLod lod{ lods[i].FirstIndex, lods[i].IndexCount, lods[i].Error, 0 };
+		memcpy(file.data() + header.LodsOffset + i * sizeof(MeshFileLod), &lod, sizeof(lod));
+	}
+	if (packed)
+	{
+		for (size_t i = 0; i < data.Vertices.size(); i++)
+		{
+			PackedVertex vertex = PackedVertex::Pack(data.Vertices[i], min, max);
+			memcpy(file.data() + header.VerticesOffset + i * sizeof(PackedVertex), &vertex, sizeof(vertex));
+		}
+	}
+	else if (!data.Vertices.empty())
+		memcpy(file.data() + header.VerticesOffset, data.Vertices.data(), data.Vertices.size() * sizeof(Vertex));
+	if (header.IndexSize == 2)
+	{
+		for (size_t i = 0; i < data.Indices.size(); i++)
+		{
+			uint16_t index = static_cast<uint16_t>(data.Indices[i]);
+			memcpy(file.data() + header.IndicesOffset + i * sizeof(index), &index, sizeof(index));
+		}
+	}
+	else if (!data.Indices.empty())
+		memcpy(file.data() + header.IndicesOffset, data.Indices.data(), data.Indices.size() * sizeof(data.Indices[0]));
+	if (header.MeshletCount > 0)
+	{
+		memcpy(file.data() + header.MeshletsOffset, data.Meshlets.Meshlets.data(), sizeof(Meshlet) * header.MeshletCount);
+		memcpy(file.data() + header.MeshletVerticesOffset, data.Meshlets.Vertices.data(), sizeof(uint32_t) * header.MeshletVertexCount);
+		memcpy(file.data() + header.MeshletTrianglesOffset, data.Meshlets.Triangles.data(), static_cast<size_t>(header.MeshletTriangleCount) * 3);
+	}
+
+	std::ofstream out(filename, std::ios::binary);
+	if (!out)
+		throw std::runtime_error("Failed to open " + filename + " for writing");
+	out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+	if (!out)
+		throw std::runtime_error("Failed to write " + filename);
+}
+
+MeshData MeshFile::ToMeshData(const MeshFileView& view)
+{
+	MeshData data;
+	data.Vertices.resize(view.Header->VertexCount);
+	if (view.HasPackedVertexLayout())
+	{
+		const MeshFileHeader& header = *view.Header;
+		glm::vec3 min(header.BoundsMin[0], header.BoundsMin[1], header.BoundsMin[2]);
+		glm::vec3 max(header.BoundsMax[0], header.BoundsMax[1], header.BoundsMax[2]);
+		for (uint32_t i = 0; i < header.VertexCount; i++)
+		{
+			PackedVertex vertex;
+			memcpy(&vertex, view.Vertices + static_cast<size_t>(i) * sizeof(PackedVertex), sizeof(PackedVertex));
+			data.Vertices[i] = vertex.Unpack(min, max);
+		}
+		data.Format = VertexFormat::Packed;
+	}
+	else if (!view.HasVertexLayout())
+		throw std::runtime_error("Mesh file vertex layout matches neither Vertex nor PackedVertex");
+	else if (!data.Vertices.empty())
+		memcpy(data.Vertices.data(), view.Vertices, static_cast<size_t>(view.GetVertexBytes()));
+
+	data.Indices.resize(view.Header->IndexCount);
+	for (uint32_t i = 0; i < view.Header->IndexCount; i++)
+		data.Indices[i] = ReadIndex(view, i);
+
+	data.Lods.resize(view.Header->LodCount);
+	for (uint32_t i = 0; i < view.Header->LodCount; i++)
+		data.Lods[i] = { view.Lods[i].FirstIndex, view.Lods[i].IndexCount, view.Lods[i].Error };
+
+	if (view.HasMeshlets())
+	{
+		const MeshFileHeader& header = *view.Header;
+		data.Meshlets.Meshlets.assign(view.Meshlets, view.Meshlets + header.MeshletCount);
+		data.Meshlets.Vertices.assign(view.MeshletVertices, view.MeshletVertices + header.MeshletVertexCount);
+		data.Meshlets.Triangles.assign(view.MeshletTriangles, view.MeshletTriangles + static_cast<size_t>(header.MeshletTriangleCount) * 3);
+	}
+	return data;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+const char* const MESH_FILE_EXTENSION = ".vsmesh";
+const uint32_t MESH_FILE_VERSION = 2;
+// Every table and blob starts at a multiple of this from the start of the file
+const uint64_t MESH_FILE_ALIGNMENT = 16;
+
+// Binary mesh container, little endian and laid out to be used in place from
+// a memory mapping: header, attribute table, LOD table, vertex blob, index blob
+// and, for meshes split into meshlets, the three meshlet blobs.
+struct MeshFileHeader
+{
+	char Magic[4];				// "VSMS"
+	uint32_t Version;
+	uint32_t VertexCount;
+	uint32_t VertexStride;
+	uint32_t IndexCount;
+	uint32_t IndexSize;			// 2 or 4 bytes
+	uint32_t AttributeCount;
+	uint32_t LodCount;
+	float BoundsCenter[3];		// bounding sphere in model space
+	float BoundsRadius;
+	float BoundsMin[3];			// bounding box in model space
+	float BoundsMax[3];
+	uint64_t AttributesOffset;
+	uint64_t LodsOffset;
+	uint64_t VerticesOffset;
+	uint64_t IndicesOffset;
+	uint32_t MeshletCount;		// 0 when the mesh has no meshlets
+	uint32_t MeshletVertexCount;
+	uint32_t MeshletTriangleCount;
+	uint32_t Reserved;
+	uint64_t MeshletsOffset;			// Meshlet, the layout the shaders read
+	uint64_t MeshletVerticesOffset;		// uint32_t mesh vertex per meshlet vertex
+	uint64_t MeshletTrianglesOffset;	// three uint8_t meshlet vertices per triangle
+};
+static_assert(sizeof(MeshFileHeader) == 144, "Mesh file header must match the file layout");
+
+// One vertex attribute, formats are VkFormat values
+struct MeshFileAttribute
+{
+	uint32_t Location;
+	uint32_t Format;
+	uint32_t Offset;
+	uint32_t Reserved;
+};
+
+// Index range drawn for one level of detail, level 0 is the full mesh
+struct MeshFileLod
+{
+	uint32_t FirstIndex;
+	uint32_t IndexCount;
+	float Error;				// simplification error in model space units
+	uint32_t Reserved;
+};
+
+// Pointers into a mapped mesh file, valid as long as the mapping is
+struct MeshFileView
+{
+	const MeshFileHeader* Header = nullptr;
+	const MeshFileAttribute* Attributes = nullptr;
+	const MeshFileLod* Lods = nullptr;
+	const uint8_t* Vertices = nullptr;
+	const uint8_t* Indices = nullptr;
+	const Meshlet* Meshlets = nullptr;
+	const uint32_t* MeshletVertices = nullptr;
+	const uint8_t* MeshletTriangles = nullptr;
+
+	uint64_t GetVertexBytes() const { return static_cast<uint64_t>(Header->VertexCount) * Header->VertexStride; }
+	uint64_t GetIndexBytes() const { return static_cast<uint64_t>(Header->IndexCount) * Header->IndexSize; }
+	bool HasMeshlets() const { return Header->MeshletCount > 0; }
+	// Whether the vertices can be used as Vertex without conversion
+	bool HasVertexLayout() const;
+	// Whether the vertices are PackedVertex, quantized against the header bounds
+	bool HasPackedVertexLayout() const;
+};
+
+namespace MeshFile
+{
+	// Checks the header and that every table and blob lies inside the data.
+	// Allocates nothing, throws std::runtime_error for malformed data.
+	MeshFileView Parse(const uint8_t* data, size_t size);
+
+	// Parse plus the content: indices in range, LODs inside the index buffer,
+	// positions inside the bounds, meshlets matching level 0 within their
+	// limits. Returns one message per problem found.
+	std::vector<std::string> Validate(const uint8_t* data, size_t size);
+
+	// Writes data with the layout of data.Format, its LODs, a single one when
+	// there are none, and its meshlets if built
+	void Write(const std::string& filename, const MeshData& data);
+
+	// Copies a file with Vertex or PackedVertex layout back into MeshData, for CPU side processing
+	MeshData ToMeshData(const MeshFileView& view);
+}
@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <numeric>
+#include "MeshOptimizer.h"
+#include "../../../Core/Profiler.h"
+
+namespace
+{
+	// FIFO cache as one timestamp per vertex: a vertex is cached while fewer
+	// than cacheSize misses happened since it was last loaded
+	class CacheSimulation
+	{
+	public:
+		CacheSimulation(size_t vertexCount, uint32_t cacheSize)
+			: m_CacheTime(vertexCount, 0), m_CacheSize(cacheSize), m_Timestamp(cacheSize + 1)
+		{
+		}
+
+		bool IsCached(uint32_t vertex) const { return m_Timestamp - m_CacheTime[vertex] <= m_CacheSize; }
+		uint32_t GetAge(uint32_t vertex) const { return m_Timestamp - m_CacheTime[vertex]; }
+
+		// Returns whether the vertex missed
+		bool Access(uint32_t vertex)
+		{
+			if (IsCached(vertex))
+				return false;
+			m_CacheTime[vertex] = m_Timestamp++;
+			return true;
+		}
+
+		void Clear() { m_Timestamp += m_CacheSize + 1; }
+
+	private:
+		std::vector<uint32_t> m_CacheTime;
+		uint32_t m_CacheSize;
+		uint32_t m_Timestamp;
+	};
+
+	uint32_t CountTriangleMisses(CacheSimulation& cache, const std::vector<uint32_t>& indices, size_t triangle)
+	{
+		uint32_t misses = 0;
+		for (size_t corner = 0; corner < 3; corner++)
+			misses += cache.Access(indices[triangle * 3 + corner]) ? 1 : 0;
+		return misses;
+	}
+
+	// Index ranges of the levels of detail, the whole buffer when there are
+	// none. Trailing indices that do not make a triangle are dropped then.
+	std::vector<MeshLod> GetLevels(MeshData& data)
+	{
+		if (!data.Lods.empty())
+			return data.Lods;
+		data.Indices.resize(data.Indices.size() - data.Indices.size() % 3);
+		return { MeshLod{ 0, static_cast<uint32_t>(data.Indices.size()), 0.0f } };
+	}
+
+	void OptimizeVertexCacheLevel(uint32_t* levelIndices, size_t triangleCount, size_t vertexCount, uint32_t cacheSize)
+	{
+		if (triangleCount == 0)
+			return;
+
+		std::vector<uint32_t> indices(levelIndices, levelIndices + triangleCount * 3);
+
+		// triangles around each vertex, as ranges of one array
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (uint32_t index : indices)
+			offsets[index + 1]++;
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		// triangles left to emit around each vertex
+		std::vector<uint32_t> live(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			live[v] = offsets[v + 1] - offsets[v];
+
+		CacheSimulation cache(vertexCount, cacheSize);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> output;
+		deadEnd.reserve(indices.size());
+		output.reserve(indices.size());
+		size_t cursor = 0;
+
+		int64_t fanning = indices[0];
+		while (fanning >= 0)
+		{
+			candidates.clear();
+			for (uint32_t i = offsets[fanning]; i < offsets[fanning + 1]; i++)
+			{
+				uint32_t triangle = adjacency[i];
+				if (emitted[triangle])
+					continue;
+				for (size_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t vertex = indices[triangle * 3 + corner];
+					output.push_back(vertex);
+					deadEnd.push_back(vertex);
+					candidates.push_back(vertex);
+					live[vertex]--;
+					cache.Access(vertex);
+				}
+				emitted[triangle] = true;
+			}
+
+			// next fan around the candidate that is still cached after emitting
+			// its remaining triangles, the oldest one of those first
+			fanning = -1;
+			int64_t bestPriority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (live[vertex] == 0)
+					continue;
+				int64_t priority = 0;
+				if (cache.GetAge(vertex) + 2 * live[vertex] <= cacheSize)
+					priority = cache.GetAge(vertex);
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					fanning = vertex;
+				}
+			}
+
+			// dead end: the most recently used vertex with triangles left, else the next one in input order
+			while (fanning < 0 && !deadEnd.empty())
+			{
+				uint32_t vertex = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[vertex] > 0)
+					fanning = vertex;
+			}
+			for (; fanning < 0 && cursor < vertexCount; cursor++)
+				if (live[cursor] > 0)
+					fanning = static_cast<int64_t>(cursor);
+		}
+
+		std::copy(output.begin(), output.end(), levelIndices);
+	}
+
+	void OptimizeOverdrawLevel(uint32_t* levelIndices, size_t triangleCount, const std::vector<Vertex>& vertices, float threshold, uint32_t cacheSize)
+	{
+		if (triangleCount < 2)
+			return;
+
+		std::vector<uint32_t> indices(levelIndices, levelIndices + triangleCount * 3);
+
+		// hard boundaries where the cache starts over, triangles missing all three vertices
+		std::vector<size_t> hardClusters;
+		{
+			CacheSimulation cache(vertices.size(), cacheSize);
+			for (size_t t = 0; t < triangleCount; t++)
+				if (CountTriangleMisses(cache, indices, t) == 3)
+					hardClusters.push_back(t);
+		}
+		hardClusters.push_back(triangleCount);
+
+		// soft boundaries inside each hard cluster, cut as soon as the part so far
+		// is within threshold of the whole cluster's ACMR. The cache is cleared at
+		// every cut, the clusters get drawn in any order afterwards.
+		std::vector<size_t> clusters;
+		CacheSimulation cache(vertices.size(), cacheSize);
+		for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+		{
+			size_t begin = hardClusters[c];
+			size_t end = hardClusters[c + 1];
+
+			cache.Clear();
+			uint32_t clusterMisses = 0;
+			for (size_t t = begin; t < end; t++)
+				clusterMisses += CountTriangleMisses(cache, indices, t);
+			float target = threshold * clusterMisses / static_cast<float>(end - begin);
+
+			cache.Clear();
+			clusters.push_back(begin);
+			uint32_t misses = 0;
+			for (size_t t = begin; t < end; t++)
+			{
+				misses += CountTriangleMisses(cache, indices, t);
+				if (t + 1 < end && misses <= target * (t + 1 - clusters.back()))
+				{
+					clusters.push_back(t + 1);
+					misses = 0;
+					cache.Clear();
+				}
+			}
+		}
+		clusters.push_back(triangleCount);
+
+		// clusters facing away from the mesh center cover the rest, draw them first
+		glm::vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+		std::vector<glm::vec3> clusterCentroids(clusters.size() - 1, glm::vec3(0.0f));
+		std::vector<glm::vec3> clusterNormals(clusters.size() - 1, glm::vec3(0.0f));
+		for (size_t c = 0; c + 1 < clusters.size(); c++)
+		{
+			float clusterArea = 0.0f;
+			for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+			{
+				const glm::vec3& a = vertices[indices[t * 3 + 0]].Position;
+				const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+				const glm::vec3& d = vertices[indices[t * 3 + 2]].Position;
+				glm::vec3 normal = glm::cross(b - a, d - a);
+				float area = glm::length(normal);
+				clusterCentroids[c] += (a + b + d) * (area / 3.0f);
+				clusterNormals[c] += normal;
+				clusterArea += area;
+			}
+			meshCentroid += clusterCentroids[c];
+			meshArea += clusterArea;
+			clusterCentroids[c] = clusterArea > 0.0f ? clusterCentroids[c] / clusterArea : vertices[indices[clusters[c] * 3]].Position;
+		}
+		if (meshArea > 0.0f)
+			meshCentroid /= meshArea;
+
+		std::vector<float> sortKeys(clusters.size() - 1);
+		for (size_t c = 0; c < sortKeys.size(); c++)
+		{
+			float length = glm::length(clusterNormals[c]);
+			sortKeys[c] = length > 0.0f ? glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / length) : 0.0f;
+		}
+
+		std::vector<size_t> order(sortKeys.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		for (size_t c : order)
+			levelIndices = std::copy(indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3, levelIndices);
+	}
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const MeshData& data, uint32_t cacheSize)
+{
+	// the full level, coarser ones reuse its vertices
+	size_t firstIndex = data.Lods.empty() ? 0 : data.Lods[0].FirstIndex;
+	size_t indexCount = data.Lods.empty() ? data.Indices.size() : data.Lods[0].IndexCount;
+
+	VertexCacheStats stats;
+	stats.Triangles = static_cast<uint32_t>(indexCount / 3);
+	if (stats.Triangles == 0)
+		return stats;
+
+	CacheSimulation cache(data.Vertices.size(), cacheSize);
+	std::vector<bool> referenced(data.Vertices.size(), false);
+	for (size_t i = firstIndex; i < firstIndex + static_cast<size_t>(stats.Triangles) * 3; i++)
+	{
+		uint32_t vertex = data.Indices[i];
+		stats.Misses += cache.Access(vertex) ? 1 : 0;
+		if (!referenced[vertex])
+		{
+			referenced[vertex] = true;
+			stats.Vertices++;
+		}
+	}
+
+	stats.ACMR = static_cast<float>(stats.Misses) / stats.Triangles;
+	stats.ATVR = static_cast<float>(stats.Misses) / stats.Vertices;
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(MeshData& data, uint32_t cacheSize)
+{
+	PROFILE_SCOPE("MeshOptimizer::OptimizeVertexCache");
+	for (const MeshLod& level : GetLevels(data))
+		OptimizeVertexCacheLevel(data.Indices.data() + level.FirstIndex, level.IndexCount / 3, data.Vertices.size(), cacheSize);
+}
+
+void MeshOptimizer::OptimizeOverdraw(MeshData& data, float threshold, uint32_t cacheSize)
+{
+	PROFILE_SCOPE("MeshOptimizer::OptimizeOverdraw");
+	for (const MeshLod& level : GetLevels(data))
+		OptimizeOverdrawLevel(data.Indices.data() + level.FirstIndex, level.IndexCount / 3, data.Vertices, threshold, cacheSize);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(MeshData& data)
+{
+	PROFILE_SCOPE("MeshOptimizer::OptimizeVertexFetch");
+	std::vector<uint32_t> remap(data.Vertices.size(), UINT32_MAX);
+	std::vector<Vertex> vertices;
+	vertices.reserve(data.Vertices.size());
+	for (auto& index : data.Indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(data.Vertices[index]);
+		}
+		index = remap[index];
+	}
+	data.Vertices = std::move(vertices);
+}
+
+void MeshOptimizer::Optimize(MeshData& data, bool overdraw)
+{
+	OptimizeVertexCache(data);
+	if (overdraw)
+		OptimizeOverdraw(data);
+	OptimizeVertexFetch(data);
+}
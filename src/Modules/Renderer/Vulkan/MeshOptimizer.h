@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include "Mesh.h"
+
+// FIFO cache size the optimizer and the statistics assume, close to what
+// current GPUs reuse between neighbouring triangles
+const uint32_t VERTEX_CACHE_SIZE = 16;
+// Overdraw ordering may raise the ACMR of each cluster by this factor
+const float OVERDRAW_THRESHOLD = 1.05f;
+
+struct VertexCacheStats
+{
+	uint32_t Triangles = 0;
+	uint32_t Vertices = 0;		// referenced by at least one triangle
+	uint32_t Misses = 0;
+	float ACMR = 0.0f;			// misses per triangle, 0.5 is the limit for large regular grids
+	float ATVR = 0.0f;			// misses per vertex, 1.0 is optimal
+};
+
+// Triangle and vertex reordering for the post-transform cache, overdraw and
+// vertex fetch. Triangles keep their winding and the mesh renders the same.
+// Levels of detail are reordered each within their own index range.
+namespace MeshOptimizer
+{
+	// Simulates a FIFO post-transform cache over the full level of detail
+	VertexCacheStats AnalyzeVertexCache(const MeshData& data, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	// Tipsify (Sander et al. 2007): fans around the most recently used
+	// vertices, linear time in the number of triangles
+	void OptimizeVertexCache(MeshData& data, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	// Splits a cache optimized index buffer into clusters where the cache
+	// restarts or the ACMR allows it, and draws outward facing clusters first
+	void OptimizeOverdraw(MeshData& data, float threshold = OVERDRAW_THRESHOLD, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	// Renumbers vertices in first use order so fetches walk the vertex buffer
+	// forward. Vertices no triangle references are dropped.
+	void OptimizeVertexFetch(MeshData& data);
+
+	// All of the above in the order they build on each other
+	void Optimize(MeshData& data, bool overdraw = true);
+}
@@ -0,0 +1,486 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include "MeshSimplifier.h"
+#include "../../../Core/Profiler.h"
+
+namespace
+{
+	// Borders and seams resist moving this much more than the faces next to them
+	const float BORDER_WEIGHT = 10.0f;
+	// A level keeping more than this share of the triangles before it is dropped
+	const float MAX_LEVEL_SHARE = 0.85f;
+
+	enum class VertexKind : uint8_t
+	{
+		Manifold,	// only vertex at its position, closed fan around it
+		Border,		// only vertex at its position, on one open edge chain
+		Seam,		// one of two vertices at a position, split by an attribute seam
+		Locked		// anything else, never collapses
+	};
+
+	// Sum of weighted squared distances to a set of planes, as a symmetric
+	// matrix A, a vector B and a constant C: p'Ap + 2B'p + C
+	struct Quadric
+	{
+		float A00 = 0.0f, A11 = 0.0f, A22 = 0.0f, A01 = 0.0f, A02 = 0.0f, A12 = 0.0f;
+		float B0 = 0.0f, B1 = 0.0f, B2 = 0.0f;
+		float C = 0.0f;
+		float Weight = 0.0f;
+
+		// normal is unit length, points p on the plane have dot(normal, p) + distance = 0
+		void AddPlane(const glm::vec3& normal, float distance, float weight)
+		{
+			A00 += weight * normal.x * normal.x;
+			A11 += weight * normal.y * normal.y;
+			A22 += weight * normal.z * normal.z;
+			A01 += weight * normal.x * normal.y;
+			A02 += weight * normal.x * normal.z;
+			A12 += weight * normal.y * normal.z;
+			B0 += weight * normal.x * distance;
+			B1 += weight * normal.y * distance;
+			B2 += weight * normal.z * distance;
+			C += weight * distance * distance;
+			Weight += weight;
+		}
+
+		void Add(const Quadric& other)
+		{
+			A00 += other.A00; A11 += other.A11; A22 += other.A22;
+			A01 += other.A01; A02 += other.A02; A12 += other.A12;
+			B0 += other.B0; B1 += other.B1; B2 += other.B2;
+			C += other.C;
+			Weight += other.Weight;
+		}
+
+		// Squared distance averaged over the plane weights
+		float Evaluate(const glm::vec3& p) const
+		{
+			float x = A00 * p.x + A01 * p.y + A02 * p.z;
+			float y = A01 * p.x + A11 * p.y + A12 * p.z;
+			float z = A02 * p.x + A12 * p.y + A22 * p.z;
+			float error = p.x * x + p.y * y + p.z * z + 2.0f * (B0 * p.x + B1 * p.y + B2 * p.z) + C;
+			return Weight > 0.0f ? std::fabs(error) / Weight : 0.0f;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t From;
+		uint32_t To;
+		float Error;
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& position) const
+		{
+			uint32_t bits[3];
+			memcpy(bits, &position, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+
+	// Directed triangle edges grouped by their first vertex, with vertices
+	// optionally replaced by the first vertex at the same position
+	class EdgeAdjacency
+	{
+	public:
+		void Build(const std::vector<uint32_t>& indices, size_t vertexCount, const std::vector<uint32_t>* remap)
+		{
+			auto map = [remap](uint32_t vertex) { return remap ? (*remap)[vertex] : vertex; };
+			m_Offsets.assign(vertexCount + 1, 0);
+			for (uint32_t index : indices)
+				m_Offsets[map(index) + 1]++;
+			std::partial_sum(m_Offsets.begin(), m_Offsets.end(), m_Offsets.begin());
+
+			m_Targets.resize(indices.size());
+			std::vector<uint32_t> fill(m_Offsets.begin(), m_Offsets.end() - 1);
+			for (size_t t = 0; t < indices.size(); t += 3)
+				for (size_t corner = 0; corner < 3; corner++)
+					m_Targets[fill[map(indices[t + corner])]++] = map(indices[t + (corner + 1) % 3]);
+		}
+
+		bool HasEdge(uint32_t from, uint32_t to) const
+		{
+			for (uint32_t i = m_Offsets[from]; i < m_Offsets[from + 1]; i++)
+				if (m_Targets[i] == to)
+					return true;
+			return false;
+		}
+
+	private:
+		std::vector<uint32_t> m_Offsets;
+		std::vector<uint32_t> m_Targets;
+	};
+
+	class Simplifier
+	{
+	public:
+		Simplifier(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+			: m_VertexCount(vertices.size())
+		{
+			NormalizePositions(vertices);
+			BuildPositionRemap(indices);
+
+			// triangles with two corners at one position have no area, drop them up front
+			m_Indices.reserve(indices.size());
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+				if (!IsDegenerate(indices[t], indices[t + 1], indices[t + 2]))
+					m_Indices.insert(m_Indices.end(), indices.begin() + t, indices.begin() + t + 3);
+
+			BuildQuadrics();
+		}
+
+		std::vector<uint32_t> Run(size_t targetIndexCount, float maxError, float& resultError)
+		{
+			float maxErrorSquared = maxError * maxError;
+			float resultErrorSquared = 0.0f;
+			while (m_Indices.size() > targetIndexCount)
+			{
+				size_t triangleGoal = (m_Indices.size() - targetIndexCount) / 3;
+				if (RunPass(triangleGoal, maxErrorSquared, resultErrorSquared) == 0)
+					break;
+			}
+
+			resultError = std::sqrt(resultErrorSquared) * m_Extent;
+			return m_Indices;
+		}
+
+	private:
+		// Positions scaled into the unit cube, errors are relative to the extent
+		void NormalizePositions(const std::vector<Vertex>& vertices)
+		{
+			m_Positions.resize(vertices.size());
+			if (vertices.empty())
+				return;
+
+			glm::vec3 min = vertices[0].Position, max = min;
+			for (const Vertex& vertex : vertices)
+			{
+				min = glm::min(min, vertex.Position);
+				max = glm::max(max, vertex.Position);
+			}
+			m_Extent = std::max(max.x - min.x, std::max(max.y - min.y, max.z - min.z));
+			float scale = m_Extent > 0.0f ? 1.0f / m_Extent : 0.0f;
+			for (size_t i = 0; i < vertices.size(); i++)
+				m_Positions[i] = (vertices[i].Position - min) * scale;
+		}
+
+		// m_Remap points every referenced vertex at the first one with the same
+		// position, m_Wedge links the vertices of a position in a ring
+		void BuildPositionRemap(const std::vector<uint32_t>& indices)
+		{
+			m_Remap.resize(m_VertexCount);
+			m_Wedge.resize(m_VertexCount);
+			std::iota(m_Remap.begin(), m_Remap.end(), 0);
+			std::iota(m_Wedge.begin(), m_Wedge.end(), 0);
+
+			std::vector<bool> referenced(m_VertexCount, false);
+			for (uint32_t index : indices)
+				referenced[index] = true;
+
+			std::unordered_map<glm::vec3, uint32_t, PositionHash> first;
+			first.reserve(m_VertexCount);
+			for (uint32_t v = 0; v < m_VertexCount; v++)
+			{
+				if (!referenced[v])
+					continue;
+				// + 0 folds -0 into 0, they compare equal but hash differently
+				uint32_t representative = first.emplace(m_Positions[v] + glm::vec3(0.0f), v).first->second;
+				m_Remap[v] = representative;
+				if (representative != v)
+				{
+					m_Wedge[v] = m_Wedge[representative];
+					m_Wedge[representative] = v;
+				}
+			}
+		}
+
+		bool IsDegenerate(uint32_t a, uint32_t b, uint32_t c) const
+		{
+			return m_Remap[a] == m_Remap[b] || m_Remap[b] == m_Remap[c] || m_Remap[c] == m_Remap[a];
+		}
+
+		// Face planes weighted by area, plus planes through every open edge
+		// perpendicular to its face so borders and seams keep their shape
+		void BuildQuadrics()
+		{
+			m_Quadrics.assign(m_VertexCount, Quadric());
+			EdgeAdjacency edges;
+			edges.Build(m_Indices, m_VertexCount, nullptr);
+
+			for (size_t t = 0; t < m_Indices.size(); t += 3)
+			{
+				const glm::vec3& p0 = m_Positions[m_Indices[t]];
+				glm::vec3 normal = glm::cross(m_Positions[m_Indices[t + 1]] - p0, m_Positions[m_Indices[t + 2]] - p0);
+				float length = glm::length(normal);
+				if (length == 0.0f)
+					continue;
+				normal /= length;
+
+				for (size_t corner = 0; corner < 3; corner++)
+					m_Quadrics[m_Remap[m_Indices[t + corner]]].AddPlane(normal, -glm::dot(normal, p0), length * 0.5f);
+
+				for (size_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t a = m_Indices[t + corner];
+					uint32_t b = m_Indices[t + (corner + 1) % 3];
+					if (edges.HasEdge(b, a))
+						continue;
+
+					glm::vec3 edge = m_Positions[b] - m_Positions[a];
+					float edgeLength = glm::length(edge);
+					glm::vec3 edgeNormal = glm::cross(normal, edge / edgeLength);
+					float distance = -glm::dot(edgeNormal, m_Positions[a]);
+					float weight = edgeLength * edgeLength * BORDER_WEIGHT;
+					m_Quadrics[m_Remap[a]].AddPlane(edgeNormal, distance, weight);
+					m_Quadrics[m_Remap[b]].AddPlane(edgeNormal, distance, weight);
+				}
+			}
+		}
+
+		void ClassifyVertices()
+		{
+			m_VertexEdges.Build(m_Indices, m_VertexCount, nullptr);
+			m_PositionEdges.Build(m_Indices, m_VertexCount, &m_Remap);
+
+			std::vector<uint32_t> vertexOpenOut(m_VertexCount, 0), vertexOpenIn(m_VertexCount, 0);
+			std::vector<uint32_t> positionOpenOut(m_VertexCount, 0), positionOpenIn(m_VertexCount, 0);
+			std::vector<bool> referenced(m_VertexCount, false);
+			for (size_t t = 0; t < m_Indices.size(); t += 3)
+				for (size_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t a = m_Indices[t + corner];
+					uint32_t b = m_Indices[t + (corner + 1) % 3];
+					referenced[a] = true;
+					if (!m_VertexEdges.HasEdge(b, a))
+					{
+						vertexOpenOut[a]++;
+						vertexOpenIn[b]++;
+					}
+					if (!m_PositionEdges.HasEdge(m_Remap[b], m_Remap[a]))
+					{
+						positionOpenOut[m_Remap[a]]++;
+						positionOpenIn[m_Remap[b]]++;
+					}
+				}
+
+			m_Kinds.assign(m_VertexCount, VertexKind::Locked);
+			for (uint32_t v = 0; v < m_VertexCount; v++)
+			{
+				if (!referenced[v])
+					continue;
+				uint32_t position = m_Remap[v];
+				bool positionClosed = positionOpenOut[position] == 0 && positionOpenIn[position] == 0;
+				uint32_t other = m_Wedge[v];
+				if (other == v)
+				{
+					if (positionClosed)
+						m_Kinds[v] = VertexKind::Manifold;
+					else if (positionOpenOut[position] == 1 && positionOpenIn[position] == 1)
+						m_Kinds[v] = VertexKind::Border;
+				}
+				else if (m_Wedge[other] == v && positionClosed &&
+					vertexOpenOut[v] == 1 && vertexOpenIn[v] == 1 && vertexOpenOut[other] == 1 && vertexOpenIn[other] == 1)
+					m_Kinds[v] = VertexKind::Seam;
+			}
+		}
+
+		// Borders and seams only slide along themselves, so the outline and the
+		// attribute split stay where they are
+		bool CanCollapse(uint32_t from, uint32_t to) const
+		{
+			if (m_Remap[from] == m_Remap[to])
+				return false;
+
+			switch (m_Kinds[from])
+			{
+			case VertexKind::Manifold:
+				return true;
+			case VertexKind::Border:
+				return m_Kinds[to] == VertexKind::Border &&
+					!(m_PositionEdges.HasEdge(m_Remap[from], m_Remap[to]) && m_PositionEdges.HasEdge(m_Remap[to], m_Remap[from]));
+			case VertexKind::Seam:
+			{
+				uint32_t fromOther = m_Wedge[from];
+				uint32_t toOther = m_Wedge[to];
+				return m_Kinds[to] == VertexKind::Seam &&
+					!(m_VertexEdges.HasEdge(from, to) && m_VertexEdges.HasEdge(to, from)) &&
+					(m_VertexEdges.HasEdge(fromOther, toOther) || m_VertexEdges.HasEdge(toOther, fromOther));
+			}
+			default:
+				return false;
+			}
+		}
+
+		// Whether moving from onto to turns a remaining triangle around, with the
+		// collapses already picked in this pass applied
+		bool FlipsTriangles(uint32_t from, uint32_t to, const std::vector<uint32_t>& collapseTarget) const
+		{
+			uint32_t fromPosition = m_Remap[from];
+			uint32_t toPosition = m_Remap[to];
+			for (uint32_t i = m_TriangleOffsets[fromPosition]; i < m_TriangleOffsets[fromPosition + 1]; i++)
+			{
+				size_t t = m_Triangles[i] * 3;
+				glm::vec3 corners[3];
+				int moving = -1;
+				bool collapses = false;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					uint32_t vertex = collapseTarget[m_Indices[t + corner]];
+					corners[corner] = m_Positions[vertex];
+					if (m_Remap[vertex] == fromPosition)
+						moving = corner;
+					collapses = collapses || m_Remap[vertex] == toPosition;
+				}
+				if (moving < 0 || collapses)
+					continue;
+
+				glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				corners[moving] = m_Positions[to];
+				glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				if (glm::dot(before, after) <= 0.0f)
+					return true;
+			}
+			return false;
+		}
+
+		// Triangles around every position, for the flip checks
+		void BuildTriangleAdjacency()
+		{
+			m_TriangleOffsets.assign(m_VertexCount + 1, 0);
+			for (uint32_t index : m_Indices)
+				m_TriangleOffsets[m_Remap[index] + 1]++;
+			std::partial_sum(m_TriangleOffsets.begin(), m_TriangleOffsets.end(), m_TriangleOffsets.begin());
+
+			m_Triangles.resize(m_Indices.size());
+			std::vector<uint32_t> fill(m_TriangleOffsets.begin(), m_TriangleOffsets.end() - 1);
+			for (size_t i = 0; i < m_Indices.size(); i++)
+				m_Triangles[fill[m_Remap[m_Indices[i]]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		// Collapses the cheapest independent edges until triangleGoal triangles
+		// are gone, returns how many collapses were done
+		size_t RunPass(size_t triangleGoal, float maxErrorSquared, float& resultErrorSquared)
+		{
+			ClassifyVertices();
+			BuildTriangleAdjacency();
+
+			std::vector<Collapse> collapses;
+			collapses.reserve(m_Indices.size() * 2);
+			for (size_t t = 0; t < m_Indices.size(); t += 3)
+				for (size_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t a = m_Indices[t + corner];
+					uint32_t b = m_Indices[t + (corner + 1) % 3];
+					for (int direction = 0; direction < 2; direction++)
+					{
+						uint32_t from = direction == 0 ? a : b;
+						uint32_t to = direction == 0 ? b : a;
+						if (!CanCollapse(from, to))
+							continue;
+						Quadric quadric = m_Quadrics[m_Remap[from]];
+						quadric.Add(m_Quadrics[m_Remap[to]]);
+						collapses.push_back({ from, to, quadric.Evaluate(m_Positions[to]) });
+					}
+				}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Error < b.Error; });
+
+			// both ends of a collapse stay put for the rest of the pass
+			std::vector<uint32_t> collapseTarget(m_VertexCount);
+			std::iota(collapseTarget.begin(), collapseTarget.end(), 0);
+			std::vector<bool> locked(m_VertexCount, false);
+			size_t removed = 0;
+			size_t performed = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.Error > maxErrorSquared || removed >= triangleGoal)
+					break;
+				uint32_t fromPosition = m_Remap[collapse.From];
+				uint32_t toPosition = m_Remap[collapse.To];
+				if (locked[fromPosition] || locked[toPosition] || FlipsTriangles(collapse.From, collapse.To, collapseTarget))
+					continue;
+
+				collapseTarget[collapse.From] = collapse.To;
+				if (m_Kinds[collapse.From] == VertexKind::Seam)
+					collapseTarget[m_Wedge[collapse.From]] = m_Wedge[collapse.To];
+				m_Quadrics[toPosition].Add(m_Quadrics[fromPosition]);
+				locked[fromPosition] = true;
+				locked[toPosition] = true;
+				resultErrorSquared = std::max(resultErrorSquared, collapse.Error);
+				removed += m_Kinds[collapse.From] == VertexKind::Border ? 1 : 2;
+				performed++;
+			}
+
+			size_t write = 0;
+			for (size_t t = 0; t < m_Indices.size(); t += 3)
+			{
+				uint32_t a = collapseTarget[m_Indices[t]];
+				uint32_t b = collapseTarget[m_Indices[t + 1]];
+				uint32_t c = collapseTarget[m_Indices[t + 2]];
+				if (IsDegenerate(a, b, c))
+					continue;
+				m_Indices[write++] = a;
+				m_Indices[write++] = b;
+				m_Indices[write++] = c;
+			}
+			m_Indices.resize(write);
+			return performed;
+		}
+
+		size_t m_VertexCount;
+		float m_Extent = 0.0f;
+		std::vector<glm::vec3> m_Positions;
+		std::vector<uint32_t> m_Remap;
+		std::vector<uint32_t> m_Wedge;
+		std::vector<Quadric> m_Quadrics;		// by the first vertex of each position
+		std::vector<VertexKind> m_Kinds;
+		EdgeAdjacency m_VertexEdges;
+		EdgeAdjacency m_PositionEdges;
+		std::vector<uint32_t> m_TriangleOffsets;
+		std::vector<uint32_t> m_Triangles;
+		std::vector<uint32_t> m_Indices;
+	};
+}
+
+std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	size_t targetIndexCount, float maxError, float& resultError)
+{
+	PROFILE_SCOPE("MeshSimplifier::Simplify");
+	resultError = 0.0f;
+	if (indices.size() <= targetIndexCount)
+		return indices;
+
+	Simplifier simplifier(vertices, indices);
+	return simplifier.Run(targetIndexCount, maxError, resultError);
+}
+
+void MeshSimplifier::GenerateLods(MeshData& data, uint32_t maxLods)
+{
+	PROFILE_SCOPE("MeshSimplifier::GenerateLods");
+	data.Indices.resize(data.Indices.size() - data.Indices.size() % 3);
+	data.Lods.assign(1, MeshLod{ 0, static_cast<uint32_t>(data.Indices.size()), 0.0f });
+
+	std::vector<uint32_t> previous = data.Indices;
+	float error = 0.0f;
+	while (data.Lods.size() < maxLods)
+	{
+		size_t target = static_cast<size_t>(previous.size() / 3 * LOD_TRIANGLE_RATIO) * 3;
+		if (target < MIN_LOD_TRIANGLES * 3)
+			break;
+
+		float levelError = 0.0f;
+		std::vector<uint32_t> level = Simplify(data.Vertices, previous, target, MAX_LOD_ERROR, levelError);
+		if (level.size() > previous.size() * MAX_LEVEL_SHARE)
+			break;
+
+		// each level is simplified from the one before it, so the errors add up
+		error += levelError;
+		data.Lods.push_back({ static_cast<uint32_t>(data.Indices.size()), static_cast<uint32_t>(level.size()), error });
+		data.Indices.insert(data.Indices.end(), level.begin(), level.end());
+		previous = std::move(level);
+	}
+}
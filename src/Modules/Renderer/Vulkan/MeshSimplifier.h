@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Mesh.h"
+
+// Levels per mesh, the full one included
+const uint32_t MAX_MESH_LODS = 6;
+// Each level aims for this share of the triangles of the level before it
+const float LOD_TRIANGLE_RATIO = 0.5f;
+// Levels are not worth a draw of their own below this many triangles
+const uint32_t MIN_LOD_TRIANGLES = 16;
+// Error limit of every level, relative to the largest extent of the mesh
+const float MAX_LOD_ERROR = 0.1f;
+
+// Edge collapse simplification driven by quadric error metrics (Garland and
+// Heckbert 1997). Vertices collapse onto their neighbours instead of moving,
+// so every level indexes the vertex buffer of the full mesh.
+namespace MeshSimplifier
+{
+	// Collapses edges of the triangles in indices until at most targetIndexCount
+	// indices remain or the next collapse would cost more than maxError, relative
+	// to the mesh extent. Borders and UV seams only collapse along themselves,
+	// vertices shared by more than two seams stay. resultError receives the
+	// largest error of the result in model space units.
+	std::vector<uint32_t> Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+		size_t targetIndexCount, float maxError, float& resultError);
+
+	// Appends coarser levels to the index buffer, each simplified from the one
+	// before it, and fills data.Lods. Stops early when a level barely shrinks.
+	void GenerateLods(MeshData& data, uint32_t maxLods = MAX_MESH_LODS);
+}
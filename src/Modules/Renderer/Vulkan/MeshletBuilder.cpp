@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "MeshletBuilder.h"
+#include "../../../Core/Profiler.h"
+
+namespace
+{
+	const uint32_t NOT_IN_MESHLET = UINT32_MAX;
+	// Normal cones wider than this (cosine of the half angle) are never back facing as a whole
+	const float MIN_CONE_SPREAD = 0.1f;
+	// Cutoff that no dot product reaches, disables cone culling for a meshlet
+	const float CONE_CULLING_DISABLED = 2.0f;
+
+	// Vertices of the triangle not yet in the meshlet, repeated corners counted once
+	uint32_t CountNewVertices(const uint32_t* triangle, const std::vector<uint32_t>& localIndex)
+	{
+		uint32_t count = localIndex[triangle[0]] == NOT_IN_MESHLET ? 1 : 0;
+		if (localIndex[triangle[1]] == NOT_IN_MESHLET && triangle[1] != triangle[0])
+			count++;
+		if (localIndex[triangle[2]] == NOT_IN_MESHLET && triangle[2] != triangle[0] && triangle[2] != triangle[1])
+			count++;
+		return count;
+	}
+
+	void ComputeBounds(const std::vector<Vertex>& vertices, const MeshletData& data, Meshlet& meshlet)
+	{
+		// sphere around the bounding box center, as for whole meshes
+		glm::vec3 min = vertices[data.Vertices[meshlet.VertexOffset]].Position;
+		glm::vec3 max = min;
+		for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+		{
+			const glm::vec3& position = vertices[data.Vertices[meshlet.VertexOffset + i]].Position;
+			min = glm::min(min, position);
+			max = glm::max(max, position);
+		}
+		meshlet.Center = (min + max) * 0.5f;
+		meshlet.Radius = 0.0f;
+		for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+			meshlet.Radius = std::max(meshlet.Radius, glm::length(vertices[data.Vertices[meshlet.VertexOffset + i]].Position - meshlet.Center));
+
+		// cone around the average face normal, degenerate triangles face nowhere
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec3> corners;
+		normals.reserve(meshlet.TriangleCount);
+		corners.reserve(meshlet.TriangleCount);
+		glm::vec3 axis(0.0f);
+		for (uint32_t t = 0; t < meshlet.TriangleCount; t++)
+		{
+			const uint8_t* triangle = &data.Triangles[(meshlet.TriangleOffset + t) * 3];
+			const glm::vec3& a = vertices[data.Vertices[meshlet.VertexOffset + triangle[0]]].Position;
+			const glm::vec3& b = vertices[data.Vertices[meshlet.VertexOffset + triangle[1]]].Position;
+			const glm::vec3& c = vertices[data.Vertices[meshlet.VertexOffset + triangle[2]]].Position;
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float length = glm::length(normal);
+			if (length == 0.0f)
+				continue;
+			normals.push_back(normal / length);
+			corners.push_back(a);
+			axis += normals.back();
+		}
+
+		meshlet.ConeAxis = glm::vec3(0.0f);
+		meshlet.ConeApex = meshlet.Center;
+		meshlet.ConeCutoff = CONE_CULLING_DISABLED;
+		if (normals.empty() || glm::length(axis) == 0.0f)
+			return;
+
+		axis = glm::normalize(axis);
+		float minDot = 1.0f;
+		for (const glm::vec3& normal : normals)
+			minDot = std::min(minDot, glm::dot(normal, axis));
+		if (minDot <= MIN_CONE_SPREAD)
+			return;
+
+		// apex behind every triangle plane: a camera that sees the apex from the
+		// back of the cone sees every triangle from the back
+		float offset = -INFINITY;
+		for (size_t i = 0; i < normals.size(); i++)
+			offset = std::max(offset, glm::dot(normals[i], meshlet.Center - corners[i]) / glm::dot(normals[i], axis));
+
+		meshlet.ConeAxis = axis;
+		meshlet.ConeApex = meshlet.Center - axis * offset;
+		meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+void MeshletBuilder::Build(MeshData& data, uint32_t maxVertices, uint32_t maxTriangles)
+{
+	PROFILE_SCOPE("MeshletBuilder::Build");
+	data.Meshlets = MeshletData();
+	// local indices are bytes
+	maxVertices = std::min(std::max(maxVertices, 3u), 256u);
+	maxTriangles = std::max(maxTriangles, 1u);
+
+	size_t firstIndex = data.Lods.empty() ? 0 : data.Lods[0].FirstIndex;
+	size_t triangleCount = (data.Lods.empty() ? data.Indices.size() : data.Lods[0].IndexCount) / 3;
+	if (triangleCount == 0)
+		return;
+	uint32_t* indices = data.Indices.data() + firstIndex;
+	size_t vertexCount = data.Vertices.size();
+
+	// triangles around each vertex, as ranges of one array
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		offsets[indices[i] + 1]++;
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+	// triangles left to emit around each vertex
+	std::vector<uint32_t> live(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		live[v] = offsets[v + 1] - offsets[v];
+
+	MeshletData& result = data.Meshlets;
+	result.Triangles.reserve(triangleCount * 3);
+	std::vector<uint32_t> localIndex(vertexCount, NOT_IN_MESHLET);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	size_t cursor = 0;
+
+	Meshlet meshlet{};
+	glm::vec3 positionSum(0.0f);
+	auto finishMeshlet = [&]()
+	{
+		ComputeBounds(data.Vertices, result, meshlet);
+		for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+			localIndex[result.Vertices[meshlet.VertexOffset + i]] = NOT_IN_MESHLET;
+		result.Meshlets.push_back(meshlet);
+		meshlet = Meshlet{};
+		positionSum = glm::vec3(0.0f);
+		meshlet.VertexOffset = static_cast<uint32_t>(result.Vertices.size());
+		meshlet.TriangleOffset = static_cast<uint32_t>(result.Triangles.size() / 3);
+	};
+
+	for (size_t count = 0; count < triangleCount; count++)
+	{
+		// the triangle next to the meshlet adding the fewest vertices, nearest to its center first
+		size_t best = triangleCount;
+		uint32_t bestNew = 4;
+		float bestDistance = INFINITY;
+		glm::vec3 center = meshlet.VertexCount > 0 ? positionSum / static_cast<float>(meshlet.VertexCount) : glm::vec3(0.0f);
+		for (uint32_t i = 0; i < meshlet.VertexCount && bestNew > 0; i++)
+		{
+			uint32_t vertex = result.Vertices[meshlet.VertexOffset + i];
+			if (live[vertex] == 0)
+				continue;
+			for (uint32_t a = offsets[vertex]; a < offsets[vertex + 1]; a++)
+			{
+				uint32_t triangle = adjacency[a];
+				if (emitted[triangle])
+					continue;
+				const uint32_t* corners = indices + triangle * 3;
+				uint32_t newVertices = CountNewVertices(corners, localIndex);
+				if (newVertices > bestNew)
+					continue;
+				glm::vec3 centroid = (data.Vertices[corners[0]].Position + data.Vertices[corners[1]].Position + data.Vertices[corners[2]].Position) / 3.0f;
+				float distance = glm::dot(centroid - center, centroid - center);
+				if (newVertices < bestNew || distance < bestDistance)
+				{
+					best = triangle;
+					bestNew = newVertices;
+					bestDistance = distance;
+				}
+			}
+		}
+
+		// nothing adjacent left, continue in index order
+		if (best == triangleCount)
+		{
+			while (emitted[cursor])
+				cursor++;
+			best = cursor;
+			bestNew = CountNewVertices(indices + best * 3, localIndex);
+		}
+
+		if (meshlet.VertexCount + bestNew > maxVertices || meshlet.TriangleCount == maxTriangles)
+			finishMeshlet();
+
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = indices[best * 3 + corner];
+			if (localIndex[vertex] == NOT_IN_MESHLET)
+			{
+				localIndex[vertex] = meshlet.VertexCount++;
+				result.Vertices.push_back(vertex);
+				positionSum += data.Vertices[vertex].Position;
+			}
+			result.Triangles.push_back(static_cast<uint8_t>(localIndex[vertex]));
+			output.push_back(vertex);
+			live[vertex]--;
+		}
+		emitted[best] = true;
+		meshlet.TriangleCount++;
+	}
+	finishMeshlet();
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+bool MeshletBuilder::IsWorthBuilding(const MeshData& data)
+{
+	size_t indexCount = data.Lods.empty() ? data.Indices.size() : data.Lods[0].IndexCount;
+	return indexCount / 3 >= MESHLET_MIN_TRIANGLES;
+}
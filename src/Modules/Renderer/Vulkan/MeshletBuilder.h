@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include "Mesh.h"
+
+// Limits of one meshlet, what mesh shaders on current GPUs output per workgroup
+// without spilling. 124 triangles keep the local indices a multiple of 4 bytes.
+const uint32_t MAX_MESHLET_VERTICES = 64;
+const uint32_t MAX_MESHLET_TRIANGLES = 124;
+// Meshes with fewer triangles in their full level are only culled as a whole
+const uint32_t MESHLET_MIN_TRIANGLES = 4096;
+
+// Splits the full level of detail into meshlets for culling below the object
+// level. CPU only, the result is plain data that goes into mesh files as is.
+namespace MeshletBuilder
+{
+	// Greedily grows each meshlet by the triangle adjacent to it that adds the
+	// fewest vertices, the one closest to the meshlet center among those, so
+	// meshlets stay round and their bounds tight. Falls back to the next triangle
+	// in index order. Rewrites level 0 of data.Indices in meshlet order and fills
+	// data.Meshlets with the bounding sphere and normal cone of each. Run it
+	// after the optimizer, which would reorder the triangles again.
+	void Build(MeshData& data, uint32_t maxVertices = MAX_MESHLET_VERTICES, uint32_t maxTriangles = MAX_MESHLET_TRIANGLES);
+
+	// Whether Build is worth it for the triangle count of the full level
+	bool IsWorthBuilding(const MeshData& data);
+}
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include "MipChain.h"
+
+namespace
+{
+	float LinearToSrgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	const std::array<float, 256>& GetSrgbToLinearTable()
+	{
+		static const std::array<float, 256> table = []()
+		{
+			std::array<float, 256> values;
+			for (int i = 0; i < 256; i++)
+			{
+				float value = i / 255.0f;
+				values[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+			}
+			return values;
+		}();
+		return table;
+	}
+}
+
+uint32_t ComputeMipLevels(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+		levels++;
+	return levels;
+}
+
+// Odd sizes clamp the last row / column instead of widening the kernel
+void DownsampleRGBA8(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* destination, uint32_t width, uint32_t height, bool srgb)
+{
+	const std::array<float, 256>& toLinear = GetSrgbToLinearTable();
+	for (uint32_t y = 0; y < height; y++)
+	{
+		uint32_t y0 = std::min(y * 2, sourceHeight - 1);
+		uint32_t y1 = std::min(y * 2 + 1, sourceHeight - 1);
+		for (uint32_t x = 0; x < width; x++)
+		{
+			uint32_t x0 = std::min(x * 2, sourceWidth - 1);
+			uint32_t x1 = std::min(x * 2 + 1, sourceWidth - 1);
+			const uint8_t* texels[4] = {
+				source + (y0 * sourceWidth + x0) * 4,
+				source + (y0 * sourceWidth + x1) * 4,
+				source + (y1 * sourceWidth + x0) * 4,
+				source + (y1 * sourceWidth + x1) * 4
+			};
+
+			uint8_t* out = destination + (y * width + x) * 4;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				if (srgb && channel < 3)
+				{
+					float sum = 0.0f;
+					for (const uint8_t* texel : texels)
+						sum += toLinear[texel[channel]];
+					out[channel] = static_cast<uint8_t>(LinearToSrgb(sum * 0.25f) * 255.0f + 0.5f);
+				}
+				else
+					out[channel] = static_cast<uint8_t>((texels[0][channel] + texels[1][channel] + texels[2][channel] + texels[3][channel] + 2) / 4);
+			}
+		}
+	}
+}
+
+std::vector<uint8_t> BuildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, std::vector<MipLevel>& levels)
+{
+	levels.clear();
+	size_t size = 0;
+	uint32_t levelCount = ComputeMipLevels(width, height);
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		MipLevel mip{ size, std::max(width >> level, 1u), std::max(height >> level, 1u) };
+		levels.push_back(mip);
+		size += static_cast<size_t>(mip.Width) * mip.Height * 4;
+	}
+
+	std::vector<uint8_t> chain(size);
+	memcpy(chain.data(), pixels, static_cast<size_t>(width) * height * 4);
+	for (uint32_t level = 1; level < levelCount; level++)
+	{
+		const MipLevel& source = levels[level - 1];
+		const MipLevel& destination = levels[level];
+		DownsampleRGBA8(chain.data() + source.Offset, source.Width, source.Height, chain.data() + destination.Offset, destination.Width, destination.Height, srgb);
+	}
+	return chain;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// One level of a mip chain packed into a single buffer
+struct MipLevel
+{
+	size_t Offset;
+	uint32_t Width;
+	uint32_t Height;
+};
+
+// Number of levels in a full chain down to 1x1
+uint32_t ComputeMipLevels(uint32_t width, uint32_t height);
+
+// 2x2 box filter from one RGBA8 level into the next smaller one. With srgb the
+// colour channels are averaged in linear space, alpha always is.
+void DownsampleRGBA8(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* destination, uint32_t width, uint32_t height, bool srgb);
+
+// Builds every level of an RGBA8 image on the CPU, largest first
+std::vector<uint8_t> BuildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, std::vector<MipLevel>& levels);
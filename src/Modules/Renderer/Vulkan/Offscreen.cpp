@@ -0,0 +1,236 @@
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#include <stdexcept>
+#include "Offscreen.h"
+
+Offscreen::Offscreen(Device& device, uint32_t width, uint32_t height)
+	: m_Device(device), m_Extent(width, height)
+{
+}
+
+Offscreen::~Offscreen()
+{
+}
+
+void Offscreen::Initialize()
+{
+	CreateRenderPass();
+	CreateImages();
+	CreateFramebuffer();
+}
+
+void Offscreen::Terminate()
+{
+	DestroyFramebuffer();
+	DestroyImages();
+	DestroyRenderPass();
+}
+
+void Offscreen::Resize(uint32_t width, uint32_t height)
+{
+	DestroyFramebuffer();
+	DestroyImages();
+
+	m_Extent = vk::Extent2D(width, height);
+
+	CreateImages();
+	CreateFramebuffer();
+}
+
+void Offscreen::ReadPixels(std::vector<uint8_t>& pixels)
+{
+	vk::DeviceSize imageSize = static_cast<vk::DeviceSize>(m_Extent.width) * m_Extent.height * 4;
+
+	vk::DeviceMemory readbackMemory;
+	vk::Buffer readbackBuffer = m_Device.CreateBuffer(
+		imageSize,
+		vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		MemoryCategory::Staging,
+		readbackMemory
+	);
+
+	vk::CommandBuffer commandBuffer = m_Device.BeginSingleTimeCommands();
+
+	vk::BufferImageCopy region(
+		0, 0, 0,
+		vk::ImageSubresourceLayers(
+			vk::ImageAspectFlagBits::eColor,
+			0, 0, 1
+		),
+		vk::Offset3D(0, 0, 0),
+		vk::Extent3D(m_Extent.width, m_Extent.height, 1)
+	);
+
+	// the render pass leaves the color image in transfer source layout
+	commandBuffer.copyImageToBuffer(
+		m_ColorImage,
+		vk::ImageLayout::eTransferSrcOptimal,
+		readbackBuffer,
+		1, &region
+	);
+
+	m_Device.EndSingleTimeCommands(commandBuffer);
+
+	pixels.resize(static_cast<size_t>(imageSize));
+	void* data = m_Device.GetDevice().mapMemory(readbackMemory, 0, imageSize, vk::MemoryMapFlags());
+	memcpy(pixels.data(), data, static_cast<size_t>(imageSize));
+	m_Device.GetDevice().unmapMemory(readbackMemory);
+
+	m_Device.GetDevice().destroyBuffer(readbackBuffer);
+	m_Device.FreeMemory(readbackMemory);
+}
+
+void Offscreen::SavePNG(const std::string& filename)
+{
+	std::vector<uint8_t> pixels;
+	ReadPixels(pixels);
+
+	int stride = static_cast<int>(m_Extent.width * 4);
+	if (!stbi_write_png(filename.c_str(), m_Extent.width, m_Extent.height, 4, pixels.data(), stride))
+		throw std::runtime_error("Failed to write " + filename);
+}
+
+void Offscreen::CreateImages()
+{
+	m_ColorImage = m_Device.CreateImage(
+		m_Extent.width,
+		m_Extent.height,
+		1,
+		m_ImageFormat,
+		vk::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Attachment,
+		m_ColorImageMemory
+	);
+	m_ColorImageView = m_Device.CreateImageView(m_ColorImage, m_ImageFormat, vk::ImageAspectFlagBits::eColor);
+
+	m_DepthImage = m_Device.CreateImage(
+		m_Extent.width,
+		m_Extent.height,
+		1,
+		m_DepthFormat,
+		vk::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eDepthStencilAttachment,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Attachment,
+		m_DepthImageMemory
+	);
+	m_DepthImageView = m_Device.CreateImageView(m_DepthImage, m_DepthFormat, vk::ImageAspectFlagBits::eDepth);
+}
+
+void Offscreen::DestroyImages()
+{
+	m_Device.GetDevice().destroyImageView(m_ColorImageView);
+	m_Device.GetDevice().destroyImage(m_ColorImage);
+	m_Device.FreeMemory(m_ColorImageMemory);
+
+	m_Device.GetDevice().destroyImageView(m_DepthImageView);
+	m_Device.GetDevice().destroyImage(m_DepthImage);
+	m_Device.FreeMemory(m_DepthImageMemory);
+}
+
+void Offscreen::CreateRenderPass()
+{
+	vk::AttachmentDescription colorAttachment(
+		vk::AttachmentDescriptionFlags(),
+		m_ImageFormat,
+		vk::SampleCountFlagBits::e1,
+		vk::AttachmentLoadOp::eClear,
+		vk::AttachmentStoreOp::eStore,
+		vk::AttachmentLoadOp::eDontCare,
+		vk::AttachmentStoreOp::eDontCare,
+		vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eTransferSrcOptimal
+	);
+
+	vk::AttachmentReference colorAttachmentRef(0, vk::ImageLayout::eColorAttachmentOptimal);
+
+	vk::AttachmentDescription depthAttachment(
+		vk::AttachmentDescriptionFlags(),
+		m_DepthFormat,
+		vk::SampleCountFlagBits::e1,
+		vk::AttachmentLoadOp::eClear,
+		vk::AttachmentStoreOp::eDontCare,
+		vk::AttachmentLoadOp::eDontCare,
+		vk::AttachmentStoreOp::eDontCare,
+		vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eDepthStencilAttachmentOptimal
+	);
+
+	vk::AttachmentReference depthAttachmentRef(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+	vk::SubpassDescription subpass(
+		vk::SubpassDescriptionFlags(),
+		vk::PipelineBindPoint::eGraphics,
+		0,
+		nullptr,
+		1,
+		&colorAttachmentRef,
+		nullptr,
+		&depthAttachmentRef
+	);
+
+	vk::SubpassDependency dependencies[] = {
+		// the depth image is shared by the frames in flight, the last frame's
+		// late depth writes have to finish before this frame clears it
+		vk::SubpassDependency(
+			VK_SUBPASS_EXTERNAL,
+			0,
+			vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests | vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests,
+			vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eTransferRead,
+			vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite
+		),
+		// make the finished frame visible to the readback copy
+		vk::SubpassDependency(
+			0,
+			VK_SUBPASS_EXTERNAL,
+			vk::PipelineStageFlagBits::eColorAttachmentOutput,
+			vk::PipelineStageFlagBits::eTransfer,
+			vk::AccessFlagBits::eColorAttachmentWrite,
+			vk::AccessFlagBits::eTransferRead
+		)
+	};
+
+	vk::AttachmentDescription attachments[] = { colorAttachment, depthAttachment };
+
+	vk::RenderPassCreateInfo renderPassInfo(
+		vk::RenderPassCreateFlags(),
+		2, attachments,
+		1, &subpass,
+		2, dependencies
+	);
+
+	m_RenderPass = m_Device.GetDevice().createRenderPass(renderPassInfo);
+}
+
+void Offscreen::DestroyRenderPass()
+{
+	m_Device.GetDevice().destroyRenderPass(m_RenderPass);
+}
+
+void Offscreen::CreateFramebuffer()
+{
+	vk::ImageView attachments[] = {
+		m_ColorImageView,
+		m_DepthImageView
+	};
+
+	vk::FramebufferCreateInfo framebufferInfo(
+		vk::FramebufferCreateFlags(),
+		m_RenderPass,
+		2, attachments,
+		m_Extent.width,
+		m_Extent.height,
+		1
+	);
+
+	m_Framebuffer = m_Device.GetDevice().createFramebuffer(framebufferInfo);
+}
+
+void Offscreen::DestroyFramebuffer()
+{
+	m_Device.GetDevice().destroyFramebuffer(m_Framebuffer);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <string>
+#include "Device.h"
+
+// Color and depth images rendered to instead of a swap chain when running
+// headless. The color image ends every render pass ready to be copied back
+// to host memory.
+class Offscreen
+{
+public:
+	Offscreen(Device& device, uint32_t width, uint32_t height);
+	~Offscreen();
+
+	Offscreen(const Offscreen &) = delete;
+	void operator=(const Offscreen &) = delete;
+	Offscreen(Offscreen &&) = delete;
+	Offscreen &operator=(Offscreen &&) = delete;
+
+	void Initialize();
+	void Terminate();
+	void Resize(uint32_t width, uint32_t height);
+
+	// Copies the last rendered frame as tightly packed RGBA8 rows, top row first
+	void ReadPixels(std::vector<uint8_t>& pixels);
+	void SavePNG(const std::string& filename);
+
+	vk::Format GetImageFormat() const { return m_ImageFormat; }
+	vk::Extent2D GetExtent() const { return m_Extent; }
+	vk::RenderPass GetRenderPass() const { return m_RenderPass; }
+	vk::Framebuffer GetFramebuffer() const { return m_Framebuffer; }
+
+private:
+	void CreateImages();
+	void DestroyImages();
+	void CreateRenderPass();
+	void DestroyRenderPass();
+	void CreateFramebuffer();
+	void DestroyFramebuffer();
+
+	Device& m_Device;
+	vk::RenderPass m_RenderPass;
+	vk::Framebuffer m_Framebuffer;
+	vk::Format m_ImageFormat = vk::Format::eR8G8B8A8Srgb;
+	vk::Format m_DepthFormat = vk::Format::eD32SfloatS8Uint;
+	vk::Extent2D m_Extent = {0, 0};
+
+	vk::Image m_ColorImage;
+	vk::DeviceMemory m_ColorImageMemory;
+	vk::ImageView m_ColorImageView;
+
+	vk::Image m_DepthImage;
+	vk::DeviceMemory m_DepthImageMemory;
+	vk::ImageView m_DepthImageView;
+};
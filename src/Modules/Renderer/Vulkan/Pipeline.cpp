@@ -1,5 +1,39 @@
 #include <fstream>
 #include "Pipeline.h"
+#include "../../../Core/Profiler.h"
+
+namespace
+{
+	std::vector<char> ReadFile(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open file");
+
+		size_t fileSize = (size_t)file.tellg();
+		std::vector<char> buffer(fileSize);
+
+		file.seekg(0);
+		file.read(buffer.data(), fileSize);
+
+		file.close();
+
+		return buffer;
+	}
+
+	vk::ShaderModule CreateShaderModule(vk::Device device, const std::string& filename)
+	{
+		std::vector<char> code = ReadFile(filename);
+		vk::ShaderModuleCreateInfo createInfo(
+			vk::ShaderModuleCreateFlags(),
+			code.size(),
+			reinterpret_cast<const uint32_t*>(code.data())
+		);
+
+		return device.createShaderModule(createInfo);
+	}
+}
 
 Pipeline::Pipeline(vk::Device device, vk::RenderPass renderPass)
 	: m_Device(device), m_RenderPass(renderPass){}
@@ -11,11 +45,8 @@ void Pipeline::Create(
 	const std::string &fragmentSource,
 	PipelineConfig config)
 {
-	auto vertShaderCode = ReadFile(vertexSource);
-	auto fragShaderCode = ReadFile(fragmentSource);
-
-	vk::ShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
-	vk::ShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+	PROFILE_SCOPE("Pipeline::Create");
+	vk::ShaderModule vertShaderModule = CreateShaderModule(m_Device, vertexSource);
 
 	vk::PipelineShaderStageCreateInfo vertShaderStageInfo(
 		vk::PipelineShaderStageCreateFlags(),
@@ -24,14 +55,64 @@ void Pipeline::Create(
 		"main"
 	);
 
+	m_PushConstantStages = vk::ShaderStageFlagBits::eVertex;
+	CreateGraphicsPipeline({ vertShaderStageInfo }, fragmentSource, config, true);
+	m_Device.destroyShaderModule(vertShaderModule);
+}
+
+void Pipeline::CreateMeshShading(
+	const std::string& taskSource,
+	const std::string& meshSource,
+	const std::string& fragmentSource,
+	PipelineConfig config)
+{
+	PROFILE_SCOPE("Pipeline::CreateMeshShading");
+	vk::ShaderModule taskShaderModule = CreateShaderModule(m_Device, taskSource);
+	vk::ShaderModule meshShaderModule = CreateShaderModule(m_Device, meshSource);
+
+	vk::PipelineShaderStageCreateInfo taskShaderStageInfo(
+		vk::PipelineShaderStageCreateFlags(),
+		vk::ShaderStageFlagBits::eTaskEXT,
+		taskShaderModule,
+		"main"
+	);
+	vk::PipelineShaderStageCreateInfo meshShaderStageInfo(
+		vk::PipelineShaderStageCreateFlags(),
+		vk::ShaderStageFlagBits::eMeshEXT,
+		meshShaderModule,
+		"main"
+	);
+
+	m_PushConstantStages = vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+	CreateGraphicsPipeline({ taskShaderStageInfo, meshShaderStageInfo }, fragmentSource, config, false);
+	m_Device.destroyShaderModule(taskShaderModule);
+	m_Device.destroyShaderModule(meshShaderModule);
+}
+
+void Pipeline::CreateGraphicsPipeline(const std::vector<vk::PipelineShaderStageCreateInfo>& stages, const std::string& fragmentSource, const PipelineConfig& config, bool vertexInput)
+{
+	vk::ShaderModule fragShaderModule = CreateShaderModule(m_Device, fragmentSource);
+
+	std::vector<vk::SpecializationMapEntry> fragConstantEntries;
+	for (uint32_t i = 0; i < config.FragmentConstants.size(); i++)
+		fragConstantEntries.emplace_back(i, i * sizeof(uint32_t), sizeof(uint32_t));
+	vk::SpecializationInfo fragSpecialization(
+		static_cast<uint32_t>(fragConstantEntries.size()),
+		fragConstantEntries.data(),
+		config.FragmentConstants.size() * sizeof(uint32_t),
+		config.FragmentConstants.data()
+	);
+
 	vk::PipelineShaderStageCreateInfo fragShaderStageInfo(
 		vk::PipelineShaderStageCreateFlags(),
 		vk::ShaderStageFlagBits::eFragment,
 		fragShaderModule,
-		"main"
+		"main",
+		config.FragmentConstants.empty() ? nullptr : &fragSpecialization
 	);
 
-	vk::PipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+	std::vector<vk::PipelineShaderStageCreateInfo> shaderStages = stages;
+	shaderStages.push_back(fragShaderStageInfo);
 
 	std::vector<vk::DynamicState> dynamicStates = {
 		vk::DynamicState::eViewport,
@@ -112,7 +193,7 @@ void Pipeline::Create(
 	);
 
 	vk::PushConstantRange pushConstantRange(
-		vk::ShaderStageFlagBits::eVertex,
+		m_PushConstantStages,
 		0,
 		config.PushConstantRangeSize
 	);
@@ -128,10 +209,10 @@ void Pipeline::Create(
 
 	vk::GraphicsPipelineCreateInfo pipelineInfo(
 		vk::PipelineCreateFlags(),
-		2,
-		shaderStages,
-		&vertexInputInfo,
-		&inputAssembly,
+		static_cast<uint32_t>(shaderStages.size()),
+		shaderStages.data(),
+		vertexInput ? &vertexInputInfo : nullptr,
+		vertexInput ? &inputAssembly : nullptr,
 		nullptr,
 		&viewportState,
 		&rasterizer,
@@ -154,7 +235,6 @@ void Pipeline::Create(
 	//m_DescriptorSetLayouts = std::vector<vk::DescriptorSetLayout>(descriptorSetLayouts, descriptorSetLayouts + 2);
 	m_Pipeline = pipeline;
 
-	m_Device.destroyShaderModule(vertShaderModule);
 	m_Device.destroyShaderModule(fragShaderModule);
 }
 
@@ -169,31 +249,62 @@ void Pipeline::Bind(vk::CommandBuffer commandBuffer)
     commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_Pipeline);
 }
 
-vk::ShaderModule Pipeline::CreateShaderModule(const std::vector<char>& code)
+ComputePipeline::ComputePipeline(vk::Device device)
+	: m_Device(device) {}
+
+void ComputePipeline::Create(
+	const std::string& computeSource,
+	uint32_t setLayoutCount,
+	const vk::DescriptorSetLayout* setLayouts,
+	uint32_t pushConstantRangeSize)
 {
-	vk::ShaderModuleCreateInfo createInfo(
-		vk::ShaderModuleCreateFlags(),
-		code.size(),
-		reinterpret_cast<const uint32_t*>(code.data())
+	PROFILE_SCOPE("ComputePipeline::Create");
+	vk::ShaderModule computeShaderModule = CreateShaderModule(m_Device, computeSource);
+
+	vk::PushConstantRange pushConstantRange(
+		vk::ShaderStageFlagBits::eCompute,
+		0,
+		pushConstantRangeSize
 	);
 
-	return m_Device.createShaderModule(createInfo);
-}
+	vk::PipelineLayoutCreateInfo pipelineLayoutInfo(
+		vk::PipelineLayoutCreateFlags(),
+		setLayoutCount,
+		setLayouts,
+		pushConstantRangeSize > 0 ? 1 : 0, &pushConstantRange
+	);
 
-std::vector<char> Pipeline::ReadFile(const std::string& filename)
-{
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+	m_Layout = m_Device.createPipelineLayout(pipelineLayoutInfo);
 
-	if (!file.is_open())
-		throw std::runtime_error("Failed to open file");
+	vk::ComputePipelineCreateInfo pipelineInfo(
+		vk::PipelineCreateFlags(),
+		vk::PipelineShaderStageCreateInfo(
+			vk::PipelineShaderStageCreateFlags(),
+			vk::ShaderStageFlagBits::eCompute,
+			computeShaderModule,
+			"main"
+		),
+		m_Layout
+	);
 
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> buffer(fileSize);
+	vk::Result result;
+	vk::Pipeline pipeline;
+	std::tie(result, pipeline) = m_Device.createComputePipeline( nullptr, pipelineInfo );
 
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
+	if (result != vk::Result::eSuccess)
+		throw std::runtime_error("Failed to create compute pipeline");
 
-	file.close();
+	m_Pipeline = pipeline;
+	m_Device.destroyShaderModule(computeShaderModule);
+}
 
-	return buffer;
-}
\ No newline at end of file
+void ComputePipeline::Terminate()
+{
+	m_Device.destroyPipeline(m_Pipeline);
+	m_Device.destroyPipelineLayout(m_Layout);
+}
+
+void ComputePipeline::Bind(vk::CommandBuffer commandBuffer)
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_Pipeline);
+}
@@ -13,6 +13,8 @@ struct PipelineConfig
 	vk::PolygonMode PolygonMode = vk::PolygonMode::eFill;
 	vk::PrimitiveTopology Topology = vk::PrimitiveTopology::eTriangleList;
 	vk::CullModeFlagBits CullMode = vk::CullModeFlagBits::eBack;
+	// 32-bit specialization constants of the fragment shader, by constant_id
+	std::vector<uint32_t> FragmentConstants;
 };
 
 class Pipeline
@@ -25,19 +27,50 @@ public:
 		const std::string& vertexSource,
 		const std::string& fragmentSource,
 		PipelineConfig config);
+	// Task and mesh shaders instead of vertex input and a vertex shader, needs
+	// VK_EXT_mesh_shader. The binding and attributes of config are ignored.
+	void CreateMeshShading(
+		const std::string& taskSource,
+		const std::string& meshSource,
+		const std::string& fragmentSource,
+		PipelineConfig config);
 	void Terminate();
     void Bind(vk::CommandBuffer commandBuffer);
 
 	vk::Pipeline GetPipeline() const { return m_Pipeline; }
 	vk::PipelineLayout GetLayout() const { return m_Layout; }
+	// Stages the push constants are visible to, pass these to pushConstants
+	vk::ShaderStageFlags GetPushConstantStages() const { return m_PushConstantStages; }
 
 private:
-	std::vector<char> ReadFile(const std::string& filename);
-	vk::ShaderModule CreateShaderModule(const std::vector<char>& code);
+	void CreateGraphicsPipeline(const std::vector<vk::PipelineShaderStageCreateInfo>& stages, const std::string& fragmentSource, const PipelineConfig& config, bool vertexInput);
 
 private:
 	vk::Device m_Device;
 	vk::Pipeline m_Pipeline;
 	vk::PipelineLayout m_Layout;
 	vk::RenderPass m_RenderPass;
+	vk::ShaderStageFlags m_PushConstantStages = vk::ShaderStageFlagBits::eVertex;
+};
+
+class ComputePipeline
+{
+public:
+	ComputePipeline(vk::Device device);
+
+	void Create(
+		const std::string& computeSource,
+		uint32_t setLayoutCount,
+		const vk::DescriptorSetLayout* setLayouts,
+		uint32_t pushConstantRangeSize);
+	void Terminate();
+	void Bind(vk::CommandBuffer commandBuffer);
+
+	vk::Pipeline GetPipeline() const { return m_Pipeline; }
+	vk::PipelineLayout GetLayout() const { return m_Layout; }
+
+private:
+	vk::Device m_Device;
+	vk::Pipeline m_Pipeline;
+	vk::PipelineLayout m_Layout;
 };
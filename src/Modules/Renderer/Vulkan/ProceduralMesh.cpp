@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <glm/gtc/constants.hpp>
+#include "ProceduralMesh.h"
+#include "../../../Core/Profiler.h"
+
+namespace
+{
+	// Row of a surface of revolution: a circle of the given radius at height Y
+	struct ProfileRow
+	{
+		float Radius;
+		float Y;
+		glm::vec2 Normal;	// x = radial, y = up
+		float V;			// texture coordinate along the profile
+	};
+
+	struct Circle
+	{
+		std::vector<float> Cos;
+		std::vector<float> Sin;
+	};
+
+	// steps + 1 points, the last one exactly equal to the first so the seam closes
+	Circle MakeCircle(uint32_t steps)
+	{
+		Circle circle;
+		circle.Cos.resize(steps + 1);
+		circle.Sin.resize(steps + 1);
+		for (uint32_t i = 0; i < steps; i++)
+		{
+			float angle = glm::two_pi<float>() * i / steps;
+			circle.Cos[i] = std::cos(angle);
+			circle.Sin[i] = std::sin(angle);
+		}
+		circle.Cos[steps] = circle.Cos[0];
+		circle.Sin[steps] = circle.Sin[0];
+		return circle;
+	}
+
+	// Runs function(begin, end) over row ranges covering [0, rows), in chunks
+	// on the pool when there is enough work. The caller takes the last chunk.
+	template <typename Function>
+	void ForEachRowChunk(uint32_t rows, size_t vertexCount, ThreadPool* pool, Function function)
+	{
+		if (pool == nullptr || pool->GetThreadCount() == 0 || vertexCount < PROCEDURAL_PARALLEL_MIN_VERTICES || rows < 2)
+		{
+			function(0u, rows);
+			return;
+		}
+
+		// a few chunks per thread so uneven scheduling evens out
+		uint32_t chunkCount = std::min(rows, (pool->GetThreadCount() + 1) * 4);
+		uint32_t chunkRows = (rows + chunkCount - 1) / chunkCount;
+		std::vector<std::future<void>> chunks;
+		uint32_t begin = 0;
+		for (; begin + chunkRows < rows; begin += chunkRows)
+		{
+			uint32_t end = begin + chunkRows;
+			chunks.push_back(pool->Submit([&function, begin, end]() { function(begin, end); }));
+		}
+		function(begin, rows);
+		for (std::future<void>& chunk : chunks)
+			chunk.get();
+	}
+
+	void CheckVertexCount(uint64_t vertexCount)
+	{
+		if (vertexCount > UINT32_MAX)
+			throw std::runtime_error("Procedural mesh has too many vertices for 32-bit indices");
+	}
+
+	// Quads between vertex rows row and row + 1 of the lattice at the start of data
+	void WriteLatticeRow(MeshData& data, uint32_t columns, uint32_t row)
+	{
+		uint32_t* indices = data.Indices.data() + static_cast<size_t>(row) * columns * 6;
+		for (uint32_t j = 0; j < columns; j++)
+		{
+			uint32_t k1 = row * (columns + 1) + j;
+			uint32_t k2 = k1 + columns + 1;
+			*indices++ = k1;
+			*indices++ = k1 + 1;
+			*indices++ = k2;
+
+			*indices++ = k2;
+			*indices++ = k1 + 1;
+			*indices++ = k2 + 1;
+		}
+	}
+
+	// Surface of revolution around +Y, profile rows from top to bottom so the
+	// triangles face outwards. extraVertices and extraIndices are left for caps.
+	MeshData Revolve(const std::vector<ProfileRow>& profile, uint32_t segments, ThreadPool* pool, uint32_t extraVertices = 0, size_t extraIndices = 0)
+	{
+		uint32_t rows = static_cast<uint32_t>(profile.size());
+		uint64_t latticeVertices = static_cast<uint64_t>(segments + 1) * rows;
+		CheckVertexCount(latticeVertices + extraVertices);
+
+		MeshData data;
+		data.Vertices.resize(latticeVertices + extraVertices);
+		data.Indices.resize(static_cast<size_t>(segments) * (rows - 1) * 6 + extraIndices);
+
+		Circle circle = MakeCircle(segments);
+		ForEachRowChunk(rows, data.Vertices.size(), pool, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const ProfileRow& row = profile[i];
+				Vertex* vertex = data.Vertices.data() + static_cast<size_t>(i) * (segments + 1);
+				for (uint32_t j = 0; j <= segments; j++, vertex++)
+				{
+					vertex->Position = glm::vec3(row.Radius * circle.Cos[j], row.Y, row.Radius * circle.Sin[j]);
+					vertex->TexCoord = glm::vec2(static_cast<float>(segments - j) / segments, row.V);
+					vertex->Normal = glm::vec3(row.Normal.x * circle.Cos[j], row.Normal.y, row.Normal.x * circle.Sin[j]);
+				}
+				if (i + 1 < rows)
+					WriteLatticeRow(data, segments, i);
+			}
+		});
+		return data;
+	}
+
+	// Disc closing a revolved mesh at height y, facing up or down
+	void WriteCap(MeshData& data, uint32_t firstVertex, size_t firstIndex, uint32_t segments, float radius, float y, bool up)
+	{
+		Circle circle = MakeCircle(segments);
+		glm::vec3 normal(0.0f, up ? 1.0f : -1.0f, 0.0f);
+		data.Vertices[firstVertex] = { glm::vec3(0.0f, y, 0.0f), glm::vec2(0.5f), normal };
+		for (uint32_t j = 0; j <= segments; j++)
+		{
+			data.Vertices[firstVertex + 1 + j] = {
+				glm::vec3(radius * circle.Cos[j], y, radius * circle.Sin[j]),
+				glm::vec2(0.5f + 0.5f * circle.Cos[j], 0.5f + 0.5f * circle.Sin[j]),
+				normal
+			};
+		}
+
+		uint32_t* indices = data.Indices.data() + firstIndex;
+		for (uint32_t j = 0; j < segments; j++)
+		{
+			uint32_t current = firstVertex + 1 + j;
+			*indices++ = firstVertex;
+			*indices++ = up ? current + 1 : current;
+			*indices++ = up ? current : current + 1;
+		}
+	}
+
+	MeshData GenerateSphere(const ProceduralMeshDesc& desc, ThreadPool* pool)
+	{
+		uint32_t rings = std::max(desc.Rings, 2u);
+		std::vector<ProfileRow> profile(rings + 1);
+		for (uint32_t i = 0; i <= rings; i++)
+		{
+			float v = static_cast<float>(i) / rings;
+			float phi = v * glm::pi<float>();
+			// exact poles, sin(pi) in floats is not zero
+			float sinPhi = i == 0 || i == rings ? 0.0f : std::sin(phi);
+			float cosPhi = i == 0 ? 1.0f : i == rings ? -1.0f : std::cos(phi);
+			profile[i] = { desc.Radius * sinPhi, desc.Radius * cosPhi, glm::vec2(sinPhi, cosPhi), v };
+		}
+		return Revolve(profile, std::max(desc.Segments, 3u), pool);
+	}
+
+	MeshData GenerateCapsule(const ProceduralMeshDesc& desc, ThreadPool* pool)
+	{
+		// two hemispheres, their equators joined by the cylinder quads in between
+		uint32_t rings = std::max(desc.Rings, 1u);
+		float halfHeight = desc.Height * 0.5f;
+		float length = desc.Height + glm::pi<float>() * desc.Radius;
+		std::vector<ProfileRow> profile(2 * (rings + 1));
+		for (uint32_t i = 0; i <= rings; i++)
+		{
+			float phi = glm::half_pi<float>() * i / rings;
+			float sinPhi = i == rings ? 1.0f : std::sin(phi);
+			float cosPhi = i == rings ? 0.0f : std::cos(phi);
+			float arc = desc.Radius * phi;
+			profile[i] = { desc.Radius * sinPhi, halfHeight + desc.Radius * cosPhi, glm::vec2(sinPhi, cosPhi), length > 0.0f ? arc / length : 0.0f };
+			// mirrored for the lower hemisphere, bottom row last
+			profile[2 * rings + 1 - i] = { desc.Radius * sinPhi, -halfHeight - desc.Radius * cosPhi, glm::vec2(sinPhi, -cosPhi), length > 0.0f ? 1.0f - arc / length : 1.0f };
+		}
+		return Revolve(profile, std::max(desc.Segments, 3u), pool);
+	}
+
+	MeshData GenerateTorus(const ProceduralMeshDesc& desc, ThreadPool* pool)
+	{
+		// around the tube against the usual direction, so the quads face outwards
+		uint32_t sides = std::max(desc.Rings, 3u);
+		Circle tube = MakeCircle(sides);
+		std::vector<ProfileRow> profile(sides + 1);
+		for (uint32_t i = 0; i <= sides; i++)
+		{
+			float cosPhi = tube.Cos[sides - i];
+			float sinPhi = tube.Sin[sides - i];
+			profile[i] = { desc.Radius + desc.Height * cosPhi, desc.Height * sinPhi, glm::vec2(cosPhi, sinPhi), static_cast<float>(i) / sides };
+		}
+		return Revolve(profile, std::max(desc.Segments, 3u), pool);
+	}
+
+	MeshData GenerateCylinder(const ProceduralMeshDesc& desc, ThreadPool* pool)
+	{
+		uint32_t segments = std::max(desc.Segments, 3u);
+		uint32_t rings = std::max(desc.Rings, 1u);
+		float halfHeight = desc.Height * 0.5f;
+		std::vector<ProfileRow> profile(rings + 1);
+		for (uint32_t i = 0; i <= rings; i++)
+		{
+			float v = static_cast<float>(i) / rings;
+			profile[i] = { desc.Radius, halfHeight - desc.Height * v, glm::vec2(1.0f, 0.0f), v };
+		}
+
+		// a center and a closed ring per cap
+		uint32_t capVertices = segments + 2;
+		size_t capIndices = static_cast<size_t>(segments) * 3;
+		MeshData data = Revolve(profile, segments, pool, 2 * capVertices, 2 * capIndices);
+		uint32_t sideVertices = static_cast<uint32_t>(data.Vertices.size()) - 2 * capVertices;
+		size_t sideIndices = data.Indices.size() - 2 * capIndices;
+		WriteCap(data, sideVertices, sideIndices, segments, desc.Radius, halfHeight, true);
+		WriteCap(data, sideVertices + capVertices, sideIndices + capIndices, segments, desc.Radius, -halfHeight, false);
+		return data;
+	}
+
+	MeshData GenerateGrid(const ProceduralMeshDesc& desc, ThreadPool* pool)
+	{
+		// rows run towards -Z so the quads face +Y
+		uint32_t columns = std::max(desc.Segments, 1u);
+		uint32_t rows = std::max(desc.Rings, 1u);
+		uint64_t vertexCount = static_cast<uint64_t>(columns + 1) * (rows + 1);
+		CheckVertexCount(vertexCount);
+
+		MeshData data;
+		data.Vertices.resize(vertexCount);
+		data.Indices.resize(static_cast<size_t>(columns) * rows * 6);
+
+		ForEachRowChunk(rows + 1, data.Vertices.size(), pool, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				float v = static_cast<float>(i) / rows;
+				Vertex* vertex = data.Vertices.data() + static_cast<size_t>(i) * (columns + 1);
+				for (uint32_t j = 0; j <= columns; j++, vertex++)
+				{
+					float u = static_cast<float>(j) / columns;
+					vertex->Position = glm::vec3((u - 0.5f) * desc.Radius, 0.0f, (0.5f - v) * desc.Height);
+					vertex->TexCoord = glm::vec2(u, v);
+					vertex->Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+				}
+				if (i < rows)
+					WriteLatticeRow(data, columns, i);
+			}
+		});
+		return data;
+	}
+}
+
+ProceduralMeshDesc ProceduralMeshDesc::Sphere(uint32_t segments, uint32_t rings, float radius)
+{
+	return { ProceduralShape::Sphere, segments, rings, radius, 0.0f };
+}
+
+ProceduralMeshDesc ProceduralMeshDesc::Capsule(uint32_t segments, uint32_t rings, float radius, float height)
+{
+	return { ProceduralShape::Capsule, segments, rings, radius, height };
+}
+
+ProceduralMeshDesc ProceduralMeshDesc::Torus(uint32_t segments, uint32_t sides, float radius, float tubeRadius)
+{
+	return { ProceduralShape::Torus, segments, sides, radius, tubeRadius };
+}
+
+ProceduralMeshDesc ProceduralMeshDesc::Cylinder(uint32_t segments, uint32_t rings, float radius, float height)
+{
+	return { ProceduralShape::Cylinder, segments, rings, radius, height };
+}
+
+ProceduralMeshDesc ProceduralMeshDesc::Grid(uint32_t columns, uint32_t rows, float width, float depth)
+{
+	return { ProceduralShape::Grid, columns, rows, width, depth };
+}
+
+size_t ProceduralMeshDescHash::operator()(const ProceduralMeshDesc& desc) const
+{
+	size_t hash = std::hash<uint32_t>()(static_cast<uint32_t>(desc.Shape));
+	auto combine = [&hash](size_t value) { hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2); };
+	combine(std::hash<uint32_t>()(desc.Segments));
+	combine(std::hash<uint32_t>()(desc.Rings));
+	combine(std::hash<float>()(desc.Radius));
+	combine(std::hash<float>()(desc.Height));
+	return hash;
+}
+
+MeshData ProceduralMesh::Generate(const ProceduralMeshDesc& desc, ThreadPool* pool)
+{
+	PROFILE_SCOPE("ProceduralMesh::Generate");
+	switch (desc.Shape)
+	{
+	case ProceduralShape::Sphere: return GenerateSphere(desc, pool);
+	case ProceduralShape::Capsule: return GenerateCapsule(desc, pool);
+	case ProceduralShape::Torus: return GenerateTorus(desc, pool);
+	case ProceduralShape::Cylinder: return GenerateCylinder(desc, pool);
+	case ProceduralShape::Grid: return GenerateGrid(desc, pool);
+	}
+	throw std::runtime_error("Unknown procedural shape");
+}
+
+ProceduralMeshCache& ProceduralMeshCache::Get()
+{
+	static ProceduralMeshCache cache;
+	return cache;
+}
+
+std::shared_ptr<const MeshData> ProceduralMeshCache::GetMesh(const ProceduralMeshDesc& desc, ThreadPool* pool)
+{
+	std::promise<std::shared_ptr<const MeshData>> promise;
+	std::shared_future<std::shared_ptr<const MeshData>> mesh;
+	bool generate = false;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_Meshes.find(desc);
+		if (it != m_Meshes.end())
+			mesh = it->second;
+		else
+		{
+			mesh = promise.get_future().share();
+			m_Meshes.emplace(desc, mesh);
+			generate = true;
+		}
+	}
+
+	// outside the lock, other descriptions generate meanwhile
+	if (generate)
+	{
+		try
+		{
+			promise.set_value(std::make_shared<const MeshData>(ProceduralMesh::Generate(desc, pool)));
+		}
+		catch (...)
+		{
+			// waiting requests see the error, later ones try again
+			promise.set_exception(std::current_exception());
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Meshes.erase(desc);
+		}
+	}
+	return mesh.get();
+}
+
+void ProceduralMeshCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Meshes.clear();
+}
+
+size_t ProceduralMeshCache::GetSize() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Meshes.size();
+}
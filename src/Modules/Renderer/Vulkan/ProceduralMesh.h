@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "Mesh.h"
+#include "../../../Core/ThreadPool.h"
+
+// Meshes with fewer vertices are generated on the calling thread only
+const uint32_t PROCEDURAL_PARALLEL_MIN_VERTICES = 65536;
+
+enum class ProceduralShape
+{
+	Sphere,		// Radius
+	Capsule,	// Radius, Height of the cylinder between the hemispheres
+	Torus,		// Radius of the ring, Height is the radius of the tube
+	Cylinder,	// Radius, Height, capped at both ends
+	Grid		// Radius x Height in the XZ plane facing +Y, for terrain
+};
+
+// Shape and tessellation, also the key of the procedural mesh cache.
+// Segments go around the axis (grid: columns), Rings along it (grid: rows).
+struct ProceduralMeshDesc
+{
+	ProceduralShape Shape = ProceduralShape::Sphere;
+	uint32_t Segments = 36;
+	uint32_t Rings = 36;
+	float Radius = 1.0f;
+	float Height = 0.0f;
+
+	static ProceduralMeshDesc Sphere(uint32_t segments, uint32_t rings, float radius = 1.0f);
+	// rings per hemisphere
+	static ProceduralMeshDesc Capsule(uint32_t segments, uint32_t rings, float radius = 0.5f, float height = 1.0f);
+	static ProceduralMeshDesc Torus(uint32_t segments, uint32_t sides, float radius = 1.0f, float tubeRadius = 0.25f);
+	static ProceduralMeshDesc Cylinder(uint32_t segments, uint32_t rings = 1, float radius = 0.5f, float height = 1.0f);
+	static ProceduralMeshDesc Grid(uint32_t columns, uint32_t rows, float width = 1.0f, float depth = 1.0f);
+
+	bool operator==(const ProceduralMeshDesc& other) const
+	{
+		return Shape == other.Shape && Segments == other.Segments && Rings == other.Rings && Radius == other.Radius && Height == other.Height;
+	}
+};
+
+struct ProceduralMeshDescHash
+{
+	size_t operator()(const ProceduralMeshDesc& desc) const;
+};
+
+// Parametric shapes written straight into buffers sized up front. Every
+// shape is a lattice of vertex rows, large ones are split into row chunks
+// on the pool. Do not call with a pool from one of that pool's own jobs,
+// the caller blocks on the chunks.
+namespace ProceduralMesh
+{
+	// Tessellations below the minimum of the shape are raised to it
+	MeshData Generate(const ProceduralMeshDesc& desc, ThreadPool* pool = nullptr);
+}
+
+// Process wide memo of generated meshes by description. The first request
+// generates, concurrent requests for the same description wait for it and
+// every later one shares the result.
+class ProceduralMeshCache
+{
+public:
+	static ProceduralMeshCache& Get();
+
+	std::shared_ptr<const MeshData> GetMesh(const ProceduralMeshDesc& desc, ThreadPool* pool = nullptr);
+	// Meshes still referenced elsewhere stay alive until released
+	void Clear();
+	size_t GetSize() const;
+
+private:
+	ProceduralMeshCache() = default;
+
+	mutable std::mutex m_Mutex;
+	std::unordered_map<ProceduralMeshDesc, std::shared_future<std::shared_ptr<const MeshData>>, ProceduralMeshDescHash> m_Meshes;
+};
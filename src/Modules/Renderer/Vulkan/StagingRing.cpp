@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cstring>
+#include "StagingRing.h"
+#include "../../../Core/Profiler.h"
+
+StagingRing::StagingRing(Device& device, vk::DeviceSize size)
+	: m_Device(device),
+	  m_Size(size)
+{
+	m_Buffer = m_Device.CreateBuffer(
+		m_Size,
+		vk::BufferUsageFlagBits::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		MemoryCategory::Staging,
+		m_Memory
+	);
+	m_Mapped = static_cast<uint8_t*>(m_Device.GetDevice().mapMemory(m_Memory, 0, m_Size, vk::MemoryMapFlags()));
+}
+
+StagingRing::~StagingRing()
+{
+	Flush();
+	m_Device.GetDevice().unmapMemory(m_Memory);
+	m_Device.GetDevice().destroyBuffer(m_Buffer);
+	m_Device.FreeMemory(m_Memory);
+}
+
+void StagingRing::Upload(const void* data, vk::DeviceSize size, vk::Buffer destination, vk::DeviceSize destinationOffset)
+{
+	const uint8_t* source = static_cast<const uint8_t*>(data);
+	while (size > 0)
+	{
+		vk::DeviceSize offset = (m_Head + STAGING_RING_ALIGNMENT - 1) / STAGING_RING_ALIGNMENT * STAGING_RING_ALIGNMENT;
+		if (offset >= m_Size)
+		{
+			Flush();
+			offset = 0;
+		}
+
+		// whatever fits now, the rest goes after the next flush
+		vk::DeviceSize chunk = std::min(size, m_Size - offset);
+		memcpy(m_Mapped + offset, source, static_cast<size_t>(chunk));
+		m_Copies.push_back({ destination, vk::BufferCopy(offset, destinationOffset, chunk) });
+
+		m_Head = offset + chunk;
+		source += chunk;
+		destinationOffset += chunk;
+		size -= chunk;
+	}
+}
+
+void StagingRing::Flush()
+{
+	if (m_Copies.empty())
+		return;
+
+	PROFILE_SCOPE("StagingRing::Flush");
+	vk::CommandBuffer commandBuffer = m_Device.BeginSingleTimeCommands();
+	// copies into the same buffer are contiguous, record them together
+	size_t first = 0;
+	std::vector<vk::BufferCopy> regions;
+	for (size_t i = 0; i <= m_Copies.size(); i++)
+	{
+		if (i < m_Copies.size() && m_Copies[i].Destination == m_Copies[first].Destination)
+		{
+			regions.push_back(m_Copies[i].Region);
+			continue;
+		}
+		commandBuffer.copyBuffer(m_Buffer, m_Copies[first].Destination, regions);
+		regions.clear();
+		if (i < m_Copies.size())
+		{
+			first = i;
+			regions.push_back(m_Copies[i].Region);
+		}
+	}
+	m_Device.EndSingleTimeCommands(commandBuffer);
+
+	m_Copies.clear();
+	m_Head = 0;
+	m_FlushCount++;
+}
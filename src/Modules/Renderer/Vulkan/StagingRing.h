@@ -0,0 +1,45 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include "Device.h"
+
+const vk::DeviceSize STAGING_RING_SIZE = 32 * 1024 * 1024;
+// Copy offsets inside the ring, enough for vertex and index data
+const vk::DeviceSize STAGING_RING_ALIGNMENT = 16;
+
+// Persistently mapped upload buffer reused for many buffer uploads. Space is
+// handed out front to back and the copies are queued; once the ring is full
+// they are submitted in one command buffer, waited for, and the ring starts
+// over. Sources are copied in right away and do not need to outlive Upload.
+class StagingRing
+{
+public:
+	StagingRing(Device& device, vk::DeviceSize size = STAGING_RING_SIZE);
+	~StagingRing();
+
+	StagingRing(const StagingRing&) = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+
+	// Queues a copy of size bytes from data into destination, in pieces if larger than the ring
+	void Upload(const void* data, vk::DeviceSize size, vk::Buffer destination, vk::DeviceSize destinationOffset = 0);
+	// Submits the queued copies and waits for them, call before the destinations are used
+	void Flush();
+
+	uint32_t GetFlushCount() const { return m_FlushCount; }
+
+private:
+	struct PendingCopy
+	{
+		vk::Buffer Destination;
+		vk::BufferCopy Region;
+	};
+
+	Device& m_Device;
+	vk::Buffer m_Buffer;
+	vk::DeviceMemory m_Memory;
+	uint8_t* m_Mapped = nullptr;
+	vk::DeviceSize m_Size;
+	vk::DeviceSize m_Head = 0;
+	std::vector<PendingCopy> m_Copies;
+	uint32_t m_FlushCount = 0;
+};
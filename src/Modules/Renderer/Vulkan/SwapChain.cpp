@@ -107,10 +107,12 @@ void SwapChain::CreateDepthResources()
 	m_DepthImage = m_Device.CreateImage(
 		m_Extent.width,
 		m_Extent.height,
+		1,
 		depthFormat,
 		vk::ImageTiling::eOptimal,
 		vk::ImageUsageFlagBits::eDepthStencilAttachment,
 		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Attachment,
 		m_DepthImageMemory
 	);
 
@@ -121,7 +123,7 @@ void SwapChain::DestroyDepthResources()
 {
 	m_Device.GetDevice().destroyImageView(m_DepthImageView);
 	m_Device.GetDevice().destroyImage(m_DepthImage);
-	m_Device.GetDevice().freeMemory(m_DepthImageMemory);
+	m_Device.FreeMemory(m_DepthImageMemory);
 }
 
 void SwapChain::Recreate()
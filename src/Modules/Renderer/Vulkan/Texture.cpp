@@ -1,6 +1,39 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#include <algorithm>
+#include <fstream>
 #include "Texture.h"
+#include "Ktx2.h"
+#include "MipChain.h"
+#include "../../../Core/Profiler.h"
+
+namespace
+{
+	bool HasExtension(const std::string& filename, const std::string& extension)
+	{
+		return filename.size() >= extension.size() && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+	}
+
+	// "textures/bricks.jpg" -> "textures/bricks.ktx2"
+	std::string GetCompressedPath(const std::string& filename)
+	{
+		size_t separator = filename.find_last_of("/\\");
+		size_t dot = filename.find_last_of('.');
+		if (dot == std::string::npos || (separator != std::string::npos && dot < separator))
+			return filename + ".ktx2";
+		return filename.substr(0, dot) + ".ktx2";
+	}
+
+	bool FileExists(const std::string& filename)
+	{
+		return std::ifstream(filename).good();
+	}
+
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
 
 Texture::Texture(Device &device)
     : m_Device(device)
@@ -14,6 +47,32 @@ Texture::~Texture()
 
 void Texture::LoadFromFile(const std::string &filename)
 {
+	PROFILE_SCOPE("Texture::LoadFromFile");
+	Upload(Decode(m_Device, filename));
+}
+
+void Texture::LoadFromBuffer(const std::vector<void*> &buffer, uint32_t width, uint32_t height)
+{
+	PROFILE_SCOPE("Texture::LoadFromBuffer");
+	Upload(FromPixels(m_Device, buffer[0], width, height));
+}
+
+TextureData Texture::Decode(Device &device, const std::string &filename, bool cpuMipmaps)
+{
+	PROFILE_SCOPE("Texture::Decode");
+	TextureData data;
+	if (HasExtension(filename, ".ktx2"))
+	{
+		if (!DecodeKtx2(device, Ktx2::Read(filename), data))
+			throw std::runtime_error("Texture format of " + filename + " is not supported by the device");
+		return data;
+	}
+
+	// a precompressed version next to the source image wins when the device can sample its format
+	std::string compressedPath = GetCompressedPath(filename);
+	if (FileExists(compressedPath) && DecodeKtx2(device, Ktx2::Read(compressedPath), data))
+		return data;
+
     int textureWidth, textureHeight, textureChannels;
     stbi_uc* pixels = stbi_load(
 		filename.c_str(),
@@ -24,53 +83,190 @@ void Texture::LoadFromFile(const std::string &filename)
 	);
 
     if (!pixels)
-        throw std::runtime_error("Failed to load texture image");
+        throw std::runtime_error("Failed to load texture image " + filename);
 
-	LoadFromBuffer({ pixels }, textureWidth, textureHeight);
+	data = FromPixels(device, pixels, textureWidth, textureHeight, cpuMipmaps);
 	stbi_image_free(pixels);
+	return data;
 }
 
-void Texture::LoadFromBuffer(const std::vector<void*> &buffer, uint32_t width, uint32_t height)
+TextureData Texture::Decode(Device &device, const std::vector<uint8_t> &encoded, const std::string &name, bool cpuMipmaps)
 {
-	vk::DeviceSize imageSize = width * height * 4;
+	PROFILE_SCOPE("Texture::Decode");
+	TextureData data;
+	if (Ktx2::IsKtx2(encoded.data(), encoded.size()))
+	{
+		if (!DecodeKtx2(device, Ktx2::Read(encoded, name), data))
+			throw std::runtime_error("Texture format of " + name + " is not supported by the device");
+		return data;
+	}
+
+	int textureWidth, textureHeight, textureChannels;
+	stbi_uc* pixels = stbi_load_from_memory(
+		encoded.data(),
+		static_cast<int>(encoded.size()),
+		&textureWidth,
+		&textureHeight,
+		&textureChannels,
+		STBI_rgb_alpha
+	);
+
+	if (!pixels)
+		throw std::runtime_error("Failed to load texture image " + name);
+
+	data = FromPixels(device, pixels, textureWidth, textureHeight, cpuMipmaps);
+	stbi_image_free(pixels);
+	return data;
+}
+
+bool Texture::DecodeKtx2(Device &device, const Ktx2Image &image, TextureData &data)
+{
+	if (!IsFormatSupported(device, image.Format))
+		return false;
+
+	// levels are copied exactly as stored, block compressed data cannot be blitted into more
+	data.Format = image.Format;
+	data.Width = image.Width;
+	data.Height = image.Height;
+	data.MipLevels = static_cast<uint32_t>(image.Levels.size());
+	data.GenerateMipmaps = false;
+
+	vk::DeviceSize size = 0;
+	for (uint32_t level = 0; level < data.MipLevels; level++)
+	{
+		size = AlignUp(size, TEXTURE_DATA_ALIGNMENT);
+		data.Regions.push_back(vk::BufferImageCopy(
+			size,
+			0,
+			0,
+			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1),
+			vk::Offset3D(0, 0, 0),
+			vk::Extent3D(std::max(image.Width >> level, 1u), std::max(image.Height >> level, 1u), 1)
+		));
+		size += image.Levels[level].Size;
+	}
+
+	data.Pixels.resize(static_cast<size_t>(size));
+	for (uint32_t level = 0; level < data.MipLevels; level++)
+		memcpy(data.Pixels.data() + data.Regions[level].bufferOffset, image.Data.data() + image.Levels[level].Offset, static_cast<size_t>(image.Levels[level].Size));
+	return true;
+}
 
+TextureData Texture::FromPixels(Device &device, const void* pixels, uint32_t width, uint32_t height, bool cpuMipmaps)
+{
+	TextureData data;
+	data.Format = vk::Format::eR8G8B8A8Srgb;
+	data.Width = width;
+	data.Height = height;
+	data.MipLevels = ComputeMipLevels(width, height);
+
+	// with blit support only the base level is uploaded and the GPU fills in
+	// the rest, otherwise the whole chain is built here and uploaded at once
+	data.GenerateMipmaps = !cpuMipmaps && SupportsBlitMipmaps(device, data.Format);
+	if (data.GenerateMipmaps)
+	{
+		const uint8_t* begin = static_cast<const uint8_t*>(pixels);
+		data.Pixels.assign(begin, begin + static_cast<size_t>(width) * height * 4);
+		data.Regions.push_back(vk::BufferImageCopy(
+			0,
+			0,
+			0,
+			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+			vk::Offset3D(0, 0, 0),
+			vk::Extent3D(width, height, 1)
+		));
+		return data;
+	}
+
+	std::vector<MipLevel> levels;
+	data.Pixels = BuildMipChain(static_cast<const uint8_t*>(pixels), width, height, true, levels);
+	for (uint32_t level = 0; level < data.MipLevels; level++)
+	{
+		data.Regions.push_back(vk::BufferImageCopy(
+			levels[level].Offset,
+			0,
+			0,
+			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1),
+			vk::Offset3D(0, 0, 0),
+			vk::Extent3D(levels[level].Width, levels[level].Height, 1)
+		));
+	}
+	return data;
+}
+
+void Texture::Upload(const TextureData &data)
+{
+	vk::DeviceSize size = data.Pixels.size();
 	vk::DeviceMemory stagingBufferMemory;
 	vk::Buffer stagingBuffer = m_Device.CreateBuffer(
-		imageSize,
+		size,
 		vk::BufferUsageFlagBits::eTransferSrc,
 		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		MemoryCategory::Staging,
 		stagingBufferMemory
 	);
 
-	void* data = m_Device.GetDevice().mapMemory(stagingBufferMemory, 0, imageSize, vk::MemoryMapFlags());
-	memcpy(data, buffer[0], static_cast<size_t>(imageSize));
+	void* mapped = m_Device.GetDevice().mapMemory(stagingBufferMemory, 0, size, vk::MemoryMapFlags());
+	memcpy(mapped, data.Pixels.data(), static_cast<size_t>(size));
 	m_Device.GetDevice().unmapMemory(stagingBufferMemory);
 
+	vk::CommandBuffer commandBuffer = m_Device.BeginSingleTimeCommands();
+	RecordUpload(commandBuffer, data, stagingBuffer, 0);
+	m_Device.EndSingleTimeCommands(commandBuffer);
+
+	m_Device.GetDevice().destroyBuffer(stagingBuffer);
+	m_Device.FreeMemory(stagingBufferMemory);
+}
+
+void Texture::RecordUpload(vk::CommandBuffer commandBuffer, const TextureData &data, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset, uint32_t firstLevel)
+{
+	if (firstLevel >= data.MipLevels || (firstLevel > 0 && data.GenerateMipmaps))
+		throw std::invalid_argument("Texture data does not contain the requested levels");
+
+	m_MipLevels = data.MipLevels - firstLevel;
+	uint32_t width = std::max(data.Width >> firstLevel, 1u);
+	uint32_t height = std::max(data.Height >> firstLevel, 1u);
+
+	vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+	if (data.GenerateMipmaps)
+		usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
 	m_Image = m_Device.CreateImage(
 		width,
 		height,
-		vk::Format::eR8G8B8A8Srgb,
+		m_MipLevels,
+		data.Format,
 		vk::ImageTiling::eOptimal,
-		vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+		usage,
 		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Texture,
 		m_ImageMemory
 	);
 
-	TransitionImageLayout(m_Image, vk::Format::eR8G8B8A8Srgb, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-	m_Device.CopyBufferToImage(stagingBuffer, m_Image, width, height);
-	TransitionImageLayout(m_Image, vk::Format::eR8G8B8A8Srgb, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+	// the staging copy starts at firstLevel
+	std::vector<vk::BufferImageCopy> regions(data.Regions.begin() + firstLevel, data.Regions.end());
+	for (vk::BufferImageCopy& region : regions)
+	{
+		region.bufferOffset = region.bufferOffset - data.Regions[firstLevel].bufferOffset + stagingOffset;
+		region.imageSubresource.mipLevel -= firstLevel;
+	}
 
-	m_Device.GetDevice().destroyBuffer(stagingBuffer);
-	m_Device.GetDevice().freeMemory(stagingBufferMemory);
+	TransitionImageLayout(commandBuffer, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, 0, m_MipLevels);
+	commandBuffer.copyBufferToImage(stagingBuffer, m_Image, vk::ImageLayout::eTransferDstOptimal, regions);
+	if (data.GenerateMipmaps)
+		GenerateMipmaps(commandBuffer, width, height);
+	else
+		TransitionImageLayout(commandBuffer, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, 0, m_MipLevels);
 
-	m_ImageView = m_Device.CreateImageView(m_Image, vk::Format::eR8G8B8A8Srgb, vk::ImageAspectFlagBits::eColor);
+	// viewed as a one layer array, materials sample atlas pages and own images the same way
+	m_ImageView = m_Device.CreateImageView(m_Image, data.Format, vk::ImageAspectFlagBits::eColor, m_MipLevels, vk::ImageViewType::e2DArray);
 }
 
 void Texture::Destroy()
 {
     m_Device.GetDevice().destroyImageView(m_ImageView);
     m_Device.GetDevice().destroyImage(m_Image);
-	m_Device.GetDevice().freeMemory(m_ImageMemory);
+	m_Device.FreeMemory(m_ImageMemory);
 	m_Device.GetDevice().destroySampler(m_Sampler);
 }
 
@@ -83,10 +279,8 @@ vk::DescriptorImageInfo Texture::DescriptorInfo()
     );
 }
 
-void Texture::TransitionImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
+void Texture::TransitionImageLayout(vk::CommandBuffer commandBuffer, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount)
 {
-    vk::CommandBuffer commandBuffer = m_Device.BeginSingleTimeCommands();
-
 	vk::ImageMemoryBarrier barrier(
 		vk::AccessFlags(),
 		vk::AccessFlags(),
@@ -94,10 +288,10 @@ void Texture::TransitionImageLayout(vk::Image image, vk::Format format, vk::Imag
 		newLayout,
 		VK_QUEUE_FAMILY_IGNORED,
 		VK_QUEUE_FAMILY_IGNORED,
-		image,
+		m_Image,
 		vk::ImageSubresourceRange(
 			vk::ImageAspectFlagBits::eColor,
-			0, 1,
+			baseMipLevel, levelCount,
 			0, 1
 		)
 	);
@@ -114,6 +308,15 @@ void Texture::TransitionImageLayout(vk::Image image, vk::Format format, vk::Imag
 		destinationStage = vk::PipelineStageFlagBits::eTransfer;
 	}
 
+	else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eTransferSrcOptimal)
+	{
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+		sourceStage = vk::PipelineStageFlagBits::eTransfer;
+		destinationStage = vk::PipelineStageFlagBits::eTransfer;
+	}
+
 	else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
 	{
 		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
@@ -123,6 +326,15 @@ void Texture::TransitionImageLayout(vk::Image image, vk::Format format, vk::Imag
 		destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
 	}
 
+	else if (oldLayout == vk::ImageLayout::eTransferSrcOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
+	{
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+		sourceStage = vk::PipelineStageFlagBits::eTransfer;
+		destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
+	}
+
 	else
 		throw std::invalid_argument("Unsupported layout transition");
 
@@ -134,12 +346,62 @@ void Texture::TransitionImageLayout(vk::Image image, vk::Format format, vk::Imag
 		0, nullptr,
 		1, &barrier
 	);
+}
 
-	m_Device.EndSingleTimeCommands(commandBuffer);
+void Texture::GenerateMipmaps(vk::CommandBuffer commandBuffer, uint32_t width, uint32_t height)
+{
+	PROFILE_SCOPE("Texture::GenerateMipmaps");
+	int32_t mipWidth = static_cast<int32_t>(width);
+	int32_t mipHeight = static_cast<int32_t>(height);
+
+	for (uint32_t level = 1; level < m_MipLevels; level++)
+	{
+		int32_t nextWidth = std::max(mipWidth / 2, 1);
+		int32_t nextHeight = std::max(mipHeight / 2, 1);
+
+		// the previous level is complete, read from it while writing this one
+		TransitionImageLayout(commandBuffer, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal, level - 1, 1);
+
+		vk::ImageBlit blit;
+		blit.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - 1, 0, 1);
+		blit.srcOffsets[1] = vk::Offset3D(mipWidth, mipHeight, 1);
+		blit.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1);
+		blit.dstOffsets[1] = vk::Offset3D(nextWidth, nextHeight, 1);
+
+		commandBuffer.blitImage(
+			m_Image, vk::ImageLayout::eTransferSrcOptimal,
+			m_Image, vk::ImageLayout::eTransferDstOptimal,
+			blit,
+			vk::Filter::eLinear
+		);
+
+		TransitionImageLayout(commandBuffer, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, level - 1, 1);
+
+		mipWidth = nextWidth;
+		mipHeight = nextHeight;
+	}
+
+	// the last level was only ever written
+	TransitionImageLayout(commandBuffer, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, m_MipLevels - 1, 1);
+}
+
+bool Texture::IsFormatSupported(Device &device, vk::Format format)
+{
+	vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+	vk::FormatProperties properties = device.GetPhysicalDevice().getFormatProperties(format);
+	return (properties.optimalTilingFeatures & required) == required;
+}
+
+bool Texture::SupportsBlitMipmaps(Device &device, vk::Format format)
+{
+	vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+	vk::FormatProperties properties = device.GetPhysicalDevice().getFormatProperties(format);
+	return (properties.optimalTilingFeatures & required) == required;
 }
 
 void Texture::CreateSampler()
 {
+	PROFILE_SCOPE("Texture::CreateSampler");
 	vk::SamplerCreateInfo samplerInfo(
 		vk::SamplerCreateFlags(),
 		vk::Filter::eLinear,
@@ -154,7 +416,7 @@ void Texture::CreateSampler()
 		VK_FALSE,
 		vk::CompareOp::eAlways,
 		0.f,
-		0.f,
+		VK_LOD_CLAMP_NONE,
 		vk::BorderColor::eIntOpaqueBlack,
 		VK_FALSE
 	);
@@ -1,6 +1,26 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
 #include "Device.h"
+#include "Ktx2.h"
+
+// Staging offsets of every level are aligned to this, enough for any block size
+const vk::DeviceSize TEXTURE_DATA_ALIGNMENT = 16;
+
+// CPU side texture ready for upload. Decoding needs no GPU access, so it can
+// run on any thread and the upload happens later on the render thread.
+struct TextureData
+{
+	vk::Format Format = vk::Format::eUndefined;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t MipLevels = 1;
+	bool GenerateMipmaps = false;	// only level 0 is in Pixels, the rest is blitted on the GPU
+	std::vector<uint8_t> Pixels;
+	std::vector<vk::BufferImageCopy> Regions;	// offsets into Pixels
+
+	// Bytes of the levels from firstLevel down, levels are stored largest first
+	vk::DeviceSize GetSize(uint32_t firstLevel = 0) const { return Pixels.size() - Regions[firstLevel].bufferOffset; }
+};
 
 class Texture
 {
@@ -13,15 +33,39 @@ public:
 	Texture(Texture &&) = delete;
 	Texture &operator=(Texture &&) = delete;
 
+	// Synchronous Decode and Upload
 	void LoadFromFile(const std::string &filename);
 	void LoadFromBuffer(const std::vector<void*> &buffer, uint32_t width, uint32_t height);
+
+	// Loads a .ktx2 file directly, other images prefer a .ktx2 with the same
+	// name when the device supports its format and fall back to stb_image.
+	// Thread safe, throws std::runtime_error if the file cannot be loaded.
+	// cpuMipmaps keeps every level in Pixels, as needed to upload a subset.
+	static TextureData Decode(Device &device, const std::string &filename, bool cpuMipmaps = false);
+	// Same for a PNG, JPEG or KTX2 file in memory, such as an image embedded in a glTF file.
+	// name only appears in errors.
+	static TextureData Decode(Device &device, const std::vector<uint8_t> &encoded, const std::string &name, bool cpuMipmaps = false);
+	// RGBA8 pixels with the mip chain built on the CPU when the GPU cannot blit it
+	static TextureData FromPixels(Device &device, const void* pixels, uint32_t width, uint32_t height, bool cpuMipmaps = false);
+
+	// Creates the image through a temporary staging buffer and waits for the copy
+	void Upload(const TextureData &data);
+	// Creates the image and records its upload from data already copied to stagingBuffer at stagingOffset.
+	// A firstLevel above 0 makes a smaller image whose level 0 is data's firstLevel.
+	void RecordUpload(vk::CommandBuffer commandBuffer, const TextureData &data, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset, uint32_t firstLevel = 0);
 	void Destroy();
 	vk::DescriptorImageInfo DescriptorInfo();
 
 	vk::ImageView GetImageView() const { return m_ImageView; }
+	uint32_t GetMipLevels() const { return m_MipLevels; }
 
 private:
-	void TransitionImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+	static bool DecodeKtx2(Device &device, const Ktx2Image &image, TextureData &data);
+	static bool IsFormatSupported(Device &device, vk::Format format);
+	static bool SupportsBlitMipmaps(Device &device, vk::Format format);
+	void TransitionImageLayout(vk::CommandBuffer commandBuffer, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount);
+	// Fills levels 1..n by blitting from the level above, leaves the image ready for sampling
+	void GenerateMipmaps(vk::CommandBuffer commandBuffer, uint32_t width, uint32_t height);
 	void CreateSampler();
 
 	Device& m_Device;
@@ -29,4 +73,5 @@ private:
 	vk::DeviceMemory m_ImageMemory;
 	vk::ImageView m_ImageView;
 	vk::Sampler m_Sampler;
+	uint32_t m_MipLevels = 1;
 };
\ No newline at end of file
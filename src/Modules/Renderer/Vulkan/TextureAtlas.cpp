@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cstring>
+#include "TextureAtlas.h"
+#include "MipChain.h"
+#include "../../../Core/Profiler.h"
+
+namespace
+{
+	const vk::Format ATLAS_FORMAT = vk::Format::eR8G8B8A8Srgb;
+
+	uint32_t AlignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+TextureAtlas::TextureAtlas(Device& device)
+	: m_Device(device)
+{
+}
+
+void TextureAtlas::Initialize()
+{
+	PROFILE_SCOPE("TextureAtlas::Initialize");
+	m_Image = m_Device.CreateImage(
+		ATLAS_PAGE_SIZE,
+		ATLAS_PAGE_SIZE,
+		ATLAS_MIP_LEVELS,
+		ATLAS_FORMAT,
+		vk::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+		vk::MemoryPropertyFlagBits::eDeviceLocal,
+		MemoryCategory::Texture,
+		m_ImageMemory,
+		ATLAS_PAGE_COUNT
+	);
+	m_ImageView = m_Device.CreateImageView(m_Image, ATLAS_FORMAT, vk::ImageAspectFlagBits::eColor, ATLAS_MIP_LEVELS, vk::ImageViewType::e2DArray, ATLAS_PAGE_COUNT);
+
+	// no anisotropy, its footprint would reach past the padding into the neighbours
+	vk::SamplerCreateInfo samplerInfo(
+		vk::SamplerCreateFlags(),
+		vk::Filter::eLinear,
+		vk::Filter::eLinear,
+		vk::SamplerMipmapMode::eLinear,
+		vk::SamplerAddressMode::eClampToEdge,
+		vk::SamplerAddressMode::eClampToEdge,
+		vk::SamplerAddressMode::eClampToEdge,
+		0.f,
+		VK_FALSE,
+		1.f,
+		VK_FALSE,
+		vk::CompareOp::eAlways,
+		0.f,
+		static_cast<float>(ATLAS_MIP_LEVELS - 1),
+		vk::BorderColor::eIntOpaqueBlack,
+		VK_FALSE
+	);
+	m_Sampler = m_Device.GetDevice().createSampler(samplerInfo);
+
+	m_PageHeights.assign(ATLAS_PAGE_COUNT, 0);
+	const uint8_t white[4] = { 255, 255, 255, 255 };
+	Pack(white, 1, 1, m_WhiteRegion);
+
+	// the first upload also takes the whole image out of the undefined layout
+	StagingBuffer staging = CreateStaging();
+	vk::CommandBuffer commandBuffer = m_Device.BeginSingleTimeCommands();
+	RecordCopies(commandBuffer, staging.Buffer, vk::ImageLayout::eUndefined);
+	m_Device.EndSingleTimeCommands(commandBuffer);
+
+	m_Device.GetDevice().destroyBuffer(staging.Buffer);
+	m_Device.FreeMemory(staging.Memory);
+}
+
+void TextureAtlas::Terminate()
+{
+	FreeStaging(0, true);
+	m_Device.GetDevice().destroySampler(m_Sampler);
+	m_Device.GetDevice().destroyImageView(m_ImageView);
+	m_Device.GetDevice().destroyImage(m_Image);
+	m_Device.FreeMemory(m_ImageMemory);
+
+	m_Shelves.clear();
+	m_PageHeights.clear();
+	m_PendingPixels.clear();
+	m_PendingCopies.clear();
+	m_TextureCount = 0;
+}
+
+bool TextureAtlas::CanPack(const TextureData& data) const
+{
+	return data.Format == ATLAS_FORMAT && !data.Regions.empty() &&
+		data.Width <= ATLAS_MAX_TEXTURE_SIZE && data.Height <= ATLAS_MAX_TEXTURE_SIZE;
+}
+
+bool TextureAtlas::Add(const TextureData& data, AtlasRegion& region)
+{
+	PROFILE_SCOPE("TextureAtlas::Add");
+	if (!CanPack(data))
+		return false;
+	return Pack(data.Pixels.data() + data.Regions[0].bufferOffset, data.Width, data.Height, region);
+}
+
+bool TextureAtlas::Pack(const uint8_t* pixels, uint32_t width, uint32_t height, AtlasRegion& region)
+{
+	// blocks start and end on multiples of the last level's texel, so every
+	// level of a block covers whole texels and is written independently
+	const uint32_t alignment = 1u << (ATLAS_MIP_LEVELS - 1);
+	uint32_t blockWidth = AlignUp(width + 2 * ATLAS_PADDING, alignment);
+	uint32_t blockHeight = AlignUp(height + 2 * ATLAS_PADDING, alignment);
+
+	uint32_t layer, x, y;
+	if (!Allocate(blockWidth, blockHeight, layer, x, y))
+		return false;
+
+	// the texture tiled out to the block size, so the padding holds the texels
+	// across each edge when it repeats
+	std::vector<uint8_t> block(static_cast<size_t>(blockWidth) * blockHeight * 4);
+	for (uint32_t blockY = 0; blockY < blockHeight; blockY++)
+	{
+		uint32_t sourceY = (blockY + height - ATLAS_PADDING % height) % height;
+		for (uint32_t blockX = 0; blockX < blockWidth; blockX++)
+		{
+			uint32_t sourceX = (blockX + width - ATLAS_PADDING % width) % width;
+			memcpy(&block[(static_cast<size_t>(blockY) * blockWidth + blockX) * 4], &pixels[(static_cast<size_t>(sourceY) * width + sourceX) * 4], 4);
+		}
+	}
+
+	std::vector<MipLevel> levels;
+	std::vector<uint8_t> chain = BuildMipChain(block.data(), blockWidth, blockHeight, true, levels);
+	const MipLevel& last = levels[ATLAS_MIP_LEVELS - 1];
+	size_t used = last.Offset + static_cast<size_t>(last.Width) * last.Height * 4;
+
+	size_t base = AlignUp(static_cast<uint32_t>(m_PendingPixels.size()), static_cast<uint32_t>(TEXTURE_DATA_ALIGNMENT));
+	m_PendingPixels.resize(base + used);
+	memcpy(m_PendingPixels.data() + base, chain.data(), used);
+	for (uint32_t level = 0; level < ATLAS_MIP_LEVELS; level++)
+	{
+		m_PendingCopies.push_back(vk::BufferImageCopy(
+			base + levels[level].Offset,
+			0,
+			0,
+			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, layer, 1),
+			vk::Offset3D(static_cast<int32_t>(x >> level), static_cast<int32_t>(y >> level), 0),
+			vk::Extent3D(levels[level].Width, levels[level].Height, 1)
+		));
+	}
+
+	float pageSize = static_cast<float>(ATLAS_PAGE_SIZE);
+	region.Transform = glm::vec4(
+		width / pageSize,
+		height / pageSize,
+		(x + ATLAS_PADDING) / pageSize,
+		(y + ATLAS_PADDING) / pageSize
+	);
+	region.Layer = layer;
+	m_TextureCount++;
+	return true;
+}
+
+bool TextureAtlas::Allocate(uint32_t width, uint32_t height, uint32_t& layer, uint32_t& x, uint32_t& y)
+{
+	// the lowest shelf with room, textures of one size end up sharing shelves
+	Shelf* best = nullptr;
+	for (Shelf& shelf : m_Shelves)
+		if (shelf.Height >= height && shelf.X + width <= ATLAS_PAGE_SIZE && (!best || shelf.Height < best->Height))
+			best = &shelf;
+
+	// a shelf more than twice as tall wastes more than opening a new one, when that is possible
+	bool open = !best || best->Height > height * 2;
+	if (open)
+	{
+		for (uint32_t page = 0; page < ATLAS_PAGE_COUNT; page++)
+		{
+			if (m_PageHeights[page] + height <= ATLAS_PAGE_SIZE)
+			{
+				m_Shelves.push_back({ page, m_PageHeights[page], height, 0 });
+				m_PageHeights[page] += height;
+				best = &m_Shelves.back();
+				break;
+			}
+		}
+	}
+
+	if (!best)
+		return false;
+
+	layer = best->Layer;
+	x = best->X;
+	y = best->Y;
+	best->X += width;
+	return true;
+}
+
+TextureAtlas::StagingBuffer TextureAtlas::CreateStaging()
+{
+	StagingBuffer staging{};
+	vk::DeviceSize size = m_PendingPixels.size();
+	staging.Buffer = m_Device.CreateBuffer(
+		size,
+		vk::BufferUsageFlagBits::eTransferSrc,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+		MemoryCategory::Staging,
+		staging.Memory
+	);
+
+	void* mapped = m_Device.GetDevice().mapMemory(staging.Memory, 0, size, vk::MemoryMapFlags());
+	memcpy(mapped, m_PendingPixels.data(), static_cast<size_t>(size));
+	m_Device.GetDevice().unmapMemory(staging.Memory);
+	return staging;
+}
+
+void TextureAtlas::RecordUploads(vk::CommandBuffer commandBuffer, uint64_t frameNumber, uint64_t framesInFlight)
+{
+	FreeStaging(frameNumber, false);
+	if (m_PendingCopies.empty())
+		return;
+
+	PROFILE_SCOPE("TextureAtlas::RecordUploads");
+	StagingBuffer staging = CreateStaging();
+	staging.FreeAtFrame = frameNumber + framesInFlight;
+	RecordCopies(commandBuffer, staging.Buffer, vk::ImageLayout::eShaderReadOnlyOptimal);
+	m_Staging.push_back(staging);
+}
+
+void TextureAtlas::RecordCopies(vk::CommandBuffer commandBuffer, vk::Buffer staging, vk::ImageLayout oldLayout)
+{
+	vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, ATLAS_MIP_LEVELS, 0, ATLAS_PAGE_COUNT);
+
+	// earlier frames may still sample the image, the copies wait for their
+	// fragment shaders since the barrier covers everything submitted before
+	vk::ImageMemoryBarrier toTransfer(
+		vk::AccessFlags(),
+		vk::AccessFlagBits::eTransferWrite,
+		oldLayout,
+		vk::ImageLayout::eTransferDstOptimal,
+		VK_QUEUE_FAMILY_IGNORED,
+		VK_QUEUE_FAMILY_IGNORED,
+		m_Image,
+		range
+	);
+	commandBuffer.pipelineBarrier(
+		oldLayout == vk::ImageLayout::eUndefined ? vk::PipelineStageFlagBits::eTopOfPipe : vk::PipelineStageFlagBits::eFragmentShader,
+		vk::PipelineStageFlagBits::eTransfer,
+		vk::DependencyFlags(),
+		0, nullptr,
+		0, nullptr,
+		1, &toTransfer
+	);
+
+	commandBuffer.copyBufferToImage(staging, m_Image, vk::ImageLayout::eTransferDstOptimal, m_PendingCopies);
+
+	vk::ImageMemoryBarrier toShader(
+		vk::AccessFlagBits::eTransferWrite,
+		vk::AccessFlagBits::eShaderRead,
+		vk::ImageLayout::eTransferDstOptimal,
+		vk::ImageLayout::eShaderReadOnlyOptimal,
+		VK_QUEUE_FAMILY_IGNORED,
+		VK_QUEUE_FAMILY_IGNORED,
+		m_Image,
+		range
+	);
+	commandBuffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer,
+		vk::PipelineStageFlagBits::eFragmentShader,
+		vk::DependencyFlags(),
+		0, nullptr,
+		0, nullptr,
+		1, &toShader
+	);
+
+	m_PendingPixels.clear();
+	m_PendingCopies.clear();
+}
+
+void TextureAtlas::FreeStaging(uint64_t frameNumber, bool all)
+{
+	auto it = m_Staging.begin();
+	while (it != m_Staging.end())
+	{
+		if (all || it->FreeAtFrame <= frameNumber)
+		{
+			m_Device.GetDevice().destroyBuffer(it->Buffer);
+			m_Device.FreeMemory(it->Memory);
+			it = m_Staging.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+vk::DescriptorImageInfo TextureAtlas::DescriptorInfo() const
+{
+	return vk::DescriptorImageInfo(
+		m_Sampler,
+		m_ImageView,
+		vk::ImageLayout::eShaderReadOnlyOptimal
+	);
+}
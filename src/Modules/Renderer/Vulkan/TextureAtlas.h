@@ -0,0 +1,93 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Device.h"
+#include "Texture.h"
+
+// Side of one atlas page, pages are the layers of a single array image
+const uint32_t ATLAS_PAGE_SIZE = 1024;
+const uint32_t ATLAS_PAGE_COUNT = 4;
+// Textures larger than this on either side get their own image
+const uint32_t ATLAS_MAX_TEXTURE_SIZE = 256;
+// Levels kept for every packed texture, blocks are aligned so each level stays separate
+const uint32_t ATLAS_MIP_LEVELS = 4;
+// Texels wrapped around each texture, so filtering across its edges reads what
+// a repeating sampler would and never a neighbour
+const uint32_t ATLAS_PADDING = 4;
+
+// Where a packed texture sits: uv * Transform.xy + Transform.zw on page Layer
+struct AtlasRegion
+{
+	glm::vec4 Transform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+	uint32_t Layer = 0;
+};
+
+// Packs small RGBA8 textures into the pages of one array image, so the
+// materials using them share an image, sampler and descriptor and never need
+// a descriptor update when their texture arrives.
+//
+// Regions are never freed, the atlas holds its textures until Terminate.
+// Packed textures repeat by wrapping their UVs inside the region in the shader.
+class TextureAtlas
+{
+public:
+	TextureAtlas(Device& device);
+
+	TextureAtlas(const TextureAtlas&) = delete;
+	TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+	// Creates the image with a white region for untextured materials
+	void Initialize();
+	void Terminate();
+
+	// Whether data has a format and size the atlas takes, not whether there is room left
+	bool CanPack(const TextureData& data) const;
+	// Packs level 0 of data, mips are rebuilt with the padding. False once the atlas is full.
+	bool Add(const TextureData& data, AtlasRegion& region);
+	// Records the copies of everything added since the last call, outside a render pass.
+	// Staging memory is released once frameNumber has left the frames in flight.
+	void RecordUploads(vk::CommandBuffer commandBuffer, uint64_t frameNumber, uint64_t framesInFlight);
+
+	const AtlasRegion& GetWhiteRegion() const { return m_WhiteRegion; }
+	vk::DescriptorImageInfo DescriptorInfo() const;
+	uint32_t GetTextureCount() const { return m_TextureCount; }
+
+private:
+	struct Shelf
+	{
+		uint32_t Layer;
+		uint32_t Y;
+		uint32_t Height;
+		uint32_t X;		// next free column
+	};
+
+	struct StagingBuffer
+	{
+		vk::Buffer Buffer;
+		vk::DeviceMemory Memory;
+		uint64_t FreeAtFrame;
+	};
+
+	bool Pack(const uint8_t* pixels, uint32_t width, uint32_t height, AtlasRegion& region);
+	bool Allocate(uint32_t width, uint32_t height, uint32_t& layer, uint32_t& x, uint32_t& y);
+	StagingBuffer CreateStaging();
+	void RecordCopies(vk::CommandBuffer commandBuffer, vk::Buffer staging, vk::ImageLayout oldLayout);
+	void FreeStaging(uint64_t frameNumber, bool all);
+
+	Device& m_Device;
+	vk::Image m_Image;
+	vk::DeviceMemory m_ImageMemory;
+	vk::ImageView m_ImageView;
+	vk::Sampler m_Sampler;
+
+	std::vector<Shelf> m_Shelves;
+	std::vector<uint32_t> m_PageHeights;	// rows used by shelves on each page
+	AtlasRegion m_WhiteRegion;
+	uint32_t m_TextureCount = 0;
+
+	// padded mip chains waiting for RecordUploads, copy offsets point into m_PendingPixels
+	std::vector<uint8_t> m_PendingPixels;
+	std::vector<vk::BufferImageCopy> m_PendingCopies;
+	std::vector<StagingBuffer> m_Staging;
+};
@@ -0,0 +1,151 @@
+#include <cstring>
+#include <stdexcept>
+#include "TextureLoader.h"
+#include "../../../Core/Profiler.h"
+
+TextureLoader::TextureLoader(Device& device)
+	: m_Device(device)
+{
+}
+
+void TextureLoader::Initialize()
+{
+	const unsigned char pixels[] = { 0xFF, 0xFF, 0xFF, 0xFF };
+	m_Placeholder = std::make_unique<Texture>(m_Device);
+	m_Placeholder->LoadFromBuffer({ (void*)pixels }, 1, 1);
+}
+
+void TextureLoader::Terminate()
+{
+	// nobody is left to hand the textures to
+	for (UploadBatch& batch : m_Batches)
+	{
+		while (vk::Result::eTimeout == m_Device.GetDevice().waitForFences(1, &batch.Fence, VK_TRUE, UINT64_MAX));
+		DestroyBatch(batch);
+		for (std::unique_ptr<Texture>& texture : batch.Textures)
+			texture->Destroy();
+	}
+	m_Batches.clear();
+	m_UploadingCount = 0;
+	m_Uploads.clear();
+
+	m_Placeholder->Destroy();
+	m_Placeholder.reset();
+}
+
+void TextureLoader::Update()
+{
+	PROFILE_SCOPE("TextureLoader::Update");
+	RetireBatches(false);
+
+	if (!m_Uploads.empty())
+	{
+		SubmitBatch(m_Uploads);
+		m_Uploads.clear();
+	}
+}
+
+void TextureLoader::Upload(std::shared_ptr<const TextureData> data, uint32_t firstLevel, Callback onReady)
+{
+	m_Uploads.push_back({ std::move(data), firstLevel, std::move(onReady) });
+}
+
+void TextureLoader::Flush()
+{
+	PROFILE_SCOPE("TextureLoader::Flush");
+	while (!m_Uploads.empty() || !m_Batches.empty())
+	{
+		Update();
+		RetireBatches(true);
+	}
+}
+
+void TextureLoader::SubmitBatch(std::vector<PendingUpload>& uploads)
+{
+	PROFILE_SCOPE("TextureLoader::SubmitBatch");
+	size_t first = 0;
+	while (first < uploads.size())
+	{
+		// staging layout, every texture starts aligned for its largest block size
+		std::vector<vk::DeviceSize> offsets;
+		vk::DeviceSize size = 0;
+		size_t last = first;
+		for (; last < uploads.size(); last++)
+		{
+			vk::DeviceSize uploadSize = uploads[last].Data->GetSize(uploads[last].FirstLevel);
+			vk::DeviceSize offset = (size + TEXTURE_DATA_ALIGNMENT - 1) / TEXTURE_DATA_ALIGNMENT * TEXTURE_DATA_ALIGNMENT;
+			if (last > first && offset + uploadSize > TEXTURE_UPLOAD_BATCH_BYTES)
+				break;
+			offsets.push_back(offset);
+			size = offset + uploadSize;
+		}
+
+		UploadBatch batch;
+		batch.StagingBuffer = m_Device.CreateBuffer(
+			size,
+			vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::Staging,
+			batch.StagingMemory
+		);
+
+		uint8_t* mapped = static_cast<uint8_t*>(m_Device.GetDevice().mapMemory(batch.StagingMemory, 0, size, vk::MemoryMapFlags()));
+		for (size_t i = first; i < last; i++)
+		{
+			const TextureData& data = *uploads[i].Data;
+			vk::DeviceSize levelOffset = data.Regions[uploads[i].FirstLevel].bufferOffset;
+			memcpy(mapped + offsets[i - first], data.Pixels.data() + levelOffset, static_cast<size_t>(data.GetSize(uploads[i].FirstLevel)));
+		}
+		m_Device.GetDevice().unmapMemory(batch.StagingMemory);
+
+		vk::CommandBufferAllocateInfo allocInfo(m_Device.GetCommandPool(), vk::CommandBufferLevel::ePrimary, 1);
+		batch.CommandBuffer = m_Device.GetDevice().allocateCommandBuffers(allocInfo).front();
+		batch.CommandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		for (size_t i = first; i < last; i++)
+		{
+			std::unique_ptr<Texture> texture = std::make_unique<Texture>(m_Device);
+			texture->RecordUpload(batch.CommandBuffer, *uploads[i].Data, batch.StagingBuffer, offsets[i - first], uploads[i].FirstLevel);
+			batch.Textures.push_back(std::move(texture));
+			batch.Callbacks.push_back(std::move(uploads[i].OnReady));
+		}
+		batch.CommandBuffer.end();
+
+		batch.Fence = m_Device.GetDevice().createFence(vk::FenceCreateInfo());
+		vk::SubmitInfo submitInfo(0, nullptr, nullptr, 1, &batch.CommandBuffer, 0, nullptr);
+		if (m_Device.GetGraphicsQueue().submit(1, &submitInfo, batch.Fence) != vk::Result::eSuccess)
+			throw std::runtime_error("Failed to submit texture uploads");
+
+		m_UploadingCount += static_cast<uint32_t>(last - first);
+		m_Batches.push_back(std::move(batch));
+		first = last;
+	}
+}
+
+void TextureLoader::RetireBatches(bool wait)
+{
+	auto it = m_Batches.begin();
+	while (it != m_Batches.end())
+	{
+		if (wait)
+			while (vk::Result::eTimeout == m_Device.GetDevice().waitForFences(1, &it->Fence, VK_TRUE, UINT64_MAX));
+		else if (m_Device.GetDevice().getFenceStatus(it->Fence) != vk::Result::eSuccess)
+		{
+			++it;
+			continue;
+		}
+
+		DestroyBatch(*it);
+		m_UploadingCount -= static_cast<uint32_t>(it->Textures.size());
+		for (size_t i = 0; i < it->Textures.size(); i++)
+			it->Callbacks[i](std::move(it->Textures[i]));
+		it = m_Batches.erase(it);
+	}
+}
+
+void TextureLoader::DestroyBatch(UploadBatch& batch)
+{
+	m_Device.GetDevice().destroyFence(batch.Fence);
+	m_Device.GetDevice().freeCommandBuffers(m_Device.GetCommandPool(), 1, &batch.CommandBuffer);
+	m_Device.GetDevice().destroyBuffer(batch.StagingBuffer);
+	m_Device.FreeMemory(batch.StagingMemory);
+}
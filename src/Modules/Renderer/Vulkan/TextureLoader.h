@@ -0,0 +1,73 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Device.h"
+#include "Texture.h"
+
+// Uploads of one Update are capped to roughly this many bytes, a single larger texture still goes alone
+const vk::DeviceSize TEXTURE_UPLOAD_BATCH_BYTES = 64 * 1024 * 1024;
+
+// Uploads decoded textures in batches: one staging buffer and one submission
+// per Update, completion is polled with a fence instead of waiting for the
+// queue. Files are decoded and shared by the TextureStreamer. Runs on the
+// render thread.
+class TextureLoader
+{
+public:
+	// Receives the resident texture on the render thread
+	using Callback = std::function<void(std::unique_ptr<Texture> texture)>;
+
+	explicit TextureLoader(Device& device);
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	void Initialize();
+	// Waits for submitted uploads and drops everything still pending
+	void Terminate();
+
+	// 1x1 white texture to bind while the real one loads, or when there is none
+	Texture& GetPlaceholder() { return *m_Placeholder; }
+
+	// Queues already decoded data for the next batch, leaving out the levels above firstLevel
+	void Upload(std::shared_ptr<const TextureData> data, uint32_t firstLevel, Callback onReady);
+	// Submits the queued uploads and runs the callbacks of completed ones, call once per frame
+	void Update();
+	// Blocks until every upload so far has been delivered
+	void Flush();
+	uint32_t GetPendingCount() const { return static_cast<uint32_t>(m_Uploads.size()) + m_UploadingCount; }
+
+private:
+	struct PendingUpload
+	{
+		std::shared_ptr<const TextureData> Data;
+		uint32_t FirstLevel;
+		Callback OnReady;
+	};
+
+	struct UploadBatch
+	{
+		vk::CommandBuffer CommandBuffer;
+		vk::Fence Fence;
+		vk::Buffer StagingBuffer;
+		vk::DeviceMemory StagingMemory;
+		std::vector<std::unique_ptr<Texture>> Textures;
+		std::vector<Callback> Callbacks;
+	};
+
+	void SubmitBatch(std::vector<PendingUpload>& uploads);
+	// Finishes batches whose fence has signaled, or all of them when wait is set
+	void RetireBatches(bool wait);
+	// Releases the staging resources of a finished batch
+	void DestroyBatch(UploadBatch& batch);
+
+	Device& m_Device;
+	std::unique_ptr<Texture> m_Placeholder;
+
+	std::vector<PendingUpload> m_Uploads;
+	std::vector<UploadBatch> m_Batches;
+	uint32_t m_UploadingCount = 0;
+};
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include "TextureStreamer.h"
+#include "../../../Core/Profiler.h"
+
+TextureStreamer::TextureStreamer(Device& device, ThreadPool& threadPool, TextureLoader& loader, TextureAtlas& atlas)
+	: m_Device(device),
+	  m_ThreadPool(threadPool),
+	  m_Loader(loader),
+	  m_Atlas(atlas)
+{
+}
+
+void TextureStreamer::Initialize()
+{
+	vk::DeviceSize deviceLocalBudget = 0;
+	for (const MemoryHeapBudget& heap : m_Device.GetMemoryBudget())
+		if (heap.DeviceLocal)
+			deviceLocalBudget += heap.Budget;
+	m_Budget = static_cast<vk::DeviceSize>(deviceLocalBudget * STREAMING_BUDGET_SHARE);
+
+	m_Device.SetMemoryPressureCallback([this](uint32_t, const MemoryHeapBudget& budget)
+	{
+		if (budget.DeviceLocal)
+			m_UnderPressure = true;
+	});
+}
+
+void TextureStreamer::Terminate()
+{
+	m_Device.SetMemoryPressureCallback(nullptr);
+	m_Textures.clear();
+	m_Ids[0].clear();
+	m_Ids[1].clear();
+}
+
+uint32_t TextureStreamer::Add(const std::string& filename, Callback onResident, PackedCallback onPacked)
+{
+	return Add(filename, nullptr, std::move(onResident), std::move(onPacked));
+}
+
+uint32_t TextureStreamer::Add(const std::string& filename, std::shared_ptr<const std::vector<uint8_t>> encoded, Callback onResident, PackedCallback onPacked)
+{
+	std::unordered_map<std::string, uint32_t>& ids = m_Ids[onPacked ? 1 : 0];
+	auto existing = ids.find(filename);
+	if (existing != ids.end())
+	{
+		// catch up with what the earlier users already got
+		StreamedTexture& texture = m_Textures[existing->second];
+		if (texture.Packed)
+			onPacked(texture.Region);
+		else if (texture.Image)
+			onResident(texture.Image);
+		texture.OnResident.push_back(std::move(onResident));
+		if (onPacked)
+			texture.OnPacked.push_back(std::move(onPacked));
+		return existing->second;
+	}
+
+	Device& device = m_Device;
+	StreamedTexture texture;
+	texture.OnResident.push_back(std::move(onResident));
+	if (onPacked)
+		texture.OnPacked.push_back(std::move(onPacked));
+	texture.Decode = m_ThreadPool.Submit([&device, filename, encoded]()
+	{
+		TextureData data = encoded ? Texture::Decode(device, *encoded, filename, true) : Texture::Decode(device, filename, true);
+		return std::shared_ptr<const TextureData>(std::make_shared<TextureData>(std::move(data)));
+	}).share();
+
+	m_Textures.push_back(std::move(texture));
+	uint32_t id = static_cast<uint32_t>(m_Textures.size() - 1);
+	ids.emplace(filename, id);
+	return id;
+}
+
+void TextureStreamer::RequestScreenSize(uint32_t id, float pixels)
+{
+	StreamedTexture& texture = m_Textures[id];
+	texture.LastRequestFrame = m_FrameNumber;
+	if (!texture.Data)
+		return;
+
+	// one texel per pixel, assuming the texture spans the object once
+	uint32_t size = std::max(texture.Data->Width, texture.Data->Height);
+	float ratio = static_cast<float>(size) / std::max(pixels, 1.0f);
+	uint32_t level = ratio > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(ratio))) : 0;
+	texture.WantedLevel = std::min(texture.WantedLevel, std::min(level, texture.Data->MipLevels - 1));
+}
+
+void TextureStreamer::Update(uint64_t frameNumber)
+{
+	PROFILE_SCOPE("TextureStreamer::Update");
+	m_FrameNumber = frameNumber;
+	CollectDecodes();
+
+	if (m_UnderPressure.exchange(false))
+	{
+		m_Budget = std::min(m_Budget, (m_ResidentBytes + m_PendingBytes) * 3 / 4);
+		std::cout << "Texture streaming budget lowered to " << m_Budget / (1024 * 1024) << " MiB after memory pressure" << std::endl;
+	}
+
+	bool overBudget = m_ResidentBytes + m_PendingBytes > m_Budget;
+	std::vector<uint32_t> upgrades;
+	std::vector<uint32_t> downgrades;
+	for (uint32_t id = 0; id < m_Textures.size(); id++)
+	{
+		StreamedTexture& texture = m_Textures[id];
+		if (texture.WantedLevel != NO_LEVEL)
+			texture.RecentLevel = texture.WantedLevel;
+		if (!texture.Data || texture.ResidentLevel == NO_LEVEL || texture.PendingLevel != NO_LEVEL)
+			continue;
+
+		// within budget a visible texture keeps one extra level, so sizes near
+		// a level boundary do not re-create the image back and forth
+		uint32_t target = GetTargetLevel(texture);
+		if (target < texture.ResidentLevel)
+			upgrades.push_back(id);
+		else if (target > texture.ResidentLevel && (overBudget || !IsSeen(texture) || target > texture.ResidentLevel + 1))
+			downgrades.push_back(id);
+	}
+
+	// the most out of date first for upgrades, the longest unseen first for evictions
+	std::sort(upgrades.begin(), upgrades.end(), [this](uint32_t a, uint32_t b)
+	{
+		return m_Textures[a].ResidentLevel - GetTargetLevel(m_Textures[a]) > m_Textures[b].ResidentLevel - GetTargetLevel(m_Textures[b]);
+	});
+	std::sort(downgrades.begin(), downgrades.end(), [this](uint32_t a, uint32_t b)
+	{
+		return m_Textures[a].LastRequestFrame < m_Textures[b].LastRequestFrame;
+	});
+
+	uint32_t uploads = 0;
+	size_t nextDowngrade = 0;
+	auto evict = [&]()
+	{
+		if (nextDowngrade >= downgrades.size() || uploads >= STREAMING_MAX_UPLOADS_PER_FRAME)
+			return false;
+		uint32_t id = downgrades[nextDowngrade++];
+		StartUpload(id, GetTargetLevel(m_Textures[id]));
+		uploads++;
+		return true;
+	};
+
+	// the replaced image is only released once the new one is resident, so
+	// evictions show up in the totals a few frames later
+	while (m_ResidentBytes + m_PendingBytes > m_Budget && evict());
+
+	for (uint32_t id : upgrades)
+	{
+		if (uploads >= STREAMING_MAX_UPLOADS_PER_FRAME)
+			break;
+
+		// the finest level that fits, stepping towards the target if the budget is tight
+		StreamedTexture& texture = m_Textures[id];
+		vk::DeviceSize available = m_Budget > m_ResidentBytes + m_PendingBytes ? m_Budget - m_ResidentBytes - m_PendingBytes : 0;
+		vk::DeviceSize current = GetBytes(texture, texture.ResidentLevel);
+		for (uint32_t level = GetTargetLevel(texture); level < texture.ResidentLevel; level++)
+		{
+			if (GetBytes(texture, level) - current <= available)
+			{
+				StartUpload(id, level);
+				uploads++;
+				break;
+			}
+		}
+	}
+
+	// textures that are sharper than needed give the memory back even within budget
+	while (evict());
+
+	for (StreamedTexture& texture : m_Textures)
+		texture.WantedLevel = NO_LEVEL;
+}
+
+void TextureStreamer::Flush()
+{
+	PROFILE_SCOPE("TextureStreamer::Flush");
+	for (StreamedTexture& texture : m_Textures)
+		if (texture.Decode.valid())
+			texture.Decode.wait();
+
+	CollectDecodes();
+	m_Loader.Flush();
+}
+
+void TextureStreamer::CollectDecodes()
+{
+	for (uint32_t id = 0; id < m_Textures.size(); id++)
+	{
+		StreamedTexture& texture = m_Textures[id];
+		if (!texture.Decode.valid() || texture.Decode.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			continue;
+
+		try
+		{
+			texture.Data = texture.Decode.get();
+		}
+		catch (const std::exception& e)
+		{
+			// the material keeps sampling the white region
+			std::cerr << "Failed to load texture: " << e.what() << std::endl;
+			texture.Failed = true;
+		}
+		texture.Decode = {};
+		if (texture.Failed)
+			continue;
+
+		// small enough to share the atlas, which keeps it for good
+		if (!texture.OnPacked.empty() && m_Atlas.Add(*texture.Data, texture.Region))
+		{
+			texture.Data.reset();
+			texture.Packed = true;
+			for (PackedCallback& onPacked : texture.OnPacked)
+				onPacked(texture.Region);
+			continue;
+		}
+
+		texture.TailLevel = texture.Data->MipLevels - 1;
+		while (texture.TailLevel > 0 && std::max(texture.Data->Width >> (texture.TailLevel - 1), texture.Data->Height >> (texture.TailLevel - 1)) <= STREAMING_MIN_RESIDENT_SIZE)
+			texture.TailLevel--;
+		StartUpload(id, texture.TailLevel);
+	}
+}
+
+bool TextureStreamer::IsSeen(const StreamedTexture& texture) const
+{
+	return texture.RecentLevel != NO_LEVEL && texture.LastRequestFrame + STREAMING_UNSEEN_FRAMES >= m_FrameNumber;
+}
+
+uint32_t TextureStreamer::GetTargetLevel(const StreamedTexture& texture) const
+{
+	return IsSeen(texture) ? std::min(texture.RecentLevel, texture.TailLevel) : texture.TailLevel;
+}
+
+vk::DeviceSize TextureStreamer::GetBytes(const StreamedTexture& texture, uint32_t level) const
+{
+	return level == NO_LEVEL ? 0 : texture.Data->GetSize(level);
+}
+
+void TextureStreamer::StartUpload(uint32_t id, uint32_t level)
+{
+	StreamedTexture& texture = m_Textures[id];
+	texture.PendingLevel = level;
+	m_PendingBytes += GetBytes(texture, level);
+
+	m_Loader.Upload(texture.Data, level, [this, id](std::unique_ptr<Texture> uploaded)
+	{
+		std::shared_ptr<Texture> image(uploaded.release(), [](Texture* texture)
+		{
+			texture->Destroy();
+			delete texture;
+		});
+		StreamedTexture& texture = m_Textures[id];
+		m_PendingBytes -= GetBytes(texture, texture.PendingLevel);
+		m_ResidentBytes = m_ResidentBytes - GetBytes(texture, texture.ResidentLevel) + GetBytes(texture, texture.PendingLevel);
+		texture.ResidentLevel = texture.PendingLevel;
+		texture.PendingLevel = NO_LEVEL;
+		texture.Image = image;
+		for (Callback& onResident : texture.OnResident)
+			onResident(image);
+	});
+}
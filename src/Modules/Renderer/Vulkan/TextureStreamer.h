@@ -0,0 +1,109 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Device.h"
+#include "Texture.h"
+#include "TextureAtlas.h"
+#include "TextureLoader.h"
+#include "../../../Core/ThreadPool.h"
+
+// Levels no larger than this on either side are always resident
+const uint32_t STREAMING_MIN_RESIDENT_SIZE = 64;
+// Residency changes started per Update, initial uploads are not limited
+const uint32_t STREAMING_MAX_UPLOADS_PER_FRAME = 4;
+// Frames without a request before a texture falls back to its resident minimum
+const uint64_t STREAMING_UNSEEN_FRAMES = 120;
+// Default budget as a share of the device local heap budget
+const float STREAMING_BUDGET_SHARE = 0.5f;
+
+// Streams mip levels of file textures in and out under a memory budget.
+//
+// Textures start with only their small tail levels resident. The renderer
+// reports how many pixels each visible texture covers, Update turns that into
+// a wanted level and re-creates the image with more or fewer levels. The whole
+// chain is kept in CPU memory, so residency changes never touch the disk.
+// Memory pressure reported by the device lowers the budget and evicts detail.
+// Textures the atlas takes are packed into it once decoded and never streamed.
+// Every file is decoded, kept and uploaded once, however many materials use it.
+// Everything but the decoding runs on the render thread.
+class TextureStreamer
+{
+public:
+	static const uint32_t INVALID_ID = UINT32_MAX;
+	// Receives every new version of the texture. The image is shared by every
+	// user of the file and destroyed with its last reference, so a caller keeps
+	// the previous one until the GPU is done with it.
+	using Callback = std::function<void(std::shared_ptr<Texture> texture)>;
+	using PackedCallback = std::function<void(const AtlasRegion&)>;
+
+	TextureStreamer(Device& device, ThreadPool& threadPool, TextureLoader& loader, TextureAtlas& atlas);
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	void Initialize();
+	void Terminate();
+
+	// Adding a file again returns the same id and shares its image or atlas
+	// region. Without onPacked the texture always gets an image of its own.
+	uint32_t Add(const std::string& filename, Callback onResident, PackedCallback onPacked = nullptr);
+	// Same for an encoded image in memory, name takes the place of the filename
+	uint32_t Add(const std::string& name, std::shared_ptr<const std::vector<uint8_t>> encoded, Callback onResident, PackedCallback onPacked = nullptr);
+	// Size of a visible texture on screen in pixels along its larger side, call for every draw
+	void RequestScreenSize(uint32_t id, float pixels);
+	// Picks residency changes from the requests since the last call, before TextureLoader::Update
+	void Update(uint64_t frameNumber);
+	// Blocks until every texture has its minimum levels resident
+	void Flush();
+
+	void SetBudget(vk::DeviceSize bytes) { m_Budget = bytes; }
+	vk::DeviceSize GetBudget() const { return m_Budget; }
+	vk::DeviceSize GetResidentBytes() const { return m_ResidentBytes; }
+
+private:
+	static const uint32_t NO_LEVEL = UINT32_MAX;
+
+	struct StreamedTexture
+	{
+		std::vector<Callback> OnResident;
+		std::vector<PackedCallback> OnPacked;
+		std::shared_ptr<Texture> Image;		// current version, for users added later
+		AtlasRegion Region;
+		bool Packed = false;
+		std::shared_future<std::shared_ptr<const TextureData>> Decode;
+		std::shared_ptr<const TextureData> Data;	// set once decoded, released again when packed
+		uint32_t TailLevel = 0;				// finest of the always resident levels
+		uint32_t ResidentLevel = NO_LEVEL;	// finest level of the current image
+		uint32_t PendingLevel = NO_LEVEL;	// finest level of an upload in flight
+		uint32_t WantedLevel = NO_LEVEL;	// finest level requested since the last Update
+		uint32_t RecentLevel = NO_LEVEL;	// WantedLevel of the last Update with requests
+		uint64_t LastRequestFrame = 0;
+		bool Failed = false;
+	};
+
+	void CollectDecodes();
+	bool IsSeen(const StreamedTexture& texture) const;
+	uint32_t GetTargetLevel(const StreamedTexture& texture) const;
+	vk::DeviceSize GetBytes(const StreamedTexture& texture, uint32_t level) const;
+	void StartUpload(uint32_t id, uint32_t level);
+
+	Device& m_Device;
+	ThreadPool& m_ThreadPool;
+	TextureLoader& m_Loader;
+	TextureAtlas& m_Atlas;
+
+	std::vector<StreamedTexture> m_Textures;
+	// ids by filename, of textures that may not and may be packed
+	std::unordered_map<std::string, uint32_t> m_Ids[2];
+	vk::DeviceSize m_Budget = 0;
+	vk::DeviceSize m_ResidentBytes = 0;
+	vk::DeviceSize m_PendingBytes = 0;
+	uint64_t m_FrameNumber = 0;
+	// set from whichever thread hits the pressure, handled in Update
+	std::atomic<bool> m_UnderPressure{ false };
+};
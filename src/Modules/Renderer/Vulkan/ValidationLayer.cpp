@@ -50,13 +50,18 @@ bool ValidationLayer::CheckValidationLayerSupport()
 	return true;
 }
 
-std::vector<const char*> ValidationLayer::GetRequiredExtensions()
+std::vector<const char*> ValidationLayer::GetRequiredExtensions(bool surfaceExtensions)
 {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions;
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	if (surfaceExtensions)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (ENABLE_VALIDATION_LAYERS)
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -20,7 +20,7 @@ public:
 
 	void Init(VkInstance instance);
 	void Destroy();
-	std::vector<const char*> GetRequiredExtensions();
+	std::vector<const char*> GetRequiredExtensions(bool surfaceExtensions = true);
 	void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 	bool CheckValidationLayerSupport();
 
@@ -0,0 +1,237 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+#include "../../Core/ThreadPool.h"
+#include "Node.h"
+
+// Sparse set storage for components attached to the nodes of a NodePool.
+// Every node is an entity, a component of any type can be attached to it.
+// Components of one type sit packed in a dense array, a sparse array indexed
+// by node slot maps to them. Adding, removing and looking up are O(1),
+// removing moves the last component into the gap.
+
+class ComponentStorageBase
+{
+public:
+	virtual ~ComponentStorageBase() = default;
+
+	// No-op when the node has no component in this storage
+	virtual void Remove(uint32_t slot) = 0;
+	// Sorts the dense arrays by keys[slot], used to keep them in depth first order
+	virtual void SortBy(const std::vector<uint32_t>& keys) = 0;
+};
+
+template <typename T>
+class ComponentStorage final : public ComponentStorageBase
+{
+public:
+	T& Add(NodeHandle entity, T component)
+	{
+		if (Contains(entity.Index))
+			throw std::runtime_error("Node already has a component of this type");
+		if (entity.Index >= m_Sparse.size())
+			m_Sparse.resize(entity.Index + 1, INVALID_NODE_INDEX);
+		m_Sparse[entity.Index] = static_cast<uint32_t>(m_Components.size());
+		m_Entities.push_back(entity);
+		m_Components.push_back(std::move(component));
+		return m_Components.back();
+	}
+
+	void Remove(uint32_t slot) override
+	{
+		if (!Contains(slot))
+			return;
+
+		uint32_t index = m_Sparse[slot];
+		if (index != m_Components.size() - 1)
+		{
+			m_Components[index] = std::move(m_Components.back());
+			m_Entities[index] = m_Entities.back();
+			m_Sparse[m_Entities[index].Index] = index;
+		}
+		m_Components.pop_back();
+		m_Entities.pop_back();
+		m_Sparse[slot] = INVALID_NODE_INDEX;
+	}
+
+	bool Contains(uint32_t slot) const { return slot < m_Sparse.size() && m_Sparse[slot] != INVALID_NODE_INDEX; }
+	// The node must have the component
+	T& Get(uint32_t slot) { return m_Components[m_Sparse[slot]]; }
+	T* Find(uint32_t slot) { return Contains(slot) ? &m_Components[m_Sparse[slot]] : nullptr; }
+
+	size_t GetSize() const { return m_Components.size(); }
+	bool IsEmpty() const { return m_Components.empty(); }
+	T& GetAt(size_t index) { return m_Components[index]; }
+	NodeHandle GetEntity(size_t index) const { return m_Entities[index]; }
+
+	// The packed components, in depth first order of their nodes after NodePool::Reorder
+	typename std::vector<T>::iterator begin() { return m_Components.begin(); }
+	typename std::vector<T>::iterator end() { return m_Components.end(); }
+
+	void SortBy(const std::vector<uint32_t>& keys) override
+	{
+		auto before = [&](NodeHandle a, NodeHandle b) { return keys[a.Index] < keys[b.Index]; };
+		if (std::is_sorted(m_Entities.begin(), m_Entities.end(), before))
+			return;
+
+		m_Order.resize(m_Components.size());
+		for (uint32_t i = 0; i < m_Order.size(); i++)
+			m_Order[i] = i;
+		std::sort(m_Order.begin(), m_Order.end(), [&](uint32_t a, uint32_t b) { return before(m_Entities[a], m_Entities[b]); });
+
+		m_ComponentScratch.clear();
+		m_EntityScratch.clear();
+		for (uint32_t index : m_Order)
+		{
+			m_ComponentScratch.push_back(std::move(m_Components[index]));
+			m_EntityScratch.push_back(m_Entities[index]);
+			m_Sparse[m_Entities[index].Index] = static_cast<uint32_t>(m_EntityScratch.size() - 1);
+		}
+		m_Components.swap(m_ComponentScratch);
+		m_Entities.swap(m_EntityScratch);
+	}
+
+private:
+	std::vector<T> m_Components;
+	std::vector<NodeHandle> m_Entities;	// owner of each component
+	std::vector<uint32_t> m_Sparse;		// node slot to component index, INVALID_NODE_INDEX for none
+
+	// kept between sorts like the NodePool scratch
+	std::vector<uint32_t> m_Order;
+	std::vector<T> m_ComponentScratch;
+	std::vector<NodeHandle> m_EntityScratch;
+};
+
+// Nodes having all of the listed components. Walks the packed array of the
+// first component and skips nodes missing any of the others, so list the
+// rarest component first. Invalidated like the storages it reads by adding or
+// removing components of the queried types.
+template <typename First, typename... Rest>
+class ComponentQuery
+{
+public:
+	ComponentQuery(ComponentStorage<First>& first, ComponentStorage<Rest>&... rest)
+		: m_First(first), m_Rest(&rest...)
+	{
+	}
+
+	// Calls function(NodeHandle, First&, Rest&...) for every match
+	template <typename Function>
+	void Each(Function function)
+	{
+		EachInRange(0, m_First.GetSize(), function);
+	}
+
+	// Splits the packed array into contiguous chunks, one per worker and one
+	// for the caller, and returns once all of them are done. function runs
+	// concurrently, it may write the components it is given but nothing shared.
+	// Ranges smaller than minChunk are not worth a job and run inline.
+	template <typename Function>
+	void ParallelEach(ThreadPool& threads, Function function, size_t minChunk = 1024)
+	{
+		size_t size = m_First.GetSize();
+		size_t chunks = std::min<size_t>(threads.GetThreadCount() + 1, (size + minChunk - 1) / std::max<size_t>(minChunk, 1));
+		if (chunks <= 1)
+		{
+			EachInRange(0, size, function);
+			return;
+		}
+
+		size_t chunkSize = (size + chunks - 1) / chunks;
+		std::vector<std::future<void>> jobs;
+		jobs.reserve(chunks - 1);
+		for (size_t begin = chunkSize; begin < size; begin += chunkSize)
+		{
+			size_t end = std::min(begin + chunkSize, size);
+			jobs.push_back(threads.Submit([this, begin, end, &function]() { EachInRange(begin, end, function); }));
+		}
+		// every job has to stop using function before a failure leaves this frame
+		std::exception_ptr failure;
+		try
+		{
+			EachInRange(0, chunkSize, function);
+		}
+		catch (...)
+		{
+			failure = std::current_exception();
+		}
+		for (std::future<void>& job : jobs)
+			job.wait();
+		if (failure)
+			std::rethrow_exception(failure);
+		for (std::future<void>& job : jobs)
+			job.get();
+	}
+
+private:
+	template <typename Function>
+	void EachInRange(size_t begin, size_t end, Function& function)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t slot = m_First.GetEntity(i).Index;
+			if ((std::get<ComponentStorage<Rest>*>(m_Rest)->Contains(slot) && ...))
+				function(m_First.GetEntity(i), m_First.GetAt(i), std::get<ComponentStorage<Rest>*>(m_Rest)->Get(slot)...);
+		}
+	}
+
+	ComponentStorage<First>& m_First;
+	std::tuple<ComponentStorage<Rest>*...> m_Rest;
+};
+
+// One storage per component type, created on first use
+class ComponentRegistry
+{
+public:
+	template <typename T>
+	ComponentStorage<T>& GetStorage()
+	{
+		uint32_t id = GetComponentId<T>();
+		if (id >= m_Storages.size())
+			m_Storages.resize(id + 1);
+		if (!m_Storages[id])
+			m_Storages[id] = std::make_unique<ComponentStorage<T>>();
+		return static_cast<ComponentStorage<T>&>(*m_Storages[id]);
+	}
+
+	template <typename... Components>
+	ComponentQuery<Components...> Query()
+	{
+		return ComponentQuery<Components...>(GetStorage<Components>()...);
+	}
+
+	// Removes every component of the node
+	void RemoveAll(uint32_t slot)
+	{
+		for (std::unique_ptr<ComponentStorageBase>& storage : m_Storages)
+			if (storage)
+				storage->Remove(slot);
+	}
+
+	void SortBy(const std::vector<uint32_t>& keys)
+	{
+		for (std::unique_ptr<ComponentStorageBase>& storage : m_Storages)
+			if (storage)
+				storage->SortBy(keys);
+	}
+
+private:
+	// Dense ids shared by every registry, so storages are found by index
+	template <typename T>
+	static uint32_t GetComponentId()
+	{
+		static const uint32_t id = s_NextComponentId++;
+		return id;
+	}
+
+	static inline std::atomic<uint32_t> s_NextComponentId{ 0 };
+
+	std::vector<std::unique_ptr<ComponentStorageBase>> m_Storages;
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+// View frustum as six inward facing planes (xyz = normal, w = distance),
+// extracted from a view projection matrix
+struct Frustum
+{
+	std::array<glm::vec4, 6> Planes;
+
+	static Frustum FromMatrix(const glm::mat4& viewProjection)
+	{
+		glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		// the near plane uses the -1..1 depth convention, which is also a
+		// conservative bound for projections with 0..1 depth
+		Frustum frustum;
+		frustum.Planes = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 };
+		for (glm::vec4& plane : frustum.Planes)
+			plane /= glm::length(glm::vec3(plane));
+		return frustum;
+	}
+
+	bool IntersectsSphere(const glm::vec3& center, float radius) const
+	{
+		for (const glm::vec4& plane : Planes)
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+				return false;
+		return true;
+	}
+};
+
+// Bounding sphere of a mesh transformed by a world matrix, scaled by its largest axis
+inline float GetWorldRadius(const glm::mat4& world, float radius)
+{
+	float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+	return radius * scale;
+}
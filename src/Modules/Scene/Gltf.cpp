@@ -0,0 +1,689 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <glm/gtc/quaternion.hpp>
+#include "Gltf.h"
+#include "../Renderer/Vulkan/MeshSimplifier.h"
+#include "../../Core/Json.h"
+#include "../../Core/MappedFile.h"
+#include "../../Core/Profiler.h"
+
+namespace
+{
+	const uint32_t GLB_MAGIC = 0x46546C67;		// "glTF"
+	const uint32_t GLB_VERSION = 2;
+	const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+	const int64_t MODE_TRIANGLES = 4;
+	const uint32_t COMPONENT_BYTE = 5120;
+	const uint32_t COMPONENT_UNSIGNED_BYTE = 5121;
+	const uint32_t COMPONENT_SHORT = 5122;
+	const uint32_t COMPONENT_UNSIGNED_SHORT = 5123;
+	const uint32_t COMPONENT_UNSIGNED_INT = 5125;
+	const uint32_t COMPONENT_FLOAT = 5126;
+
+	// Deeper hierarchies are treated as broken files
+	const uint32_t MAX_NODE_DEPTH = 256;
+
+	template <typename T>
+	T Load(const uint8_t* data)
+	{
+		T value;
+		memcpy(&value, data, sizeof(T));
+		return value;
+	}
+
+	uint32_t GetComponentSize(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case COMPONENT_BYTE:
+		case COMPONENT_UNSIGNED_BYTE: return 1;
+		case COMPONENT_SHORT:
+		case COMPONENT_UNSIGNED_SHORT: return 2;
+		case COMPONENT_UNSIGNED_INT:
+		case COMPONENT_FLOAT: return 4;
+		default: throw std::runtime_error("Unknown glTF component type " + std::to_string(componentType));
+		}
+	}
+
+	uint32_t GetComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		if (type == "MAT2") return 4;
+		if (type == "MAT3") return 9;
+		if (type == "MAT4") return 16;
+		throw std::runtime_error("Unknown glTF accessor type " + type);
+	}
+
+	// Typed view of accessor elements inside a buffer, reads convert in place
+	struct Accessor
+	{
+		const uint8_t* Data = nullptr;	// nullptr when the accessor has no buffer view and reads as zeros
+		size_t Stride = 0;
+		size_t Count = 0;
+		uint32_t ComponentType = 0;
+		uint32_t Components = 0;
+		bool Normalized = false;
+
+		float ReadFloat(size_t element, uint32_t component) const
+		{
+			if (!Data)
+				return 0.0f;
+
+			const uint8_t* value = Data + element * Stride + component * GetComponentSize(ComponentType);
+			switch (ComponentType)
+			{
+			case COMPONENT_FLOAT: return Load<float>(value);
+			case COMPONENT_BYTE: return Normalized ? std::max(Load<int8_t>(value) / 127.0f, -1.0f) : Load<int8_t>(value);
+			case COMPONENT_UNSIGNED_BYTE: return Normalized ? Load<uint8_t>(value) / 255.0f : Load<uint8_t>(value);
+			case COMPONENT_SHORT: return Normalized ? std::max(Load<int16_t>(value) / 32767.0f, -1.0f) : Load<int16_t>(value);
+			case COMPONENT_UNSIGNED_SHORT: return Normalized ? Load<uint16_t>(value) / 65535.0f : Load<uint16_t>(value);
+			default: return static_cast<float>(Load<uint32_t>(value));
+			}
+		}
+
+		// Shapes the mesh reader handles, anything else would read past the elements
+		bool IsVertexAttribute(uint32_t components) const
+		{
+			bool integer = ComponentType == COMPONENT_BYTE || ComponentType == COMPONENT_UNSIGNED_BYTE
+				|| ComponentType == COMPONENT_SHORT || ComponentType == COMPONENT_UNSIGNED_SHORT;
+			return Components == components && (ComponentType == COMPONENT_FLOAT || (integer && Normalized));
+		}
+
+		bool IsIndexList() const
+		{
+			return Components == 1 && (ComponentType == COMPONENT_UNSIGNED_BYTE
+				|| ComponentType == COMPONENT_UNSIGNED_SHORT || ComponentType == COMPONENT_UNSIGNED_INT);
+		}
+
+		uint32_t ReadIndex(size_t element) const
+		{
+			if (!Data)
+				return 0;
+
+			const uint8_t* value = Data + element * Stride;
+			switch (ComponentType)
+			{
+			case COMPONENT_UNSIGNED_BYTE: return Load<uint8_t>(value);
+			case COMPONENT_UNSIGNED_SHORT: return Load<uint16_t>(value);
+			default: return Load<uint32_t>(value);
+			}
+		}
+	};
+
+	struct BufferRange
+	{
+		const uint8_t* Data = nullptr;
+		size_t Size = 0;
+	};
+
+	// Where the texture loader finds an image, see Importer::GetImage
+	struct ImageSource
+	{
+		std::string Path;		// under ASSETS_PATH, or a name for an embedded image
+		std::shared_ptr<const std::vector<uint8_t>> Encoded;	// null for files
+	};
+
+	// Mesh and material of one Model node, with its bounding sphere in model space
+	struct ModelPart
+	{
+		std::shared_ptr<MeshData> Mesh;	// shared by every node instancing the glTF mesh
+		MaterialData Material;
+		glm::vec3 BoundsCenter = glm::vec3(0.0f);
+		float BoundsRadius = 0.0f;
+	};
+
+	bool StartsWith(const std::string& text, const char* prefix)
+	{
+		return text.compare(0, strlen(prefix), prefix) == 0;
+	}
+
+	std::vector<uint8_t> DecodeBase64(const char* text, size_t size)
+	{
+		auto decode = [](char c) -> int
+		{
+			if (c >= 'A' && c <= 'Z') return c - 'A';
+			if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+			if (c >= '0' && c <= '9') return c - '0' + 52;
+			if (c == '+' || c == '-') return 62;
+			if (c == '/' || c == '_') return 63;
+			return -1;
+		};
+
+		std::vector<uint8_t> data;
+		data.reserve(size / 4 * 3);
+		uint32_t bits = 0;
+		int bitCount = 0;
+		for (size_t i = 0; i < size && text[i] != '='; i++)
+		{
+			int value = decode(text[i]);
+			if (value < 0)
+				throw std::runtime_error("Invalid base64 data in glTF URI");
+			bits = (bits << 6) | static_cast<uint32_t>(value);
+			bitCount += 6;
+			if (bitCount >= 8)
+			{
+				bitCount -= 8;
+				data.push_back(static_cast<uint8_t>(bits >> bitCount));
+			}
+		}
+		return data;
+	}
+
+	// Relative URIs may escape spaces and other characters as %XX
+	std::string DecodeUri(const std::string& uri)
+	{
+		std::string path;
+		path.reserve(uri.size());
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			if (uri[i] == '%' && i + 2 < uri.size() && isxdigit(static_cast<unsigned char>(uri[i + 1])) && isxdigit(static_cast<unsigned char>(uri[i + 2])))
+			{
+				path += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+				i += 2;
+			}
+			else
+				path += uri[i];
+		}
+		return path;
+	}
+
+	// Angles in degrees for Transform's default XYZ order, R = Rx * Ry * Rz
+	glm::vec3 ToEulerXYZ(const glm::quat& rotation)
+	{
+		glm::mat3 m = glm::mat3_cast(glm::normalize(rotation));
+		float y = std::asin(glm::clamp(m[2][0], -1.0f, 1.0f));
+		float x, z;
+		if (std::abs(m[2][0]) < 0.9999f)
+		{
+			x = std::atan2(-m[2][1], m[2][2]);
+			z = std::atan2(-m[1][0], m[0][0]);
+		}
+		else
+		{
+			// gimbal lock, x and z rotate about the same axis
+			x = std::atan2(m[1][2], m[1][1]);
+			z = 0.0f;
+		}
+		return glm::degrees(glm::vec3(x, y, z));
+	}
+
+	glm::vec4 ReadVec4(const JsonValue& value, const glm::vec4& fallback)
+	{
+		if (!value.IsArray() || value.Size() < 4)
+			return fallback;
+		return glm::vec4(value[0].AsFloat(), value[1].AsFloat(), value[2].AsFloat(), value[3].AsFloat());
+	}
+
+	glm::vec2 ReadVec2(const JsonValue& value, const glm::vec2& fallback)
+	{
+		if (!value.IsArray() || value.Size() < 2)
+			return fallback;
+		return glm::vec2(value[0].AsFloat(), value[1].AsFloat());
+	}
+
+	class Importer
+	{
+	public:
+		Importer(const std::string& path, SceneGraph& scene, VertexFormat format)
+			: m_Path(path), m_Scene(scene), m_Format(format)
+		{
+			size_t separator = path.find_last_of("/\\");
+			m_Directory = separator == std::string::npos ? "" : path.substr(0, separator + 1);
+			std::string filename = path.substr(m_Directory.size());
+			m_Stem = filename.substr(0, filename.find_last_of('.'));
+		}
+
+		GltfImportResult Run(NodeHandle parent)
+		{
+			LoadDocument();
+			LoadBuffers();
+
+			m_MeshParts.resize(m_Json["meshes"].Size());
+			m_MeshLoaded.resize(m_Json["meshes"].Size(), false);
+			m_NodeVisited.resize(m_Json["nodes"].Size(), false);
+
+			if (parent.IsNull())
+				parent = m_Scene.GetRoot();
+			m_Result.Root = m_Scene.AddNode(GetUniqueName(parent, m_Stem), parent);
+			try
+			{
+				for (size_t node : GetSceneRoots())
+					ImportNode(node, m_Result.Root, glm::mat4(1.0f), 0);
+			}
+			catch (...)
+			{
+				m_Scene.RemoveNode(m_Result.Root);
+				throw;
+			}
+			return m_Result;
+		}
+
+	private:
+		void LoadDocument()
+		{
+			m_File = MappedFile(ASSETS_PATH + m_Path);
+			const uint8_t* data = m_File.GetData();
+			size_t size = m_File.GetSize();
+
+			if (size < 12 || Load<uint32_t>(data) != GLB_MAGIC)
+			{
+				m_Json = JsonValue::Parse(reinterpret_cast<const char*>(data), size);
+			}
+			else
+			{
+				// binary container: header, JSON chunk, optional BIN chunk
+				if (Load<uint32_t>(data + 4) != GLB_VERSION)
+					throw std::runtime_error(m_Path + " is not a glTF 2.0 binary");
+				size_t length = std::min<size_t>(Load<uint32_t>(data + 8), size);
+				bool hasJson = false;
+				for (size_t offset = 12; offset + 8 <= length;)
+				{
+					size_t chunkLength = Load<uint32_t>(data + offset);
+					uint32_t chunkType = Load<uint32_t>(data + offset + 4);
+					const uint8_t* chunk = data + offset + 8;
+					if (chunkLength > length - offset - 8)
+						throw std::runtime_error(m_Path + " has a truncated chunk");
+
+					if (chunkType == GLB_CHUNK_JSON && !hasJson)
+					{
+						m_Json = JsonValue::Parse(reinterpret_cast<const char*>(chunk), chunkLength);
+						hasJson = true;
+					}
+					else if (chunkType == GLB_CHUNK_BIN && !m_BinChunk.Data)
+						m_BinChunk = { chunk, chunkLength };
+					offset += 8 + (chunkLength + 3) / 4 * 4;
+				}
+				if (!hasJson)
+					throw std::runtime_error(m_Path + " has no JSON chunk");
+			}
+
+			if (!StartsWith(m_Json["asset"]["version"].AsString(), "2."))
+				throw std::runtime_error(m_Path + " is not a glTF 2.0 file");
+		}
+
+		// Buffers stay in their mappings, only data URIs are decoded into memory
+		void LoadBuffers()
+		{
+			const JsonValue& buffers = m_Json["buffers"];
+			for (size_t i = 0; i < buffers.Size(); i++)
+			{
+				const JsonValue& buffer = buffers[i];
+				const std::string& uri = buffer["uri"].AsString();
+				BufferRange range;
+				if (uri.empty())
+				{
+					if (i != 0 || !m_BinChunk.Data)
+						throw std::runtime_error(m_Path + ": buffer " + std::to_string(i) + " has no data");
+					range = m_BinChunk;
+				}
+				else if (StartsWith(uri, "data:"))
+				{
+					size_t comma = uri.find(";base64,");
+					if (comma == std::string::npos)
+						throw std::runtime_error(m_Path + ": buffer " + std::to_string(i) + " has a data URI without base64 data");
+					m_DecodedBuffers.push_back(DecodeBase64(uri.data() + comma + 8, uri.size() - comma - 8));
+					range = { m_DecodedBuffers.back().data(), m_DecodedBuffers.back().size() };
+				}
+				else
+				{
+					m_BufferFiles.emplace_back(ASSETS_PATH + m_Directory + DecodeUri(uri));
+					range = { m_BufferFiles.back().GetData(), m_BufferFiles.back().GetSize() };
+				}
+
+				size_t byteLength = static_cast<size_t>(buffer["byteLength"].AsInt());
+				if (range.Size < byteLength)
+					throw std::runtime_error(m_Path + ": buffer " + std::to_string(i) + " is shorter than its byteLength");
+				range.Size = byteLength;
+				m_Buffers.push_back(range);
+			}
+		}
+
+		Accessor GetAccessor(int64_t index) const
+		{
+			const JsonValue& json = m_Json["accessors"][static_cast<size_t>(index)];
+			if (!json.IsObject())
+				throw std::runtime_error(m_Path + ": accessor " + std::to_string(index) + " does not exist");
+
+			Accessor accessor;
+			accessor.ComponentType = static_cast<uint32_t>(json["componentType"].AsInt());
+			accessor.Components = GetComponentCount(json["type"].AsString());
+			accessor.Count = static_cast<size_t>(json["count"].AsInt());
+			accessor.Normalized = json["normalized"].AsBool();
+			if (json.Has("sparse"))
+				std::cerr << m_Path << ": sparse accessor " << index << " is read without its sparse values" << std::endl;
+			if (!json.Has("bufferView"))
+				return accessor;
+
+			const JsonValue& view = m_Json["bufferViews"][static_cast<size_t>(json["bufferView"].AsInt())];
+			size_t buffer = static_cast<size_t>(view["buffer"].AsInt(-1));
+			if (!view.IsObject() || buffer >= m_Buffers.size())
+				throw std::runtime_error(m_Path + ": accessor " + std::to_string(index) + " has an invalid buffer view");
+
+			size_t elementSize = static_cast<size_t>(GetComponentSize(accessor.ComponentType)) * accessor.Components;
+			size_t viewOffset = static_cast<size_t>(view["byteOffset"].AsInt());
+			size_t viewLength = static_cast<size_t>(view["byteLength"].AsInt());
+			size_t offset = static_cast<size_t>(json["byteOffset"].AsInt());
+			accessor.Stride = static_cast<size_t>(view["byteStride"].AsInt());
+			if (accessor.Stride == 0)
+				accessor.Stride = elementSize;
+
+			const BufferRange& range = m_Buffers[buffer];
+			bool inside = viewOffset <= range.Size && viewLength <= range.Size - viewOffset;
+			if (inside && accessor.Count > 0)
+				inside = offset <= viewLength && (accessor.Count - 1) * accessor.Stride + elementSize <= viewLength - offset;
+			if (!inside)
+				throw std::runtime_error(m_Path + ": accessor " + std::to_string(index) + " reaches past its buffer");
+
+			accessor.Data = range.Data + viewOffset + offset;
+			return accessor;
+		}
+
+		const std::vector<ModelPart>& GetMeshParts(size_t meshIndex)
+		{
+			if (meshIndex >= m_MeshParts.size())
+				throw std::runtime_error(m_Path + ": mesh " + std::to_string(meshIndex) + " does not exist");
+			if (m_MeshLoaded[meshIndex])
+				return m_MeshParts[meshIndex];
+
+			PROFILE_SCOPE("Gltf::LoadMesh");
+			const JsonValue& primitives = m_Json["meshes"][meshIndex]["primitives"];
+			for (size_t i = 0; i < primitives.Size(); i++)
+			{
+				const JsonValue& primitive = primitives[i];
+				const JsonValue& attributes = primitive["attributes"];
+				int64_t mode = primitive["mode"].AsInt(MODE_TRIANGLES);
+				if (mode != MODE_TRIANGLES || !attributes.Has("POSITION"))
+				{
+					std::cerr << m_Path << ": skipped primitive " << i << " of mesh " << meshIndex << ", only triangle lists with positions are imported" << std::endl;
+					continue;
+				}
+
+				Accessor positions = GetAccessor(attributes["POSITION"].AsInt());
+				bool hasNormals = attributes.Has("NORMAL");
+				Accessor normals = hasNormals ? GetAccessor(attributes["NORMAL"].AsInt()) : Accessor();
+				bool hasTexCoords = attributes.Has("TEXCOORD_0");
+				Accessor texCoords = hasTexCoords ? GetAccessor(attributes["TEXCOORD_0"].AsInt()) : Accessor();
+				bool hasIndices = primitive.Has("indices");
+				Accessor indexAccessor = hasIndices ? GetAccessor(primitive["indices"].AsInt()) : Accessor();
+				if (!positions.IsVertexAttribute(3) || (hasNormals && !normals.IsVertexAttribute(3))
+					|| (hasTexCoords && !texCoords.IsVertexAttribute(2)) || (hasIndices && !indexAccessor.IsIndexList()))
+				{
+					std::cerr << m_Path << ": skipped primitive " << i << " of mesh " << meshIndex << ", its attribute or index accessors have unsupported types" << std::endl;
+					continue;
+				}
+
+				// read straight from the buffers into the vertices the models keep
+				std::vector<Vertex> vertices(positions.Count);
+				for (size_t v = 0; v < positions.Count; v++)
+					vertices[v].Position = glm::vec3(positions.ReadFloat(v, 0), positions.ReadFloat(v, 1), positions.ReadFloat(v, 2));
+
+				for (size_t v = 0; v < std::min(normals.Count, vertices.size()); v++)
+					vertices[v].Normal = glm::vec3(normals.ReadFloat(v, 0), normals.ReadFloat(v, 1), normals.ReadFloat(v, 2));
+
+				// glTF puts the UV origin at the top left like Vulkan images, no flip needed
+				for (size_t v = 0; v < std::min(texCoords.Count, vertices.size()); v++)
+					vertices[v].TexCoord = glm::vec2(texCoords.ReadFloat(v, 0), texCoords.ReadFloat(v, 1));
+
+				std::vector<uint32_t> indices;
+				if (hasIndices)
+				{
+					indices.resize(indexAccessor.Count);
+					for (size_t j = 0; j < indexAccessor.Count; j++)
+					{
+						indices[j] = indexAccessor.ReadIndex(j);
+						if (indices[j] >= vertices.size())
+							throw std::runtime_error(m_Path + ": mesh " + std::to_string(meshIndex) + " has an index past its vertices");
+					}
+				}
+				else
+				{
+					indices.resize(vertices.size());
+					for (size_t j = 0; j < indices.size(); j++)
+						indices[j] = static_cast<uint32_t>(j);
+				}
+				indices.resize(indices.size() - indices.size() % 3);
+
+				MaterialData material = GetMaterial(primitive["material"].AsInt(-1));
+				AppendPart(std::move(vertices), std::move(indices), material, !hasNormals, m_MeshParts[meshIndex]);
+			}
+
+			m_MeshLoaded[meshIndex] = true;
+			return m_MeshParts[meshIndex];
+		}
+
+		void AppendPart(std::vector<Vertex> vertices, std::vector<uint32_t> indices, const MaterialData& material, bool computeNormals, std::vector<ModelPart>& parts)
+		{
+			parts.emplace_back();
+			ModelPart& part = parts.back();
+			part.Mesh = std::make_shared<MeshData>();
+			MeshData& mesh = *part.Mesh;
+			mesh.Vertices = std::move(vertices);
+			mesh.Indices = std::move(indices);
+			part.Material = material;
+			mesh.Format = m_Format;
+			if (computeNormals)
+				mesh.ComputeMissingNormals();
+			if (mesh.Vertices.empty())
+				return;
+			MeshSimplifier::GenerateLods(mesh);
+
+			glm::vec3 min = mesh.Vertices[0].Position, max = min;
+			for (const Vertex& vertex : mesh.Vertices)
+			{
+				min = glm::min(min, vertex.Position);
+				max = glm::max(max, vertex.Position);
+			}
+			part.BoundsCenter = (min + max) * 0.5f;
+			for (const Vertex& vertex : mesh.Vertices)
+				part.BoundsRadius = std::max(part.BoundsRadius, glm::length(vertex.Position - part.BoundsCenter));
+		}
+
+		MaterialData GetMaterial(int64_t index)
+		{
+			MaterialData material;
+			const JsonValue& json = m_Json["materials"][static_cast<size_t>(index)];
+			if (index < 0 || !json.IsObject())
+				return material;
+
+			const JsonValue& pbr = json["pbrMetallicRoughness"];
+			material.Parameters.DiffuseColor = ReadVec4(pbr["baseColorFactor"], glm::vec4(1.0f));
+
+			const JsonValue& baseColor = pbr["baseColorTexture"];
+			if (baseColor.IsObject())
+			{
+				const JsonValue& texture = m_Json["textures"][static_cast<size_t>(baseColor["index"].AsInt(-1))];
+				if (texture.Has("source"))
+				{
+					const ImageSource& image = GetImage(static_cast<size_t>(texture["source"].AsInt()));
+					material.TexturePath = image.Path;
+					material.EmbeddedTexture = image.Encoded;
+				}
+
+				const JsonValue& transform = baseColor["extensions"]["KHR_texture_transform"];
+				if (transform.IsObject())
+				{
+					glm::vec2 scale = ReadVec2(transform["scale"], glm::vec2(1.0f));
+					glm::vec2 offset = ReadVec2(transform["offset"], glm::vec2(0.0f));
+					material.Parameters.UVTransform = glm::vec4(scale, offset);
+				}
+			}
+			return material;
+		}
+
+		// External images are files under ASSETS_PATH. Embedded ones are handed
+		// to the texture streamer as encoded bytes and named after the file and
+		// image, so the asset directory is never written to.
+		const ImageSource& GetImage(size_t index)
+		{
+			auto found = m_Images.find(index);
+			if (found != m_Images.end())
+				return found->second;
+
+			const JsonValue& image = m_Json["images"][index];
+			if (!image.IsObject())
+				throw std::runtime_error(m_Path + ": image " + std::to_string(index) + " does not exist");
+
+			const std::string& uri = image["uri"].AsString();
+			ImageSource source;
+			if (!uri.empty() && !StartsWith(uri, "data:"))
+				source.Path = m_Directory + DecodeUri(uri);
+			else if (!uri.empty())
+			{
+				size_t comma = uri.find(";base64,");
+				if (comma == std::string::npos)
+					throw std::runtime_error(m_Path + ": image " + std::to_string(index) + " has a data URI without base64 data");
+				source.Path = m_Path + "#image" + std::to_string(index);
+				source.Encoded = std::make_shared<const std::vector<uint8_t>>(DecodeBase64(uri.data() + comma + 8, uri.size() - comma - 8));
+			}
+			else
+			{
+				const JsonValue& view = m_Json["bufferViews"][static_cast<size_t>(image["bufferView"].AsInt(-1))];
+				size_t buffer = static_cast<size_t>(view["buffer"].AsInt(-1));
+				size_t offset = static_cast<size_t>(view["byteOffset"].AsInt());
+				size_t length = static_cast<size_t>(view["byteLength"].AsInt());
+				if (buffer >= m_Buffers.size() || offset > m_Buffers[buffer].Size || length > m_Buffers[buffer].Size - offset)
+					throw std::runtime_error(m_Path + ": image " + std::to_string(index) + " has an invalid buffer view");
+				// copied, the buffers are unmapped once the import is done
+				const uint8_t* data = m_Buffers[buffer].Data + offset;
+				source.Path = m_Path + "#image" + std::to_string(index);
+				source.Encoded = std::make_shared<const std::vector<uint8_t>>(data, data + length);
+			}
+
+			return m_Images.emplace(index, std::move(source)).first->second;
+		}
+
+		std::vector<size_t> GetSceneRoots() const
+		{
+			std::vector<size_t> roots;
+			const JsonValue& scenes = m_Json["scenes"];
+			if (scenes.Size() > 0)
+			{
+				const JsonValue& nodes = scenes[static_cast<size_t>(m_Json["scene"].AsInt(0))]["nodes"];
+				for (const JsonValue& node : nodes.GetElements())
+					roots.push_back(static_cast<size_t>(node.AsInt()));
+				return roots;
+			}
+
+			// without scenes every node that is nobody's child is a root
+			const JsonValue& nodes = m_Json["nodes"];
+			std::vector<bool> isChild(nodes.Size(), false);
+			for (const JsonValue& node : nodes.GetElements())
+				for (const JsonValue& child : node["children"].GetElements())
+					if (static_cast<size_t>(child.AsInt()) < isChild.size())
+						isChild[static_cast<size_t>(child.AsInt())] = true;
+			for (size_t i = 0; i < nodes.Size(); i++)
+				if (!isChild[i])
+					roots.push_back(i);
+			return roots;
+		}
+
+		std::string GetUniqueName(NodeHandle parent, const std::string& name) const
+		{
+			std::string unique = name;
+			for (uint32_t suffix = 1; !m_Scene.FindChild(parent, unique).IsNull(); suffix++)
+				unique = name + "_" + std::to_string(suffix);
+			return unique;
+		}
+
+		void ImportNode(size_t index, NodeHandle parent, const glm::mat4& parentWorld, uint32_t depth)
+		{
+			if (index >= m_NodeVisited.size() || m_NodeVisited[index] || depth > MAX_NODE_DEPTH)
+				throw std::runtime_error(m_Path + ": node " + std::to_string(index) + " does not exist or has several parents");
+			m_NodeVisited[index] = true;
+
+			const JsonValue& json = m_Json["nodes"][index];
+			std::string name = json["name"].AsString();
+			if (name.empty())
+				name = "node" + std::to_string(index);
+
+			Transform transform;
+			const JsonValue& matrix = json["matrix"];
+			if (matrix.Size() == 16)
+			{
+				for (int i = 0; i < 16; i++)
+					transform.PreTransform[i / 4][i % 4] = matrix[i].AsFloat();
+			}
+			else
+			{
+				const JsonValue& translation = json["translation"];
+				const JsonValue& rotation = json["rotation"];
+				const JsonValue& scale = json["scale"];
+				if (translation.Size() == 3)
+					transform.Position = glm::vec3(translation[0].AsFloat(), translation[1].AsFloat(), translation[2].AsFloat());
+				if (rotation.Size() == 4)
+					transform.Rotation = ToEulerXYZ(glm::quat(rotation[3].AsFloat(), rotation[0].AsFloat(), rotation[1].AsFloat(), rotation[2].AsFloat()));
+				if (scale.Size() == 3)
+					transform.Scale = glm::vec3(scale[0].AsFloat(), scale[1].AsFloat(), scale[2].AsFloat());
+			}
+			glm::mat4 world = parentWorld * transform.GetCompositeMatrix();
+
+			const std::vector<ModelPart>* parts = json.Has("mesh") ? &GetMeshParts(static_cast<size_t>(json["mesh"].AsInt())) : nullptr;
+			NodeHandle node;
+			if (parts && parts->size() == 1)
+			{
+				node = m_Scene.AddNode(GetUniqueName(parent, name), Model(parts->front().Mesh, parts->front().Material), parent);
+				AccountModel(parts->front(), world);
+			}
+			else
+			{
+				// meshes with several primitives get one child per primitive
+				node = m_Scene.AddNode(GetUniqueName(parent, name), parent);
+				for (size_t i = 0; parts && i < parts->size(); i++)
+				{
+					m_Scene.AddNode("primitive" + std::to_string(i), Model((*parts)[i].Mesh, (*parts)[i].Material), node);
+					AccountModel((*parts)[i], world);
+					m_Result.NodeCount++;
+				}
+			}
+			m_Scene[node].GetTransform() = transform;
+			m_Result.NodeCount++;
+
+			for (const JsonValue& child : json["children"].GetElements())
+				ImportNode(static_cast<size_t>(child.AsInt(-1)), node, world, depth + 1);
+		}
+
+		void AccountModel(const ModelPart& part, const glm::mat4& world)
+		{
+			float scale = std::max({ glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2])) });
+			glm::vec3 center = glm::vec3(world * glm::vec4(part.BoundsCenter, 1.0f));
+			m_Result.Radius = std::max(m_Result.Radius, glm::length(center) + part.BoundsRadius * scale);
+			m_Result.TriangleCount += part.Mesh->Indices.size() / 3;
+			m_Result.ModelCount++;
+		}
+
+		std::string m_Path;
+		SceneGraph& m_Scene;
+		VertexFormat m_Format;
+		std::string m_Directory;		// relative to ASSETS_PATH, with a trailing separator
+		std::string m_Stem;
+		MappedFile m_File;
+		JsonValue m_Json;
+		BufferRange m_BinChunk;
+		std::vector<MappedFile> m_BufferFiles;
+		std::vector<std::vector<uint8_t>> m_DecodedBuffers;
+		std::vector<BufferRange> m_Buffers;
+		std::vector<std::vector<ModelPart>> m_MeshParts;
+		std::vector<bool> m_MeshLoaded;
+		std::vector<bool> m_NodeVisited;
+		std::unordered_map<size_t, ImageSource> m_Images;
+		GltfImportResult m_Result;
+	};
+}
+
+GltfImportResult Gltf::Import(const std::string& path, SceneGraph& scene, NodeHandle parent, VertexFormat format)
+{
+	PROFILE_SCOPE("Gltf::Import");
+	Importer importer(path, scene, format);
+	return importer.Run(parent);
+}
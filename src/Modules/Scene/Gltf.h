@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Graph.h"
+
+struct GltfImportResult
+{
+	NodeHandle Root;				// Inner node named after the file
+	uint32_t NodeCount = 0;
+	uint32_t ModelCount = 0;
+	uint64_t TriangleCount = 0;
+	float Radius = 0.0f;			// sphere around the origin containing every model
+};
+
+// glTF 2.0 importer, .gltf with external or data URI buffers and .glb.
+//
+//   GltfImportResult result = Gltf::Import("models/sponza/Sponza.gltf", scene);
+//
+// Nodes keep the file hierarchy and transforms, every triangle primitive
+// becomes a Model node and the base color of its material maps to the
+// diffuse color and texture. Cameras, lights, skins and animations are skipped.
+namespace Gltf
+{
+	// path is relative to ASSETS_PATH, the file becomes a child of parent,
+	// of the root for a null one. Throws std::runtime_error for files that
+	// cannot be read or are not valid glTF and leaves the scene unchanged.
+	// Meshes get the vertex format given, packed by default since production
+	// meshes are dense and halving the vertex bandwidth is worth 16-bit positions.
+	// Mesh shaders only draw full vertices.
+	GltfImportResult Import(const std::string& path, SceneGraph& scene, NodeHandle parent = {}, VertexFormat format = VertexFormat::Packed);
+}
@@ -1,5 +1,6 @@
 #include <imgui.h>
 #include "Graph.h"
+#include "../../Core/Profiler.h"
 
 SceneGraph::SceneGraph()
 {
@@ -15,71 +16,138 @@ void SceneGraph::Initialize()
 
 void SceneGraph::Terminate()
 {
-    m_Root.Destroy();
+    m_Nodes.Clear();
 }
 
 void SceneGraph::OnGUI()
 {
 }
 
-void SceneGraph::AddNode(Node *node)
+void SceneGraph::OnPropertiesGUI(NodeHandle handle)
 {
-    m_Root.AddNode(node);
-}
+    const std::string& name = m_Nodes.GetName(handle);
+    Node& node = m_Nodes.Get(handle);
+    ImGui::PushID(name.c_str());
 
-SceneGraphDFSIterator SceneGraph::begin()
-{
-    return SceneGraphDFSIterator(&m_Root);
-}
+    ImGui::SeparatorText(name.c_str());
+    ImGui::Separator();
+    node.GetTransform().OnGUI();
+    ImGui::Separator();
 
-SceneGraphDFSIterator SceneGraph::end()
-{
-    return SceneGraphDFSIterator(nullptr);
+    if (MaterialComponent* material = m_Nodes.FindComponent<MaterialComponent>(handle))
+        material->Data.OnGUI();
+
+    if (DirectionalLight* light = m_Nodes.FindComponent<DirectionalLight>(handle))
+        light->OnGUI();
+
+    if (PointLight* light = m_Nodes.FindComponent<PointLight>(handle))
+        light->OnGUI();
+
+    ImGui::PopID();
 }
 
-SceneGraphDFSIterator::SceneGraphDFSIterator(Node *node)
+NodeHandle SceneGraph::AddNode(const std::string& name, NodeHandle parent)
 {
-    if (node != nullptr)
-    {
-        stack_.push(node);
-        AdvanceToNextNode();
-    }
+    return m_Nodes.Create(name, GetParentForNew(parent));
 }
 
-SceneGraphDFSIterator &SceneGraphDFSIterator::operator++()
+NodeHandle SceneGraph::AddNode(const std::string& name, const Model& model, NodeHandle parent)
 {
-    AdvanceToNextNode();
-    return *this;
+    NodeHandle handle = m_Nodes.Create(name, GetParentForNew(parent));
+    m_Nodes.AddComponent(handle, MeshComponent{ model.GetMeshData(), model.GetMeshPath() });
+    m_Nodes.AddComponent(handle, MaterialComponent{ model.GetMaterialParameters() });
+    return handle;
 }
 
-Node &SceneGraphDFSIterator::operator*()
+NodeHandle SceneGraph::AddNode(const std::string& name, const DirectionalLight& light, NodeHandle parent)
 {
-    return *current_node_;
+    NodeHandle handle = m_Nodes.Create(name, GetParentForNew(parent));
+    m_Nodes.AddComponent(handle, light);
+    return handle;
 }
 
-bool SceneGraphDFSIterator::operator==(const SceneGraphDFSIterator &other) const
+NodeHandle SceneGraph::AddNode(const std::string& name, const PointLight& light, NodeHandle parent)
 {
-    return current_node_ == other.current_node_ && stack_ == other.stack_;
+    NodeHandle handle = m_Nodes.Create(name, GetParentForNew(parent));
+    m_Nodes.AddComponent(handle, light);
+    return handle;
 }
 
-bool SceneGraphDFSIterator::operator!=(const SceneGraphDFSIterator &other) const
+NodeHandle SceneGraph::AddNode(const std::string& name, const Camera& camera, NodeHandle parent)
 {
-    return !(*this == other);
+    NodeHandle handle = m_Nodes.Create(name, GetParentForNew(parent));
+    m_Nodes.AddComponent(handle, camera);
+    return handle;
 }
 
-void SceneGraphDFSIterator::AdvanceToNextNode()
+void SceneGraph::PublishSnapshot(const Camera& camera, double time, double step)
 {
-    if (stack_.empty())
+    PROFILE_SCOPE("SceneGraph::PublishSnapshot");
+    SceneSnapshot& snapshot = m_Snapshots.GetWriteBuffer();
+    snapshot.Tick = ++m_Tick;
+    snapshot.Time = time;
+    snapshot.Step = step;
+    snapshot.CurrentCamera = camera;
+    snapshot.PreviousCamera = m_HasPrevious ? m_PreviousCamera : camera;
+    snapshot.Items.clear();
+
+    // parents come first in the pool, so world matrices are one pass
+    m_Nodes.Reorder();
+    std::vector<Node>& nodes = m_Nodes.GetNodes();
+    m_World.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
     {
-        current_node_ = nullptr;
-        return;
+        glm::mat4 local = nodes[i].GetTransform().GetCompositeMatrix();
+        m_World[i] = nodes[i].GetParent() == INVALID_NODE_INDEX ? local : m_World[nodes[i].GetParent()] * local;
     }
 
-    current_node_ = stack_.top();
-    stack_.pop();
-
-    for (auto it = current_node_->GetChildren().rbegin(); it != current_node_->GetChildren().rend(); ++it)
+    // the first light of each kind in depth first order, as the components are
+    ComponentStorage<DirectionalLight>& dirLights = m_Nodes.GetStorage<DirectionalLight>();
+    if (!dirLights.IsEmpty())
+    {
+        snapshot.DirLight.Direction = nodes[m_Nodes.GetPosition(dirLights.GetEntity(0))].GetTransform().GetForward();
+        snapshot.DirLight.Light = dirLights.GetAt(0);
+    }
+    ComponentStorage<PointLight>& pointLights = m_Nodes.GetStorage<PointLight>();
+    if (!pointLights.IsEmpty())
     {
-        stack_.push(*it);
+        snapshot.PointLight.Position = nodes[m_Nodes.GetPosition(pointLights.GetEntity(0))].GetTransform().Position;
+        snapshot.PointLight.Light = pointLights.GetAt(0);
     }
-}
\ No newline at end of file
+
+    m_Nodes.Query<MaterialComponent, MeshComponent>().Each([&](NodeHandle handle, MaterialComponent& material, MeshComponent& mesh)
+    {
+        if (mesh.GPUMesh == nullptr || material.GPUMaterial == nullptr)
+            return;
+
+        const glm::mat4& world = m_World[m_Nodes.GetPosition(handle)];
+        RenderItem item{};
+        item.GPUMesh = mesh.GPUMesh.get();
+        item.GPUMaterial = material.GPUMaterial;
+        item.Type = material.Data.Type;
+        item.Parameters = material.Data.Parameters;
+        item.Model = world;
+        item.Normal = glm::transpose(glm::inverse(world));
+        item.Current = WorldTransform::FromMatrix(world);
+
+        // the world matrix this node had at the last publish, if it was drawn then
+        if (handle.Index >= m_PreviousWorld.size())
+            m_PreviousWorld.resize(handle.Index + 1);
+        PreviousWorld& previous = m_PreviousWorld[handle.Index];
+        item.Moved = previous.Handle == handle && previous.Tick + 1 == snapshot.Tick && previous.World != world;
+        item.Previous = item.Moved ? WorldTransform::FromMatrix(previous.World) : item.Current;
+        previous = { handle, snapshot.Tick, world };
+
+        snapshot.Items.push_back(item);
+    });
+    m_PreviousCamera = camera;
+    m_HasPrevious = true;
+
+    m_Snapshots.Publish();
+}
+
+const SceneSnapshot& SceneGraph::AcquireSnapshot()
+{
+    m_Snapshots.Acquire();
+    return m_Snapshots.GetReadBuffer();
+}
@@ -1,27 +1,18 @@
 #pragma once
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <stack>
+#include <mutex>
 #include "../Renderer/Vulkan/Mesh.h"
 #include "../Renderer/Vulkan/Material.h"
-#include "Node.h"
-
-class SceneGraphDFSIterator
-{
-public:
-    SceneGraphDFSIterator(Node* node);
-    SceneGraphDFSIterator& operator++();
-    Node& operator*();
-    bool operator==(const SceneGraphDFSIterator& other) const;
-    bool operator!=(const SceneGraphDFSIterator& other) const;
-
-private:
-    void AdvanceToNextNode();
-
-
-    Node* current_node_{};
-    std::stack<Node*> stack_;
-};
+#include "../../Core/TripleBuffer.h"
+#include "Camera.h"
+#include "Model.h"
+#include "Lighting/DirectionalLight.h"
+#include "Lighting/PointLight.h"
+#include "NodePool.h"
+#include "Snapshot.h"
 
 class SceneGraph
 {
@@ -33,23 +24,89 @@ public:
     void Terminate();
 
     void OnGUI();
+    void OnPropertiesGUI(NodeHandle handle);
+
+    // A null parent adds to the root. Names are unique among siblings, adding
+    // a duplicate throws. The overloads attach components, a Model becomes a
+    // MeshComponent and a MaterialComponent.
+    NodeHandle AddNode(const std::string& name, NodeHandle parent = {});
+    NodeHandle AddNode(const std::string& name, const Model& model, NodeHandle parent = {});
+    NodeHandle AddNode(const std::string& name, const DirectionalLight& light, NodeHandle parent = {});
+    NodeHandle AddNode(const std::string& name, const PointLight& light, NodeHandle parent = {});
+    NodeHandle AddNode(const std::string& name, const Camera& camera, NodeHandle parent = {});
+    // Removes the node and its subtree
+    void RemoveNode(NodeHandle handle) { m_Nodes.Destroy(handle); }
+
+    bool IsValid(NodeHandle handle) const { return m_Nodes.IsValid(handle); }
+    NodeHandle GetRoot() const { return m_Nodes.GetRoot(); }
+    // Lookups hash interned names instead of scanning siblings. They return
+    // null when nothing matches, handles stay valid until the node is removed
+    // so hot code should look up once and keep the handle.
+    NodeHandle FindChild(NodeHandle parent, std::string_view name) const { return m_Nodes.FindChild(parent, name); }
+    // Slash separated path below the root, like "level/props/crate"
+    NodeHandle Find(std::string_view path) const { return m_Nodes.FindPath(GetRoot(), path); }
+    const std::string& GetName(NodeHandle handle) const { return m_Nodes.GetName(handle); }
+    NodePool& GetNodes() { return m_Nodes; }
 
-    void AddNode(Node* node);
+    // Components of any type, see NodePool
+    template <typename T>
+    T& AddComponent(NodeHandle handle, T component) { return m_Nodes.AddComponent(handle, std::move(component)); }
+    template <typename T>
+    T& GetComponent(NodeHandle handle) { return m_Nodes.GetComponent<T>(handle); }
+    template <typename T>
+    T* FindComponent(NodeHandle handle) { return m_Nodes.FindComponent<T>(handle); }
+    // Linear over packed component arrays, optionally split across threads
+    template <typename... Components>
+    ComponentQuery<Components...> Query() { return m_Nodes.Query<Components...>(); }
 
-    Node& operator[](std::string name) {
-        Node* root = m_Root[name];
-        if (root == nullptr)
-        {
-            throw std::runtime_error("Node with name " + name + " does not exist");
-        }
-        return *root;
+    // Simulation side: copies render relevant state into the next snapshot.
+    // time and step describe the simulation clock for render interpolation.
+    // Must be called with the scene mutex held.
+    void PublishSnapshot(const Camera& camera, double time = 0.0, double step = 0.0);
+    // Render side: returns the most recently published snapshot
+    const SceneSnapshot& AcquireSnapshot();
+
+    // Guards the nodes against concurrent edits from the simulation and render threads
+    std::mutex& GetMutex() { return m_Mutex; }
+
+    Node& operator[](NodeHandle handle) { return m_Nodes.Get(handle); }
+    // Node by path below the root, see Find
+    Node& operator[](const std::string& path)
+    {
+        NodeHandle handle = Find(path);
+        if (handle.IsNull())
+            throw std::runtime_error("Node with name " + path + " does not exist");
+        return m_Nodes.Get(handle);
     }
 
-    SceneGraphDFSIterator begin();
-    SceneGraphDFSIterator end() ;
+    // Every node in depth first order, the root first. A linear scan over the
+    // pool, sorted first if the topology changed since the last traversal.
+    Node* begin() { return m_Nodes.GetAll().begin(); }
+    Node* end() { return m_Nodes.GetAll().end(); }
+    // Allocation free views, see NodeView.h
+    NodeRange Subtree(NodeHandle handle) { return m_Nodes.GetSubtree(handle); }
+    NodeChildView Children(NodeHandle parent) const { return m_Nodes.GetChildren(parent); }
 
 private:
-    Node m_Root{"Root"};
+    // Resolves a null parent to the root
+    NodeHandle GetParentForNew(NodeHandle parent) const { return parent.IsNull() ? GetRoot() : parent; }
+
+    NodePool m_Nodes;
+    std::vector<glm::mat4> m_World;		// per node, in pool order
+    std::mutex m_Mutex;
+    TripleBuffer<SceneSnapshot> m_Snapshots;
+    uint64_t m_Tick = 0;
+    Camera m_PreviousCamera;
+    // World matrix of every drawn node at the publish it was last drawn in,
+    // by slot. The handle tells a reused slot from the node it had before.
+    struct PreviousWorld
+    {
+        NodeHandle Handle;
+        uint64_t Tick = 0;
+        glm::mat4 World = glm::mat4(1.0f);
+    };
+    std::vector<PreviousWorld> m_PreviousWorld;
+    bool m_HasPrevious = false;
 
 friend class Renderer;
 };
\ No newline at end of file
@@ -3,10 +3,16 @@
 #include "Model.h"
 
 Model::Model(const MeshData& meshData, MaterialData material)
-    : m_MeshData(meshData), m_Material(material)
+    : m_MeshData(std::make_shared<const MeshData>(meshData)), m_Material(material)
 {
 }
 
-Model::~Model()
+Model::Model(std::shared_ptr<const MeshData> meshData, MaterialData material)
+    : m_MeshData(std::move(meshData)), m_Material(material)
+{
+}
+
+Model::Model(const std::string& meshPath, MaterialData material)
+    : m_MeshPath(meshPath), m_Material(material)
 {
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <memory>
 #include <string>
 #include "../Renderer/Vulkan/Mesh.h"
 #include "../Renderer/Vulkan/Material.h"
@@ -8,16 +9,21 @@ class Model
 {
 public:
     Model() = default;
+    // Copies meshData, share one mesh between models with the shared_ptr overload
     Model(const MeshData& meshData, MaterialData material);
-    ~Model();
+    Model(std::shared_ptr<const MeshData> meshData, MaterialData material);
+    // Mesh loaded from a mesh file under ASSETS_PATH when the renderer sets up
+    Model(const std::string& meshPath, MaterialData material);
 
-    MeshData GetMeshData() const { return m_MeshData; }
+    // Null for models loaded from a mesh file
+    const std::shared_ptr<const MeshData>& GetMeshData() const { return m_MeshData; }
+    const std::string& GetMeshPath() const { return m_MeshPath; }
     MaterialData& GetMaterialParameters() { return m_Material; }
+    const MaterialData& GetMaterialParameters() const { return m_Material; }
     void SetMaterialParameters(MaterialData material) { m_Material = material; }
 
 private:
-    MeshData m_MeshData;
+    std::shared_ptr<const MeshData> m_MeshData;
+    std::string m_MeshPath;		// empty when m_MeshData is the mesh
     MaterialData m_Material;
-
-    friend class Node;
 };
\ No newline at end of file
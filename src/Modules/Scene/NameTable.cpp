@@ -0,0 +1,19 @@
+#include "NameTable.h"
+
+uint32_t NameTable::Intern(std::string_view name)
+{
+	auto it = m_Ids.find(name);
+	if (it != m_Ids.end())
+		return it->second;
+
+	uint32_t id = static_cast<uint32_t>(m_Names.size());
+	m_Names.emplace_back(name);
+	m_Ids.emplace(m_Names.back(), id);
+	return id;
+}
+
+uint32_t NameTable::Find(std::string_view name) const
+{
+	auto it = m_Ids.find(name);
+	return it == m_Ids.end() ? INVALID_NAME : it->second;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Interns node names so equal names share one id. Comparing and hashing ids
+// replaces string compares in lookups. Names stay interned for the lifetime
+// of the table, references returned by Get never move.
+class NameTable
+{
+public:
+	// Index of no name
+	static const uint32_t INVALID_NAME = UINT32_MAX;
+
+	uint32_t Intern(std::string_view name);
+	// INVALID_NAME when the name was never interned, so no node can have it
+	uint32_t Find(std::string_view name) const;
+	const std::string& Get(uint32_t id) const { return m_Names[id]; }
+	size_t GetSize() const { return m_Names.size(); }
+
+private:
+	std::deque<std::string> m_Names;	// stable addresses for the views in m_Ids
+	std::unordered_map<std::string_view, uint32_t> m_Ids;
+};
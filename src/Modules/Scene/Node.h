@@ -1,66 +1,42 @@
 #pragma once
-#include <memory.h>
-#include <stack>
-#include "./Lighting/Light.h"
-#include "Lighting/DirectionalLight.h"
-#include "Lighting/PointLight.h"
-#include "../Renderer/Vulkan/Mesh.h"
-#include "../Renderer/Vulkan/Material.h"
-#include "Model.h"
+#include <cstdint>
 #include "Transform.h"
 
-enum class NodeType
+// Index of no node, no slot or no component
+const uint32_t INVALID_NODE_INDEX = UINT32_MAX;
+
+// Generational reference to a node in a NodePool. Stays valid while the pool
+// grows and reorders, and never matches a later node reusing the same slot.
+struct NodeHandle
 {
-    Inner,
-    Model,
-    DirLight,
-    PointLight
+    uint32_t Index = INVALID_NODE_INDEX;	// slot in the pool
+    uint32_t Generation = 0;
+
+    bool IsNull() const { return Index == INVALID_NODE_INDEX; }
+    bool operator==(const NodeHandle& other) const { return Index == other.Index && Generation == other.Generation; }
+    bool operator!=(const NodeHandle& other) const { return !(*this == other); }
 };
 
+// Hierarchy and transform of one node, stored contiguously in depth first
+// order by the NodePool. Names and components live elsewhere, so a node only
+// carries what every traversal touches. References are invalidated by any
+// change to the topology, keep handles across those.
 class Node
 {
 public:
-    Node() = default;
-    Node(std::string name);
-    Node(std::string name, Model model);
-    Node(std::string name, DirectionalLight light);
-    Node(std::string name, PointLight light);
-    void Destroy();
-
-    std::string GetName() const { return m_Name; }
-    Model& GetModel() { return m_Model; }
-    DirectionalLight& GetDirLight() { return m_DirLight; }
-    PointLight& GetPointLight() { return m_PointLight; }
+    NodeHandle GetHandle() const { return m_Handle; }
     Transform& GetTransform() { return m_Transform; }
-    NodeType GetType() const { return m_Type; }
-
-    Node* GetParent() const { return m_Parent; }
-    std::vector<Node*>& GetChildren() { return m_Children; }
-
-    void AddNode(Node* node);
+    const Transform& GetTransform() const { return m_Transform; }
 
-    Node* operator[](uint32_t index) { return m_Children[index]; }
-    Node* operator[](std::string name) { return FindNode(name); }
+    // Positions in the pool, valid while the pool is in order
+    uint32_t GetParent() const { return m_Parent; }
+    uint32_t GetSubtreeEnd() const { return m_SubtreeEnd; }
 
-    void OnPropertiesGUI();
-    
 private:
-    bool NodeExists(std::string name);
-    Node* FindNode(std::string name);
-
-    std::string m_Name;
-    Model m_Model;
     Transform m_Transform;
-    NodeType m_Type = NodeType::Inner;
-
-    Node* m_Parent = nullptr;
-    std::vector<Node*> m_Children; 
-    
-    DirectionalLight m_DirLight;
-    PointLight m_PointLight;
+    uint32_t m_Parent = INVALID_NODE_INDEX;
+    uint32_t m_SubtreeEnd = 0;					// one past the last descendant
+    NodeHandle m_Handle;
 
-    Mesh* m_Mesh = nullptr;
-    Material* m_Material = nullptr;
-
-friend class Renderer;
-};
\ No newline at end of file
+friend class NodePool;
+};
@@ -0,0 +1,310 @@
+#include <stdexcept>
+#include "NodePool.h"
+#include "../../Core/Profiler.h"
+
+NodePool::NodePool()
+{
+	m_Root = Allocate("Root", INVALID_NODE_INDEX);
+}
+
+NodeHandle NodePool::Create(const std::string& name, NodeHandle parent)
+{
+	return Allocate(name, GetSlot(parent));
+}
+
+void NodePool::Destroy(NodeHandle handle)
+{
+	uint32_t slot = GetSlot(handle);
+	if (handle == m_Root)
+		throw std::runtime_error("The root node cannot be destroyed");
+
+	Unlink(slot);
+	m_InOrder = false;
+
+	// post order over the links, a node is freed once all of its children are
+	uint32_t current = slot;
+	while (m_Slots[current].FirstChild != INVALID_NODE_INDEX)
+		current = m_Slots[current].FirstChild;
+	while (true)
+	{
+		uint32_t next = m_Slots[current].NextSibling;
+		uint32_t parent = m_Slots[current].Parent;
+		bool last = current == slot;
+		Free(current);
+		if (last)
+			break;
+
+		if (next == INVALID_NODE_INDEX)
+			current = parent;
+		else
+		{
+			current = next;
+			while (m_Slots[current].FirstChild != INVALID_NODE_INDEX)
+				current = m_Slots[current].FirstChild;
+		}
+	}
+}
+
+void NodePool::Clear()
+{
+	while (m_Slots[m_Root.Index].FirstChild != INVALID_NODE_INDEX)
+		Destroy(GetHandle(m_Slots[m_Root.Index].FirstChild));
+	// the root alone is in order
+	m_Nodes[0].m_SubtreeEnd = 1;
+	m_InOrder = true;
+}
+
+bool NodePool::IsValid(NodeHandle handle) const
+{
+	return handle.Index < m_Slots.size() && m_Slots[handle.Index].Generation == handle.Generation && m_Slots[handle.Index].Position != INVALID_NODE_INDEX;
+}
+
+Node& NodePool::Get(NodeHandle handle)
+{
+	return m_Nodes[m_Slots[GetSlot(handle)].Position];
+}
+
+const std::string& NodePool::GetName(NodeHandle handle) const
+{
+	return m_Names.Get(m_Slots[GetSlot(handle)].Name);
+}
+
+uint32_t NodePool::GetPosition(NodeHandle handle) const
+{
+	return m_Slots[GetSlot(handle)].Position;
+}
+
+NodeHandle NodePool::GetParent(NodeHandle handle) const
+{
+	return GetHandle(m_Slots[GetSlot(handle)].Parent);
+}
+
+NodeHandle NodePool::GetFirstChild(NodeHandle handle) const
+{
+	return GetHandle(m_Slots[GetSlot(handle)].FirstChild);
+}
+
+NodeHandle NodePool::GetNextSibling(NodeHandle handle) const
+{
+	return GetHandle(m_Slots[GetSlot(handle)].NextSibling);
+}
+
+NodeHandle NodePool::FindChild(NodeHandle parent, std::string_view name) const
+{
+	return GetHandle(FindChildSlot(GetSlot(parent), name));
+}
+
+NodeHandle NodePool::FindPath(NodeHandle from, std::string_view path) const
+{
+	uint32_t slot = GetSlot(from);
+	size_t start = 0;
+	while (slot != INVALID_NODE_INDEX && start < path.size())
+	{
+		size_t end = path.find('/', start);
+		if (end == std::string_view::npos)
+			end = path.size();
+		if (end > start)
+			slot = FindChildSlot(slot, path.substr(start, end - start));
+		start = end + 1;
+	}
+	return GetHandle(slot);
+}
+
+void NodePool::Reorder()
+{
+	if (m_InOrder)
+		return;
+
+	PROFILE_SCOPE("NodePool::Reorder");
+	m_NodeScratch.clear();
+
+	// Depth first over the links. Positions are handed out on the way down,
+	// subtree ends on the way back up. Parents are always placed first, so
+	// their slot already holds the new position when a child reads it.
+	uint32_t slot = m_Root.Index;
+	while (slot != INVALID_NODE_INDEX)
+	{
+		Slot& entry = m_Slots[slot];
+		m_NodeScratch.push_back(std::move(m_Nodes[entry.Position]));
+		entry.Position = static_cast<uint32_t>(m_NodeScratch.size() - 1);
+		m_NodeScratch.back().m_Parent = entry.Parent == INVALID_NODE_INDEX ? INVALID_NODE_INDEX : m_Slots[entry.Parent].Position;
+		if (entry.FirstChild != INVALID_NODE_INDEX)
+		{
+			slot = entry.FirstChild;
+			continue;
+		}
+
+		// close every finished subtree up to the next sibling, the root has none
+		while (slot != INVALID_NODE_INDEX && m_Slots[slot].NextSibling == INVALID_NODE_INDEX)
+		{
+			m_NodeScratch[m_Slots[slot].Position].m_SubtreeEnd = static_cast<uint32_t>(m_NodeScratch.size());
+			slot = m_Slots[slot].Parent;
+		}
+		if (slot != INVALID_NODE_INDEX)
+		{
+			m_NodeScratch[m_Slots[slot].Position].m_SubtreeEnd = static_cast<uint32_t>(m_NodeScratch.size());
+			slot = m_Slots[slot].NextSibling;
+		}
+	}
+	m_Nodes.swap(m_NodeScratch);
+
+	// components follow their nodes, free slots are never looked at
+	m_PositionScratch.resize(m_Slots.size());
+	for (uint32_t i = 0; i < GetSize(); i++)
+		m_PositionScratch[m_Nodes[i].m_Handle.Index] = i;
+	m_Components.SortBy(m_PositionScratch);
+	m_InOrder = true;
+}
+
+NodeRange NodePool::GetAll()
+{
+	Reorder();
+	return NodeRange(m_Nodes.data(), m_Nodes.data() + m_Nodes.size());
+}
+
+NodeRange NodePool::GetSubtree(NodeHandle handle)
+{
+	uint32_t slot = GetSlot(handle);
+	Reorder();
+	Node* node = m_Nodes.data() + m_Slots[slot].Position;
+	return NodeRange(node, m_Nodes.data() + node->m_SubtreeEnd);
+}
+
+NodeHandle NodePool::Allocate(const std::string& name, uint32_t parent)
+{
+	uint32_t slot = m_FreeSlot != INVALID_NODE_INDEX ? m_FreeSlot : static_cast<uint32_t>(m_Slots.size());
+	uint32_t nameId = m_Names.Intern(name);
+	if (parent != INVALID_NODE_INDEX && !m_Children.emplace(GetChildKey(parent, nameId), slot).second)
+		throw std::runtime_error("Node " + name + " already exists");
+
+	if (slot == m_FreeSlot)
+		m_FreeSlot = m_Slots[slot].NextFree;
+	else
+		m_Slots.emplace_back();
+
+	uint32_t position = GetSize();
+	Slot& entry = m_Slots[slot];
+	entry.Position = position;
+	entry.Name = nameId;
+	entry.Parent = parent;
+	entry.FirstChild = INVALID_NODE_INDEX;
+	entry.LastChild = INVALID_NODE_INDEX;
+	entry.PreviousSibling = INVALID_NODE_INDEX;
+	entry.NextSibling = INVALID_NODE_INDEX;
+	entry.NextFree = INVALID_NODE_INDEX;
+
+	Node node;
+	node.m_Handle = { slot, entry.Generation };
+	node.m_SubtreeEnd = position + 1;
+	if (parent != INVALID_NODE_INDEX)
+	{
+		Slot& parentEntry = m_Slots[parent];
+		entry.PreviousSibling = parentEntry.LastChild;
+		if (parentEntry.LastChild != INVALID_NODE_INDEX)
+			m_Slots[parentEntry.LastChild].NextSibling = slot;
+		else
+			parentEntry.FirstChild = slot;
+		parentEntry.LastChild = slot;
+		node.m_Parent = parentEntry.Position;
+
+		// Appending under a node whose subtree ends the array keeps the order
+		// depth first, as when a scene is built top down. Only the subtree ends
+		// of the ancestors grow then.
+		if (m_InOrder && m_Nodes[parentEntry.Position].m_SubtreeEnd == position)
+		{
+			for (uint32_t ancestor = parentEntry.Position; ancestor != INVALID_NODE_INDEX; ancestor = m_Nodes[ancestor].m_Parent)
+				m_Nodes[ancestor].m_SubtreeEnd = position + 1;
+		}
+		else
+			m_InOrder = false;
+	}
+
+	m_Nodes.push_back(node);
+	return node.m_Handle;
+}
+
+uint32_t NodePool::GetSlot(NodeHandle handle) const
+{
+	if (!IsValid(handle))
+		throw std::runtime_error("Node handle is null or stale");
+	return handle.Index;
+}
+
+uint32_t NodePool::FindChildSlot(uint32_t parent, std::string_view name) const
+{
+	// a name that was never interned cannot belong to any node
+	uint32_t nameId = m_Names.Find(name);
+	if (nameId == NameTable::INVALID_NAME)
+		return INVALID_NODE_INDEX;
+	auto it = m_Children.find(GetChildKey(parent, nameId));
+	return it == m_Children.end() ? INVALID_NODE_INDEX : it->second;
+}
+
+NodeHandle NodePool::GetHandle(uint32_t slot) const
+{
+	if (slot == INVALID_NODE_INDEX)
+		return NodeHandle();
+	return { slot, m_Slots[slot].Generation };
+}
+
+void NodePool::Unlink(uint32_t slot)
+{
+	Slot& entry = m_Slots[slot];
+	if (entry.Parent == INVALID_NODE_INDEX)
+		return;
+
+	m_Children.erase(GetChildKey(entry.Parent, entry.Name));
+	Slot& parent = m_Slots[entry.Parent];
+	if (entry.PreviousSibling != INVALID_NODE_INDEX)
+		m_Slots[entry.PreviousSibling].NextSibling = entry.NextSibling;
+	else
+		parent.FirstChild = entry.NextSibling;
+	if (entry.NextSibling != INVALID_NODE_INDEX)
+		m_Slots[entry.NextSibling].PreviousSibling = entry.PreviousSibling;
+	else
+		parent.LastChild = entry.PreviousSibling;
+
+	entry.Parent = INVALID_NODE_INDEX;
+	entry.PreviousSibling = INVALID_NODE_INDEX;
+	entry.NextSibling = INVALID_NODE_INDEX;
+}
+
+void NodePool::Free(uint32_t slot)
+{
+	Slot& entry = m_Slots[slot];
+	uint32_t position = entry.Position;
+	// meshes are shared, removing the component drops this node's reference
+	MaterialComponent* material = m_Components.GetStorage<MaterialComponent>().Find(slot);
+	if (material != nullptr && material->GPUMaterial != nullptr)
+	{
+		material->GPUMaterial->Destroy();
+		delete material->GPUMaterial;
+	}
+	m_Components.RemoveAll(slot);
+
+	// descendants are freed without unlinking, the top node already was
+	if (entry.Parent != INVALID_NODE_INDEX)
+		m_Children.erase(GetChildKey(entry.Parent, entry.Name));
+
+	// the last node takes the freed place
+	uint32_t last = GetSize() - 1;
+	if (position != last)
+	{
+		m_Nodes[position] = std::move(m_Nodes[last]);
+		m_Slots[m_Nodes[position].m_Handle.Index].Position = position;
+	}
+	m_Nodes.pop_back();
+
+	entry.Position = INVALID_NODE_INDEX;
+	entry.Generation++;
+	entry.FirstChild = INVALID_NODE_INDEX;
+	entry.LastChild = INVALID_NODE_INDEX;
+	entry.NextFree = m_FreeSlot;
+	m_FreeSlot = slot;
+}
+
+NodeChildView::Iterator& NodeChildView::Iterator::operator++()
+{
+	m_Node = m_Pool->GetNextSibling(m_Node);
+	return *this;
+}
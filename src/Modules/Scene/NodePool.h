@@ -0,0 +1,169 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "Node.h"
+#include "NodeView.h"
+#include "NameTable.h"
+#include "ComponentRegistry.h"
+#include "../Renderer/Vulkan/Mesh.h"
+#include "../Renderer/Vulkan/Material.h"
+
+// Components the renderer draws. Lights and cameras are attached as
+// DirectionalLight, PointLight and Camera themselves.
+
+struct MeshComponent
+{
+	std::shared_ptr<const MeshData> Data;	// null for mesh files
+	std::string Path;						// mesh file under ASSETS_PATH, empty when Data is the mesh
+	std::shared_ptr<Mesh> GPUMesh;			// created by the renderer, shared by every node drawing the same mesh
+};
+
+struct MaterialComponent
+{
+	MaterialData Data;
+	Material* GPUMaterial = nullptr;		// created by the renderer, destroyed with the node
+};
+
+// Owns every node of a scene. Handles map through a slot table to positions
+// in one contiguous node array. Everything else a node has, meshes,
+// materials, lights, cameras, is a component in a ComponentRegistry keyed by
+// the same slots. Creating and destroying a node is O(1) apart from its
+// subtree, freed slots are reused through a free list.
+//
+// Names are interned and unique among siblings. A hash index from parent and
+// name to child makes finding a child, and so checking for duplicates on
+// create, O(1) however wide the parent is.
+//
+// The hierarchy is kept as first child / next sibling links in the slots.
+// Topology changes only mark the pool out of order, Reorder then sorts the
+// nodes and every component array into depth first order, so a traversal is
+// a linear scan where every parent comes before its children and a query
+// visits components in the same order.
+class NodePool
+{
+public:
+	NodePool();
+
+	NodePool(const NodePool&) = delete;
+	NodePool& operator=(const NodePool&) = delete;
+
+	// The root is created with the pool and cannot be destroyed
+	NodeHandle GetRoot() const { return m_Root; }
+
+	// Appends a node as the last child of parent, throws std::runtime_error
+	// when parent already has a child of that name
+	NodeHandle Create(const std::string& name, NodeHandle parent);
+	// Destroys the node and its subtree with all of their components. GPU
+	// meshes and materials are destroyed too, the renderer must no longer be
+	// using them.
+	void Destroy(NodeHandle handle);
+	// Destroys everything but the root, GPU resources included
+	void Clear();
+
+	bool IsValid(NodeHandle handle) const;
+	// Throw std::runtime_error for stale handles
+	Node& Get(NodeHandle handle);
+	const std::string& GetName(NodeHandle handle) const;
+	// Index of the node in GetNodes
+	uint32_t GetPosition(NodeHandle handle) const;
+
+	// At most one component of each type per node. Add throws when the node
+	// already has one, Get when it has none, Find returns null then.
+	template <typename T>
+	T& AddComponent(NodeHandle handle, T component)
+	{
+		GetSlot(handle);
+		return m_Components.GetStorage<T>().Add(handle, std::move(component));
+	}
+	template <typename T>
+	T& GetComponent(NodeHandle handle)
+	{
+		T* component = FindComponent<T>(handle);
+		if (component == nullptr)
+			throw std::runtime_error("Node " + GetName(handle) + " has no component of this type");
+		return *component;
+	}
+	template <typename T>
+	T* FindComponent(NodeHandle handle) { return m_Components.GetStorage<T>().Find(GetSlot(handle)); }
+	template <typename T>
+	bool HasComponent(NodeHandle handle) { return FindComponent<T>(handle) != nullptr; }
+	template <typename T>
+	void RemoveComponent(NodeHandle handle)
+	{
+		static_assert(!std::is_same_v<T, MaterialComponent>,
+			"GPU backed components are destroyed with their node");
+		m_Components.GetStorage<T>().Remove(GetSlot(handle));
+	}
+
+	// Packed components of one type and queries across several, see ComponentRegistry.h
+	template <typename T>
+	ComponentStorage<T>& GetStorage() { return m_Components.GetStorage<T>(); }
+	template <typename... Components>
+	ComponentQuery<Components...> Query() { return m_Components.Query<Components...>(); }
+
+	NodeHandle GetParent(NodeHandle handle) const;
+	NodeHandle GetFirstChild(NodeHandle handle) const;
+	NodeHandle GetNextSibling(NodeHandle handle) const;
+	// Null when parent has no child of that name
+	NodeHandle FindChild(NodeHandle parent, std::string_view name) const;
+	// Follows a slash separated path of child names down from the node, one
+	// hash lookup per name. Empty names are skipped, so "/a//b/" is "a/b".
+	NodeHandle FindPath(NodeHandle from, std::string_view path) const;
+
+	// Sorts nodes and components into depth first order, free when already in order
+	void Reorder();
+	bool IsInOrder() const { return m_InOrder; }
+
+	// Allocation free traversals in depth first order, the ranges sort first
+	NodeRange GetAll();
+	// The node followed by all of its descendants
+	NodeRange GetSubtree(NodeHandle handle);
+	NodeChildView GetChildren(NodeHandle parent) const { return NodeChildView(this, GetFirstChild(parent)); }
+
+	uint32_t GetSize() const { return static_cast<uint32_t>(m_Nodes.size()); }
+	// Contiguous storage, in depth first order after Reorder
+	std::vector<Node>& GetNodes() { return m_Nodes; }
+
+private:
+	struct Slot
+	{
+		uint32_t Position = INVALID_NODE_INDEX;	// in m_Nodes, INVALID_NODE_INDEX while free
+		uint32_t Generation = 0;
+		uint32_t Name = NameTable::INVALID_NAME;
+		uint32_t Parent = INVALID_NODE_INDEX;	// slots, INVALID_NODE_INDEX for none
+		uint32_t FirstChild = INVALID_NODE_INDEX;
+		uint32_t LastChild = INVALID_NODE_INDEX;
+		uint32_t PreviousSibling = INVALID_NODE_INDEX;
+		uint32_t NextSibling = INVALID_NODE_INDEX;
+		uint32_t NextFree = INVALID_NODE_INDEX;
+	};
+
+	NodeHandle Allocate(const std::string& name, uint32_t parent);
+	uint32_t GetSlot(NodeHandle handle) const;
+	uint32_t FindChildSlot(uint32_t parent, std::string_view name) const;
+	static uint64_t GetChildKey(uint32_t parent, uint32_t name) { return static_cast<uint64_t>(parent) << 32 | name; }
+	NodeHandle GetHandle(uint32_t slot) const;
+	void Unlink(uint32_t slot);
+	void Free(uint32_t slot);
+
+	std::vector<Slot> m_Slots;
+	uint32_t m_FreeSlot = INVALID_NODE_INDEX;
+	NodeHandle m_Root;
+	bool m_InOrder = true;
+
+	NameTable m_Names;
+	std::unordered_map<uint64_t, uint32_t> m_Children;	// parent slot and name to child slot
+
+	std::vector<Node> m_Nodes;
+	ComponentRegistry m_Components;
+
+	// kept between reorders so sorting allocates nothing once the scene stops growing
+	std::vector<Node> m_NodeScratch;
+	std::vector<uint32_t> m_PositionScratch;	// per slot, the sort keys of the components
+};
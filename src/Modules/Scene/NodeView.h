@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include "Node.h"
+
+class NodePool;
+
+// Allocation free ranges over the nodes of a NodePool. Like Node references
+// they are invalidated by any change to the topology.
+
+// Contiguous nodes in depth first order: the whole pool or one subtree
+class NodeRange
+{
+public:
+	NodeRange(Node* first, Node* last) : m_First(first), m_Last(last) {}
+
+	Node* begin() const { return m_First; }
+	Node* end() const { return m_Last; }
+	size_t size() const { return static_cast<size_t>(m_Last - m_First); }
+
+private:
+	Node* m_First;
+	Node* m_Last;
+};
+
+// Handles of the direct children of a node, following the sibling links.
+// Does not need the pool in order, so it also works between edits.
+class NodeChildView
+{
+public:
+	class Iterator
+	{
+	public:
+		Iterator(const NodePool* pool, NodeHandle node) : m_Pool(pool), m_Node(node) {}
+
+		NodeHandle operator*() const { return m_Node; }
+		Iterator& operator++();
+		bool operator==(const Iterator& other) const { return m_Node == other.m_Node; }
+		bool operator!=(const Iterator& other) const { return m_Node != other.m_Node; }
+
+	private:
+		const NodePool* m_Pool;
+		NodeHandle m_Node;
+	};
+
+	NodeChildView(const NodePool* pool, NodeHandle first) : m_Pool(pool), m_First(first) {}
+
+	Iterator begin() const { return Iterator(m_Pool, m_First); }
+	Iterator end() const { return Iterator(m_Pool, NodeHandle()); }
+	bool empty() const { return m_First.IsNull(); }
+
+private:
+	const NodePool* m_Pool;
+	NodeHandle m_First;
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "../Renderer/Vulkan/Mesh.h"
+#include "../Renderer/Vulkan/Material.h"
+#include "Camera.h"
+#include "Lighting/DirectionalLight.h"
+#include "Lighting/PointLight.h"
+
+// Immutable copy of everything the renderer needs to draw one frame.
+// Built by the simulation thread and handed to the render thread through a
+// TripleBuffer, so the renderer never touches the live SceneGraph.
+
+// World matrix split into translation, rotation and scale, so it can be
+// interpolated without shrinking rotated objects. Shear is dropped.
+struct WorldTransform
+{
+	glm::vec3 Translation = glm::vec3(0.0f);
+	glm::quat Rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 Scale = glm::vec3(1.0f);
+
+	static WorldTransform FromMatrix(const glm::mat4& matrix)
+	{
+		WorldTransform transform;
+		transform.Translation = glm::vec3(matrix[3]);
+		glm::mat3 basis(matrix);
+		transform.Scale = glm::vec3(glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]));
+		// a mirroring matrix keeps a proper rotation with one negative scale
+		if (glm::determinant(basis) < 0.0f)
+			transform.Scale.x = -transform.Scale.x;
+		for (int i = 0; i < 3; i++)
+			basis[i] = transform.Scale[i] != 0.0f ? basis[i] / transform.Scale[i] : glm::vec3(0.0f);
+		transform.Rotation = glm::normalize(glm::quat_cast(basis));
+		return transform;
+	}
+
+	glm::mat4 GetMatrix() const
+	{
+		glm::mat4 matrix = glm::mat4_cast(Rotation);
+		matrix[0] *= Scale.x;
+		matrix[1] *= Scale.y;
+		matrix[2] *= Scale.z;
+		matrix[3] = glm::vec4(Translation, 1.0f);
+		return matrix;
+	}
+
+	static WorldTransform Interpolate(const WorldTransform& from, const WorldTransform& to, float alpha)
+	{
+		WorldTransform transform;
+		transform.Translation = glm::mix(from.Translation, to.Translation, alpha);
+		transform.Rotation = glm::slerp(from.Rotation, to.Rotation, alpha);
+		transform.Scale = glm::mix(from.Scale, to.Scale, alpha);
+		return transform;
+	}
+};
+
+struct RenderItem
+{
+	Mesh* GPUMesh = nullptr;
+	Material* GPUMaterial = nullptr;
+	MaterialType Type = MaterialType::Default;
+	MaterialParameters Parameters;
+	glm::mat4 Model = glm::mat4(1.0f);
+	glm::mat4 Normal = glm::mat4(1.0f);		// of Model
+	// world transform at this and the previous snapshot, for interpolation
+	WorldTransform Current;
+	WorldTransform Previous;
+	bool Moved = false;						// Previous differs from Current
+};
+
+struct DirLightSnapshot
+{
+	glm::vec3 Direction = glm::vec3(0.0f, 0.0f, 1.0f);
+	DirectionalLight Light;
+};
+
+struct PointLightSnapshot
+{
+	glm::vec3 Position = glm::vec3(0.0f);
+	PointLight Light;
+};
+
+struct SceneSnapshot
+{
+	uint64_t Tick = 0;
+	double Time = 0.0;	// Time::Now() when the snapshot was published
+	double Step = 0.0;	// simulation step, 0 disables interpolation
+	Camera CurrentCamera;
+	Camera PreviousCamera;
+	DirLightSnapshot DirLight;
+	PointLightSnapshot PointLight;
+	std::vector<RenderItem> Items;
+};
+
+// Blend factor between the previous and current state for a frame rendered at renderTime
+inline float GetInterpolationAlpha(const SceneSnapshot& snapshot, double renderTime)
+{
+	if (snapshot.Step <= 0.0)
+		return 1.0f;
+
+	double alpha = (renderTime - snapshot.Time) / snapshot.Step;
+	return static_cast<float>(alpha < 0.0 ? 0.0 : (alpha > 1.0 ? 1.0 : alpha));
+}
@@ -0,0 +1,395 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Core/MappedFile.h"
+#include "../Core/ThreadPool.h"
+#include "../Modules/Renderer/Vulkan/MeshFile.h"
+#include "../Modules/Renderer/Vulkan/MeshOptimizer.h"
+#include "../Modules/Renderer/Vulkan/MeshSimplifier.h"
+#include "../Modules/Renderer/Vulkan/MeshletBuilder.h"
+#include "../Modules/Renderer/Vulkan/ProceduralMesh.h"
+
+// Offline converter and validator for .vsmesh files, loaded with zero copies
+// through Model(meshPath, material). Converted and generated meshes are
+// optimized for the vertex cache, overdraw and vertex fetch, and large ones
+// split into meshlets.
+//
+//   VulkanSandboxMeshTool convert resources/assets/meshes/*.obj
+//   VulkanSandboxMeshTool generate sphere:96 --out resources/assets/meshes/sphere.vsmesh
+//   VulkanSandboxMeshTool generate grid:1024x1024 --out resources/assets/meshes/terrain.vsmesh
+//   VulkanSandboxMeshTool validate resources/assets/meshes/*.vsmesh
+//   VulkanSandboxMeshTool analyze sphere:96 resources/assets/meshes/*.obj
+
+namespace
+{
+	struct ToolConfig
+	{
+		std::string Command;
+		std::string OutputPath;
+		std::vector<std::string> Inputs;
+		bool Optimize = true;
+		bool Packed = false;
+		bool Overdraw = true;
+		bool Lods = true;
+		bool Meshlets = true;
+		uint32_t CacheSize = VERTEX_CACHE_SIZE;
+	};
+
+	void PrintUsage()
+	{
+		std::cout <<
+			"usage: VulkanSandboxMeshTool <command> [options] <input>...\n"
+			"  convert <file.obj>...   Wavefront OBJ to .vsmesh next to the input\n"
+			"  generate <shape>        triangle, quad, cube or pyramid, or one of sphere, capsule,\n"
+			"                          torus, cylinder or grid with an optional :AxB tessellation\n"
+			"  validate <file>...      checks .vsmesh files, exits with 1 on any problem\n"
+			"  analyze <input>...      vertex cache ACMR / ATVR before and after optimizing and\n"
+			"                          meshlet sizes, inputs are .obj or .vsmesh files or generate shapes\n"
+			"  --out <file>            output path for a single input\n"
+			"  --no-optimize           write meshes in their original order\n"
+			"  --no-overdraw           optimize for the vertex cache only\n"
+			"  --packed                write 16 byte PackedVertex instead of Vertex\n"
+			"  --no-lods               write the full level of detail only\n"
+			"  --no-meshlets           skip meshlets, large meshes get them otherwise\n"
+			"  --cache <n>             simulated FIFO cache size (16)\n";
+	}
+
+	bool ParseArguments(int argc, char** argv, ToolConfig& config)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			if (arg == "--out")
+			{
+				if (i + 1 >= argc)
+					throw std::runtime_error("missing value for " + arg);
+				config.OutputPath = argv[++i];
+			}
+			else if (arg == "--cache")
+			{
+				if (i + 1 >= argc)
+					throw std::runtime_error("missing value for " + arg);
+				config.CacheSize = std::max(static_cast<uint32_t>(std::stoul(argv[++i])), 3u);
+			}
+			else if (arg == "--no-optimize")
+				config.Optimize = false;
+			else if (arg == "--no-overdraw")
+				config.Overdraw = false;
+			else if (arg == "--packed")
+				config.Packed = true;
+			else if (arg == "--no-lods")
+				config.Lods = false;
+			else if (arg == "--no-meshlets")
+				config.Meshlets = false;
+			else if (arg == "--help" || arg == "-h")
+			{
+				PrintUsage();
+				return false;
+			}
+			else if (arg.size() > 1 && arg[0] == '-')
+				throw std::runtime_error("unknown argument " + arg);
+			else if (config.Command.empty())
+				config.Command = arg;
+			else
+				config.Inputs.push_back(arg);
+		}
+
+		if (config.Command != "convert" && config.Command != "generate" && config.Command != "validate" && config.Command != "analyze")
+			throw std::runtime_error("unknown command " + config.Command);
+		if (config.Inputs.empty())
+			throw std::runtime_error("no inputs");
+		if (!config.OutputPath.empty() && config.Inputs.size() > 1)
+			throw std::runtime_error("--out needs a single input");
+		if (config.Command == "generate" && config.OutputPath.empty())
+			throw std::runtime_error("generate needs --out");
+		return true;
+	}
+
+	std::string GetOutputPath(const std::string& input)
+	{
+		size_t separator = input.find_last_of("/\\");
+		size_t dot = input.find_last_of('.');
+		if (dot == std::string::npos || (separator != std::string::npos && dot < separator))
+			return input + MESH_FILE_EXTENSION;
+		return input.substr(0, dot) + MESH_FILE_EXTENSION;
+	}
+
+	// 1-based OBJ index, negative values count back from the end
+	int ResolveIndex(int index, size_t count)
+	{
+		int resolved = index < 0 ? static_cast<int>(count) + index : index - 1;
+		if (resolved < 0 || resolved >= static_cast<int>(count))
+			throw std::runtime_error("face index " + std::to_string(index) + " out of range");
+		return resolved;
+	}
+
+	// Triangulated, with one vertex per distinct position / uv / normal triple.
+	// Missing normals are the area weighted average of the adjacent faces.
+	MeshData LoadObj(const std::string& filename)
+	{
+		std::ifstream file(filename);
+		if (!file)
+			throw std::runtime_error("Failed to open " + filename);
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texCoords;
+		std::vector<glm::vec3> normals;
+		std::unordered_map<std::string, uint32_t> vertexIds;
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		bool missingNormals = false;
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream stream(line);
+			std::string type;
+			stream >> type;
+			if (type == "v")
+			{
+				glm::vec3 position;
+				stream >> position.x >> position.y >> position.z;
+				positions.push_back(position);
+			}
+			else if (type == "vt")
+			{
+				glm::vec2 texCoord;
+				stream >> texCoord.x >> texCoord.y;
+				// OBJ puts v = 0 at the bottom, images start at the top
+				texCoords.push_back({ texCoord.x, 1.0f - texCoord.y });
+			}
+			else if (type == "vn")
+			{
+				glm::vec3 normal;
+				stream >> normal.x >> normal.y >> normal.z;
+				normals.push_back(normal);
+			}
+			else if (type == "f")
+			{
+				std::vector<uint32_t> face;
+				std::string corner;
+				while (stream >> corner)
+				{
+					auto found = vertexIds.find(corner);
+					if (found != vertexIds.end())
+					{
+						face.push_back(found->second);
+						continue;
+					}
+
+					// "p", "p/t", "p//n" or "p/t/n"
+					int ids[3] = { 0, 0, 0 };
+					size_t start = 0;
+					for (int part = 0; part < 3 && start <= corner.size(); part++)
+					{
+						size_t end = corner.find('/', start);
+						std::string value = corner.substr(start, end == std::string::npos ? std::string::npos : end - start);
+						if (!value.empty())
+							ids[part] = std::stoi(value);
+						if (end == std::string::npos)
+							break;
+						start = end + 1;
+					}
+
+					Vertex vertex{};
+					vertex.Position = positions[ResolveIndex(ids[0], positions.size())];
+					if (ids[1] != 0)
+						vertex.TexCoord = texCoords[ResolveIndex(ids[1], texCoords.size())];
+					if (ids[2] != 0)
+						vertex.Normal = normals[ResolveIndex(ids[2], normals.size())];
+					else
+						missingNormals = true;
+
+					uint32_t id = static_cast<uint32_t>(vertices.size());
+					vertices.push_back(vertex);
+					vertexIds.emplace(corner, id);
+					face.push_back(id);
+				}
+
+				// fan triangulation, fine for the convex polygons exporters write
+				for (size_t i = 2; i < face.size(); i++)
+				{
+					indices.push_back(face[0]);
+					indices.push_back(face[i - 1]);
+					indices.push_back(face[i]);
+				}
+			}
+		}
+
+		MeshData data;
+		data.Vertices = std::move(vertices);
+		data.Indices = std::move(indices);
+		if (missingNormals)
+			data.ComputeMissingNormals();
+		return data;
+	}
+
+	// Started with the first procedural shape, small ones stay on this thread
+	ThreadPool& GetThreadPool()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+	// shape[:A[xB]], a single count is used for both directions
+	MeshData Generate(const std::string& shape)
+	{
+		size_t colon = shape.find(':');
+		std::string name = shape.substr(0, colon);
+		if (name == "triangle") return MeshData::Triangle();
+		if (name == "quad") return MeshData::Quad();
+		if (name == "cube") return MeshData::Cube();
+		if (name == "pyramid") return MeshData::Pyramid();
+
+		ProceduralMeshDesc desc;
+		if (name == "sphere") desc = ProceduralMeshDesc::Sphere(36, 36);
+		else if (name == "capsule") desc = ProceduralMeshDesc::Capsule(36, 18);
+		else if (name == "torus") desc = ProceduralMeshDesc::Torus(48, 24);
+		else if (name == "cylinder") desc = ProceduralMeshDesc::Cylinder(36);
+		else if (name == "grid") desc = ProceduralMeshDesc::Grid(64, 64);
+		else throw std::runtime_error("unknown shape " + shape);
+
+		if (colon != std::string::npos)
+		{
+			std::string counts = shape.substr(colon + 1);
+			size_t separator = counts.find('x');
+			desc.Segments = static_cast<uint32_t>(std::stoul(counts.substr(0, separator)));
+			desc.Rings = separator == std::string::npos ? desc.Segments : static_cast<uint32_t>(std::stoul(counts.substr(separator + 1)));
+		}
+		return ProceduralMesh::Generate(desc, &GetThreadPool());
+	}
+
+	void Optimize(MeshData& data, const ToolConfig& config)
+	{
+		MeshOptimizer::OptimizeVertexCache(data, config.CacheSize);
+		if (config.Overdraw)
+			MeshOptimizer::OptimizeOverdraw(data, OVERDRAW_THRESHOLD, config.CacheSize);
+		MeshOptimizer::OptimizeVertexFetch(data);
+	}
+
+	void Write(MeshData data, const std::string& input, const std::string& output, const ToolConfig& config)
+	{
+		// levels already in a .vsmesh input are kept as they are
+		if (config.Lods && data.Lods.empty())
+			MeshSimplifier::GenerateLods(data);
+		if (config.Optimize)
+		{
+			// meshlets of a .vsmesh input do not survive the reordering
+			data.Meshlets = MeshletData();
+			Optimize(data, config);
+		}
+		if (!config.Meshlets)
+			data.Meshlets = MeshletData();
+		else if (data.Meshlets.IsEmpty() && MeshletBuilder::IsWorthBuilding(data))
+			MeshletBuilder::Build(data);
+		if (config.Packed)
+			data.Format = VertexFormat::Packed;
+		MeshFile::Write(output, data);
+		std::cout << input << " -> " << output << " (" << data.Vertices.size() << " vertices, "
+			<< (data.Lods.empty() ? data.Indices.size() : data.Lods[0].IndexCount) / 3 << " triangles, "
+			<< std::max<size_t>(data.Lods.size(), 1) << " levels, "
+			<< data.Meshlets.Meshlets.size() << " meshlets, ACMR "
+			<< MeshOptimizer::AnalyzeVertexCache(data, config.CacheSize).ACMR << ")" << std::endl;
+	}
+
+	MeshData Load(const std::string& input)
+	{
+		if (input.size() > 4 && input.compare(input.size() - 4, 4, ".obj") == 0)
+			return LoadObj(input);
+		if (input.find(MESH_FILE_EXTENSION) != std::string::npos)
+		{
+			MappedFile file(input);
+			return MeshFile::ToMeshData(MeshFile::Parse(file.GetData(), file.GetSize()));
+		}
+		return Generate(input);
+	}
+
+	// CPU only, so the gains can be checked on machines without a GPU
+	void Analyze(const std::string& input, const ToolConfig& config)
+	{
+		MeshData data = Load(input);
+		VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(data, config.CacheSize);
+		Optimize(data, config);
+		VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(data, config.CacheSize);
+
+		std::cout << input << ": " << before.Triangles << " triangles, " << before.Vertices << " vertices, cache " << config.CacheSize
+			<< "\n  ACMR " << before.ACMR << " -> " << after.ACMR
+			<< "\n  ATVR " << before.ATVR << " -> " << after.ATVR << std::endl;
+
+		// meshlets are built for any size here, to see how well a mesh would split
+		MeshletBuilder::Build(data);
+		const std::vector<Meshlet>& meshlets = data.Meshlets.Meshlets;
+		if (meshlets.empty())
+			return;
+		size_t coneCulled = std::count_if(meshlets.begin(), meshlets.end(), [](const Meshlet& meshlet) { return meshlet.ConeCutoff <= 1.0f; });
+		std::cout << "  " << meshlets.size() << " meshlets, "
+			<< static_cast<float>(data.Meshlets.Vertices.size()) / meshlets.size() << " vertices and "
+			<< static_cast<float>(data.Meshlets.Triangles.size() / 3) / meshlets.size() << " triangles on average, "
+			<< 100.0f * coneCulled / meshlets.size() << "% with a normal cone, ACMR in meshlet order "
+			<< MeshOptimizer::AnalyzeVertexCache(data, config.CacheSize).ACMR << std::endl;
+	}
+
+	bool Validate(const std::string& filename)
+	{
+		MappedFile file(filename);
+		std::vector<std::string> errors = MeshFile::Validate(file.GetData(), file.GetSize());
+		if (errors.empty())
+		{
+			const MeshFileHeader& header = *MeshFile::Parse(file.GetData(), file.GetSize()).Header;
+			std::cout << filename << ": ok, " << header.VertexCount << " vertices of " << header.VertexStride << " bytes, "
+				<< header.IndexCount << " " << header.IndexSize * 8 << "-bit indices, " << header.LodCount << " LODs, " << header.MeshletCount << " meshlets, "
+				<< file.GetSize() / 1024 << " KiB" << std::endl;
+			return true;
+		}
+
+		for (const std::string& error : errors)
+			std::cerr << filename << ": " << error << std::endl;
+		return false;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ToolConfig config;
+	try
+	{
+		if (!ParseArguments(argc, argv, config))
+			return EXIT_SUCCESS;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	int result = EXIT_SUCCESS;
+	for (const std::string& input : config.Inputs)
+	{
+		try
+		{
+			std::string output = config.OutputPath.empty() ? GetOutputPath(input) : config.OutputPath;
+			if (config.Command == "convert")
+				Write(LoadObj(input), input, output, config);
+			else if (config.Command == "generate")
+				Write(Generate(input), input, output, config);
+			else if (config.Command == "analyze")
+				Analyze(input, config);
+			else if (!Validate(input))
+				result = EXIT_FAILURE;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << input << ": " << e.what() << std::endl;
+			result = EXIT_FAILURE;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,223 @@
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+#include <stb_image.h>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "../Modules/Renderer/Vulkan/Ktx2.h"
+#include "../Modules/Renderer/Vulkan/MipChain.h"
+
+// Offline converter from JPG / PNG assets to KTX2 with a full, block compressed
+// mip chain. Texture::LoadFromFile picks up the .ktx2 next to the source image.
+//
+//   VulkanSandboxTextureTool resources/assets/images/*.jpg
+//   VulkanSandboxTextureTool --format bc5 --out normal.ktx2 normal.png
+
+namespace
+{
+	enum class OutputFormat
+	{
+		Auto,	// BC1 for opaque images, BC3 when there is alpha
+		BC1,
+		BC3,
+		BC5,
+		RGBA
+	};
+
+	struct ToolConfig
+	{
+		OutputFormat Format = OutputFormat::Auto;
+		bool Linear = false;
+		bool Mipmaps = true;
+		std::string OutputPath;
+		std::vector<std::string> Inputs;
+	};
+
+	void PrintUsage()
+	{
+		std::cout <<
+			"usage: VulkanSandboxTextureTool [options] <image>...\n"
+			"  --format <f>   auto, bc1, bc3, bc5 (two channel, normal maps) or rgba (auto)\n"
+			"  --linear       store colour as UNORM instead of sRGB\n"
+			"  --no-mips      only write the base level\n"
+			"  --out <file>   output path for a single input (image name with .ktx2)\n";
+	}
+
+	bool ParseArguments(int argc, char** argv, ToolConfig& config)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			auto next = [&]() -> const char*
+			{
+				if (i + 1 >= argc)
+					throw std::runtime_error("missing value for " + arg);
+				return argv[++i];
+			};
+
+			if (arg == "--format")
+			{
+				std::string format = next();
+				if (format == "auto") config.Format = OutputFormat::Auto;
+				else if (format == "bc1") config.Format = OutputFormat::BC1;
+				else if (format == "bc3") config.Format = OutputFormat::BC3;
+				else if (format == "bc5") config.Format = OutputFormat::BC5;
+				else if (format == "rgba") config.Format = OutputFormat::RGBA;
+				else throw std::runtime_error("unknown format " + format);
+			}
+			else if (arg == "--linear") config.Linear = true;
+			else if (arg == "--no-mips") config.Mipmaps = false;
+			else if (arg == "--out") config.OutputPath = next();
+			else if (arg == "--help" || arg == "-h")
+			{
+				PrintUsage();
+				return false;
+			}
+			else if (arg.size() > 1 && arg[0] == '-')
+				throw std::runtime_error("unknown argument " + arg);
+			else
+				config.Inputs.push_back(arg);
+		}
+
+		if (config.Inputs.empty())
+			throw std::runtime_error("no input images");
+		if (!config.OutputPath.empty() && config.Inputs.size() > 1)
+			throw std::runtime_error("--out needs a single input");
+		return true;
+	}
+
+	std::string GetOutputPath(const std::string& input)
+	{
+		size_t separator = input.find_last_of("/\\");
+		size_t dot = input.find_last_of('.');
+		if (dot == std::string::npos || (separator != std::string::npos && dot < separator))
+			return input + ".ktx2";
+		return input.substr(0, dot) + ".ktx2";
+	}
+
+	bool HasAlpha(const uint8_t* pixels, uint32_t width, uint32_t height)
+	{
+		for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+			if (pixels[i * 4 + 3] != 255)
+				return true;
+		return false;
+	}
+
+	vk::Format GetVulkanFormat(OutputFormat format, bool linear)
+	{
+		switch (format)
+		{
+		case OutputFormat::BC1: return linear ? vk::Format::eBc1RgbUnormBlock : vk::Format::eBc1RgbSrgbBlock;
+		case OutputFormat::BC3: return linear ? vk::Format::eBc3UnormBlock : vk::Format::eBc3SrgbBlock;
+		case OutputFormat::BC5: return vk::Format::eBc5UnormBlock;
+		default: return linear ? vk::Format::eR8G8B8A8Unorm : vk::Format::eR8G8B8A8Srgb;
+		}
+	}
+
+	// Compresses one RGBA8 level in 4x4 blocks, edge texels are repeated for partial blocks
+	std::vector<uint8_t> EncodeLevel(const uint8_t* pixels, uint32_t width, uint32_t height, OutputFormat format)
+	{
+		if (format == OutputFormat::RGBA)
+			return std::vector<uint8_t>(pixels, pixels + static_cast<size_t>(width) * height * 4);
+
+		uint32_t blockBytes = format == OutputFormat::BC1 ? 8 : 16;
+		uint32_t blocksX = (width + 3) / 4;
+		uint32_t blocksY = (height + 3) / 4;
+		std::vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+
+		uint8_t rgba[16 * 4];
+		uint8_t rg[16 * 2];
+		for (uint32_t by = 0; by < blocksY; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					uint32_t x = std::min(bx * 4 + i % 4, width - 1);
+					uint32_t y = std::min(by * 4 + i / 4, height - 1);
+					const uint8_t* texel = pixels + (static_cast<size_t>(y) * width + x) * 4;
+					memcpy(rgba + i * 4, texel, 4);
+					rg[i * 2] = texel[0];
+					rg[i * 2 + 1] = texel[1];
+				}
+
+				uint8_t* destination = blocks.data() + (static_cast<size_t>(by) * blocksX + bx) * blockBytes;
+				if (format == OutputFormat::BC5)
+					stb_compress_bc5_block(destination, rg);
+				else
+					stb_compress_dxt_block(destination, rgba, format == OutputFormat::BC3 ? 1 : 0, STB_DXT_HIGHQUAL);
+			}
+		}
+		return blocks;
+	}
+
+	void Convert(const ToolConfig& config, const std::string& input, const std::string& output)
+	{
+		int width, height, channels;
+		stbi_uc* pixels = stbi_load(input.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if (!pixels)
+			throw std::runtime_error("Failed to load " + input + ": " + stbi_failure_reason());
+
+		OutputFormat format = config.Format;
+		if (format == OutputFormat::Auto)
+			format = HasAlpha(pixels, width, height) ? OutputFormat::BC3 : OutputFormat::BC1;
+		bool linear = config.Linear || format == OutputFormat::BC5;
+
+		std::vector<MipLevel> levels;
+		std::vector<uint8_t> chain = BuildMipChain(pixels, width, height, !linear, levels);
+		stbi_image_free(pixels);
+		if (!config.Mipmaps)
+			levels.resize(1);
+
+		std::vector<std::vector<uint8_t>> encoded;
+		size_t encodedBytes = 0;
+		for (const MipLevel& level : levels)
+		{
+			encoded.push_back(EncodeLevel(chain.data() + level.Offset, level.Width, level.Height, format));
+			encodedBytes += encoded.back().size();
+		}
+
+		vk::Format vulkanFormat = GetVulkanFormat(format, linear);
+		Ktx2::Write(output, vulkanFormat, width, height, encoded);
+
+		size_t rgbaBytes = config.Mipmaps ? chain.size() : static_cast<size_t>(width) * height * 4;
+		std::cout << input << " -> " << output << " (" << vk::to_string(vulkanFormat) << ", "
+			<< width << "x" << height << ", " << levels.size() << " levels, "
+			<< encodedBytes / 1024 << " KiB, " << static_cast<float>(rgbaBytes) / encodedBytes << "x smaller than RGBA8)" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ToolConfig config;
+	try
+	{
+		if (!ParseArguments(argc, argv, config))
+			return EXIT_SUCCESS;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	int result = EXIT_SUCCESS;
+	for (const std::string& input : config.Inputs)
+	{
+		try
+		{
+			Convert(config, input, config.OutputPath.empty() ? GetOutputPath(input) : config.OutputPath);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+			result = EXIT_FAILURE;
+		}
+	}
+	return result;
+}